@@ -83,21 +83,22 @@ static void drawPolyBoundaries(duDebugDraw* dd, const dtMeshTile* tile,
 				if (p->neis[j] != 0) continue;
 			}
 			
-			const float* v0 = &tile->verts[p->verts[j]*3];
-			const float* v1 = &tile->verts[p->verts[(j+1) % nj]*3];
+			float v0[3], v1[3];
+			dtGetTileVert(tile, p->verts[j], v0);
+			dtGetTileVert(tile, p->verts[(j+1) % nj], v1);
 			
 			// Draw detail mesh edges which align with the actual poly edge.
 			// This is really slow.
 			for (int k = 0; k < pd->triCount; ++k)
 			{
 				const unsigned char* t = &tile->detailTris[(pd->triBase+k)*4];
-				const float* tv[3];
+				float tv[3][3];
 				for (int m = 0; m < 3; ++m)
 				{
 					if (t[m] < p->vertCount)
-						tv[m] = &tile->verts[p->verts[t[m]]*3];
+						dtGetTileVert(tile, p->verts[t[m]], tv[m]);
 					else
-						tv[m] = &tile->detailVerts[(pd->vertBase+(t[m]-p->vertCount))*3];
+						dtGetTileDetailVert(tile, pd->vertBase+(t[m]-p->vertCount), tv[m]);
 				}
 				for (int m = 0, n = 2; m < 3; n=m++)
 				{
@@ -152,10 +153,12 @@ static void drawMeshTile(duDebugDraw* dd, const dtNavMesh& mesh, const dtNavMesh
 			const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
 			for (int k = 0; k < 3; ++k)
 			{
+				float v[3];
 				if (t[k] < p->vertCount)
-					dd->vertex(&tile->verts[p->verts[t[k]]*3], col);
+					dtGetTileVert(tile, p->verts[t[k]], v);
 				else
-					dd->vertex(&tile->detailVerts[(pd->vertBase+t[k]-p->vertCount)*3], col);
+					dtGetTileDetailVert(tile, pd->vertBase+t[k]-p->vertCount, v);
+				dd->vertex(v, col);
 			}
 		}
 	}
@@ -183,8 +186,9 @@ static void drawMeshTile(duDebugDraw* dd, const dtNavMesh& mesh, const dtNavMesh
 				col = duDarkenCol(duTransCol(dd->areaToCol(p->getArea()), 220));
 
 			const dtOffMeshConnection* con = &tile->offMeshCons[i - tile->header->offMeshBase];
-			const float* va = &tile->verts[p->verts[0]*3];
-			const float* vb = &tile->verts[p->verts[1]*3];
+			float va[3], vb[3];
+			dtGetTileVert(tile, p->verts[0], va);
+			dtGetTileVert(tile, p->verts[1], vb);
 
 			// Check to see if start and end end-points have links.
 			bool startSet = false;
@@ -226,7 +230,8 @@ static void drawMeshTile(duDebugDraw* dd, const dtNavMesh& mesh, const dtNavMesh
 	dd->begin(DU_DRAW_POINTS, 3.0f);
 	for (int i = 0; i < tile->header->vertCount; ++i)
 	{
-		const float* v = &tile->verts[i*3];
+		float v[3];
+		dtGetTileVert(tile, i, v);
 		dd->vertex(v[0], v[1], v[2], vcol);
 	}
 	dd->end();
@@ -357,8 +362,9 @@ static void drawMeshTilePortal(duDebugDraw* dd, const dtMeshTile* tile)
 					continue;
 				
 				// Create new links
-				const float* va = &tile->verts[poly->verts[j]*3];
-				const float* vb = &tile->verts[poly->verts[(j+1) % nv]*3];
+				float va[3], vb[3];
+				dtGetTileVert(tile, poly->verts[j], va);
+				dtGetTileVert(tile, poly->verts[(j+1) % nv], vb);
 				
 				if (side == 0 || side == 4)
 				{
@@ -472,10 +478,12 @@ void duDebugDrawNavMeshPoly(duDebugDraw* dd, const dtNavMesh& mesh, dtPolyRef re
 			const unsigned char* t = &tile->detailTris[(pd->triBase+i)*4];
 			for (int j = 0; j < 3; ++j)
 			{
+				float v[3];
 				if (t[j] < poly->vertCount)
-					dd->vertex(&tile->verts[poly->verts[t[j]]*3], c);
+					dtGetTileVert(tile, poly->verts[t[j]], v);
 				else
-					dd->vertex(&tile->detailVerts[(pd->vertBase+t[j]-poly->vertCount)*3], c);
+					dtGetTileDetailVert(tile, pd->vertBase+t[j]-poly->vertCount, v);
+				dd->vertex(v, c);
 			}
 		}
 		dd->end();
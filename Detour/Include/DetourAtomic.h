@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURATOMIC_H
+#define DETOURATOMIC_H
+
+// Note: This header file's only purpose is to define the atomic loads and stores
+// used to publish data from a single writer thread to concurrent readers.
+// Feel free to change the file and include your own implementation instead.
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/// Loads a pointer or an integer value with acquire semantics.
+///  @param[in]		ptr		The value to load.
+/// @return The loaded value.
+template<class T> inline T dtAtomicLoad(const T* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+
+/// Stores a pointer or an integer value with release semantics.
+///  @param[in]		ptr		The value to store to.
+///  @param[in]		value	The value to store.
+template<class T> inline void dtAtomicStore(T* ptr, T value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+
+#elif defined(_MSC_VER)
+
+// With /volatile:ms, the default on x86 and x64, volatile accesses have acquire and release semantics.
+template<class T> inline T dtAtomicLoad(const T* ptr) { return *(const volatile T*)ptr; }
+template<class T> inline void dtAtomicStore(T* ptr, T value) { *(volatile T*)ptr = value; }
+
+#else
+
+// Unknown compiler, the accesses are not ordered and concurrent readers are not supported.
+template<class T> inline T dtAtomicLoad(const T* ptr) { return *ptr; }
+template<class T> inline void dtAtomicStore(T* ptr, T value) { *ptr = value; }
+
+#endif
+
+#endif // DETOURATOMIC_H
@@ -60,6 +60,11 @@ typedef unsigned int dtTileRef;
 /// @ingroup detour
 static const int DT_VERTS_PER_POLYGON = 6;
 
+/// The number of changed tiles the users of the navigation mesh fetch at once.
+/// @ingroup detour
+/// @see dtNavMesh::getChangedTiles
+static const int DT_MAX_TILE_CHANGES = 256;
+
 /// @{
 /// @name Tile Serialization Constants
 /// These constants are used to detect whether a navigation tile's data
@@ -72,6 +77,10 @@ static const int DT_NAVMESH_MAGIC = 'D'<<24 | 'N'<<16 | 'A'<<8 | 'V';
 /// A version number used to detect compatibility of navigation tile data.
 static const int DT_NAVMESH_VERSION = 7;
 
+/// A magic number used to detect navigation tile data stored with quantized vertices.
+/// @see dtQuantizeNavMeshData
+static const int DT_NAVMESH_QUANTIZED_MAGIC = 'D'<<24 | 'N'<<16 | 'A'<<8 | 'Q';
+
 /// A magic number used to detect the compatibility of navigation tile states.
 static const int DT_NAVMESH_STATE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'S';
 
@@ -276,6 +285,15 @@ struct dtMeshHeader
 	float bvQuantFactor;
 };
 
+/// Quantization parameters stored after the header of quantized tile data.
+/// @see dtQuantizeNavMeshData
+/// @ingroup detour
+struct dtMeshQuantHeader
+{
+	float cs;		///< The xz-plane cell size used for quantization.
+	float ch;		///< The y-axis cell height used for quantization.
+};
+
 /// Defines a navigation mesh tile.
 /// @ingroup detour
 struct dtMeshTile
@@ -285,11 +303,17 @@ struct dtMeshTile
 	unsigned int linksFreeList;			///< Index to the next free link.
 	dtMeshHeader* header;				///< The tile header.
 	dtPoly* polys;						///< The tile polygons. [Size: dtMeshHeader::polyCount]
-	float* verts;						///< The tile vertices. [(x, y, z) * dtMeshHeader::vertCount]
+	
+	/// The tile vertices. [(x, y, z) * dtMeshHeader::vertCount]
+	/// For quantized tiles, only the off-mesh connection vertices. [(x, y, z) * 2 * dtMeshHeader::offMeshConCount]
+	/// Use dtGetTileVert to read the vertices of any tile.
+	float* verts;
+	
 	dtLink* links;						///< The tile links. [Size: dtMeshHeader::maxLinkCount]
 	dtPolyDetail* detailMeshes;			///< The tile's detail sub-meshes. [Size: dtMeshHeader::detailMeshCount]
 	
 	/// The detail mesh's unique vertices. [(x, y, z) * dtMeshHeader::detailVertCount]
+	/// (Null for quantized tiles, use dtGetTileDetailVert to read the vertices of any tile.)
 	float* detailVerts;	
 
 	/// The detail mesh's triangles. [(vertA, vertB, vertC, triFlags) * dtMeshHeader::detailTriCount].
@@ -301,11 +325,21 @@ struct dtMeshTile
 	dtBVNode* bvTree;
 
 	dtOffMeshConnection* offMeshCons;		///< The tile off-mesh connections. [Size: dtMeshHeader::offMeshConCount]
+	
+	/// The quantized polygon vertices, relative to dtMeshHeader::bmin. (Null unless the tile was added from quantized data.)
+	/// [(x, y, z) * (dtMeshHeader::vertCount - 2 * dtMeshHeader::offMeshConCount)]
+	unsigned short* quantVerts;
+	
+	/// The quantized detail mesh vertices, relative to dtMeshHeader::bmin. (Null unless the tile was added from quantized data.)
+	/// [(x, y, z) * dtMeshHeader::detailVertCount]
+	unsigned short* quantDetailVerts;
+	
+	float quantScale[3];					///< The size of a quantization step along each axis. [(cs, ch, cs)]
 		
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
 	int dataSize;							///< Size of the tile data.
 	int flags;								///< Tile flags. (See: #dtTileFlags)
-	dtMeshTile* next;						///< The next free tile, or the next tile in the spatial grid.
+	dtMeshTile* next;						///< The next tile in the same spatial grid bucket. (Free tiles are kept in a separate list.)
 private:
 	dtMeshTile(const dtMeshTile&);
 	dtMeshTile& operator=(const dtMeshTile&);
@@ -320,6 +354,97 @@ inline int dtGetDetailTriEdgeFlags(unsigned char triFlags, int edgeIndex)
 	return (triFlags >> (edgeIndex * 2)) & 0x3;
 }
 
+/// Gets a polygon vertex of a tile, decoding it if the tile stores quantized vertices.
+///  @param[in]		tile	The tile.
+///  @param[in]		i		The index of the vertex. [Limit: < dtMeshHeader::vertCount]
+///  @param[out]	v		The vertex. [(x, y, z)]
+inline void dtGetTileVert(const dtMeshTile* tile, const int i, float* v)
+{
+	int vi = i;
+	if (tile->quantVerts)
+	{
+		// The off-mesh connection vertices follow the quantized vertices.
+		const int nquant = tile->header->vertCount - tile->header->offMeshConCount*2;
+		if (i < nquant)
+		{
+			const unsigned short* q = &tile->quantVerts[i*3];
+			const float* orig = tile->header->bmin;
+			v[0] = orig[0] + q[0] * tile->quantScale[0];
+			v[1] = orig[1] + q[1] * tile->quantScale[1];
+			v[2] = orig[2] + q[2] * tile->quantScale[2];
+			return;
+		}
+		vi -= nquant;
+	}
+	const float* src = &tile->verts[vi*3];
+	v[0] = src[0];
+	v[1] = src[1];
+	v[2] = src[2];
+}
+
+/// Gets a detail mesh vertex of a tile, decoding it if the tile stores quantized vertices.
+///  @param[in]		tile	The tile.
+///  @param[in]		i		The index of the vertex. [Limit: < dtMeshHeader::detailVertCount]
+///  @param[out]	v		The vertex. [(x, y, z)]
+inline void dtGetTileDetailVert(const dtMeshTile* tile, const int i, float* v)
+{
+	if (tile->quantDetailVerts)
+	{
+		const unsigned short* q = &tile->quantDetailVerts[i*3];
+		const float* orig = tile->header->bmin;
+		v[0] = orig[0] + q[0] * tile->quantScale[0];
+		v[1] = orig[1] + q[1] * tile->quantScale[1];
+		v[2] = orig[2] + q[2] * tile->quantScale[2];
+		return;
+	}
+	const float* src = &tile->detailVerts[i*3];
+	v[0] = src[0];
+	v[1] = src[1];
+	v[2] = src[2];
+}
+
+/// Provides an interface for the codec used to store tiles compressed in a navigation mesh.
+/// @see dtNavMesh::setTileCompressor, dtNavMesh::compressTile
+/// @ingroup detour
+struct dtNavMeshTileCompressor
+{
+	virtual ~dtNavMeshTileCompressor();
+
+	virtual int maxCompressedSize(const int bufferSize) = 0;
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize) = 0;
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize) = 0;
+};
+
+/// Statistics about the compressed tiles of a navigation mesh.
+/// @see dtNavMesh::getCompressionStats
+/// @ingroup detour
+struct dtNavMeshCompressionStats
+{
+	int compressedTileCount;		///< The number of tiles currently stored compressed.
+	int hitCount;					///< The number of dtNavMesh::touchTileAndPolyByRef calls which found the tile decompressed.
+	int missCount;					///< The number of dtNavMesh::touchTileAndPolyByRef calls which had to decompress the tile.
+	size_t uncompressedSize;		///< The total size of the compressed tiles when decompressed. [Unit: bytes]
+	size_t compressedSize;			///< The total size of the compressed tile data. [Unit: bytes]
+};
+
+/// Memory used by a navigation mesh, broken down by category.
+/// @see dtNavMesh::getMemoryUsage
+/// @ingroup detour
+struct dtNavMeshMemoryUsage
+{
+	size_t tileHeaders;		///< The tile headers. [Unit: bytes]
+	size_t polys;			///< The polygons and their vertices. [Unit: bytes]
+	size_t links;			///< The polygon link pools. [Unit: bytes]
+	size_t detailMeshes;	///< The detail meshes, vertices and triangles. [Unit: bytes]
+	size_t bvTrees;			///< The bounding volume trees. [Unit: bytes]
+	size_t offMeshCons;		///< The off-mesh connections. [Unit: bytes]
+	size_t lookup;			///< The tile array, the tile position lookup and the active tile list. [Unit: bytes]
+	size_t compressedTiles;	///< The data of the compressed tiles and their bookkeeping. [Unit: bytes]
+	size_t total;			///< The sum of all the categories above. [Unit: bytes]
+};
+
 /// Configuration parameters used to define multi-tile navigation meshes.
 /// The values are used to allocate space during the initialization of a navigation mesh.
 /// @see dtNavMesh::init()
@@ -376,6 +501,75 @@ public:
 	/// @return The status flags for the operation.
 	dtStatus removeTile(dtTileRef ref, unsigned char** data, int* dataSize);
 
+	/// Gets the number of tile changes made to the navigation mesh since it was initialized.
+	/// Adding, removing, compressing and decompressing a tile, and changing the flags
+	/// or area of its polygons are changes. Adding or removing a tile also changes the
+	/// links of the neighbour tiles, and changing a polygon changes the tiles it is
+	/// linked to, so these are changed too.
+	/// @return The number of tile changes.
+	unsigned int getTileChangeCount() const;
+
+	/// Gets the indices of the tiles changed since the specified change count.
+	/// Each changed tile is returned once, in the order of the tile indices.
+	///  @param[in]		since		The change count the caller has seen last. (See: #getTileChangeCount)
+	///  @param[out]	tiles		The tile indices. [(index) * maxTiles]
+	///  @param[in]		maxTiles	The maximum number of tile indices to return.
+	/// @return The number of tile indices returned, or -1 if more than @p maxTiles
+	///			tiles were changed since @p since.
+	int getChangedTiles(const unsigned int since, int* tiles, const int maxTiles) const;
+
+	/// @}
+
+	/// @{
+	/// @name Tile Compression
+
+	/// Sets the codec used to compress and decompress tiles.
+	///  @param[in]	comp	The compressor. The navigation mesh does not take ownership. [opt]
+	void setTileCompressor(dtNavMeshTileCompressor* comp);
+
+	/// Disconnects the specified tile and keeps its data in compressed form.
+	///  @param[in]	ref		The reference of the tile to compress.
+	/// @return The status flags for the operation.
+	dtStatus compressTile(dtTileRef ref);
+
+	/// Decompresses the specified tile and connects it back to the navigation mesh.
+	///  @param[in]	ref		The reference of the compressed tile.
+	/// @return The status flags for the operation.
+	dtStatus decompressTile(dtTileRef ref);
+
+	/// Checks whether the specified tile is stored compressed.
+	///  @param[in]	ref		The tile reference.
+	/// @return True if the tile is compressed.
+	bool isTileCompressed(dtTileRef ref) const;
+
+	/// Gets the tile and polygon for the specified polygon reference, decompressing the tile if needed.
+	///  @param[in]		ref		The reference for the a polygon.
+	///  @param[out]	tile	The tile containing the polygon.
+	///  @param[out]	poly	The polygon.
+	/// @return The status flags for the operation.
+	dtStatus touchTileAndPolyByRef(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly);
+
+	/// Gets the statistics of the compressed tiles.
+	///  @param[out]	stats	The compression statistics.
+	void getCompressionStats(dtNavMeshCompressionStats* stats) const;
+
+	/// @}
+
+	/// @{
+	/// @name Memory Usage
+
+	/// Gets the memory currently used by the navigation mesh.
+	///  @param[out]	usage	The memory usage per category.
+	void getMemoryUsage(dtNavMeshMemoryUsage* usage) const;
+
+	/// Gets the highest memory usage of each category since the navigation mesh was initialized
+	/// or since the last call to #resetPeakMemoryUsage.
+	///  @param[out]	peak	The peak memory usage per category.
+	void getPeakMemoryUsage(dtNavMeshMemoryUsage* peak) const;
+
+	/// Resets the peak memory usage to the current memory usage.
+	void resetPeakMemoryUsage();
+
 	/// @}
 
 	/// @{
@@ -418,7 +612,7 @@ public:
 	/// Gets the tile for the specified tile reference.
 	///  @param[in]	ref		The tile reference of the tile to retrieve.
 	/// @return The tile for the specified reference, or null if the 
-	///		reference is invalid.
+	///		reference is invalid or the tile is compressed.
 	const dtMeshTile* getTileByRef(dtTileRef ref) const;
 	
 	/// The maximum number of tiles supported by the navigation mesh.
@@ -616,6 +810,27 @@ private:
 	/// Returns pointer to tile in the tile array.
 	dtMeshTile* getTile(int i);
 
+	/// Inserts the tile into the lookups and connects it to its neighbours.
+	void linkTile(dtMeshTile* tile, unsigned char* data, int dataSize, int flags);
+
+	/// Removes the tile from the lookups and disconnects it from its neighbours.
+	void unlinkTile(dtMeshTile* tile);
+
+	/// Returns true if no tile slot was relinked into the position lookup since @p seq was read.
+	bool isTileLookupStable(const unsigned int seq) const;
+
+	/// Records a change of the tile in the tile change log.
+	void recordTileChange(const dtMeshTile* tile);
+
+	/// Records a change of the polygon for its tile and the tiles it is linked to.
+	void recordPolyChange(const dtMeshTile* tile, const dtPoly* poly);
+
+	/// Adds (or removes if @p add is false) the tile data described by the header to the memory usage.
+	void accountTileMemory(const dtMeshHeader* header, bool add);
+
+	/// Updates the peak memory usage from the current memory usage.
+	void updatePeakMemoryUsage();
+
 	/// Returns neighbour tile based on side.
 	int getTilesAt(const int x, const int y,
 				   dtMeshTile** tiles, const int maxTiles) const;
@@ -664,8 +879,23 @@ private:
 	int m_tileLutMask;					///< Tile hash lookup mask.
 
 	dtMeshTile** m_posLookup;			///< Tile hash lookup.
-	dtMeshTile* m_nextFree;				///< Freelist of tiles.
+	unsigned int m_tileLookupSeq;		///< Odd while a tile slot is being relinked into the hash lookup.
+	dtMeshTile** m_freeTiles;			///< Stack of free tiles.
+	int m_freeTileCount;				///< Number of tiles in the free stack.
 	dtMeshTile* m_tiles;				///< List of tiles.
+
+	dtMeshTile** m_activeTiles;			///< Compact list of tiles which hold data, used by wide area queries.
+	int* m_activeTileIndex;				///< Index of each tile in the active list, or -1 if the tile is free.
+	int m_activeTileCount;				///< Number of tiles in the active list.
+
+	dtNavMeshTileCompressor* m_tileComp;			///< Codec used for compressed tiles.
+	struct dtCompressedTile* m_compressedTiles;		///< Compressed data per tile, allocated on first use.
+	dtNavMeshCompressionStats m_compressionStats;	///< Statistics of the compressed tiles.
+	dtNavMeshMemoryUsage m_memoryUsage;				///< Current memory usage.
+	dtNavMeshMemoryUsage m_peakMemoryUsage;			///< Peak memory usage.
+
+	unsigned int* m_tileChangeStamps;			///< The change count after the last change of each tile, 0 if never changed. [Size: #m_maxTiles]
+	unsigned int m_tileChangeCount;				///< Number of tile changes so far.
 		
 #ifndef DT_POLYREF64
 	unsigned int m_saltBits;			///< Number of salt bits in the tile ID.
@@ -122,6 +122,26 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int dataSize);
 ///  @param[in]		dataSize	The size of the data array.
 bool dtNavMeshDataSwapEndian(unsigned char* data, const int dataSize);
 
+/// Converts navigation mesh tile data into the compact quantized format.
+///  @param[in]		data		The tile data array. (See: #dtCreateNavMeshData)
+///  @param[in]		dataSize	The size of the data array.
+///  @param[in]		cs			The xz-plane cell size used to build the tile. [Limit: > 0] [Unit: wu]
+///  @param[in]		ch			The y-axis cell height used to build the tile. [Limit: > 0] [Unit: wu]
+///  @param[out]	outData		The resulting quantized tile data.
+///  @param[out]	outDataSize	The size of the quantized tile data array.
+/// @return True if the quantized data was successfully created.
+bool dtQuantizeNavMeshData(const unsigned char* data, const int dataSize, const float cs, const float ch,
+						   unsigned char** outData, int* outDataSize);
+
+/// Converts quantized navigation mesh tile data back into the regular tile format.
+///  @param[in]		data		The quantized tile data array. (See: #dtQuantizeNavMeshData)
+///  @param[in]		dataSize	The size of the data array.
+///  @param[out]	outData		The resulting tile data.
+///  @param[out]	outDataSize	The size of the tile data array.
+/// @return True if the tile data was successfully created.
+bool dtDequantizeNavMeshData(const unsigned char* data, const int dataSize,
+							 unsigned char** outData, int* outDataSize);
+
 #endif // DETOURNAVMESHBUILDER_H
 
 // This section contains detailed documentation for members that don't have
@@ -145,5 +165,22 @@ function.
 
 @see dtCreateNavMeshData
 
+@fn bool dtQuantizeNavMeshData(const unsigned char* data, const int dataSize, const float cs, const float ch, unsigned char** outData, int* outDataSize)
+@par
+
+The quantized format stores the polygon and detail mesh vertices as 16-bit cell
+coordinates relative to the tile's minimum bounds. Polygon vertices are stored
+losslessly when @p cs and @p ch match the values used to build the tile. Detail
+vertices are snapped to the nearest cell. The off-mesh connection vertices are
+kept as floats, they can lie outside of the tile.
+
+Quantized data can be passed directly to dtNavMesh::addTile. The tile keeps the
+quantized vertices in memory and the queries decode them on use, see dtGetTileVert
+and dtGetTileDetailVert.
+
+The output data array is allocated using the detour allocator (dtAlloc()).
+
+@see dtDequantizeNavMeshData, dtNavMesh::addTile
+
 */
 
@@ -159,6 +159,19 @@ public:
 	virtual void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count) = 0;
 };
 
+/// Memory used by a navigation mesh query object, broken down by category.
+/// @see dtNavMeshQuery::getMemoryUsage
+/// @ingroup detour
+struct dtNavMeshQueryMemoryUsage
+{
+	size_t nodePool;		///< The node pool used by the path searches. [Unit: bytes]
+	size_t tinyNodePool;	///< The small node pool used by the local searches. [Unit: bytes]
+	size_t openList;		///< The open list of the path searches. [Unit: bytes]
+	size_t total;			///< The sum of all the categories above, including the query object itself. [Unit: bytes]
+	int maxNodes;			///< The number of nodes in the node pool.
+	int peakNodeCount;		///< The highest number of nodes used by a single path search.
+};
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -308,6 +321,19 @@ public:
 	///  				be used immediately after one of the two Dijkstra searches, findPolysAroundCircle or findPolysAroundShape.
 	dtStatus getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const;
 
+	/// Expands a Dijkstra search made backwards from a goal polygon, as used to build flow fields.
+	/// The search state lives in the provided node pool and open list instead of the query object,
+	/// so the search can be spread over several calls and its result kept.
+	/// The parent of each node is the next polygon on the cheapest path to the goal.
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[in,out]	nodePool	The nodes of the search.
+	///  @param[in,out]	openList	The open list of the search, initially holding the goal node.
+	///  @param[in]		maxIter		The maximum number of polygons to expand.
+	///  @param[out]	doneIters	The number of polygons expanded. [opt]
+	/// @returns The status flags for the query. #DT_IN_PROGRESS until the open list is empty.
+	dtStatus updateReverseDijkstraSearch(const dtQueryFilter* filter, class dtNodePool* nodePool,
+										 class dtNodeQueue* openList, const int maxIter, int* doneIters) const;
+
 	/// @}
 	/// @name Local Query Functions
 	///@{
@@ -516,6 +542,10 @@ public:
 	/// @returns The node pool.
 	class dtNodePool* getNodePool() const { return m_nodePool; }
 	
+	/// Gets the memory used by the query object.
+	///  @param[out]	usage	The memory usage per category.
+	void getMemoryUsage(dtNavMeshQueryMemoryUsage* usage) const;
+	
 	/// Gets the navigation mesh the query object is using.
 	/// @return The navigation mesh the query object is using.
 	const dtNavMesh* getAttachedNavMesh() const { return m_nav; }
@@ -92,6 +92,9 @@ public:
 	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
 	inline int getNodeCount() const { return m_nodeCount; }
 	
+	/// The highest number of nodes used by a single search since the pool was created.
+	inline int getPeakNodeCount() const { return m_nodeCount > m_peakNodeCount ? m_nodeCount : m_peakNodeCount; }
+	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtNodePool(const dtNodePool&);
@@ -103,6 +106,7 @@ private:
 	const int m_maxNodes;
 	const int m_hashSize;
 	int m_nodeCount;
+	int m_peakNodeCount;
 };
 
 class dtNodeQueue
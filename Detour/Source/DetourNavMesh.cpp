@@ -25,6 +25,7 @@
 #include "DetourMath.h"
 #include "DetourAlloc.h"
 #include "DetourAssert.h"
+#include "DetourAtomic.h"
 #include <new>
 
 
@@ -134,6 +135,60 @@ inline void freeLink(dtMeshTile* tile, unsigned int link)
 	tile->linksFreeList = link;
 }
 
+static void resetTile(dtMeshTile* tile)
+{
+	dtAtomicStore(&tile->header, (dtMeshHeader*)0);
+	dtAtomicStore(&tile->polys, (dtPoly*)0);
+	tile->flags = 0;
+	tile->linksFreeList = 0;
+	tile->verts = 0;
+	tile->links = 0;
+	tile->detailMeshes = 0;
+	tile->detailVerts = 0;
+	tile->detailTris = 0;
+	tile->bvTree = 0;
+	tile->offMeshCons = 0;
+	tile->quantVerts = 0;
+	tile->quantDetailVerts = 0;
+	tile->data = 0;
+	tile->dataSize = 0;
+}
+
+// Returns the stored position of an off-mesh connection vertex, which is kept as floats in quantized tiles too.
+static float* getOffMeshConVert(dtMeshTile* tile, const int i)
+{
+	if (tile->quantVerts)
+		return &tile->verts[(i - (tile->header->vertCount - tile->header->offMeshConCount*2))*3];
+	return &tile->verts[i*3];
+}
+
+// Gets the vertices of a detail triangle. [(x, y, z) * 3]
+static void getDetailTriVerts(const dtMeshTile* tile, const dtPoly* poly, const dtPolyDetail* pd,
+							  const unsigned char* tri, float v[3][3])
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		if (tri[k] < poly->vertCount)
+			dtGetTileVert(tile, poly->verts[tri[k]], v[k]);
+		else
+			dtGetTileDetailVert(tile, pd->vertBase + (tri[k] - poly->vertCount), v[k]);
+	}
+}
+
+/// Compressed representation of a tile which has been unloaded with dtNavMesh::compressTile.
+struct dtCompressedTile
+{
+	unsigned char* data;	///< Compressed tile data, or null if the tile is not compressed.
+	int dataSize;			///< Size of the compressed data.
+	int rawSize;			///< Size of the tile data when decompressed.
+	int flags;				///< Tile flags of the original tile.
+};
+
+dtNavMeshTileCompressor::~dtNavMeshTileCompressor()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
 
 dtNavMesh* dtAllocNavMesh()
 {
@@ -181,6 +236,11 @@ Notes:
   to have only a single tile.
 - This class does not implement any asynchronous methods. So the ::dtStatus result of all methods will 
   always contain either a success or failure flag.
+- A single writer thread can add and remove tiles while other threads look up tiles and validate
+  references using #getTileAt, #getTileRefAt, #getTilesAt, #getTileByRef, #isValidPolyRef and
+  #getTileAndPolyByRef. See #removeTile for the rules on releasing the tile data.
+  Only these lookups are safe: the queries of dtNavMeshQuery follow the polygon links, which the
+  writer rewires, so they still need to be serialized with tile changes.
 
 @see dtNavMeshQuery, dtCreateNavMeshData, dtNavMeshCreateParams, #dtAllocNavMesh, #dtFreeNavMesh
 */
@@ -192,8 +252,17 @@ dtNavMesh::dtNavMesh() :
 	m_tileLutSize(0),
 	m_tileLutMask(0),
 	m_posLookup(0),
-	m_nextFree(0),
-	m_tiles(0)
+	m_tileLookupSeq(0),
+	m_freeTiles(0),
+	m_freeTileCount(0),
+	m_tiles(0),
+	m_activeTiles(0),
+	m_activeTileIndex(0),
+	m_activeTileCount(0),
+	m_tileComp(0),
+	m_compressedTiles(0),
+	m_tileChangeStamps(0),
+	m_tileChangeCount(0)
 {
 #ifndef DT_POLYREF64
 	m_saltBits = 0;
@@ -201,6 +270,9 @@ dtNavMesh::dtNavMesh() :
 	m_polyBits = 0;
 #endif
 	memset(&m_params, 0, sizeof(dtNavMeshParams));
+	memset(&m_compressionStats, 0, sizeof(dtNavMeshCompressionStats));
+	memset(&m_memoryUsage, 0, sizeof(dtNavMeshMemoryUsage));
+	memset(&m_peakMemoryUsage, 0, sizeof(dtNavMeshMemoryUsage));
 	m_orig[0] = 0;
 	m_orig[1] = 0;
 	m_orig[2] = 0;
@@ -216,9 +288,16 @@ dtNavMesh::~dtNavMesh()
 			m_tiles[i].data = 0;
 			m_tiles[i].dataSize = 0;
 		}
+		if (m_compressedTiles)
+			dtFree(m_compressedTiles[i].data);
 	}
+	dtFree(m_compressedTiles);
 	dtFree(m_posLookup);
+	dtFree(m_freeTiles);
 	dtFree(m_tiles);
+	dtFree(m_activeTiles);
+	dtFree(m_activeTileIndex);
+	dtFree(m_tileChangeStamps);
 }
 		
 dtStatus dtNavMesh::init(const dtNavMeshParams* params)
@@ -240,15 +319,35 @@ dtStatus dtNavMesh::init(const dtNavMeshParams* params)
 	m_posLookup = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*m_tileLutSize, DT_ALLOC_PERM);
 	if (!m_posLookup)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_freeTiles = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*m_maxTiles, DT_ALLOC_PERM);
+	if (!m_freeTiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_activeTiles = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*m_maxTiles, DT_ALLOC_PERM);
+	if (!m_activeTiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_activeTileIndex = (int*)dtAlloc(sizeof(int)*m_maxTiles, DT_ALLOC_PERM);
+	if (!m_activeTileIndex)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_tileChangeStamps = (unsigned int*)dtAlloc(sizeof(unsigned int)*m_maxTiles, DT_ALLOC_PERM);
+	if (!m_tileChangeStamps)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	memset(m_tiles, 0, sizeof(dtMeshTile)*m_maxTiles);
+	memset(m_tileChangeStamps, 0, sizeof(unsigned int)*m_maxTiles);
 	memset(m_posLookup, 0, sizeof(dtMeshTile*)*m_tileLutSize);
-	m_nextFree = 0;
+	m_freeTileCount = 0;
 	for (int i = m_maxTiles-1; i >= 0; --i)
 	{
 		m_tiles[i].salt = 1;
-		m_tiles[i].next = m_nextFree;
-		m_nextFree = &m_tiles[i];
+		m_freeTiles[m_freeTileCount++] = &m_tiles[i];
+		m_activeTileIndex[i] = -1;
 	}
+	m_activeTileCount = 0;
+	
+	memset(&m_memoryUsage, 0, sizeof(dtNavMeshMemoryUsage));
+	m_memoryUsage.lookup = sizeof(dtMeshTile)*m_maxTiles + sizeof(dtMeshTile*)*m_tileLutSize +
+		(sizeof(dtMeshTile*)*2 + sizeof(int) + sizeof(unsigned int))*m_maxTiles;
+	m_memoryUsage.total = m_memoryUsage.lookup;
+	memcpy(&m_peakMemoryUsage, &m_memoryUsage, sizeof(dtNavMeshMemoryUsage));
 	
 	// Init ID generator values.
 #ifndef DT_POLYREF64
@@ -272,7 +371,7 @@ dtStatus dtNavMesh::init(unsigned char* data, const int dataSize, const int flag
 {
 	// Make sure the data is in right format.
 	dtMeshHeader* header = (dtMeshHeader*)data;
-	if (header->magic != DT_NAVMESH_MAGIC)
+	if (header->magic != DT_NAVMESH_MAGIC && header->magic != DT_NAVMESH_QUANTIZED_MAGIC)
 		return DT_FAILURE | DT_WRONG_MAGIC;
 	if (header->version != DT_NAVMESH_VERSION)
 		return DT_FAILURE | DT_WRONG_VERSION;
@@ -327,8 +426,9 @@ int dtNavMesh::findConnectingPolys(const float* va, const float* vb,
 			// Skip edges which do not point to the right side.
 			if (poly->neis[j] != m) continue;
 			
-			const float* vc = &tile->verts[poly->verts[j]*3];
-			const float* vd = &tile->verts[poly->verts[(j+1) % nv]*3];
+			float vc[3], vd[3];
+			dtGetTileVert(tile, poly->verts[j], vc);
+			dtGetTileVert(tile, poly->verts[(j+1) % nv], vd);
 			const float bpos = getSlabCoord(vc, side);
 			
 			// Segments are not close enough.
@@ -412,8 +512,9 @@ void dtNavMesh::connectExtLinks(dtMeshTile* tile, dtMeshTile* target, int side)
 				continue;
 			
 			// Create new links
-			const float* va = &tile->verts[poly->verts[j]*3];
-			const float* vb = &tile->verts[poly->verts[(j+1) % nv]*3];
+			float va[3], vb[3];
+			dtGetTileVert(tile, poly->verts[j], va);
+			dtGetTileVert(tile, poly->verts[(j+1) % nv], vb);
 			dtPolyRef nei[4];
 			float neia[4*2];
 			int nnei = findConnectingPolys(va,vb, target, dtOppositeTile(dir), nei,neia,4);
@@ -486,8 +587,7 @@ void dtNavMesh::connectExtOffMeshLinks(dtMeshTile* tile, dtMeshTile* target, int
 		if (dtSqr(nearestPt[0]-p[0])+dtSqr(nearestPt[2]-p[2]) > dtSqr(targetCon->rad))
 			continue;
 		// Make sure the location is on current mesh.
-		float* v = &target->verts[targetPoly->verts[1]*3];
-		dtVcopy(v, nearestPt);
+		dtVcopy(getOffMeshConVert(target, targetPoly->verts[1]), nearestPt);
 				
 		// Link off-mesh connection to target poly.
 		unsigned int idx = allocLink(target);
@@ -585,8 +685,7 @@ void dtNavMesh::baseOffMeshLinks(dtMeshTile* tile)
 		if (dtSqr(nearestPt[0]-p[0])+dtSqr(nearestPt[2]-p[2]) > dtSqr(con->rad))
 			continue;
 		// Make sure the location is on current mesh.
-		float* v = &tile->verts[poly->verts[0]*3];
-		dtVcopy(v, nearestPt);
+		dtVcopy(getOffMeshConVert(tile, poly->verts[0]), nearestPt);
 
 		// Link off-mesh connection to target poly.
 		unsigned int idx = allocLink(tile);
@@ -630,8 +729,8 @@ namespace
 
 		float dmin = FLT_MAX;
 		float tmin = 0;
-		const float* pmin = 0;
-		const float* pmax = 0;
+		float pmin[3] = {0,0,0};
+		float pmax[3] = {0,0,0};
 
 		for (int i = 0; i < pd->triCount; i++)
 		{
@@ -643,14 +742,8 @@ namespace
 			if (onlyBoundary && (tris[3] & ANY_BOUNDARY_EDGE) == 0)
 				continue;
 
-			const float* v[3];
-			for (int j = 0; j < 3; ++j)
-			{
-				if (tris[j] < poly->vertCount)
-					v[j] = &tile->verts[poly->verts[tris[j]] * 3];
-				else
-					v[j] = &tile->detailVerts[(pd->vertBase + (tris[j] - poly->vertCount)) * 3];
-			}
+			float v[3][3];
+			getDetailTriVerts(tile, poly, pd, tris, v);
 
 			for (int k = 0, j = 2; k < 3; j = k++)
 			{
@@ -668,8 +761,8 @@ namespace
 				{
 					dmin = d;
 					tmin = t;
-					pmin = v[j];
-					pmax = v[k];
+					dtVcopy(pmin, v[j]);
+					dtVcopy(pmax, v[k]);
 				}
 			}
 		}
@@ -691,7 +784,7 @@ bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const
 	float verts[DT_VERTS_PER_POLYGON*3];	
 	const int nv = poly->vertCount;
 	for (int i = 0; i < nv; ++i)
-		dtVcopy(&verts[i*3], &tile->verts[poly->verts[i]*3]);
+		dtGetTileVert(tile, poly->verts[i], &verts[i*3]);
 	
 	if (!dtPointInPolygon(pos, verts, nv))
 		return false;
@@ -703,14 +796,8 @@ bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const
 	for (int j = 0; j < pd->triCount; ++j)
 	{
 		const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
-		const float* v[3];
-		for (int k = 0; k < 3; ++k)
-		{
-			if (t[k] < poly->vertCount)
-				v[k] = &tile->verts[poly->verts[t[k]]*3];
-			else
-				v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
-		}
+		float v[3][3];
+		getDetailTriVerts(tile, poly, pd, t, v);
 		float h;
 		if (dtClosestHeightPointTriangle(pos, v[0], v[1], v[2], h))
 		{
@@ -749,8 +836,9 @@ void dtNavMesh::closestPointOnPoly(dtPolyRef ref, const float* pos, float* close
 	// Off-mesh connections don't have detail polygons.
 	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 	{
-		const float* v0 = &tile->verts[poly->verts[0]*3];
-		const float* v1 = &tile->verts[poly->verts[1]*3];
+		float v0[3], v1[3];
+		dtGetTileVert(tile, poly->verts[0], v0);
+		dtGetTileVert(tile, poly->verts[1], v1);
 		float t;
 		dtDistancePtSegSqr2D(pos, v0, v1, t);
 		dtVlerp(closest, v0, v1, t);
@@ -874,12 +962,13 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 			if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 				continue;
 			// Calc polygon bounds.
-			const float* v = &tile->verts[p->verts[0]*3];
+			float v[3];
+			dtGetTileVert(tile, p->verts[0], v);
 			dtVcopy(bmin, v);
 			dtVcopy(bmax, v);
 			for (int j = 1; j < p->vertCount; ++j)
 			{
-				v = &tile->verts[p->verts[j]*3];
+				dtGetTileVert(tile, p->verts[j], v);
 				dtVmin(bmin, v);
 				dtVmax(bmax, v);
 			}
@@ -908,13 +997,17 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 /// should not be reused in other nav meshes until the tile has been successfully
 /// removed from this nav mesh.
 ///
+/// Quantized tile data (see #dtQuantizeNavMeshData) is used in place like any
+/// other tile data. Its vertices stay quantized and are decoded by the queries,
+/// so the tile vertices must be read using #dtGetTileVert and #dtGetTileDetailVert.
+///
 /// @see dtCreateNavMeshData, #removeTile
 dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 							dtTileRef lastRef, dtTileRef* result)
 {
 	// Make sure the data is in right format.
 	dtMeshHeader* header = (dtMeshHeader*)data;
-	if (header->magic != DT_NAVMESH_MAGIC)
+	if (header->magic != DT_NAVMESH_MAGIC && header->magic != DT_NAVMESH_QUANTIZED_MAGIC)
 		return DT_FAILURE | DT_WRONG_MAGIC;
 	if (header->version != DT_NAVMESH_VERSION)
 		return DT_FAILURE | DT_WRONG_VERSION;
@@ -934,12 +1027,8 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	dtMeshTile* tile = 0;
 	if (!lastRef)
 	{
-		if (m_nextFree)
-		{
-			tile = m_nextFree;
-			m_nextFree = tile->next;
-			tile->next = 0;
-		}
+		if (m_freeTileCount)
+			tile = m_freeTiles[--m_freeTileCount];
 	}
 	else
 	{
@@ -947,54 +1036,89 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		int tileIndex = (int)decodePolyIdTile((dtPolyRef)lastRef);
 		if (tileIndex >= m_maxTiles)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
-		// Try to find the specific tile id from the free list.
+		// Try to find the specific tile id from the free stack.
 		dtMeshTile* target = &m_tiles[tileIndex];
-		dtMeshTile* prev = 0;
-		tile = m_nextFree;
-		while (tile && tile != target)
-		{
-			prev = tile;
-			tile = tile->next;
-		}
+		int freeIdx = m_freeTileCount-1;
+		while (freeIdx >= 0 && m_freeTiles[freeIdx] != target)
+			freeIdx--;
 		// Could not find the correct location.
-		if (tile != target)
+		if (freeIdx < 0)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
-		// Remove from freelist
-		if (!prev)
-			m_nextFree = tile->next;
-		else
-			prev->next = tile->next;
+		// Remove from the free stack, keeping the order of the other free tiles.
+		for (int i = freeIdx; i < m_freeTileCount-1; ++i)
+			m_freeTiles[i] = m_freeTiles[i+1];
+		m_freeTileCount--;
+		tile = target;
 
 		// Restore salt.
-		tile->salt = decodePolyIdSalt((dtPolyRef)lastRef);
+		dtAtomicStore(&tile->salt, decodePolyIdSalt((dtPolyRef)lastRef));
 	}
 
 	// Make sure we could allocate a tile.
 	if (!tile)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	// Insert tile into the position lut.
-	int h = computeTileHash(header->x, header->y, m_tileLutMask);
-	tile->next = m_posLookup[h];
-	m_posLookup[h] = tile;
+	linkTile(tile, data, dataSize, flags);
+
+	if (result)
+		*result = getTileRef(tile);
+	
+	return DT_SUCCESS;
+}
+
+void dtNavMesh::linkTile(dtMeshTile* tile, unsigned char* data, int dataSize, int flags)
+{
+	dtMeshHeader* header = (dtMeshHeader*)data;
+
+	// Insert tile into the active list.
+	const int tileIndex = (int)(tile - m_tiles);
+	m_activeTileIndex[tileIndex] = m_activeTileCount;
+	m_activeTiles[m_activeTileCount++] = tile;
 	
 	// Patch header pointers.
 	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
 	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
 	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
 	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
 	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
 	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
 	
 	unsigned char* d = data + headerSize;
-	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
-	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
-	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
-	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
-	tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	if (header->magic == DT_NAVMESH_QUANTIZED_MAGIC)
+	{
+		// Only the off-mesh connection vertices are stored as floats.
+		const int meshVertCount = header->vertCount - header->offMeshConCount*2;
+		const int quantHeaderSize = dtAlign4(sizeof(dtMeshQuantHeader));
+		const int qvertsSize = dtAlign4(sizeof(unsigned short)*3*meshVertCount);
+		const int offMeshVertsSize = dtAlign4(sizeof(float)*3*header->offMeshConCount*2);
+		const int qdetailVertsSize = dtAlign4(sizeof(unsigned short)*3*header->detailVertCount);
+		
+		const dtMeshQuantHeader* quant = dtGetThenAdvanceBufferPointer<const dtMeshQuantHeader>(d, quantHeaderSize);
+		tile->quantVerts = dtGetThenAdvanceBufferPointer<unsigned short>(d, qvertsSize);
+		tile->verts = dtGetThenAdvanceBufferPointer<float>(d, offMeshVertsSize);
+		dtAtomicStore(&tile->polys, dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize));
+		tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
+		tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
+		tile->quantDetailVerts = dtGetThenAdvanceBufferPointer<unsigned short>(d, qdetailVertsSize);
+		tile->detailVerts = 0;
+		tile->quantScale[0] = quant->cs;
+		tile->quantScale[1] = quant->ch;
+		tile->quantScale[2] = quant->cs;
+	}
+	else
+	{
+		const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+		const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+		
+		tile->quantVerts = 0;
+		tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+		dtAtomicStore(&tile->polys, dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize));
+		tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
+		tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
+		tile->quantDetailVerts = 0;
+		tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	}
 	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
 	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
 	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
@@ -1010,7 +1134,7 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		tile->links[i].next = i+1;
 
 	// Init tile.
-	tile->header = header;
+	dtAtomicStore(&tile->header, header);
 	tile->data = data;
 	tile->dataSize = dataSize;
 	tile->flags = flags;
@@ -1037,6 +1161,7 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		connectExtLinks(neis[j], tile, -1);
 		connectExtOffMeshLinks(tile, neis[j], -1);
 		connectExtOffMeshLinks(neis[j], tile, -1);
+		recordTileChange(neis[j]);
 	}
 	
 	// Connect with neighbour tiles.
@@ -1049,32 +1174,53 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 			connectExtLinks(neis[j], tile, dtOppositeTile(i));
 			connectExtOffMeshLinks(tile, neis[j], i);
 			connectExtOffMeshLinks(neis[j], tile, dtOppositeTile(i));
+			recordTileChange(neis[j]);
 		}
 	}
 	
-	if (result)
-		*result = getTileRef(tile);
+	// Insert tile into the position lut last, so that readers only find fully connected tiles.
+	// A reused slot may still be visited by readers walking the chain it was removed from,
+	// the sequence number tells them to restart instead of following the new next pointer.
+	int h = computeTileHash(header->x, header->y, m_tileLutMask);
+	dtAtomicStore(&m_tileLookupSeq, m_tileLookupSeq+1);
+	dtAtomicStore(&tile->next, m_posLookup[h]);
+	dtAtomicStore(&m_posLookup[h], tile);
+	dtAtomicStore(&m_tileLookupSeq, m_tileLookupSeq+1);
 	
-	return DT_SUCCESS;
+	accountTileMemory(header, true);
+	updatePeakMemoryUsage();
+	
+	recordTileChange(tile);
+}
+
+bool dtNavMesh::isTileLookupStable(const unsigned int seq) const
+{
+	return (seq & 1) == 0 && dtAtomicLoad(&m_tileLookupSeq) == seq;
 }
 
 const dtMeshTile* dtNavMesh::getTileAt(const int x, const int y, const int layer) const
 {
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
-	while (tile)
+	for (;;)
 	{
-		if (tile->header &&
-			tile->header->x == x &&
-			tile->header->y == y &&
-			tile->header->layer == layer)
+		const unsigned int seq = dtAtomicLoad(&m_tileLookupSeq);
+		dtMeshTile* tile = dtAtomicLoad(&m_posLookup[h]);
+		while (tile)
 		{
-			return tile;
+			const dtMeshHeader* header = dtAtomicLoad(&tile->header);
+			if (header &&
+				header->x == x &&
+				header->y == y &&
+				header->layer == layer)
+			{
+				return tile;
+			}
+			tile = dtAtomicLoad(&tile->next);
 		}
-		tile = tile->next;
+		if (isTileLookupStable(seq))
+			return 0;
 	}
-	return 0;
 }
 
 int dtNavMesh::getNeighbourTilesAt(const int x, const int y, const int side, dtMeshTile** tiles, const int maxTiles) const
@@ -1097,24 +1243,28 @@ int dtNavMesh::getNeighbourTilesAt(const int x, const int y, const int side, dtM
 
 int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile** tiles, const int maxTiles) const
 {
-	int n = 0;
-	
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
-	while (tile)
+	for (;;)
 	{
-		if (tile->header &&
-			tile->header->x == x &&
-			tile->header->y == y)
+		int n = 0;
+		const unsigned int seq = dtAtomicLoad(&m_tileLookupSeq);
+		dtMeshTile* tile = dtAtomicLoad(&m_posLookup[h]);
+		while (tile)
 		{
-			if (n < maxTiles)
-				tiles[n++] = tile;
+			const dtMeshHeader* header = dtAtomicLoad(&tile->header);
+			if (header &&
+				header->x == x &&
+				header->y == y)
+			{
+				if (n < maxTiles)
+					tiles[n++] = tile;
+			}
+			tile = dtAtomicLoad(&tile->next);
 		}
-		tile = tile->next;
+		if (isTileLookupStable(seq))
+			return n;
 	}
-	
-	return n;
 }
 
 /// @par
@@ -1123,24 +1273,28 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile** tiles, const in
 /// entire result set.  It will simply fill the array to capacity.
 int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile const** tiles, const int maxTiles) const
 {
-	int n = 0;
-	
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
-	while (tile)
+	for (;;)
 	{
-		if (tile->header &&
-			tile->header->x == x &&
-			tile->header->y == y)
+		int n = 0;
+		const unsigned int seq = dtAtomicLoad(&m_tileLookupSeq);
+		dtMeshTile* tile = dtAtomicLoad(&m_posLookup[h]);
+		while (tile)
 		{
-			if (n < maxTiles)
-				tiles[n++] = tile;
+			const dtMeshHeader* header = dtAtomicLoad(&tile->header);
+			if (header &&
+				header->x == x &&
+				header->y == y)
+			{
+				if (n < maxTiles)
+					tiles[n++] = tile;
+			}
+			tile = dtAtomicLoad(&tile->next);
 		}
-		tile = tile->next;
+		if (isTileLookupStable(seq))
+			return n;
 	}
-	
-	return n;
 }
 
 
@@ -1148,19 +1302,25 @@ dtTileRef dtNavMesh::getTileRefAt(const int x, const int y, const int layer) con
 {
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
-	while (tile)
+	for (;;)
 	{
-		if (tile->header &&
-			tile->header->x == x &&
-			tile->header->y == y &&
-			tile->header->layer == layer)
+		const unsigned int seq = dtAtomicLoad(&m_tileLookupSeq);
+		dtMeshTile* tile = dtAtomicLoad(&m_posLookup[h]);
+		while (tile)
 		{
-			return getTileRef(tile);
+			const dtMeshHeader* header = dtAtomicLoad(&tile->header);
+			if (header &&
+				header->x == x &&
+				header->y == y &&
+				header->layer == layer)
+			{
+				return getTileRef(tile);
+			}
+			tile = dtAtomicLoad(&tile->next);
 		}
-		tile = tile->next;
+		if (isTileLookupStable(seq))
+			return 0;
 	}
-	return 0;
 }
 
 const dtMeshTile* dtNavMesh::getTileByRef(dtTileRef ref) const
@@ -1172,7 +1332,10 @@ const dtMeshTile* dtNavMesh::getTileByRef(dtTileRef ref) const
 	if ((int)tileIndex >= m_maxTiles)
 		return 0;
 	const dtMeshTile* tile = &m_tiles[tileIndex];
-	if (tile->salt != tileSalt)
+	if (dtAtomicLoad(&tile->salt) != tileSalt)
+		return 0;
+	// Compressed tiles keep their salt but have no data.
+	if (!dtAtomicLoad(&tile->header))
 		return 0;
 	return tile;
 }
@@ -1204,10 +1367,15 @@ dtStatus dtNavMesh::getTileAndPolyByRef(const dtPolyRef ref, const dtMeshTile**
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
-	if (ip >= (unsigned int)m_tiles[it].header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
+	if (dtAtomicLoad(&m_tiles[it].salt) != salt) return DT_FAILURE | DT_INVALID_PARAM;
+	const dtMeshHeader* header = dtAtomicLoad(&m_tiles[it].header);
+	if (header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (ip >= (unsigned int)header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
+	const dtPoly* polys = dtAtomicLoad(&m_tiles[it].polys);
+	// The tile may have been removed while reading it.
+	if (dtAtomicLoad(&m_tiles[it].salt) != salt) return DT_FAILURE | DT_INVALID_PARAM;
 	*tile = &m_tiles[it];
-	*poly = &m_tiles[it].polys[ip];
+	*poly = &polys[ip];
 	return DT_SUCCESS;
 }
 
@@ -1230,30 +1398,19 @@ bool dtNavMesh::isValidPolyRef(dtPolyRef ref) const
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return false;
-	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return false;
-	if (ip >= (unsigned int)m_tiles[it].header->polyCount) return false;
+	if (dtAtomicLoad(&m_tiles[it].salt) != salt) return false;
+	const dtMeshHeader* header = dtAtomicLoad(&m_tiles[it].header);
+	if (header == 0) return false;
+	if (ip >= (unsigned int)header->polyCount) return false;
 	return true;
 }
 
-/// @par
-///
-/// This function returns the data for the tile so that, if desired,
-/// it can be added back to the navigation mesh at a later point.
-///
-/// @see #addTile
-dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSize)
+void dtNavMesh::unlinkTile(dtMeshTile* tile)
 {
-	if (!ref)
-		return DT_FAILURE | DT_INVALID_PARAM;
-	unsigned int tileIndex = decodePolyIdTile((dtPolyRef)ref);
-	unsigned int tileSalt = decodePolyIdSalt((dtPolyRef)ref);
-	if ((int)tileIndex >= m_maxTiles)
-		return DT_FAILURE | DT_INVALID_PARAM;
-	dtMeshTile* tile = &m_tiles[tileIndex];
-	if (tile->salt != tileSalt)
-		return DT_FAILURE | DT_INVALID_PARAM;
-	
-	// Remove tile from hash lookup.
+	const int tileIndex = (int)(tile - m_tiles);
+
+	// Remove tile from hash lookup. The next pointer of the tile is kept,
+	// so that readers which are currently visiting the tile can continue.
 	int h = computeTileHash(tile->header->x,tile->header->y,m_tileLutMask);
 	dtMeshTile* prev = 0;
 	dtMeshTile* cur = m_posLookup[h];
@@ -1262,14 +1419,24 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 		if (cur == tile)
 		{
 			if (prev)
-				prev->next = cur->next;
+				dtAtomicStore(&prev->next, cur->next);
 			else
-				m_posLookup[h] = cur->next;
+				dtAtomicStore(&m_posLookup[h], cur->next);
 			break;
 		}
 		prev = cur;
 		cur = cur->next;
 	}
+
+	// Remove tile from the active list, move the last tile to its place.
+	const int activeIdx = m_activeTileIndex[tileIndex];
+	if (activeIdx >= 0)
+	{
+		dtMeshTile* last = m_activeTiles[--m_activeTileCount];
+		m_activeTiles[activeIdx] = last;
+		m_activeTileIndex[(int)(last - m_tiles)] = activeIdx;
+		m_activeTileIndex[tileIndex] = -1;
+	}
 	
 	// Remove connections to neighbour tiles.
 	static const int MAX_NEIS = 32;
@@ -1282,6 +1449,7 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	{
 		if (neis[j] == tile) continue;
 		unconnectLinks(neis[j], tile);
+		recordTileChange(neis[j]);
 	}
 	
 	// Disconnect from neighbour tiles.
@@ -1289,58 +1457,429 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	{
 		nneis = getNeighbourTilesAt(tile->header->x, tile->header->y, i, neis, MAX_NEIS);
 		for (int j = 0; j < nneis; ++j)
+		{
 			unconnectLinks(neis[j], tile);
+			recordTileChange(neis[j]);
+		}
 	}
-		
-	// Reset tile.
-	if (tile->flags & DT_TILE_FREE_DATA)
+	
+	accountTileMemory(tile->header, false);
+	
+	recordTileChange(tile);
+}
+
+/// @par
+///
+/// This function returns the data for the tile so that, if desired,
+/// it can be added back to the navigation mesh at a later point.
+///
+/// The references to the tile are invalidated before the tile is unlinked,
+/// so concurrent readers stop accepting them right away. Readers which validated
+/// a reference just before may still be reading the tile data, so when tiles are
+/// removed while other threads read the navigation mesh, add the tiles without
+/// #DT_TILE_FREE_DATA and release the returned data only once those readers are done.
+///
+/// @see #addTile
+dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSize)
+{
+	if (!ref)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	unsigned int tileIndex = decodePolyIdTile((dtPolyRef)ref);
+	unsigned int tileSalt = decodePolyIdSalt((dtPolyRef)ref);
+	if ((int)tileIndex >= m_maxTiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	dtMeshTile* tile = &m_tiles[tileIndex];
+	if (tile->salt != tileSalt)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const bool compressed = isTileCompressed(ref);
+	
+	// Update salt first to invalidate the references held by readers, salt should never be zero.
+#ifdef DT_POLYREF64
+	unsigned int salt = (tile->salt+1) & ((1<<DT_SALT_BITS)-1);
+#else
+	unsigned int salt = (tile->salt+1) & ((1<<m_saltBits)-1);
+#endif
+	if (salt == 0)
+		salt++;
+	dtAtomicStore(&tile->salt, salt);
+	
+	if (compressed)
 	{
-		// Owns data
-		dtFree(tile->data);
-		tile->data = 0;
-		tile->dataSize = 0;
+		// Compressed tiles are already unlinked, the compressed data is simply discarded.
+		dtCompressedTile* ctile = &m_compressedTiles[tileIndex];
+		m_compressionStats.compressedTileCount--;
+		m_compressionStats.uncompressedSize -= ctile->rawSize;
+		m_compressionStats.compressedSize -= ctile->dataSize;
+		m_memoryUsage.compressedTiles -= ctile->dataSize;
+		m_memoryUsage.total -= ctile->dataSize;
+		dtFree(ctile->data);
+		memset(ctile, 0, sizeof(dtCompressedTile));
 		if (data) *data = 0;
 		if (dataSize) *dataSize = 0;
+		recordTileChange(tile);
 	}
 	else
 	{
-		if (data) *data = tile->data;
-		if (dataSize) *dataSize = tile->dataSize;
+		unlinkTile(tile);
+
+		// Reset tile.
+		if (tile->flags & DT_TILE_FREE_DATA)
+		{
+			// Owns data
+			dtFree(tile->data);
+			tile->data = 0;
+			tile->dataSize = 0;
+			if (data) *data = 0;
+			if (dataSize) *dataSize = 0;
+		}
+		else
+		{
+			if (data) *data = tile->data;
+			if (dataSize) *dataSize = tile->dataSize;
+		}
 	}
 
-	tile->header = 0;
-	tile->flags = 0;
-	tile->linksFreeList = 0;
-	tile->polys = 0;
-	tile->verts = 0;
-	tile->links = 0;
-	tile->detailMeshes = 0;
-	tile->detailVerts = 0;
-	tile->detailTris = 0;
-	tile->bvTree = 0;
-	tile->offMeshCons = 0;
+	resetTile(tile);
 
-	// Update salt, salt should never be zero.
-#ifdef DT_POLYREF64
-	tile->salt = (tile->salt+1) & ((1<<DT_SALT_BITS)-1);
-#else
-	tile->salt = (tile->salt+1) & ((1<<m_saltBits)-1);
-#endif
-	if (tile->salt == 0)
-		tile->salt++;
+	// Add to free stack.
+	m_freeTiles[m_freeTileCount++] = tile;
+
+	return DT_SUCCESS;
+}
 
-	// Add to free list.
-	tile->next = m_nextFree;
-	m_nextFree = tile;
+void dtNavMesh::recordTileChange(const dtMeshTile* tile)
+{
+	m_tileChangeCount++;
+	m_tileChangeStamps[tile - m_tiles] = m_tileChangeCount;
+}
 
+void dtNavMesh::recordPolyChange(const dtMeshTile* tile, const dtPoly* poly)
+{
+	recordTileChange(tile);
+	
+	// The polygons linked to this one see it as a wall or not depending on its flags and area.
+	const unsigned int it = (unsigned int)(tile - m_tiles);
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		const unsigned int nit = decodePolyIdTile(tile->links[i].ref);
+		if (nit != it)
+			recordTileChange(&m_tiles[nit]);
+	}
+}
+
+unsigned int dtNavMesh::getTileChangeCount() const
+{
+	return m_tileChangeCount;
+}
+
+/// @par
+///
+/// The tile change log lets the users of the navigation mesh, like the crowd,
+/// update the state they derived from the changed tiles only, instead of
+/// checking all of it on every update. The navigation mesh remembers the last
+/// change of each tile, so repeated changes of the same tiles, like rebuilding
+/// a tile many times, do not overflow the log. When this function returns -1
+/// the caller must assume that all the tiles have changed.
+///
+/// @see #getTileChangeCount
+int dtNavMesh::getChangedTiles(const unsigned int since, int* tiles, const int maxTiles) const
+{
+	const unsigned int n = m_tileChangeCount - since;
+	if (!n)
+		return 0;
+	int ntiles = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		// Changed if the stamp is in (since, m_tileChangeCount], taking the wrap around into account.
+		if (m_tileChangeStamps[i] - since - 1 >= n)
+			continue;
+		if (ntiles >= maxTiles)
+			return -1;
+		tiles[ntiles++] = i;
+	}
+	return ntiles;
+}
+
+void dtNavMesh::setTileCompressor(dtNavMeshTileCompressor* comp)
+{
+	m_tileComp = comp;
+}
+
+/// @par
+///
+/// The tile is disconnected from the navigation graph and its data is replaced
+/// by the compressed copy. The tile keeps its slot and salt, so the tile and
+/// polygon references stay the same once the tile is decompressed again.
+/// While compressed, the references are reported as invalid by the query functions.
+///
+/// Only tiles which own their data (#DT_TILE_FREE_DATA) can be compressed.
+/// The data is released immediately, so tiles must not be compressed while
+/// other threads read the navigation mesh.
+///
+/// @see #setTileCompressor, #decompressTile, #touchTileAndPolyByRef
+dtStatus dtNavMesh::compressTile(dtTileRef ref)
+{
+	if (!m_tileComp)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const dtMeshTile* ctile = getTileByRef(ref);
+	if (!ctile || !ctile->header)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if ((ctile->flags & DT_TILE_FREE_DATA) == 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	dtMeshTile* tile = &m_tiles[(int)(ctile - m_tiles)];
+	
+	if (!m_compressedTiles)
+	{
+		m_compressedTiles = (dtCompressedTile*)dtAlloc(sizeof(dtCompressedTile)*m_maxTiles, DT_ALLOC_PERM);
+		if (!m_compressedTiles)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(m_compressedTiles, 0, sizeof(dtCompressedTile)*m_maxTiles);
+		m_memoryUsage.compressedTiles += sizeof(dtCompressedTile)*m_maxTiles;
+		m_memoryUsage.total += sizeof(dtCompressedTile)*m_maxTiles;
+	}
+	
+	const int maxCompressedSize = m_tileComp->maxCompressedSize(tile->dataSize);
+	unsigned char* compressed = (unsigned char*)dtAlloc(maxCompressedSize, DT_ALLOC_TEMP);
+	if (!compressed)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	unlinkTile(tile);
+	
+	// Links are rebuilt when the tile is decompressed, clear them so that they compress well.
+	memset(tile->links, 0, sizeof(dtLink)*tile->header->maxLinkCount);
+	
+	int compressedSize = 0;
+	dtStatus status = m_tileComp->compress(tile->data, tile->dataSize, compressed, maxCompressedSize, &compressedSize);
+	if (dtStatusFailed(status))
+	{
+		dtFree(compressed);
+		linkTile(tile, tile->data, tile->dataSize, tile->flags);
+		return status;
+	}
+	
+	// Store the compressed data in a tightly sized buffer.
+	unsigned char* data = (unsigned char*)dtAlloc(compressedSize, DT_ALLOC_PERM);
+	if (!data)
+	{
+		dtFree(compressed);
+		linkTile(tile, tile->data, tile->dataSize, tile->flags);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memcpy(data, compressed, compressedSize);
+	dtFree(compressed);
+	
+	const int tileIndex = (int)(tile - m_tiles);
+	dtCompressedTile* comp = &m_compressedTiles[tileIndex];
+	comp->data = data;
+	comp->dataSize = compressedSize;
+	comp->rawSize = tile->dataSize;
+	comp->flags = tile->flags;
+	
+	m_compressionStats.compressedTileCount++;
+	m_compressionStats.uncompressedSize += comp->rawSize;
+	m_compressionStats.compressedSize += comp->dataSize;
+	m_memoryUsage.compressedTiles += comp->dataSize;
+	m_memoryUsage.total += comp->dataSize;
+	updatePeakMemoryUsage();
+	
+	dtFree(tile->data);
+	resetTile(tile);
+	
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// The decompressed tile is connected back to the navigation graph using
+/// its original tile reference.
+///
+/// @see #compressTile
+dtStatus dtNavMesh::decompressTile(dtTileRef ref)
+{
+	if (!isTileCompressed(ref))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!m_tileComp)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const int tileIndex = (int)decodePolyIdTile((dtPolyRef)ref);
+	dtMeshTile* tile = &m_tiles[tileIndex];
+	dtCompressedTile* comp = &m_compressedTiles[tileIndex];
+	
+	unsigned char* data = (unsigned char*)dtAlloc(comp->rawSize, DT_ALLOC_PERM);
+	if (!data)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	int dataSize = 0;
+	dtStatus status = m_tileComp->decompress(comp->data, comp->dataSize, data, comp->rawSize, &dataSize);
+	if (dtStatusFailed(status))
+	{
+		dtFree(data);
+		return status;
+	}
+	
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (dataSize != comp->rawSize || (header->magic != DT_NAVMESH_MAGIC && header->magic != DT_NAVMESH_QUANTIZED_MAGIC))
+	{
+		dtFree(data);
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	}
+	
+	// Another tile may have been added to the location while this one was compressed.
+	if (getTileAt(header->x, header->y, header->layer))
+	{
+		dtFree(data);
+		return DT_FAILURE | DT_ALREADY_OCCUPIED;
+	}
+	
+	linkTile(tile, data, dataSize, comp->flags);
+	
+	m_compressionStats.compressedTileCount--;
+	m_compressionStats.uncompressedSize -= comp->rawSize;
+	m_compressionStats.compressedSize -= comp->dataSize;
+	m_memoryUsage.compressedTiles -= comp->dataSize;
+	m_memoryUsage.total -= comp->dataSize;
+	
+	dtFree(comp->data);
+	memset(comp, 0, sizeof(dtCompressedTile));
+	
+	return DT_SUCCESS;
+}
+
+bool dtNavMesh::isTileCompressed(dtTileRef ref) const
+{
+	if (!ref || !m_compressedTiles)
+		return false;
+	const unsigned int tileIndex = decodePolyIdTile((dtPolyRef)ref);
+	const unsigned int tileSalt = decodePolyIdSalt((dtPolyRef)ref);
+	if ((int)tileIndex >= m_maxTiles)
+		return false;
+	if (m_tiles[tileIndex].salt != tileSalt)
+		return false;
+	return m_compressedTiles[tileIndex].data != 0;
+}
+
+/// @par
+///
+/// Works like #getTileAndPolyByRef, but if the polygon belongs to a compressed
+/// tile, the tile is decompressed first. The call is recorded as a hit or a miss
+/// in the compression statistics.
+///
+/// @see #compressTile, #getCompressionStats
+dtStatus dtNavMesh::touchTileAndPolyByRef(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly)
+{
+	if (!ref) return DT_FAILURE;
+	unsigned int salt, it, ip;
+	decodePolyId(ref, salt, it, ip);
+	const dtTileRef tileRef = (dtTileRef)encodePolyId(salt, it, 0);
+	if (isTileCompressed(tileRef))
+	{
+		m_compressionStats.missCount++;
+		dtStatus status = decompressTile(tileRef);
+		if (dtStatusFailed(status))
+			return status;
+		return getTileAndPolyByRef(ref, tile, poly);
+	}
+	
+	// Only the valid references of loaded tiles are hits.
+	dtStatus status = getTileAndPolyByRef(ref, tile, poly);
+	if (dtStatusSucceed(status))
+		m_compressionStats.hitCount++;
+	return status;
+}
+
+void dtNavMesh::getCompressionStats(dtNavMeshCompressionStats* stats) const
+{
+	memcpy(stats, &m_compressionStats, sizeof(dtNavMeshCompressionStats));
+}
+
+void dtNavMesh::accountTileMemory(const dtMeshHeader* header, bool add)
+{
+	size_t headerSize = dtAlign4(sizeof(dtMeshHeader));
+	size_t vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	size_t detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	if (header->magic == DT_NAVMESH_QUANTIZED_MAGIC)
+	{
+		const int meshVertCount = header->vertCount - header->offMeshConCount*2;
+		headerSize += dtAlign4(sizeof(dtMeshQuantHeader));
+		vertsSize = dtAlign4(sizeof(unsigned short)*3*meshVertCount) + dtAlign4(sizeof(float)*3*header->offMeshConCount*2);
+		detailVertsSize = dtAlign4(sizeof(unsigned short)*3*header->detailVertCount);
+	}
+	const size_t polysSize = vertsSize + dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const size_t linksSize = dtAlign4(sizeof(dtLink)*header->maxLinkCount);
+	const size_t detailSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount) + detailVertsSize +
+		dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const size_t bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const size_t offMeshSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	const size_t tileSize = headerSize + polysSize + linksSize + detailSize + bvtreeSize + offMeshSize;
+	
+	if (add)
+	{
+		m_memoryUsage.tileHeaders += headerSize;
+		m_memoryUsage.polys += polysSize;
+		m_memoryUsage.links += linksSize;
+		m_memoryUsage.detailMeshes += detailSize;
+		m_memoryUsage.bvTrees += bvtreeSize;
+		m_memoryUsage.offMeshCons += offMeshSize;
+		m_memoryUsage.total += tileSize;
+	}
+	else
+	{
+		m_memoryUsage.tileHeaders -= headerSize;
+		m_memoryUsage.polys -= polysSize;
+		m_memoryUsage.links -= linksSize;
+		m_memoryUsage.detailMeshes -= detailSize;
+		m_memoryUsage.bvTrees -= bvtreeSize;
+		m_memoryUsage.offMeshCons -= offMeshSize;
+		m_memoryUsage.total -= tileSize;
+	}
+}
+
+void dtNavMesh::updatePeakMemoryUsage()
+{
+	dtNavMeshMemoryUsage& peak = m_peakMemoryUsage;
+	peak.tileHeaders = dtMax(peak.tileHeaders, m_memoryUsage.tileHeaders);
+	peak.polys = dtMax(peak.polys, m_memoryUsage.polys);
+	peak.links = dtMax(peak.links, m_memoryUsage.links);
+	peak.detailMeshes = dtMax(peak.detailMeshes, m_memoryUsage.detailMeshes);
+	peak.bvTrees = dtMax(peak.bvTrees, m_memoryUsage.bvTrees);
+	peak.offMeshCons = dtMax(peak.offMeshCons, m_memoryUsage.offMeshCons);
+	peak.lookup = dtMax(peak.lookup, m_memoryUsage.lookup);
+	peak.compressedTiles = dtMax(peak.compressedTiles, m_memoryUsage.compressedTiles);
+	peak.total = dtMax(peak.total, m_memoryUsage.total);
+}
+
+/// @par
+///
+/// The tile data is accounted using the section sizes in the tile headers, so the
+/// sum of the tile categories matches the data size of tiles built with #dtCreateNavMeshData.
+/// Tiles added with quantized data are accounted with their expanded size.
+///
+/// @see #getPeakMemoryUsage
+void dtNavMesh::getMemoryUsage(dtNavMeshMemoryUsage* usage) const
+{
+	memcpy(usage, &m_memoryUsage, sizeof(dtNavMeshMemoryUsage));
+}
+
+/// @par
+///
+/// Each category is tracked separately, so the peak of the total can be smaller
+/// than the sum of the category peaks.
+void dtNavMesh::getPeakMemoryUsage(dtNavMeshMemoryUsage* peak) const
+{
+	memcpy(peak, &m_peakMemoryUsage, sizeof(dtNavMeshMemoryUsage));
+}
+
+void dtNavMesh::resetPeakMemoryUsage()
+{
+	memcpy(&m_peakMemoryUsage, &m_memoryUsage, sizeof(dtNavMeshMemoryUsage));
+}
+
 dtTileRef dtNavMesh::getTileRef(const dtMeshTile* tile) const
 {
 	if (!tile) return 0;
 	const unsigned int it = (unsigned int)(tile - m_tiles);
-	return (dtTileRef)encodePolyId(tile->salt, it, 0);
+	return (dtTileRef)encodePolyId(dtAtomicLoad(&tile->salt), it, 0);
 }
 
 /// @par
@@ -1361,7 +1900,7 @@ dtPolyRef dtNavMesh::getPolyRefBase(const dtMeshTile* tile) const
 {
 	if (!tile) return 0;
 	const unsigned int it = (unsigned int)(tile - m_tiles);
-	return encodePolyId(tile->salt, it, 0);
+	return encodePolyId(dtAtomicLoad(&tile->salt), it, 0);
 }
 
 struct dtTileState
@@ -1380,7 +1919,8 @@ struct dtPolyState
 ///  @see #storeTileState
 int dtNavMesh::getTileStateSize(const dtMeshTile* tile) const
 {
-	if (!tile) return 0;
+	// Compressed tiles have no state until they are decompressed.
+	if (!tile || !tile->header) return 0;
 	const int headerSize = dtAlign4(sizeof(dtTileState));
 	const int polyStateSize = dtAlign4(sizeof(dtPolyState) * tile->header->polyCount);
 	return headerSize + polyStateSize;
@@ -1393,6 +1933,9 @@ int dtNavMesh::getTileStateSize(const dtMeshTile* tile) const
 /// @see #getTileStateSize, #restoreTileState
 dtStatus dtNavMesh::storeTileState(const dtMeshTile* tile, unsigned char* data, const int maxDataSize) const
 {
+	if (!tile || !tile->header)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
 	// Make sure there is enough space to store the state.
 	const int sizeReq = getTileStateSize(tile);
 	if (maxDataSize < sizeReq)
@@ -1425,6 +1968,9 @@ dtStatus dtNavMesh::storeTileState(const dtMeshTile* tile, unsigned char* data,
 /// @see #storeTileState
 dtStatus dtNavMesh::restoreTileState(dtMeshTile* tile, const unsigned char* data, const int maxDataSize)
 {
+	if (!tile || !tile->header)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
 	// Make sure there is enough space to store the state.
 	const int sizeReq = getTileStateSize(tile);
 	if (maxDataSize < sizeReq)
@@ -1448,6 +1994,7 @@ dtStatus dtNavMesh::restoreTileState(dtMeshTile* tile, const unsigned char* data
 		const dtPolyState* s = &polyStates[i];
 		p->flags = s->flags;
 		p->setArea(s->area);
+		recordPolyChange(tile, p);
 	}
 	
 	return DT_SUCCESS;
@@ -1496,8 +2043,8 @@ dtStatus dtNavMesh::getOffMeshConnectionPolyEndPoints(dtPolyRef prevRef, dtPolyR
 		}
 	}
 	
-	dtVcopy(startPos, &tile->verts[poly->verts[idx0]*3]);
-	dtVcopy(endPos, &tile->verts[poly->verts[idx1]*3]);
+	dtGetTileVert(tile, poly->verts[idx0], startPos);
+	dtGetTileVert(tile, poly->verts[idx1], endPos);
 
 	return DT_SUCCESS;
 }
@@ -1542,6 +2089,8 @@ dtStatus dtNavMesh::setPolyFlags(dtPolyRef ref, unsigned short flags)
 	// Change flags.
 	poly->flags = flags;
 	
+	recordPolyChange(tile, poly);
+	
 	return DT_SUCCESS;
 }
 
@@ -1574,6 +2123,8 @@ dtStatus dtNavMesh::setPolyArea(dtPolyRef ref, unsigned char area)
 	
 	poly->setArea(area);
 	
+	recordPolyChange(tile, poly);
+	
 	return DT_SUCCESS;
 }
 
@@ -431,7 +431,9 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*params->polyCount);
 	const int detailVertsSize = dtAlign4(sizeof(float)*3*uniqueDetailVertCount);
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*detailTriCount);
-	const int bvTreeSize = params->buildBvTree ? dtAlign4(sizeof(dtBVNode)*params->polyCount*2) : 0;
+	// The BV tree is a full binary tree with one leaf per polygon.
+	const int bvNodeCount = params->buildBvTree ? params->polyCount*2 - 1 : 0;
+	const int bvTreeSize = dtAlign4(sizeof(dtBVNode)*bvNodeCount);
 	const int offMeshConsSize = dtAlign4(sizeof(dtOffMeshConnection)*storedOffMeshConCount);
 	
 	const int dataSize = headerSize + vertsSize + polysSize + linksSize +
@@ -480,7 +482,7 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	header->walkableRadius = params->walkableRadius;
 	header->walkableClimb = params->walkableClimb;
 	header->offMeshConCount = storedOffMeshConCount;
-	header->bvNodeCount = params->buildBvTree ? params->polyCount*2 : 0;
+	header->bvNodeCount = bvNodeCount;
 	
 	const int offMeshVertsBase = params->vertCount;
 	const int offMeshPolyBase = params->polyCount;
@@ -624,7 +626,9 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	// Store and create BVtree.
 	if (params->buildBvTree)
 	{
-		createBVTree(params, navBvtree, 2*params->polyCount);
+		const int nnodes = createBVTree(params, navBvtree, bvNodeCount);
+		dtAssert(nnodes == bvNodeCount);
+		dtIgnoreUnused(nnodes);
 	}
 	
 	// Store Off-Mesh connections.
@@ -800,3 +804,177 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 	
 	return true;
 }
+
+inline unsigned short quantizeCoord(const float v, const float orig, const float scale)
+{
+	return (unsigned short)dtClamp((int)dtMathFloorf((v - orig) * scale + 0.5f), 0, 0xffff);
+}
+
+bool dtQuantizeNavMeshData(const unsigned char* data, const int dataSize, const float cs, const float ch,
+						   unsigned char** outData, int* outDataSize)
+{
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (dataSize < (int)sizeof(dtMeshHeader) || cs <= 0.0f || ch <= 0.0f)
+		return false;
+	if (header->magic != DT_NAVMESH_MAGIC)
+		return false;
+	if (header->version != DT_NAVMESH_VERSION)
+		return false;
+	
+	// Off-mesh connection vertices are not quantized, they can lie outside of the tile.
+	const int meshVertCount = header->vertCount - header->offMeshConCount*2;
+
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+
+	const int quantHeaderSize = dtAlign4(sizeof(dtMeshQuantHeader));
+	const int qvertsSize = dtAlign4(sizeof(unsigned short)*3*meshVertCount);
+	const int offMeshVertsSize = dtAlign4(sizeof(float)*3*header->offMeshConCount*2);
+	const int qdetailVertsSize = dtAlign4(sizeof(unsigned short)*3*header->detailVertCount);
+	
+	if (dataSize < headerSize + vertsSize + polysSize + linksSize + detailMeshesSize + detailVertsSize +
+				   detailTrisSize + bvtreeSize + offMeshLinksSize)
+		return false;
+	
+	const int qdataSize = headerSize + quantHeaderSize + qvertsSize + offMeshVertsSize + polysSize + linksSize +
+						  detailMeshesSize + qdetailVertsSize + detailTrisSize + bvtreeSize + offMeshLinksSize;
+
+	unsigned char* qdata = (unsigned char*)dtAlloc(sizeof(unsigned char)*qdataSize, DT_ALLOC_PERM);
+	if (!qdata)
+		return false;
+	memset(qdata, 0, qdataSize);
+
+	const unsigned char* s = data + headerSize;
+	const float* verts = dtGetThenAdvanceBufferPointer<const float>(s, vertsSize);
+	const unsigned char* polys = dtGetThenAdvanceBufferPointer<const unsigned char>(s, polysSize + linksSize + detailMeshesSize);
+	const float* detailVerts = dtGetThenAdvanceBufferPointer<const float>(s, detailVertsSize);
+	const unsigned char* rest = s; // Detail tris, BV-tree and off-mesh connections are copied as is.
+	
+	unsigned char* d = qdata;
+	dtMeshHeader* qheader = dtGetThenAdvanceBufferPointer<dtMeshHeader>(d, headerSize);
+	dtMeshQuantHeader* quant = dtGetThenAdvanceBufferPointer<dtMeshQuantHeader>(d, quantHeaderSize);
+	unsigned short* qverts = dtGetThenAdvanceBufferPointer<unsigned short>(d, qvertsSize);
+	float* offMeshVerts = dtGetThenAdvanceBufferPointer<float>(d, offMeshVertsSize);
+	unsigned char* qpolys = dtGetThenAdvanceBufferPointer<unsigned char>(d, polysSize + linksSize + detailMeshesSize);
+	unsigned short* qdetailVerts = dtGetThenAdvanceBufferPointer<unsigned short>(d, qdetailVertsSize);
+	
+	memcpy(qheader, header, sizeof(dtMeshHeader));
+	qheader->magic = DT_NAVMESH_QUANTIZED_MAGIC;
+	quant->cs = cs;
+	quant->ch = ch;
+	
+	const float ics = 1.0f / cs;
+	const float ich = 1.0f / ch;
+	const float* orig = header->bmin;
+	for (int i = 0; i < meshVertCount; ++i)
+	{
+		qverts[i*3+0] = quantizeCoord(verts[i*3+0], orig[0], ics);
+		qverts[i*3+1] = quantizeCoord(verts[i*3+1], orig[1], ich);
+		qverts[i*3+2] = quantizeCoord(verts[i*3+2], orig[2], ics);
+	}
+	memcpy(offMeshVerts, &verts[meshVertCount*3], sizeof(float)*3*header->offMeshConCount*2);
+	for (int i = 0; i < header->detailVertCount; ++i)
+	{
+		qdetailVerts[i*3+0] = quantizeCoord(detailVerts[i*3+0], orig[0], ics);
+		qdetailVerts[i*3+1] = quantizeCoord(detailVerts[i*3+1], orig[1], ich);
+		qdetailVerts[i*3+2] = quantizeCoord(detailVerts[i*3+2], orig[2], ics);
+	}
+	
+	memcpy(qpolys, polys, polysSize + linksSize + detailMeshesSize);
+	memcpy(d, rest, detailTrisSize + bvtreeSize + offMeshLinksSize);
+	
+	*outData = qdata;
+	*outDataSize = qdataSize;
+	
+	return true;
+}
+
+bool dtDequantizeNavMeshData(const unsigned char* data, const int dataSize,
+							 unsigned char** outData, int* outDataSize)
+{
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (dataSize < (int)sizeof(dtMeshHeader))
+		return false;
+	if (header->magic != DT_NAVMESH_QUANTIZED_MAGIC)
+		return false;
+	if (header->version != DT_NAVMESH_VERSION)
+		return false;
+	
+	const int meshVertCount = header->vertCount - header->offMeshConCount*2;
+	
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	
+	const int quantHeaderSize = dtAlign4(sizeof(dtMeshQuantHeader));
+	const int qvertsSize = dtAlign4(sizeof(unsigned short)*3*meshVertCount);
+	const int offMeshVertsSize = dtAlign4(sizeof(float)*3*header->offMeshConCount*2);
+	const int qdetailVertsSize = dtAlign4(sizeof(unsigned short)*3*header->detailVertCount);
+	
+	const int qdataSize = headerSize + quantHeaderSize + qvertsSize + offMeshVertsSize + polysSize + linksSize +
+						  detailMeshesSize + qdetailVertsSize + detailTrisSize + bvtreeSize + offMeshLinksSize;
+	if (dataSize < qdataSize)
+		return false;
+	
+	const int outSize = headerSize + vertsSize + polysSize + linksSize +
+						detailMeshesSize + detailVertsSize + detailTrisSize +
+						bvtreeSize + offMeshLinksSize;
+	
+	unsigned char* out = (unsigned char*)dtAlloc(sizeof(unsigned char)*outSize, DT_ALLOC_PERM);
+	if (!out)
+		return false;
+	memset(out, 0, outSize);
+	
+	const unsigned char* s = data + headerSize;
+	const dtMeshQuantHeader* quant = dtGetThenAdvanceBufferPointer<const dtMeshQuantHeader>(s, quantHeaderSize);
+	const unsigned short* qverts = dtGetThenAdvanceBufferPointer<const unsigned short>(s, qvertsSize);
+	const float* offMeshVerts = dtGetThenAdvanceBufferPointer<const float>(s, offMeshVertsSize);
+	const unsigned char* qpolys = dtGetThenAdvanceBufferPointer<const unsigned char>(s, polysSize + linksSize + detailMeshesSize);
+	const unsigned short* qdetailVerts = dtGetThenAdvanceBufferPointer<const unsigned short>(s, qdetailVertsSize);
+	const unsigned char* rest = s;
+	
+	unsigned char* d = out;
+	dtMeshHeader* outHeader = dtGetThenAdvanceBufferPointer<dtMeshHeader>(d, headerSize);
+	float* verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+	unsigned char* polys = dtGetThenAdvanceBufferPointer<unsigned char>(d, polysSize + linksSize + detailMeshesSize);
+	float* detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	
+	memcpy(outHeader, header, sizeof(dtMeshHeader));
+	outHeader->magic = DT_NAVMESH_MAGIC;
+	
+	const float* orig = header->bmin;
+	for (int i = 0; i < meshVertCount; ++i)
+	{
+		verts[i*3+0] = orig[0] + qverts[i*3+0] * quant->cs;
+		verts[i*3+1] = orig[1] + qverts[i*3+1] * quant->ch;
+		verts[i*3+2] = orig[2] + qverts[i*3+2] * quant->cs;
+	}
+	memcpy(&verts[meshVertCount*3], offMeshVerts, sizeof(float)*3*header->offMeshConCount*2);
+	for (int i = 0; i < header->detailVertCount; ++i)
+	{
+		detailVerts[i*3+0] = orig[0] + qdetailVerts[i*3+0] * quant->cs;
+		detailVerts[i*3+1] = orig[1] + qdetailVerts[i*3+1] * quant->ch;
+		detailVerts[i*3+2] = orig[2] + qdetailVerts[i*3+2] * quant->cs;
+	}
+	
+	memcpy(polys, qpolys, polysSize + linksSize + detailMeshesSize);
+	memcpy(d, rest, detailTrisSize + bvtreeSize + offMeshLinksSize);
+	
+	*outData = out;
+	*outDataSize = outSize;
+	
+	return true;
+}
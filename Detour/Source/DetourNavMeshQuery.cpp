@@ -270,9 +270,10 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 		float polyArea = 0.0f;
 		for (int j = 2; j < p->vertCount; ++j)
 		{
-			const float* va = &tile->verts[p->verts[0]*3];
-			const float* vb = &tile->verts[p->verts[j-1]*3];
-			const float* vc = &tile->verts[p->verts[j]*3];
+			float va[3], vb[3], vc[3];
+			dtGetTileVert(tile, p->verts[0], va);
+			dtGetTileVert(tile, p->verts[j-1], vb);
+			dtGetTileVert(tile, p->verts[j], vc);
 			polyArea += dtTriArea2D(va,vb,vc);
 		}
 
@@ -290,15 +291,10 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 		return DT_FAILURE;
 
 	// Randomly pick point on polygon.
-	const float* v = &tile->verts[poly->verts[0]*3];
 	float verts[3*DT_VERTS_PER_POLYGON];
 	float areas[DT_VERTS_PER_POLYGON];
-	dtVcopy(&verts[0*3],v);
-	for (int j = 1; j < poly->vertCount; ++j)
-	{
-		v = &tile->verts[poly->verts[j]*3];
-		dtVcopy(&verts[j*3],v);
-	}
+	for (int j = 0; j < poly->vertCount; ++j)
+		dtGetTileVert(tile, poly->verts[j], &verts[j*3]);
 	
 	const float s = frand();
 	const float t = frand();
@@ -378,9 +374,10 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 			float polyArea = 0.0f;
 			for (int j = 2; j < bestPoly->vertCount; ++j)
 			{
-				const float* va = &bestTile->verts[bestPoly->verts[0]*3];
-				const float* vb = &bestTile->verts[bestPoly->verts[j-1]*3];
-				const float* vc = &bestTile->verts[bestPoly->verts[j]*3];
+				float va[3], vb[3], vc[3];
+				dtGetTileVert(bestTile, bestPoly->verts[0], va);
+				dtGetTileVert(bestTile, bestPoly->verts[j-1], vb);
+				dtGetTileVert(bestTile, bestPoly->verts[j], vc);
 				polyArea += dtTriArea2D(va,vb,vc);
 			}
 			// Choose random polygon weighted by area, using reservoir sampling.
@@ -473,15 +470,10 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 		return DT_FAILURE;
 	
 	// Randomly pick point on polygon.
-	const float* v = &randomTile->verts[randomPoly->verts[0]*3];
 	float verts[3*DT_VERTS_PER_POLYGON];
 	float areas[DT_VERTS_PER_POLYGON];
-	dtVcopy(&verts[0*3],v);
-	for (int j = 1; j < randomPoly->vertCount; ++j)
-	{
-		v = &randomTile->verts[randomPoly->verts[j]*3];
-		dtVcopy(&verts[j*3],v);
-	}
+	for (int j = 0; j < randomPoly->vertCount; ++j)
+		dtGetTileVert(randomTile, randomPoly->verts[j], &verts[j*3]);
 	
 	const float s = frand();
 	const float t = frand();
@@ -552,7 +544,7 @@ dtStatus dtNavMeshQuery::closestPointOnPolyBoundary(dtPolyRef ref, const float*
 	int nv = 0;
 	for (int i = 0; i < (int)poly->vertCount; ++i)
 	{
-		dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
+		dtGetTileVert(tile, poly->verts[i], &verts[nv*3]);
 		nv++;
 	}		
 	
@@ -605,8 +597,9 @@ dtStatus dtNavMeshQuery::getPolyHeight(dtPolyRef ref, const float* pos, float* h
 	// case it here.
 	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 	{
-		const float* v0 = &tile->verts[poly->verts[0]*3];
-		const float* v1 = &tile->verts[poly->verts[1]*3];
+		float v0[3], v1[3];
+		dtGetTileVert(tile, poly->verts[0], v0);
+		dtGetTileVert(tile, poly->verts[1], v1);
 		float t;
 		dtDistancePtSegSqr2D(pos, v0, v1, t);
 		if (height)
@@ -814,12 +807,13 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 			if (!filter->passFilter(ref, tile, p))
 				continue;
 			// Calc polygon bounds.
-			const float* v = &tile->verts[p->verts[0]*3];
+			float v[3];
+			dtGetTileVert(tile, p->verts[0], v);
 			dtVcopy(bmin, v);
 			dtVcopy(bmax, v);
 			for (int j = 1; j < p->vertCount; ++j)
 			{
-				v = &tile->verts[p->verts[j]*3];
+				dtGetTileVert(tile, p->verts[j], v);
 				dtVmin(bmin, v);
 				dtVmax(bmax, v);
 			}
@@ -920,6 +914,10 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 /// passed to this function. The dtPolyQuery::process function is invoked multiple
 /// times until all overlapping polygons have been processed.
 ///
+/// Tiles (and tile layers) whose bounds do not overlap the query box are skipped.
+/// For very wide queries the tiles are found by scanning the list of loaded tiles
+/// instead of probing each tile grid cell, so empty parts of the world cost nothing.
+///
 dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
 									   const dtQueryFilter* filter, dtPolyQuery* query) const
 {
@@ -941,6 +939,24 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 	m_nav->calcTileLoc(bmin, &minx, &miny);
 	m_nav->calcTileLoc(bmax, &maxx, &maxy);
 
+	// When the query covers more grid cells than there are tiles in the mesh,
+	// it is cheaper to scan the active tile list than to probe every cell.
+	const float cellCount = ((float)maxx - (float)minx + 1) * ((float)maxy - (float)miny + 1);
+	if (cellCount > (float)m_nav->m_activeTileCount)
+	{
+		for (int i = 0; i < m_nav->m_activeTileCount; ++i)
+		{
+			const dtMeshTile* tile = m_nav->m_activeTiles[i];
+			const dtMeshHeader* header = tile->header;
+			if (header->x < minx || header->x > maxx || header->y < miny || header->y > maxy)
+				continue;
+			if (!dtOverlapBounds(bmin, bmax, header->bmin, header->bmax))
+				continue;
+			queryPolygonsInTile(tile, bmin, bmax, filter, query);
+		}
+		return DT_SUCCESS;
+	}
+
 	static const int MAX_NEIS = 32;
 	const dtMeshTile* neis[MAX_NEIS];
 	
@@ -951,6 +967,9 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 			const int nneis = m_nav->getTilesAt(x,y,neis,MAX_NEIS);
 			for (int j = 0; j < nneis; ++j)
 			{
+				// Skip layers which do not overlap the query vertically.
+				if (!dtOverlapBounds(bmin, bmax, neis[j]->header->bmin, neis[j]->header->bmax))
+					continue;
 				queryPolygonsInTile(neis[j], bmin, bmax, filter, query);
 			}
 		}
@@ -2108,7 +2127,7 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 		// Collect vertices.
 		const int nverts = curPoly->vertCount;
 		for (int i = 0; i < nverts; ++i)
-			dtVcopy(&verts[i*3], &curTile->verts[curPoly->verts[i]*3]);
+			dtGetTileVert(curTile, curPoly->verts[i], &verts[i*3]);
 		
 		// If target is inside the poly, stop search.
 		if (dtPointInPolygon(endPos, verts, nverts))
@@ -2292,8 +2311,8 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 			if (fromTile->links[i].ref == to)
 			{
 				const int v = fromTile->links[i].edge;
-				dtVcopy(left, &fromTile->verts[fromPoly->verts[v]*3]);
-				dtVcopy(right, &fromTile->verts[fromPoly->verts[v]*3]);
+				dtGetTileVert(fromTile, fromPoly->verts[v], left);
+				dtGetTileVert(fromTile, fromPoly->verts[v], right);
 				return DT_SUCCESS;
 			}
 		}
@@ -2307,8 +2326,8 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 			if (toTile->links[i].ref == from)
 			{
 				const int v = toTile->links[i].edge;
-				dtVcopy(left, &toTile->verts[toPoly->verts[v]*3]);
-				dtVcopy(right, &toTile->verts[toPoly->verts[v]*3]);
+				dtGetTileVert(toTile, toPoly->verts[v], left);
+				dtGetTileVert(toTile, toPoly->verts[v], right);
 				return DT_SUCCESS;
 			}
 		}
@@ -2318,8 +2337,11 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 	// Find portal vertices.
 	const int v0 = fromPoly->verts[link->edge];
 	const int v1 = fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount];
-	dtVcopy(left, &fromTile->verts[v0*3]);
-	dtVcopy(right, &fromTile->verts[v1*3]);
+	float va[3], vb[3];
+	dtGetTileVert(fromTile, v0, va);
+	dtGetTileVert(fromTile, v1, vb);
+	dtVcopy(left, va);
+	dtVcopy(right, vb);
 	
 	// If the link is at tile boundary, dtClamp the vertices to
 	// the link width.
@@ -2331,8 +2353,8 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 			const float s = 1.0f/255.0f;
 			const float tmin = link->bmin*s;
 			const float tmax = link->bmax*s;
-			dtVlerp(left, &fromTile->verts[v0*3], &fromTile->verts[v1*3], tmin);
-			dtVlerp(right, &fromTile->verts[v0*3], &fromTile->verts[v1*3], tmax);
+			dtVlerp(left, va, vb, tmin);
+			dtVlerp(right, va, vb, tmax);
 		}
 	}
 	
@@ -2518,7 +2540,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 		int nv = 0;
 		for (int i = 0; i < (int)poly->vertCount; ++i)
 		{
-			dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
+			dtGetTileVert(tile, poly->verts[i], &verts[nv*3]);
 			nv++;
 		}
 		
@@ -2598,8 +2620,9 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 			// Check for partial edge links.
 			const int v0 = poly->verts[link->edge];
 			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
-			const float* left = &tile->verts[v0*3];
-			const float* right = &tile->verts[v1*3];
+			float left[3], right[3];
+			dtGetTileVert(tile, v0, left);
+			dtGetTileVert(tile, v1, right);
 			
 			// Check that the intersection lies inside the link portal.
 			if (link->side == 0 || link->side == 4)
@@ -3073,6 +3096,119 @@ dtStatus dtNavMeshQuery::getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef*
 	return getPathToNode(endNode, path, pathCount, maxPath);
 }
 
+/// @par
+///
+/// The agents move from a node to its parent, so a neighbour is only added to the search
+/// if it has a link to the expanded polygon. This follows one-way off-mesh connections the right way.
+///
+/// Polygons removed from the navigation mesh while the search is spread over several calls are skipped.
+dtStatus dtNavMeshQuery::updateReverseDijkstraSearch(const dtQueryFilter* filter, dtNodePool* nodePool,
+													 dtNodeQueue* openList, const int maxIter, int* doneIters) const
+{
+	dtAssert(m_nav);
+	
+	if (doneIters)
+		*doneIters = 0;
+	
+	if (!filter || !nodePool || !openList || maxIter < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	dtStatus status = DT_SUCCESS;
+	
+	int iter = 0;
+	while (iter < maxIter && !openList->empty())
+	{
+		++iter;
+		
+		dtNode* bestNode = openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		
+		// Get poly and tile.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		if (dtStatusFailed(m_nav->getTileAndPolyByRef(bestRef, &bestTile, &bestPoly)))
+			continue;
+		
+		// Get the next poly towards the goal.
+		dtPolyRef nextRef = 0;
+		const dtMeshTile* nextTile = 0;
+		const dtPoly* nextPoly = 0;
+		if (bestNode->pidx)
+			nextRef = nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (nextRef)
+			m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+		
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			const dtPolyRef neighbourRef = bestTile->links[i].ref;
+			// Skip invalid neighbours and do not follow back to the next poly.
+			if (!neighbourRef || neighbourRef == nextRef)
+				continue;
+			
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+			
+			// Do not advance if the polygon is excluded by the filter.
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+			
+			// The agents move from the neighbour to the best poly, through the portal
+			// leading from the neighbour to the best poly.
+			float pos[3];
+			if (dtStatusFailed(getEdgeMidPoint(neighbourRef, neighbourPoly, neighbourTile,
+											   bestRef, bestPoly, bestTile, pos)))
+				continue;
+			
+			dtNode* neighbourNode = nodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+			{
+				status |= DT_OUT_OF_NODES;
+				continue;
+			}
+			
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				continue;
+			
+			const float cost = filter->getCost(pos, bestNode->pos,
+											   neighbourRef, neighbourTile, neighbourPoly,
+											   bestRef, bestTile, bestPoly,
+											   nextRef, nextTile, nextPoly);
+			const float total = bestNode->total + cost;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			
+			dtVcopy(neighbourNode->pos, pos);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->pidx = nodePool->getNodeIdx(bestNode);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				openList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags = DT_NODE_OPEN;
+				openList->push(neighbourNode);
+			}
+		}
+	}
+	
+	if (doneIters)
+		*doneIters = iter;
+	
+	if (!openList->empty())
+		status = (status & ~DT_SUCCESS) | DT_IN_PROGRESS;
+	
+	return status;
+}
+
 /// @par
 ///
 /// This method is optimized for a small search radius and small number of result 
@@ -3213,7 +3349,7 @@ dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float*
 			// Collect vertices of the neighbour poly.
 			const int npa = neighbourPoly->vertCount;
 			for (int k = 0; k < npa; ++k)
-				dtVcopy(&pa[k*3], &neighbourTile->verts[neighbourPoly->verts[k]*3]);
+				dtGetTileVert(neighbourTile, neighbourPoly->verts[k], &pa[k*3]);
 			
 			bool overlap = false;
 			for (int j = 0; j < n; ++j)
@@ -3241,7 +3377,7 @@ dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float*
 				// Get vertices and test overlap
 				const int npb = pastPoly->vertCount;
 				for (int k = 0; k < npb; ++k)
-					dtVcopy(&pb[k*3], &pastTile->verts[pastPoly->verts[k]*3]);
+					dtGetTileVert(pastTile, pastPoly->verts[k], &pb[k*3]);
 				
 				if (dtOverlapPolyPoly2D(pa,npa, pb,npb))
 				{
@@ -3388,8 +3524,9 @@ dtStatus dtNavMeshQuery::getPolyWallSegments(dtPolyRef ref, const dtQueryFilter*
 			
 			if (n < maxSegments)
 			{
-				const float* vj = &tile->verts[poly->verts[j]*3];
-				const float* vi = &tile->verts[poly->verts[i]*3];
+				float vj[3], vi[3];
+				dtGetTileVert(tile, poly->verts[j], vj);
+				dtGetTileVert(tile, poly->verts[i], vi);
 				float* seg = &segmentVerts[n*6];
 				dtVcopy(seg+0, vj);
 				dtVcopy(seg+3, vi);
@@ -3410,8 +3547,9 @@ dtStatus dtNavMeshQuery::getPolyWallSegments(dtPolyRef ref, const dtQueryFilter*
 		insertInterval(ints, nints, MAX_INTERVAL, 255, 256, 0);
 		
 		// Store segments.
-		const float* vj = &tile->verts[poly->verts[j]*3];
-		const float* vi = &tile->verts[poly->verts[i]*3];
+		float vj[3], vi[3];
+		dtGetTileVert(tile, poly->verts[j], vj);
+		dtGetTileVert(tile, poly->verts[i], vi);
 		for (int k = 1; k < nints; ++k)
 		{
 			// Portal segment.
@@ -3564,8 +3702,9 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 			}
 			
 			// Calc distance to the edge.
-			const float* vj = &bestTile->verts[bestPoly->verts[j]*3];
-			const float* vi = &bestTile->verts[bestPoly->verts[i]*3];
+			float vj[3], vi[3];
+			dtGetTileVert(bestTile, bestPoly->verts[j], vj);
+			dtGetTileVert(bestTile, bestPoly->verts[i], vi);
 			float tseg;
 			float distSqr = dtDistancePtSegSqr2D(centerPos, vj, vi, tseg);
 			
@@ -3599,8 +3738,9 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 				continue;
 			
 			// Calc distance to the edge.
-			const float* va = &bestTile->verts[bestPoly->verts[link->edge]*3];
-			const float* vb = &bestTile->verts[bestPoly->verts[(link->edge+1) % bestPoly->vertCount]*3];
+			float va[3], vb[3];
+			dtGetTileVert(bestTile, bestPoly->verts[link->edge], va);
+			dtGetTileVert(bestTile, bestPoly->verts[(link->edge+1) % bestPoly->vertCount], vb);
 			float tseg;
 			float distSqr = dtDistancePtSegSqr2D(centerPos, va, vb, tseg);
 			
@@ -3694,3 +3834,23 @@ bool dtNavMeshQuery::isInClosedList(dtPolyRef ref) const
 
 	return false;
 }
+
+/// @par
+///
+/// The peak node count can be compared against the maximum number of nodes
+/// to tune the value passed to #init.
+void dtNavMeshQuery::getMemoryUsage(dtNavMeshQueryMemoryUsage* usage) const
+{
+	memset(usage, 0, sizeof(dtNavMeshQueryMemoryUsage));
+	if (m_nodePool)
+	{
+		usage->nodePool = m_nodePool->getMemUsed();
+		usage->maxNodes = m_nodePool->getMaxNodes();
+		usage->peakNodeCount = m_nodePool->getPeakNodeCount();
+	}
+	if (m_tinyNodePool)
+		usage->tinyNodePool = m_tinyNodePool->getMemUsed();
+	if (m_openList)
+		usage->openList = m_openList->getMemUsed();
+	usage->total = sizeof(*this) + usage->nodePool + usage->tinyNodePool + usage->openList;
+}
@@ -54,7 +54,8 @@ dtNodePool::dtNodePool(int maxNodes, int hashSize) :
 	m_next(0),
 	m_maxNodes(maxNodes),
 	m_hashSize(hashSize),
-	m_nodeCount(0)
+	m_nodeCount(0),
+	m_peakNodeCount(0)
 {
 	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
 	// pidx is special as 0 means "none" and 1 is the first node. For that reason
@@ -83,6 +84,8 @@ dtNodePool::~dtNodePool()
 void dtNodePool::clear()
 {
 	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	if (m_nodeCount > m_peakNodeCount)
+		m_peakNodeCount = m_nodeCount;
 	m_nodeCount = 0;
 }
 
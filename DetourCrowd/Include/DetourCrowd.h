@@ -25,6 +25,7 @@
 #include "DetourPathCorridor.h"
 #include "DetourProximityGrid.h"
 #include "DetourPathQueue.h"
+#include "DetourFlowField.h"
 
 /// The maximum number of neighbors that a crowd agent can take into account
 /// for steering decisions.
@@ -69,6 +70,21 @@ enum CrowdAgentState
 	DT_CROWDAGENT_STATE_OFFMESH 		///< The agent is traversing an off-mesh connection.
 };
 
+/// The level of detail used to update a crowd agent.
+/// @ingroup crowd
+/// @see dtCrowd::setAgentLOD(), dtCrowd::setLODUpdateInterval()
+enum CrowdAgentLOD
+{
+	DT_CROWDAGENT_LOD_FULL,			///< The agent is fully updated at every update.
+	DT_CROWDAGENT_LOD_REDUCED,		///< The neighbours, the avoidance and the path optimizations are updated at a reduced rate.
+	DT_CROWDAGENT_LOD_CORRIDOR,		///< The agent follows its path corridor without avoidance, separation or collisions.
+	DT_CROWDAGENT_LOD_FROZEN		///< The agent is not moved, but the other agents still avoid it.
+};
+
+/// The number of crowd agent levels of detail.
+/// @ingroup crowd
+static const int DT_CROWDAGENT_MAX_LODS = 4;
+
 /// Configuration parameters for a crowd agent.
 /// @ingroup crowd
 struct dtCrowdAgentParams
@@ -121,6 +137,9 @@ struct dtCrowdAgent
 	/// The type of mesh polygon the agent is traversing. (See: #CrowdAgentState)
 	unsigned char state;
 
+	/// The level of detail used to update the agent. (See: #CrowdAgentLOD)
+	unsigned char lod;
+
 	/// True if the agent has valid path (targetState == DT_CROWDAGENT_TARGET_VALID) and the path does not lead to the requested position, else false.
 	bool partial;
 
@@ -130,9 +149,12 @@ struct dtCrowdAgent
 	/// The local boundary data for the agent.
 	dtLocalBoundary boundary;
 	
-	/// Time since the agent's path corridor was optimized.
+	/// Time since the agent's path corridor was optimized, scaled by the update rate of its level of detail.
 	float topologyOptTime;
 	
+	/// The priority of the pending validity check of the path corridor, or 0 if none.
+	unsigned char pathCheck;
+	
 	/// The known neighbors of the agent.
 	dtCrowdNeighbour neis[DT_CROWDAGENT_MAX_NEIGHBOURS];
 
@@ -142,11 +164,16 @@ struct dtCrowdAgent
 	/// The desired speed.
 	float desiredSpeed;
 
-	float npos[3];		///< The current agent position. [(x, y, z)]
-	float disp[3];		///< A temporary value used to accumulate agent displacement during iterative collision resolution. [(x, y, z)]
-	float dvel[3];		///< The desired velocity of the agent. Based on the current path, calculated from scratch each frame. [(x, y, z)]
-	float nvel[3];		///< The desired velocity adjusted by obstacle avoidance, calculated from scratch each frame. [(x, y, z)]
-	float vel[3];		///< The actual velocity of the agent. The change from nvel -> vel is constrained by max acceleration. [(x, y, z)]
+	/// @{
+	/// @name Per-frame motion state
+	/// These point into the arrays the crowd keeps packed by agent index (see dtCrowd::getAgentPositions),
+	/// so the update loops over the neighbours do not have to touch the whole agent.
+	float* npos;		///< The current agent position. [(x, y, z)]
+	float* disp;		///< A temporary value used to accumulate agent displacement during iterative collision resolution. [(x, y, z)]
+	float* dvel;		///< The desired velocity of the agent. Based on the current path, calculated from scratch each frame. [(x, y, z)]
+	float* nvel;		///< The desired velocity adjusted by obstacle avoidance, calculated from scratch each frame. [(x, y, z)]
+	float* vel;			///< The actual velocity of the agent. The change from nvel -> vel is constrained by max acceleration. [(x, y, z)]
+	/// @}
 
 	/// The agent's configuration parameters.
 	dtCrowdAgentParams params;
@@ -169,6 +196,8 @@ struct dtCrowdAgent
 	dtPathQueueRef targetPathqRef;		///< Path finder ref.
 	bool targetReplan;					///< Flag indicating that the current path is being replanned.
 	float targetReplanTime;				/// <Time since the agent's target was replanned.
+	const dtFlowField* targetField;		///< The flow field the agent follows to its target, or null.
+	unsigned int targetFieldVersion;	///< The version of the flow field the target was taken from.
 };
 
 struct dtCrowdAgentAnimation
@@ -198,6 +227,92 @@ struct dtCrowdAgentDebugInfo
 	dtObstacleAvoidanceDebugData* vod;
 };
 
+/// Configures how the crowd plans the paths of the agents.
+/// @see dtCrowd::setPathParams
+/// @ingroup crowd
+struct dtCrowdPathParams
+{
+	/// The maximum number of path requests in the path queue at once. [Limit: >= 1]
+	int maxQueuedRequests;
+	
+	/// The maximum number of pathfinder iterations the path queue runs per update. [Limit: >= 1]
+	int maxQueueIters;
+	
+	/// The maximum number of quick searches towards a new target run per update.
+	/// The other agents wait for the next update. [Limit: >= 1]
+	int maxQuickSearches;
+	
+	/// The number of pathfinder iterations of a quick search. [Limit: >= 0]
+	int quickSearchIters;
+	
+	/// True if the path queue is updated by the user with #dtCrowd::updatePathQueue,
+	/// for example on a worker thread, instead of by #dtCrowd::update.
+	bool userPathQueueUpdate;
+};
+
+/// Configures how the crowd spreads the maintenance of the agent paths over the updates.
+/// @see dtCrowd::setMaintenanceParams
+/// @ingroup crowd
+struct dtCrowdMaintenanceParams
+{
+	/// The maximum number of path corridors improved by topology optimization per update.
+	/// The agents which have waited the longest are optimized first. [Limit: >= 0]
+	int maxTopologyOptimizations;
+	
+	/// The time an agent waits between two topology optimizations of its path corridor. [Limit: >= 0] [Unit: s]
+	float topologyOptimizationDelay;
+	
+	/// The maximum number of path corridors validated per update after navigation mesh tile changes.
+	/// The agents standing on a changed tile are validated first. [Limit: >= 1]
+	int maxPathChecks;
+	
+	/// The number of path corridors validated in turn per update, whether tiles changed or not.
+	/// This catches the changes the navigation mesh does not record, like filter changes. [Limit: >= 0]
+	int pathSweepChecks;
+};
+
+/// Memory used by a crowd, broken down by category.
+/// @see dtCrowd::getMemoryUsage
+/// @ingroup crowd
+struct dtCrowdMemoryUsage
+{
+	size_t agents;				///< The agent pool, including the corridor paths. [Unit: bytes]
+	size_t animations;			///< The off-mesh connection animation states. [Unit: bytes]
+	size_t pathQueue;			///< The path request queue and its query object. [Unit: bytes]
+	size_t proximityGrid;		///< The proximity grid used to find the neighbours. [Unit: bytes]
+	size_t obstacleAvoidance;	///< The obstacle avoidance queries of the workers. [Unit: bytes]
+	size_t wallSegments;		///< The wall segment caches of the workers. [Unit: bytes]
+	size_t navQuery;			///< The query objects of the workers. [Unit: bytes]
+	size_t total;				///< The sum of all the categories above, including the crowd object itself. [Unit: bytes]
+};
+
+/// A unit of work handed by the crowd to a #dtCrowdTaskRunner.
+/// @ingroup crowd
+class dtCrowdTask
+{
+public:
+	virtual ~dtCrowdTask();
+	
+	/// Processes the share of the work assigned to the specified worker.
+	///  @param[in]		worker	The worker index. [Limits: 0 <= value < worker count]
+	virtual void execute(const int worker) = 0;
+};
+
+/// Runs the parallel phases of #dtCrowd::update on the user's threads.
+/// @see dtCrowd::setTaskRunner
+/// @ingroup crowd
+class dtCrowdTaskRunner
+{
+public:
+	virtual ~dtCrowdTaskRunner();
+	
+	/// Calls dtCrowdTask::execute once for each worker index and returns when all the calls have finished.
+	/// The calls may run concurrently, each worker index must be used by only one thread at a time.
+	///  @param[in]		task			The task to run.
+	///  @param[in]		workerCount		The number of workers to run the task on.
+	virtual void run(dtCrowdTask* task, const int workerCount) = 0;
+};
+
 /// Provides local steering behaviors for a group of agents. 
 /// @ingroup crowd
 class dtCrowd
@@ -207,7 +322,22 @@ class dtCrowd
 	dtCrowdAgent** m_activeAgents;
 	dtCrowdAgentAnimation* m_agentAnims;
 	
+	// The state read by the per-frame phases, packed by agent index. The agents point into these.
+	float* m_agentPos;		///< Agent positions. [(x, y, z) * maxAgents]
+	float* m_agentDisp;		///< Agent collision displacements. [(x, y, z) * maxAgents]
+	float* m_agentDvel;		///< Agent desired velocities. [(x, y, z) * maxAgents]
+	float* m_agentNvel;		///< Agent avoidance velocities. [(x, y, z) * maxAgents]
+	float* m_agentVel;		///< Agent velocities. [(x, y, z) * maxAgents]
+	float* m_agentRadius;	///< Agent radii, set from the agent parameters. [maxAgents]
+	
 	dtPathQueue m_pathq;
+	dtCrowdPathParams m_pathParams;
+	dtCrowdAgent** m_pathRequestAgents;		///< Agents waiting for the path queue, by priority. [maxQueuedRequests]
+	
+	dtCrowdMaintenanceParams m_maintenanceParams;
+	dtCrowdAgent** m_optQueue;				///< Agents picked for topology optimization, by priority. [maxAgents]
+	unsigned int m_tileChangeCount;			///< The navigation mesh tile change count seen last.
+	int m_pathSweepCursor;					///< The active agent validated last by the sweep.
 
 	dtObstacleAvoidanceParams m_obstacleQueryParams[DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS];
 	dtObstacleAvoidanceQuery* m_obstacleQuery;
@@ -227,16 +357,46 @@ class dtCrowd
 
 	dtNavMeshQuery* m_navquery;
 
+	dtCrowdTaskRunner* m_taskRunner;
+	int m_workerCount;
+	dtNavMeshQuery** m_workerNavQueries;				///< Query per worker, the first one is m_navquery.
+	dtObstacleAvoidanceQuery** m_workerObstacleQueries;	///< Obstacle query per worker, the first one is m_obstacleQuery.
+	dtWallSegmentCache** m_workerWallCaches;			///< Wall segment cache per worker, shared by the local boundaries of its agents.
+	int* m_workerSampleCounts;
+
+	int m_lodUpdateInterval[DT_CROWDAGENT_MAX_LODS];
+	unsigned int m_updateCount;
+
+	bool initWorkers(const int workerCount);
+	void purgeWorkers();
+	void runPhase(const int phase, dtCrowdAgent** agents, const int nagents, const float dt, dtCrowdAgentDebugInfo* debug);
+	void updatePhase(const int phase, const int worker, dtCrowdAgent** agents,
+					 const int begin, const int end, const float dt, dtCrowdAgentDebugInfo* debug);
+
 	void updateTopologyOptimization(dtCrowdAgent** agents, const int nagents, const float dt);
+	void updateGrid(dtCrowdAgent** agents, const int nagents);
 	void updateMoveRequest(const float dt);
 	void checkPathValidity(dtCrowdAgent** agents, const int nagents, const float dt);
+	void updateTileChanges(dtCrowdAgent** agents, const int nagents);
+	bool validateAgentPath(dtCrowdAgent* ag);
 
 	inline int getAgentIndex(const dtCrowdAgent* agent) const  { return (int)(agent - m_agents); }
 
+	// Returns true if the parts of the agent update which run at a reduced rate are updated this time.
+	// The agents are staggered by their index so that the work is spread over the updates.
+	inline bool isLODUpdate(const dtCrowdAgent* agent) const
+	{
+		const unsigned int interval = (unsigned int)m_lodUpdateInterval[agent->lod];
+		return (m_updateCount + (unsigned int)getAgentIndex(agent)) % interval == 0;
+	}
+
 	bool requestMoveTargetReplan(const int idx, dtPolyRef ref, const float* pos);
+	bool initPathQueue(const dtNavMesh* nav, const dtCrowdPathParams* params);
 
 	void purge();
 	
+	friend class dtCrowdPhaseTask;
+	
 public:
 	dtCrowd();
 	~dtCrowd();
@@ -265,9 +425,22 @@ public:
 	const dtCrowdAgent* getAgent(const int idx);
 
 	/// Gets the specified agent from the pool.
+	/// Change the agent parameters using #updateAgentParameters.
 	///	 @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
 	/// @return The requested agent.
 	dtCrowdAgent* getEditableAgent(const int idx);
+	
+	/// Gets the positions of all the agents in the pool, including the inactive ones.
+	/// @return The positions indexed by agent index. [(x, y, z) * #getAgentCount()]
+	const float* getAgentPositions() const { return m_agentPos; }
+	
+	/// Gets the velocities of all the agents in the pool, including the inactive ones.
+	/// @return The velocities indexed by agent index. [(x, y, z) * #getAgentCount()]
+	const float* getAgentVelocities() const { return m_agentVel; }
+	
+	/// Gets the radii of all the agents in the pool, including the inactive ones.
+	/// @return The radii indexed by agent index. [(radius) * #getAgentCount()]
+	const float* getAgentRadii() const { return m_agentRadius; }
 
 	/// The maximum number of agents that can be managed by the object.
 	/// @return The maximum number of agents.
@@ -284,6 +457,24 @@ public:
 	///  @param[in]		params	The new agent configuration.
 	void updateAgentParameters(const int idx, const dtCrowdAgentParams* params);
 
+	/// Sets the level of detail used to update the specified agent.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		lod		The level of detail. (See: #CrowdAgentLOD)
+	/// @return True if the level of detail was set.
+	bool setAgentLOD(const int idx, const int lod);
+
+	/// Sets how often the reduced rate parts of the agent update run at the specified level of detail.
+	/// Only #DT_CROWDAGENT_LOD_REDUCED and #DT_CROWDAGENT_LOD_CORRIDOR have parts updated at a reduced rate.
+	///  @param[in]		lod			The level of detail. (See: #CrowdAgentLOD)
+	///  @param[in]		interval	The number of updates between two updates of the parts. [Limit: >= 1]
+	/// @return True if the interval was set.
+	bool setLODUpdateInterval(const int lod, const int interval);
+
+	/// Gets how often the reduced rate parts of the agent update run at the specified level of detail.
+	///  @param[in]		lod		The level of detail. (See: #CrowdAgentLOD)
+	/// @return The number of updates between two updates of the parts, or 0 if the level of detail is not valid.
+	int getLODUpdateInterval(const int lod) const;
+
 	/// Removes the agent from the crowd.
 	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
 	void removeAgent(const int idx);
@@ -295,6 +486,14 @@ public:
 	/// @return True if the request was successfully submitted.
 	bool requestMoveTarget(const int idx, dtPolyRef ref, const float* pos);
 
+	/// Submits a new move request for the specified agent, to the goal of a flow field.
+	/// The agent takes its path from the flow field instead of searching for it, and follows
+	/// the goal of the flow field when a new table is finished.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		field	The flow field, it must have a finished table and outlive the request.
+	/// @return True if the request was successfully submitted.
+	bool requestMoveFlowField(const int idx, const dtFlowField* field);
+
 	/// Submits a new move request for the specified agent.
 	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
 	///  @param[in]		vel		The movement velocity. [(x, y, z)]
@@ -344,10 +543,51 @@ public:
 	/// Gets the crowd's path request queue.
 	/// @return The crowd's path request queue.
 	const dtPathQueue* getPathQueue() const { return &m_pathq; }
+	
+	/// Sets how the crowd plans the paths of the agents.
+	/// Changing the queue size drops the queued requests, the agents request their paths again.
+	/// Must not be called while #updatePathQueue is running.
+	///  @param[in]		params	The new configuration.
+	/// @return True if the configuration was set.
+	bool setPathParams(const dtCrowdPathParams* params);
+	
+	/// Gets how the crowd plans the paths of the agents.
+	/// @return The path planning configuration.
+	const dtCrowdPathParams* getPathParams() const { return &m_pathParams; }
+	
+	/// Runs the path queue for dtCrowdPathParams::maxQueueIters pathfinder iterations.
+	/// Only needed when dtCrowdPathParams::userPathQueueUpdate is set, in which case it
+	/// may be called on another thread than #update, while #update is running.
+	/// The navigation mesh must not be changed meanwhile.
+	void updatePathQueue();
+
+	/// Sets how the crowd spreads the maintenance of the agent paths over the updates.
+	///  @param[in]		params	The new configuration.
+	/// @return True if the configuration was set.
+	bool setMaintenanceParams(const dtCrowdMaintenanceParams* params);
+	
+	/// Gets how the crowd spreads the maintenance of the agent paths over the updates.
+	/// @return The maintenance configuration.
+	const dtCrowdMaintenanceParams* getMaintenanceParams() const { return &m_maintenanceParams; }
 
 	/// Gets the query object used by the crowd.
 	const dtNavMeshQuery* getNavMeshQuery() const { return m_navquery; }
 
+	/// Sets the task runner used to split the agent update phases across several workers.
+	/// Each worker gets its own query objects, so this allocates memory when the worker count grows.
+	///  @param[in]		runner			The task runner, or null to update the agents serially. [opt]
+	///  @param[in]		workerCount		The number of workers. Ignored if @p runner is null. [Limit: >= 1]
+	/// @return True if the workers were set up successfully.
+	bool setTaskRunner(dtCrowdTaskRunner* runner, const int workerCount);
+	
+	/// Gets the number of workers used by #update.
+	/// @return The number of workers used by #update.
+	inline int getWorkerCount() const { return m_workerCount; }
+
+	/// Gets the memory used by the crowd.
+	///  @param[out]	usage	The memory usage per category.
+	void getMemoryUsage(dtCrowdMemoryUsage* usage) const;
+
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtCrowd(const dtCrowd&);
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURFLOWFIELD_H
+#define DETOURFLOWFIELD_H
+
+#include "DetourNavMesh.h"
+
+class dtNavMeshQuery;
+class dtQueryFilter;
+class dtNodePool;
+class dtNodeQueue;
+
+/// A table of the next polygon to move to in order to reach a shared goal, for every polygon around the goal.
+///
+/// The table is built with a Dijkstra search backwards from the goal, so any number of agents moving
+/// to the same goal can find their path without searching.
+///
+/// Usage:
+///  -# #setGoal() to start building the table.
+///  -# #update() until it returns a success status. The build can be spread over several updates.
+///  -# #getPath() as many times as needed.
+///  -# When #isUpToDate() returns false, the navigation mesh tiles have changed since the build started.
+///     Call #setGoal() again with the same goal to rebuild the table.
+///
+/// The previous table stays available until the new one is finished.
+/// @ingroup crowd
+class dtFlowField
+{
+	const dtNavMesh* m_nav;
+	
+	dtNodePool* m_pools[2];		///< The finished table and the one being built.
+	dtNodeQueue* m_openList;
+	int m_current;				///< The index of the finished table, or -1 if there is none.
+	int m_building;				///< The index of the table being built, or -1 if there is none.
+	
+	struct Goal
+	{
+		dtPolyRef ref;
+		float pos[3];
+	};
+	Goal m_goals[2];
+	const dtQueryFilter* m_filter;
+	dtStatus m_buildStatus;
+	unsigned int m_version;
+	
+	dtTileRef* m_tileRefs[2];	///< The tiles of the navigation mesh when the tables were started. [maxTiles]
+	int m_maxTiles;
+	
+	void purge();
+	void snapshotTiles(dtTileRef* tileRefs) const;
+	
+public:
+	dtFlowField();
+	~dtFlowField();
+	
+	/// Initializes the flow field.
+	///  @param[in]		nav			The navigation mesh to search.
+	///  @param[in]		maxNodes	The maximum number of polygons in the table. [Limits: 0 < value <= 65535]
+	/// @return True if the initialization succeeded.
+	bool init(const dtNavMesh* nav, const int maxNodes);
+	
+	/// Starts building the table towards a new goal.
+	///  @param[in]		goalRef		The reference of the goal polygon.
+	///  @param[in]		goalPos		The goal position. [(x, y, z)]
+	///  @param[in]		filter		The filter to apply to the search, must stay valid until the build is finished.
+	/// @returns The status flags for the query.
+	dtStatus setGoal(dtPolyRef goalRef, const float* goalPos, const dtQueryFilter* filter);
+	
+	/// Continues building the table.
+	///  @param[in]		query		A query object for the navigation mesh the field was initialized with.
+	///  @param[in]		maxIters	The maximum number of polygons to expand.
+	///  @param[out]	doneIters	The number of polygons expanded. [opt]
+	/// @returns #DT_IN_PROGRESS while the table is being built, then the status of the build.
+	///			#DT_OUT_OF_NODES is set if some polygons could not be added to the table.
+	dtStatus update(const dtNavMeshQuery* query, const int maxIters, int* doneIters = 0);
+	
+	/// Returns true if a finished table is available.
+	inline bool isReady() const { return m_current != -1; }
+	
+	/// Returns true if a table is being built.
+	inline bool isUpdating() const { return m_building != -1; }
+	
+	/// Returns false if the navigation mesh tiles have changed since the table being built,
+	/// or else the finished one, was started.
+	bool isUpToDate() const;
+	
+	/// Gets the number of finished tables, it changes each time a new table is finished.
+	inline unsigned int getVersion() const { return m_version; }
+	
+	/// Gets the goal polygon of the finished table, or 0 if there is none.
+	inline dtPolyRef getGoalRef() const { return m_current != -1 ? m_goals[m_current].ref : 0; }
+	
+	/// Gets the goal position of the finished table. [(x, y, z)]
+	inline const float* getGoalPos() const { return m_goals[m_current != -1 ? m_current : 0].pos; }
+	
+	/// Gets the polygon to move to from the specified polygon.
+	///  @param[in]		ref		The reference of the polygon to move from.
+	/// @return The next polygon, or 0 if the polygon is the goal or is not in the table.
+	dtPolyRef getNextPoly(dtPolyRef ref) const;
+	
+	/// Gets the cost of the path from the specified polygon to the goal.
+	///  @param[in]		ref		The reference of the polygon.
+	///  @param[out]	cost	The cost to reach the goal.
+	/// @return True if the polygon is in the table.
+	bool getCost(dtPolyRef ref, float* cost) const;
+	
+	/// Follows the table from the specified polygon towards the goal.
+	/// The path stops early at polygons which are no longer valid.
+	///  @param[in]		startRef	The reference of the start polygon.
+	///  @param[out]	path		The polygons from the start polygon towards the goal. [(polyRef) * @p pathCount]
+	///  @param[in]		maxPath		The maximum number of polygons the path can hold. [Limit: >= 1]
+	/// @return The number of polygons in the path, or 0 if the start polygon is not in the table.
+	int getPath(dtPolyRef startRef, dtPolyRef* path, const int maxPath) const;
+	
+	/// Gets the memory used by the flow field.
+	int getMemUsed() const;
+	
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtFlowField(const dtFlowField&);
+	dtFlowField& operator=(const dtFlowField&);
+};
+
+/// Allocates a flow field object using the Detour allocator.
+/// @return A flow field object that is ready for initialization, or null on failure.
+/// @ingroup crowd
+dtFlowField* dtAllocFlowField();
+
+/// Frees the specified flow field object using the Detour allocator.
+///  @param[in]		ptr		A flow field object allocated using #dtAllocFlowField
+/// @ingroup crowd
+void dtFreeFlowField(dtFlowField* ptr);
+
+#endif // DETOURFLOWFIELD_H
@@ -21,6 +21,94 @@
 
 #include "DetourNavMeshQuery.h"
 
+/// Caches the wall segments of polygons, so that the local boundaries of agents
+/// walking on the same polygons share the navigation mesh queries.
+/// The segments are keyed by the polygon, the filter object and its include and
+/// exclude flags. Any other change of the filter is not noticed, call #clear after it.
+/// The cache is not thread safe, each thread needs its own cache.
+class dtWallSegmentCache
+{
+	static const int MAX_SEGS_PER_POLY = DT_VERTS_PER_POLYGON*3;
+	
+	struct Entry
+	{
+		dtPolyRef ref;					///< The polygon reference.
+		const dtQueryFilter* filter;	///< The filter the segments were found with.
+		unsigned short includeFlags;	///< The include flags of the filter.
+		unsigned short excludeFlags;	///< The exclude flags of the filter.
+		unsigned int stamp;				///< The entry is in use if the stamp matches the cache stamp.
+		int tile;						///< The tile index of the polygon.
+		int firstSeg;					///< The index of the first segment.
+		int nsegs;						///< The number of segments, or -1 if the polygon must be queried again.
+	};
+	
+	Entry* m_entries;
+	int m_tableSize;
+	int m_maxPolys;
+	int m_npolys;
+	
+	float* m_segs;
+	int m_maxSegs;
+	int m_nsegs;
+	
+	unsigned int m_stamp;
+	int m_hits;
+	int m_misses;
+	
+	float m_tmpSegs[MAX_SEGS_PER_POLY*6];
+	
+	void purge();
+	
+public:
+	dtWallSegmentCache();
+	~dtWallSegmentCache();
+	
+	/// Initializes the cache.
+	///  @param[in]	maxPolys	The maximum number of polygons in the cache. [Limit: > 0]
+	///  @param[in]	maxSegs		The maximum number of segments in the cache. [Limit: >= #DT_VERTS_PER_POLYGON * 3]
+	/// @return True if the initialization succeeded.
+	bool init(const int maxPolys, const int maxSegs);
+	
+	/// Removes all the polygons from the cache.
+	void clear();
+	
+	/// Makes the cache query the polygons of the specified tiles again.
+	///  @param[in]	tiles	The tile indices, sorted in ascending order. [(index) * @p ntiles]
+	///  @param[in]	ntiles	The number of tiles.
+	void invalidateTiles(const int* tiles, const int ntiles);
+	
+	/// Gets the wall segments of the specified polygon, from the cache if possible.
+	/// (See: dtNavMeshQuery::getPolyWallSegments)
+	///  @param[in]		ref			The reference of the polygon.
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[in]		navquery	The query object used to find the segments missing from the cache.
+	///  @param[out]	segs		The segments, valid until the next call. [(ax, ay, az, bx, by, bz) * segmentCount]
+	/// @return The number of segments.
+	int getWallSegments(dtPolyRef ref, const dtQueryFilter* filter, const dtNavMeshQuery* navquery, const float** segs);
+	
+	/// Gets the number of polygons found in the cache since the cache was initialized.
+	inline int getHitCount() const { return m_hits; }
+	
+	/// Gets the number of polygons queried from the navigation mesh since the cache was initialized.
+	inline int getMissCount() const { return m_misses; }
+	
+	/// Gets the memory used by the cache.
+	/// @return The size of the cache and its buffers. [Unit: bytes]
+	size_t getMemUsed() const;
+	
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtWallSegmentCache(const dtWallSegmentCache&);
+	dtWallSegmentCache& operator=(const dtWallSegmentCache&);
+};
+
+/// Allocates a wall segment cache object using the Detour allocator.
+/// @return A wall segment cache that is ready for initialization, or null on failure.
+dtWallSegmentCache* dtAllocWallSegmentCache();
+
+/// Frees the specified wall segment cache object using the Detour allocator.
+///  @param[in]	ptr		A wall segment cache allocated using #dtAllocWallSegmentCache
+void dtFreeWallSegmentCache(dtWallSegmentCache* ptr);
 
 class dtLocalBoundary
 {
@@ -49,7 +137,7 @@ public:
 	void reset();
 	
 	void update(dtPolyRef ref, const float* pos, const float collisionQueryRange,
-				dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+				dtNavMeshQuery* navquery, const dtQueryFilter* filter, dtWallSegmentCache* cache = 0);
 	
 	bool isValid(dtNavMeshQuery* navquery, const dtQueryFilter* filter);
 	
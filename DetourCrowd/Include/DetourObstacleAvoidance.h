@@ -34,6 +34,14 @@ struct dtObstacleSegment
 	bool touch;
 };
 
+/// A half-plane of permitted velocities, used by dtObstacleAvoidanceQuery::computeVelocityORCA.
+/// The permitted velocities are on the left side of the line. The coordinates are (x, z).
+struct dtObstacleLine
+{
+	float point[2];			///< A point on the line.
+	float dir[2];			///< The normalized direction of the line.
+};
+
 
 class dtObstacleAvoidanceDebugData
 {
@@ -80,6 +88,15 @@ void dtFreeObstacleAvoidanceDebugData(dtObstacleAvoidanceDebugData* ptr);
 static const int DT_MAX_PATTERN_DIVS = 32;	///< Max numver of adaptive divs.
 static const int DT_MAX_PATTERN_RINGS = 4;	///< Max number of adaptive rings.
 
+/// The methods used by dtCrowd to choose a velocity.
+/// @see dtObstacleAvoidanceParams::mode
+enum dtObstacleAvoidanceMode
+{
+	DT_OBSTACLE_AVOIDANCE_ADAPTIVE = 0,	///< Sample velocities with dtObstacleAvoidanceQuery::sampleVelocityAdaptive.
+	DT_OBSTACLE_AVOIDANCE_GRID = 1,		///< Sample velocities with dtObstacleAvoidanceQuery::sampleVelocityGrid.
+	DT_OBSTACLE_AVOIDANCE_ORCA = 2		///< Solve for the velocity with dtObstacleAvoidanceQuery::computeVelocityORCA.
+};
+
 struct dtObstacleAvoidanceParams
 {
 	float velBias;
@@ -92,8 +109,13 @@ struct dtObstacleAvoidanceParams
 	unsigned char adaptiveDivs;	///< adaptive
 	unsigned char adaptiveRings;	///< adaptive
 	unsigned char adaptiveDepth;	///< adaptive
+	unsigned char mode;		///< The velocity selection method, 0 (#DT_OBSTACLE_AVOIDANCE_ADAPTIVE) is the sampling used before modes existed. (See: #dtObstacleAvoidanceMode)
 };
 
+/// Sets the avoidance parameters to the defaults used by dtCrowd, with the adaptive sampling mode.
+///  @param[out]	params	The parameters to initialize.
+void dtInitObstacleAvoidanceParams(dtObstacleAvoidanceParams* params);
+
 class dtObstacleAvoidanceQuery
 {
 public:
@@ -119,23 +141,54 @@ public:
 							   const dtObstacleAvoidanceParams* params, 
 							   dtObstacleAvoidanceDebugData* debug = 0);
 	
+	/// Computes the velocity closest to the desired velocity which avoids the obstacles,
+	/// using Optimal Reciprocal Collision Avoidance (ORCA).
+	/// 
+	/// Each obstacle limits the velocity to a half-plane, and the velocity is found with
+	/// linear programming instead of sampling. The circles are expected to be other agents
+	/// using the same method, each agent takes half of the responsibility of avoiding the other.
+	/// Segments are expected to be navmesh walls, which the agent already keeps away from,
+	/// and they only prevent the agent from crossing them during the next time step.
+	/// 
+	///  @param[in]		pos		The position of the agent.
+	///  @param[in]		rad		The radius of the agent.
+	///  @param[in]		vmax	The maximum speed of the agent.
+	///  @param[in]		vel		The current velocity of the agent.
+	///  @param[in]		dvel	The desired velocity of the agent.
+	///  @param[out]	nvel	The new velocity of the agent.
+	///  @param[in]		dt		The time step. [Limit: > 0]
+	///  @param[in]		params	The avoidance parameters, only #dtObstacleAvoidanceParams::horizTime is used.
+	///  @param[in]		debug	Receives the chosen velocity if not null.
+	/// @return The number of half-planes the velocity was constrained by.
+	int computeVelocityORCA(const float* pos, const float rad, const float vmax,
+							const float* vel, const float* dvel, float* nvel,
+							const float dt, const dtObstacleAvoidanceParams* params,
+							dtObstacleAvoidanceDebugData* debug = 0);
+	
 	inline int getObstacleCircleCount() const { return m_ncircles; }
 	const dtObstacleCircle* getObstacleCircle(const int i) { return &m_circles[i]; }
 
 	inline int getObstacleSegmentCount() const { return m_nsegments; }
 	const dtObstacleSegment* getObstacleSegment(const int i) { return &m_segments[i]; }
 
+	inline int getMemUsed() const
+	{
+		return sizeof(*this) +
+			(sizeof(dtObstacleCircle) + sizeof(float)*DT_CIRCLE_SOA_SIZE)*m_maxCircles +
+			(sizeof(dtObstacleSegment) + sizeof(float)*DT_SEGMENT_SOA_SIZE)*m_maxSegments +
+			sizeof(dtObstacleLine)*2*(m_maxCircles+m_maxSegments);
+	}
+
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtObstacleAvoidanceQuery(const dtObstacleAvoidanceQuery&);
 	dtObstacleAvoidanceQuery& operator=(const dtObstacleAvoidanceQuery&);
 
-	void prepare(const float* pos, const float* dvel);
+	void prepare(const float* pos, const float rad, const float* dvel);
 
-	float processSample(const float* vcand, const float cs,
-						const float* pos, const float rad,
+	void processSamples(const float* vcands, const int nvcands, const float cs,
 						const float* vel, const float* dvel,
-						const float minPenalty,
+						float& minPenalty, float* bestVel,
 						dtObstacleAvoidanceDebugData* debug);
 
 	dtObstacleAvoidanceParams m_params;
@@ -150,6 +203,16 @@ private:
 	int m_maxSegments;
 	dtObstacleSegment* m_segments;
 	int m_nsegments;
+
+	// The obstacles are copied by prepare() into one array per component,
+	// so that a batch of candidate velocities can be tested against each obstacle at once.
+	enum { DT_CIRCLE_SOA_SIZE = 9, DT_SEGMENT_SOA_SIZE = 8 };
+	float* m_circleSoA;		///< [(vel x, vel z, dp x, dp z, np x, np z, s x, s z, c) * m_maxCircles]
+	float* m_segmentSoA;	///< [(touch, norm x, norm z, dir x, dir z, w x, w z, perp(dir, w)) * m_maxSegments]
+
+	// Half-planes used by computeVelocityORCA(), and the projected half-planes used when they are infeasible.
+	dtObstacleLine* m_lines;
+	dtObstacleLine* m_projLines;
 };
 
 dtObstacleAvoidanceQuery* dtAllocObstacleAvoidanceQuery();
@@ -133,6 +133,10 @@ public:
 	/// @return The number of polygons in the current corridor path.
 	inline int getPathCount() const { return m_npath; }
 
+	/// The maximum number of polygons the corridor path can hold.
+	/// @return The maximum number of polygons the corridor path can hold.
+	inline int getMaxPath() const { return m_maxPath; }
+
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtPathCorridor(const dtPathCorridor&);
@@ -24,8 +24,16 @@
 
 static const unsigned int DT_PATHQ_INVALID = 0;
 
+/// The default number of requests a path queue can hold at once.
+static const int DT_PATHQ_DEFAULT_MAX_REQUESTS = 8;
+
 typedef unsigned int dtPathQueueRef;
 
+/// Processes path requests over several updates, a limited number of pathfinder iterations at a time.
+///
+/// #update may run on another thread than the other methods, for example on a worker thread
+/// which returns the results asynchronously. Calls to #update must not overlap with each other,
+/// nor with #init. The navigation mesh must not be changed while #update is running.
 class dtPathQueue
 {
 	struct PathQuery
@@ -34,20 +42,23 @@ class dtPathQueue
 		/// Path find start and end location.
 		float startPos[3], endPos[3];
 		dtPolyRef startRef, endRef;
+		/// Requests with higher priority are processed first.
+		float priority;
 		/// Result.
 		dtPolyRef* path;
 		int npath;
 		/// State.
 		dtStatus status;
-		int keepAlive;
+		int keepAlive;			///< Updates since the request was finished. Written by #update only.
+		int owner;				///< Who may access the request. Accessed with atomics.
 		const dtQueryFilter* filter; ///< TODO: This is potentially dangerous!
 	};
 	
-	static const int MAX_QUEUE = 8;
-	PathQuery m_queue[MAX_QUEUE];
+	PathQuery* m_queue;
+	int m_maxQueue;
 	dtPathQueueRef m_nextHandle;
 	int m_maxPathSize;
-	int m_queueHead;
+	int m_activeQuery;		///< The request being searched by #update, or -1.
 	dtNavMeshQuery* m_navquery;
 	
 	void purge();
@@ -56,19 +67,49 @@ public:
 	dtPathQueue();
 	~dtPathQueue();
 	
-	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav);
+	/// Initializes the queue.
+	///  @param[in]		maxPathSize			The maximum number of polygons in a path result.
+	///  @param[in]		maxSearchNodeCount	The maximum number of search nodes of the pathfinder.
+	///  @param[in]		nav					The navigation mesh to search.
+	///  @param[in]		maxRequests			The maximum number of requests in the queue at once. [Limit: >= 1]
+	/// @return True if the initialization succeeded.
+	bool init(const int maxPathSize, const int maxSearchNodeCount, const dtNavMesh* nav,
+			  const int maxRequests = DT_PATHQ_DEFAULT_MAX_REQUESTS);
 	
+	/// Runs the pathfinder on the queued requests, highest priority first.
+	///  @param[in]		maxIters	The maximum number of pathfinder iterations to run.
 	void update(const int maxIters);
 	
+	/// Queues a path request.
+	///  @param[in]		startRef	The reference of the start polygon.
+	///  @param[in]		endRef		The reference of the end polygon.
+	///  @param[in]		startPos	The start position. [(x, y, z)]
+	///  @param[in]		endPos		The end position. [(x, y, z)]
+	///  @param[in]		filter		The filter to apply to the search, must stay valid until the request is finished.
+	///  @param[in]		priority	Requests with higher priority are processed first, equal ones in request order.
+	/// @return The request reference, or #DT_PATHQ_INVALID if the queue is full.
 	dtPathQueueRef request(dtPolyRef startRef, dtPolyRef endRef,
 						   const float* startPos, const float* endPos, 
-						   const dtQueryFilter* filter);
+						   const dtQueryFilter* filter, const float priority = 0.0f);
 	
+	/// Gets the status of a request.
+	/// @return #DT_IN_PROGRESS until the request is finished, then the status of the search.
+	///			#DT_FAILURE if the request does not exist.
 	dtStatus getRequestStatus(dtPathQueueRef ref) const;
 	
+	/// Copies the path of a finished request and frees the request.
+	/// Unread results are freed a couple of updates after the request has finished.
 	dtStatus getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath);
 	
+	/// Gets the maximum number of requests in the queue at once.
+	inline int getMaxRequests() const { return m_maxQueue; }
+	
+	/// Gets the number of requests waiting in the queue or being searched.
+	int getPendingRequestCount() const;
+	
 	inline const dtNavMeshQuery* getNavQuery() const { return m_navquery; }
+	
+	int getMemUsed() const;
 
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
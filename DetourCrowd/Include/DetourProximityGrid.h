@@ -19,48 +19,141 @@
 #ifndef DETOURPROXIMITYGRID_H
 #define DETOURPROXIMITYGRID_H
 
+/// Provides custom handling of the items found by dtProximityGrid::queryItems.
+class dtProximityQuery
+{
+public:
+	virtual ~dtProximityQuery();
+
+	/// Called for each batch of items overlapping the query area in dtProximityGrid::queryItems.
+	/// This can be called multiple times for a single query.
+	virtual void process(const int* ids, const int count) = 0;
+};
+
+/// A uniform grid used to find items close to each other.
+///
+/// Each item is stored once, in the cell containing the center of its bounds,
+/// and queries are expanded by the largest item extent. The items are sorted
+/// into the cells with a counting sort, so rebuilding the grid is O(n).
+///
+/// Usage:
+///  -# #clear() the grid and #addItem() every item.
+///  -# #build() the grid.
+///  -# #queryItems() as many times as needed.
+///  -# Items which have moved can be updated with #moveItem() as long
+///     as they stay in the same cell. Otherwise, start over from the first step.
+///
+/// Item ids are non-negative and smaller than the item count the grid was initialized with.
 class dtProximityGrid
 {
 	float m_cellSize;
 	float m_invCellSize;
 	
-	struct Item
-	{
-		unsigned short id;
-		short x,y;
-		unsigned short next;
-	};
-	Item* m_pool;
-	int m_poolHead;
-	int m_poolSize;
-	
-	unsigned short* m_buckets;
+	int m_maxItems;
+	
+	// Items added since the last clear, in insertion order.
+	int m_itemCount;
+	int* m_addedIds;
+	float* m_addedBounds;
+	
+	// Items sorted by cell. [(minx, miny, maxx, maxy) * m_itemCount]
+	int* m_ids;
+	int* m_cells;
+	float* m_bounds;
+	
+	// Maps an item id to its sorted index, or -1 if the item is not in the grid.
+	int* m_slots;
+	
+	// Start of each bucket in the sorted items. [m_bucketsSize + 1]
+	int* m_buckets;
 	int m_bucketsSize;
 	
-	int m_bounds[4];
+	float m_maxExtent;
+	bool m_built;
+	
+	int m_cellBounds[4];
 	
 public:
 	dtProximityGrid();
 	~dtProximityGrid();
 	
-	bool init(const int poolSize, const float cellSize);
+	/// Initializes the grid.
+	///  @param[in]		maxItems	The maximum number of items in the grid. [Limit: > 0]
+	///  @param[in]		cellSize	The size of the grid cells. [Limit: > 0]
+	/// @return True if the grid was successfully initialized.
+	bool init(const int maxItems, const float cellSize);
 	
+	/// Removes all items from the grid.
 	void clear();
 	
-	void addItem(const unsigned short id,
+	/// Adds an item to the grid. The item is not visible to queries until the grid is built.
+	///  @param[in]		id		The id of the item. [Limits: 0 <= value < max items]
+	///  @param[in]		minx	The minimum x-bounds of the item.
+	///  @param[in]		miny	The minimum y-bounds of the item.
+	///  @param[in]		maxx	The maximum x-bounds of the item.
+	///  @param[in]		maxy	The maximum y-bounds of the item.
+	void addItem(const int id,
 				 const float minx, const float miny,
 				 const float maxx, const float maxy);
 	
+	/// Sorts the items added since the last clear into the grid cells.
+	void build();
+	
+	/// Updates the bounds of an item without rebuilding the grid.
+	///  @param[in]		id		The id of the item.
+	///  @param[in]		minx	The minimum x-bounds of the item.
+	///  @param[in]		miny	The minimum y-bounds of the item.
+	///  @param[in]		maxx	The maximum x-bounds of the item.
+	///  @param[in]		maxy	The maximum y-bounds of the item.
+	/// @return False if the item is not in the grid or its center moved to another cell,
+	/// in which case the grid needs to be cleared and the items added again.
+	bool moveItem(const int id,
+				  const float minx, const float miny,
+				  const float maxx, const float maxy);
+	
+	/// Finds the items whose bounds overlap the query area.
+	///  @param[in]		minx	The minimum x-bounds of the query area.
+	///  @param[in]		miny	The minimum y-bounds of the query area.
+	///  @param[in]		maxx	The maximum x-bounds of the query area.
+	///  @param[in]		maxy	The maximum y-bounds of the query area.
+	///  @param[out]	ids		The ids of the items found.
+	///  @param[in]		maxIds	The maximum number of ids to return.
+	/// @return The number of items found.
 	int queryItems(const float minx, const float miny,
 				   const float maxx, const float maxy,
-				   unsigned short* ids, const int maxIds) const;
+				   int* ids, const int maxIds) const;
+	
+	/// Finds all the items whose bounds overlap the query area and passes them
+	/// to the query object in batches.
+	///  @param[in]		minx	The minimum x-bounds of the query area.
+	///  @param[in]		miny	The minimum y-bounds of the query area.
+	///  @param[in]		maxx	The maximum x-bounds of the query area.
+	///  @param[in]		maxy	The maximum y-bounds of the query area.
+	///  @param[in]		query	The query object receiving the items.
+	void queryItems(const float minx, const float miny,
+					const float maxx, const float maxy,
+					dtProximityQuery* query) const;
 	
+	/// Returns the number of items whose center is in the specified cell.
 	int getItemCountAt(const int x, const int y) const;
 	
-	inline const int* getBounds() const { return m_bounds; }
+	/// The number of items in the grid.
+	inline int getItemCount() const { return m_built ? m_itemCount : 0; }
+	
+	/// The cell bounds of the items in the grid. [(minx, miny, maxx, maxy)]
+	inline const int* getBounds() const { return m_cellBounds; }
 	inline float getCellSize() const { return m_cellSize; }
+	
+	inline int getMemUsed() const
+	{
+		return sizeof(*this) +
+			(sizeof(int)*5 + sizeof(float)*8)*m_maxItems +
+			sizeof(int)*(m_bucketsSize+1);
+	}
 
 private:
+	void expandCellBounds(const int x, const int y);
+	
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtProximityGrid(const dtProximityGrid&);
 	dtProximityGrid& operator=(const dtProximityGrid&);
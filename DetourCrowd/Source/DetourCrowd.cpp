@@ -49,6 +49,13 @@ static const int MAX_ITERS_PER_UPDATE = 100;
 
 static const int MAX_PATHQUEUE_NODES = 4096;
 static const int MAX_COMMON_NODES = 512;
+static const int MAX_WALL_CACHE_POLYS = 1024;
+static const int MAX_WALL_CACHE_SEGS = 4096;
+
+// Priorities of the path corridor validity checks. (See: dtCrowdAgent::pathCheck)
+static const unsigned char PATH_CHECK_NONE = 0;
+static const unsigned char PATH_CHECK_PATH = 1;			// The path crosses a changed tile.
+static const unsigned char PATH_CHECK_POSITION = 2;		// The agent stands on a changed tile.
 
 inline float tween(const float t, const float t0, const float t1)
 {
@@ -184,37 +191,68 @@ static int addNeighbour(const int idx, const float dist,
 	return dtMin(nneis+1, maxNeis);
 }
 
-static int getNeighbours(const float* pos, const float height, const float range,
-						 const dtCrowdAgent* skip, dtCrowdNeighbour* result, const int maxResult,
-						 dtCrowdAgent** agents, const int /*nagents*/, dtProximityGrid* grid)
+/// Keeps the closest agents found by the proximity grid.
+class dtCrowdNeighbourQuery : public dtProximityQuery
 {
-	int n = 0;
+	const dtCrowdAgent* m_agents;
+	const dtCrowdAgent* m_skip;
+	const float* m_pos;
+	float m_height;
+	float m_range;
+	dtCrowdNeighbour* m_result;
+	int m_maxResult;
+	int m_count;
+	
+public:
+	dtCrowdNeighbourQuery(const dtCrowdAgent* agents, const float* pos, const float height, const float range,
+						  const dtCrowdAgent* skip, dtCrowdNeighbour* result, const int maxResult) :
+		m_agents(agents),
+		m_skip(skip),
+		m_pos(pos),
+		m_height(height),
+		m_range(range),
+		m_result(result),
+		m_maxResult(maxResult),
+		m_count(0)
+	{
+	}
 	
-	static const int MAX_NEIS = 32;
-	unsigned short ids[MAX_NEIS];
-	int nids = grid->queryItems(pos[0]-range, pos[2]-range,
-								pos[0]+range, pos[2]+range,
-								ids, MAX_NEIS);
+	virtual ~dtCrowdNeighbourQuery() { }
 	
-	for (int i = 0; i < nids; ++i)
+	virtual void process(const int* ids, const int count)
 	{
-		const dtCrowdAgent* ag = agents[ids[i]];
-		
-		if (ag == skip) continue;
-		
-		// Check for overlap.
-		float diff[3];
-		dtVsub(diff, pos, ag->npos);
-		if (dtMathFabsf(diff[1]) >= (height+ag->params.height)/2.0f)
-			continue;
-		diff[1] = 0;
-		const float distSqr = dtVlenSqr(diff);
-		if (distSqr > dtSqr(range))
-			continue;
-		
-		n = addNeighbour(ids[i], distSqr, result, n, maxResult);
+		for (int i = 0; i < count; ++i)
+		{
+			const dtCrowdAgent* ag = &m_agents[ids[i]];
+			
+			if (ag == m_skip) continue;
+			
+			// Check for overlap.
+			float diff[3];
+			dtVsub(diff, m_pos, ag->npos);
+			if (dtMathFabsf(diff[1]) >= (m_height+ag->params.height)/2.0f)
+				continue;
+			diff[1] = 0;
+			const float distSqr = dtVlenSqr(diff);
+			if (distSqr > dtSqr(m_range))
+				continue;
+			
+			m_count = addNeighbour(ids[i], distSqr, m_result, m_count, m_maxResult);
+		}
 	}
-	return n;
+	
+	int getCount() const { return m_count; }
+};
+
+static int getNeighbours(const float* pos, const float height, const float range,
+						 const dtCrowdAgent* skip, dtCrowdNeighbour* result, const int maxResult,
+						 const dtCrowdAgent* agents, const dtProximityGrid* grid)
+{
+	// All the agents overlapping the range are visited, only the closest are kept.
+	dtCrowdNeighbourQuery query(agents, pos, height, range, skip, result, maxResult);
+	grid->queryItems(pos[0]-range, pos[2]-range,
+					 pos[0]+range, pos[2]+range, &query);
+	return query.getCount();
 }
 
 static int addToOptQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int nagents, const int maxAgents)
@@ -253,15 +291,24 @@ static int addToOptQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int n
 	return dtMin(nagents+1, maxAgents);
 }
 
+// Agents which have waited longer are planned first, and near targets before far ones.
+// The distance is converted to the time the agent needs to walk it.
+static float getPathRequestPriority(const dtCrowdAgent* ag)
+{
+	const float dist = dtVdist2D(ag->corridor.getTarget(), ag->targetPos);
+	return ag->targetReplanTime - dist / dtMax(ag->params.maxSpeed, 0.01f);
+}
+
 static int addToPathQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int nagents, const int maxAgents)
 {
-	// Insert neighbour based on greatest time.
+	// Insert neighbour based on greatest priority.
+	const float priority = getPathRequestPriority(newag);
 	int slot = 0;
 	if (!nagents)
 	{
 		slot = nagents;
 	}
-	else if (newag->targetReplanTime <= agents[nagents-1]->targetReplanTime)
+	else if (priority <= getPathRequestPriority(agents[nagents-1]))
 	{
 		if (nagents >= maxAgents)
 			return nagents;
@@ -271,7 +318,7 @@ static int addToPathQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int
 	{
 		int i;
 		for (i = 0; i < nagents; ++i)
-			if (newag->targetReplanTime >= agents[i]->targetReplanTime)
+			if (priority >= getPathRequestPriority(agents[i]))
 				break;
 		
 		const int tgt = i+1;
@@ -333,14 +380,46 @@ dtCrowd::dtCrowd() :
 	m_agents(0),
 	m_activeAgents(0),
 	m_agentAnims(0),
+	m_agentPos(0),
+	m_agentDisp(0),
+	m_agentDvel(0),
+	m_agentNvel(0),
+	m_agentVel(0),
+	m_agentRadius(0),
+	m_pathRequestAgents(0),
+	m_optQueue(0),
+	m_tileChangeCount(0),
+	m_pathSweepCursor(0),
 	m_obstacleQuery(0),
 	m_grid(0),
 	m_pathResult(0),
 	m_maxPathResult(0),
 	m_maxAgentRadius(0),
 	m_velocitySampleCount(0),
-	m_navquery(0)
+	m_navquery(0),
+	m_taskRunner(0),
+	m_workerCount(1),
+	m_workerNavQueries(0),
+	m_workerObstacleQueries(0),
+	m_workerWallCaches(0),
+	m_workerSampleCounts(0),
+	m_updateCount(0)
 {
+	m_pathParams.maxQueuedRequests = 32;
+	m_pathParams.maxQueueIters = MAX_ITERS_PER_UPDATE;
+	m_pathParams.maxQuickSearches = 32;
+	m_pathParams.quickSearchIters = 20;
+	m_pathParams.userPathQueueUpdate = false;
+	
+	m_maintenanceParams.maxTopologyOptimizations = 1;
+	m_maintenanceParams.topologyOptimizationDelay = 0.5f;
+	m_maintenanceParams.maxPathChecks = 64;
+	m_maintenanceParams.pathSweepChecks = 4;
+	
+	m_lodUpdateInterval[DT_CROWDAGENT_LOD_FULL] = 1;
+	m_lodUpdateInterval[DT_CROWDAGENT_LOD_REDUCED] = 4;
+	m_lodUpdateInterval[DT_CROWDAGENT_LOD_CORRIDOR] = 8;
+	m_lodUpdateInterval[DT_CROWDAGENT_LOD_FROZEN] = 1;
 }
 
 dtCrowd::~dtCrowd()
@@ -350,6 +429,8 @@ dtCrowd::~dtCrowd()
 
 void dtCrowd::purge()
 {
+	purgeWorkers();
+	
 	for (int i = 0; i < m_maxAgents; ++i)
 		m_agents[i].~dtCrowdAgent();
 	dtFree(m_agents);
@@ -362,9 +443,28 @@ void dtCrowd::purge()
 	dtFree(m_agentAnims);
 	m_agentAnims = 0;
 	
+	dtFree(m_agentPos);
+	m_agentPos = 0;
+	dtFree(m_agentDisp);
+	m_agentDisp = 0;
+	dtFree(m_agentDvel);
+	m_agentDvel = 0;
+	dtFree(m_agentNvel);
+	m_agentNvel = 0;
+	dtFree(m_agentVel);
+	m_agentVel = 0;
+	dtFree(m_agentRadius);
+	m_agentRadius = 0;
+	
 	dtFree(m_pathResult);
 	m_pathResult = 0;
 	
+	dtFree(m_pathRequestAgents);
+	m_pathRequestAgents = 0;
+	
+	dtFree(m_optQueue);
+	m_optQueue = 0;
+	
 	dtFreeProximityGrid(m_grid);
 	m_grid = 0;
 
@@ -391,7 +491,7 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	m_grid = dtAllocProximityGrid();
 	if (!m_grid)
 		return false;
-	if (!m_grid->init(m_maxAgents*4, maxAgentRadius*3))
+	if (!m_grid->init(m_maxAgents, maxAgentRadius*3))
 		return false;
 	
 	m_obstacleQuery = dtAllocObstacleAvoidanceQuery();
@@ -401,21 +501,8 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 		return false;
 
 	// Init obstacle query params.
-	memset(m_obstacleQueryParams, 0, sizeof(m_obstacleQueryParams));
 	for (int i = 0; i < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS; ++i)
-	{
-		dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[i];
-		params->velBias = 0.4f;
-		params->weightDesVel = 2.0f;
-		params->weightCurVel = 0.75f;
-		params->weightSide = 0.75f;
-		params->weightToi = 2.5f;
-		params->horizTime = 2.5f;
-		params->gridSize = 33;
-		params->adaptiveDivs = 7;
-		params->adaptiveRings = 2;
-		params->adaptiveDepth = 5;
-	}
+		dtInitObstacleAvoidanceParams(&m_obstacleQueryParams[i]);
 	
 	// Allocate temp buffer for merging paths.
 	m_maxPathResult = 256;
@@ -423,7 +510,7 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	if (!m_pathResult)
 		return false;
 	
-	if (!m_pathq.init(m_maxPathResult, MAX_PATHQUEUE_NODES, nav))
+	if (!initPathQueue(nav, &m_pathParams))
 		return false;
 	
 	m_agents = (dtCrowdAgent*)dtAlloc(sizeof(dtCrowdAgent)*m_maxAgents, DT_ALLOC_PERM);
@@ -438,10 +525,44 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	if (!m_agentAnims)
 		return false;
 	
+	m_optQueue = (dtCrowdAgent**)dtAlloc(sizeof(dtCrowdAgent*)*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_optQueue)
+		return false;
+	
+	m_agentPos = (float*)dtAlloc(sizeof(float)*3*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_agentPos)
+		return false;
+	memset(m_agentPos, 0, sizeof(float)*3*m_maxAgents);
+	m_agentDisp = (float*)dtAlloc(sizeof(float)*3*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_agentDisp)
+		return false;
+	memset(m_agentDisp, 0, sizeof(float)*3*m_maxAgents);
+	m_agentDvel = (float*)dtAlloc(sizeof(float)*3*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_agentDvel)
+		return false;
+	memset(m_agentDvel, 0, sizeof(float)*3*m_maxAgents);
+	m_agentNvel = (float*)dtAlloc(sizeof(float)*3*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_agentNvel)
+		return false;
+	memset(m_agentNvel, 0, sizeof(float)*3*m_maxAgents);
+	m_agentVel = (float*)dtAlloc(sizeof(float)*3*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_agentVel)
+		return false;
+	memset(m_agentVel, 0, sizeof(float)*3*m_maxAgents);
+	m_agentRadius = (float*)dtAlloc(sizeof(float)*m_maxAgents, DT_ALLOC_PERM);
+	if (!m_agentRadius)
+		return false;
+	memset(m_agentRadius, 0, sizeof(float)*m_maxAgents);
+	
 	for (int i = 0; i < m_maxAgents; ++i)
 	{
 		new(&m_agents[i]) dtCrowdAgent();
 		m_agents[i].active = false;
+		m_agents[i].npos = &m_agentPos[i*3];
+		m_agents[i].disp = &m_agentDisp[i*3];
+		m_agents[i].dvel = &m_agentDvel[i*3];
+		m_agents[i].nvel = &m_agentNvel[i*3];
+		m_agents[i].vel = &m_agentVel[i*3];
 		if (!m_agents[i].corridor.init(m_maxPathResult))
 			return false;
 	}
@@ -458,9 +579,156 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	if (dtStatusFailed(m_navquery->init(nav, MAX_COMMON_NODES)))
 		return false;
 	
+	// The agents are added after this, their paths do not cross the tiles changed so far.
+	m_tileChangeCount = nav->getTileChangeCount();
+	m_pathSweepCursor = 0;
+	
+	if (!initWorkers(m_workerCount))
+		return false;
+	
+	return true;
+}
+
+void dtCrowd::purgeWorkers()
+{
+	// The first worker uses the query objects of the crowd.
+	for (int i = 1; i < m_workerCount; ++i)
+	{
+		if (m_workerNavQueries)
+			dtFreeNavMeshQuery(m_workerNavQueries[i]);
+		if (m_workerObstacleQueries)
+			dtFreeObstacleAvoidanceQuery(m_workerObstacleQueries[i]);
+	}
+	dtFree(m_workerNavQueries);
+	m_workerNavQueries = 0;
+	dtFree(m_workerObstacleQueries);
+	m_workerObstacleQueries = 0;
+	if (m_workerWallCaches)
+	{
+		for (int i = 0; i < m_workerCount; ++i)
+			dtFreeWallSegmentCache(m_workerWallCaches[i]);
+	}
+	dtFree(m_workerWallCaches);
+	m_workerWallCaches = 0;
+	dtFree(m_workerSampleCounts);
+	m_workerSampleCounts = 0;
+}
+
+bool dtCrowd::initWorkers(const int workerCount)
+{
+	purgeWorkers();
+	m_workerCount = workerCount;
+	
+	m_workerNavQueries = (dtNavMeshQuery**)dtAlloc(sizeof(dtNavMeshQuery*)*m_workerCount, DT_ALLOC_PERM);
+	if (!m_workerNavQueries)
+		return false;
+	memset(m_workerNavQueries, 0, sizeof(dtNavMeshQuery*)*m_workerCount);
+	m_workerObstacleQueries = (dtObstacleAvoidanceQuery**)dtAlloc(sizeof(dtObstacleAvoidanceQuery*)*m_workerCount, DT_ALLOC_PERM);
+	if (!m_workerObstacleQueries)
+		return false;
+	memset(m_workerObstacleQueries, 0, sizeof(dtObstacleAvoidanceQuery*)*m_workerCount);
+	m_workerWallCaches = (dtWallSegmentCache**)dtAlloc(sizeof(dtWallSegmentCache*)*m_workerCount, DT_ALLOC_PERM);
+	if (!m_workerWallCaches)
+		return false;
+	memset(m_workerWallCaches, 0, sizeof(dtWallSegmentCache*)*m_workerCount);
+	m_workerSampleCounts = (int*)dtAlloc(sizeof(int)*m_workerCount, DT_ALLOC_PERM);
+	if (!m_workerSampleCounts)
+		return false;
+	
+	m_workerNavQueries[0] = m_navquery;
+	m_workerObstacleQueries[0] = m_obstacleQuery;
+	for (int i = 1; i < m_workerCount; ++i)
+	{
+		m_workerNavQueries[i] = dtAllocNavMeshQuery();
+		if (!m_workerNavQueries[i])
+			return false;
+		if (dtStatusFailed(m_workerNavQueries[i]->init(m_navquery->getAttachedNavMesh(), MAX_COMMON_NODES)))
+			return false;
+		m_workerObstacleQueries[i] = dtAllocObstacleAvoidanceQuery();
+		if (!m_workerObstacleQueries[i])
+			return false;
+		if (!m_workerObstacleQueries[i]->init(6, 8))
+			return false;
+	}
+	for (int i = 0; i < m_workerCount; ++i)
+	{
+		m_workerWallCaches[i] = dtAllocWallSegmentCache();
+		if (!m_workerWallCaches[i])
+			return false;
+		if (!m_workerWallCaches[i]->init(MAX_WALL_CACHE_POLYS, MAX_WALL_CACHE_SEGS))
+			return false;
+	}
+	
+	return true;
+}
+
+/// @par
+///
+/// The agents are split into contiguous ranges, one per worker, and each phase
+/// of #update only writes the state of the agents in the worker's range.
+/// The result of the update does not depend on the number of workers.
+///
+/// The path queue (unless dtCrowdPathParams::userPathQueueUpdate is set), the topology optimization and the off-mesh connection
+/// handling are still processed on the calling thread.
+///
+/// Can be called before or after #init.
+bool dtCrowd::setTaskRunner(dtCrowdTaskRunner* runner, const int workerCount)
+{
+	const int count = runner ? workerCount : 1;
+	if (count < 1)
+		return false;
+	m_taskRunner = runner;
+	if (!m_navquery)
+	{
+		m_workerCount = count;
+		return true;
+	}
+	return initWorkers(count);
+}
+
+bool dtCrowd::initPathQueue(const dtNavMesh* nav, const dtCrowdPathParams* params)
+{
+	dtFree(m_pathRequestAgents);
+	m_pathRequestAgents = (dtCrowdAgent**)dtAlloc(sizeof(dtCrowdAgent*)*params->maxQueuedRequests, DT_ALLOC_PERM);
+	if (!m_pathRequestAgents)
+		return false;
+	return m_pathq.init(m_maxPathResult, MAX_PATHQUEUE_NODES, nav, params->maxQueuedRequests);
+}
+
+/// @par
+///
+/// Can be called before or after #init.
+bool dtCrowd::setPathParams(const dtCrowdPathParams* params)
+{
+	if (params->maxQueuedRequests < 1 || params->maxQueueIters < 1 ||
+		params->maxQuickSearches < 1 || params->quickSearchIters < 0)
+		return false;
+	
+	const bool resize = params->maxQueuedRequests != m_pathParams.maxQueuedRequests;
+	memcpy(&m_pathParams, params, sizeof(dtCrowdPathParams));
+	if (resize && m_navquery)
+		return initPathQueue(m_navquery->getAttachedNavMesh(), &m_pathParams);
+	return true;
+}
+
+/// @par
+///
+/// Can be called before or after #init.
+bool dtCrowd::setMaintenanceParams(const dtCrowdMaintenanceParams* params)
+{
+	if (params->maxTopologyOptimizations < 0 || params->topologyOptimizationDelay < 0.0f ||
+		params->maxPathChecks < 1 || params->pathSweepChecks < 0)
+		return false;
+	
+	memcpy(&m_maintenanceParams, params, sizeof(dtCrowdMaintenanceParams));
 	return true;
 }
 
+void dtCrowd::updatePathQueue()
+{
+	m_pathq.update(m_pathParams.maxQueueIters);
+}
+
 void dtCrowd::setObstacleAvoidanceParams(const int idx, const dtObstacleAvoidanceParams* params)
 {
 	if (idx >= 0 && idx < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS)
@@ -479,6 +747,61 @@ int dtCrowd::getAgentCount() const
 	return m_maxAgents;
 }
 
+/// @par
+///
+/// The memory used by the crowd is allocated in #init, so the values only change
+/// when the crowd is initialized again.
+void dtCrowd::getMemoryUsage(dtCrowdMemoryUsage* usage) const
+{
+	memset(usage, 0, sizeof(dtCrowdMemoryUsage));
+	if (m_agents)
+	{
+		usage->agents = (sizeof(dtCrowdAgent) + sizeof(dtCrowdAgent*)*2 + sizeof(float)*(3*5+1))*m_maxAgents;
+		for (int i = 0; i < m_maxAgents; ++i)
+			usage->agents += sizeof(dtPolyRef)*m_agents[i].corridor.getMaxPath();
+	}
+	if (m_agentAnims)
+		usage->animations = sizeof(dtCrowdAgentAnimation)*m_maxAgents;
+	// The path queue is stored in the crowd object, count it only once.
+	usage->pathQueue = m_pathq.getMemUsed() - sizeof(dtPathQueue);
+	if (m_pathRequestAgents)
+		usage->pathQueue += sizeof(dtCrowdAgent*)*m_pathParams.maxQueuedRequests;
+	if (m_grid)
+		usage->proximityGrid = m_grid->getMemUsed();
+	if (m_obstacleQuery)
+		usage->obstacleAvoidance = m_obstacleQuery->getMemUsed();
+	if (m_navquery)
+	{
+		dtNavMeshQueryMemoryUsage queryUsage;
+		m_navquery->getMemoryUsage(&queryUsage);
+		usage->navQuery = queryUsage.total;
+	}
+	size_t workers = 0;
+	if (m_workerNavQueries)
+	{
+		workers += (sizeof(dtNavMeshQuery*) + sizeof(dtObstacleAvoidanceQuery*) + sizeof(dtWallSegmentCache*) + sizeof(int))*m_workerCount;
+		for (int i = 0; i < m_workerCount; ++i)
+		{
+			if (m_workerWallCaches[i])
+				usage->wallSegments += m_workerWallCaches[i]->getMemUsed();
+		}
+		for (int i = 1; i < m_workerCount; ++i)
+		{
+			if (m_workerNavQueries[i])
+			{
+				dtNavMeshQueryMemoryUsage queryUsage;
+				m_workerNavQueries[i]->getMemoryUsage(&queryUsage);
+				usage->navQuery += queryUsage.total;
+			}
+			if (m_workerObstacleQueries[i])
+				usage->obstacleAvoidance += m_workerObstacleQueries[i]->getMemUsed();
+		}
+	}
+	usage->total = sizeof(*this) + sizeof(dtPolyRef)*m_maxPathResult + workers +
+		usage->agents + usage->animations + usage->pathQueue +
+		usage->proximityGrid + usage->obstacleAvoidance + usage->wallSegments + usage->navQuery;
+}
+
 /// @par
 /// 
 /// Agents in the pool may not be in use.  Check #dtCrowdAgent.active before using the returned object.
@@ -503,6 +826,7 @@ void dtCrowd::updateAgentParameters(const int idx, const dtCrowdAgentParams* par
 	if (idx < 0 || idx >= m_maxAgents)
 		return;
 	memcpy(&m_agents[idx].params, params, sizeof(dtCrowdAgentParams));
+	m_agentRadius[idx] = params->radius;
 }
 
 /// @par
@@ -543,8 +867,11 @@ int dtCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
 	ag->partial = false;
 
 	ag->topologyOptTime = 0;
+	ag->pathCheck = 0;
 	ag->targetReplanTime = 0;
+	ag->targetField = 0;
 	ag->nneis = 0;
+	ag->lod = DT_CROWDAGENT_LOD_FULL;
 	
 	dtVset(ag->dvel, 0,0,0);
 	dtVset(ag->nvel, 0,0,0);
@@ -565,6 +892,42 @@ int dtCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
 	return idx;
 }
 
+/// @par
+///
+/// The agents are added at #DT_CROWDAGENT_LOD_FULL. Lowering the level of detail of the agents
+/// which are far from the viewer allows large crowds to be updated at a fraction of the cost.
+bool dtCrowd::setAgentLOD(const int idx, const int lod)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+	if (lod < 0 || lod >= DT_CROWDAGENT_MAX_LODS)
+		return false;
+	m_agents[idx].lod = (unsigned char)lod;
+	return true;
+}
+
+/// @par
+///
+/// The reduced rate parts of the update are spread over the updates by the agent index,
+/// so that only about one in @p interval of the agents at the level of detail run them at each update.
+/// The default intervals are 4 for #DT_CROWDAGENT_LOD_REDUCED and 8 for #DT_CROWDAGENT_LOD_CORRIDOR.
+bool dtCrowd::setLODUpdateInterval(const int lod, const int interval)
+{
+	if (lod != DT_CROWDAGENT_LOD_REDUCED && lod != DT_CROWDAGENT_LOD_CORRIDOR)
+		return false;
+	if (interval < 1)
+		return false;
+	m_lodUpdateInterval[lod] = interval;
+	return true;
+}
+
+int dtCrowd::getLODUpdateInterval(const int lod) const
+{
+	if (lod < 0 || lod >= DT_CROWDAGENT_MAX_LODS)
+		return 0;
+	return m_lodUpdateInterval[lod];
+}
+
 /// @par
 ///
 /// The agent is deactivated and will no longer be processed.  Its #dtCrowdAgent object
@@ -618,6 +981,7 @@ bool dtCrowd::requestMoveTarget(const int idx, dtPolyRef ref, const float* pos)
 	dtVcopy(ag->targetPos, pos);
 	ag->targetPathqRef = DT_PATHQ_INVALID;
 	ag->targetReplan = false;
+	ag->targetField = 0;
 	if (ag->targetRef)
 		ag->targetState = DT_CROWDAGENT_TARGET_REQUESTING;
 	else
@@ -626,6 +990,34 @@ bool dtCrowd::requestMoveTarget(const int idx, dtPolyRef ref, const float* pos)
 	return true;
 }
 
+/// @par
+///
+/// Many agents can share the same flow field, this avoids a path search per agent
+/// when they all move to the same goal. Agents whose polygon is not in the flow field
+/// fall back to a regular path search.
+///
+/// The request will be processed during the next #update().
+bool dtCrowd::requestMoveFlowField(const int idx, const dtFlowField* field)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+	if (!field || !field->isReady())
+		return false;
+	
+	dtCrowdAgent* ag = &m_agents[idx];
+	
+	// Initialize request.
+	ag->targetRef = field->getGoalRef();
+	dtVcopy(ag->targetPos, field->getGoalPos());
+	ag->targetPathqRef = DT_PATHQ_INVALID;
+	ag->targetReplan = false;
+	ag->targetField = field;
+	ag->targetFieldVersion = field->getVersion();
+	ag->targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+	
+	return true;
+}
+
 bool dtCrowd::requestMoveVelocity(const int idx, const float* vel)
 {
 	if (idx < 0 || idx >= m_maxAgents)
@@ -638,6 +1030,7 @@ bool dtCrowd::requestMoveVelocity(const int idx, const float* vel)
 	dtVcopy(ag->targetPos, vel);
 	ag->targetPathqRef = DT_PATHQ_INVALID;
 	ag->targetReplan = false;
+	ag->targetField = 0;
 	ag->targetState = DT_CROWDAGENT_TARGET_VELOCITY;
 	
 	return true;
@@ -656,6 +1049,7 @@ bool dtCrowd::resetMoveTarget(const int idx)
 	dtVset(ag->dvel, 0,0,0);
 	ag->targetPathqRef = DT_PATHQ_INVALID;
 	ag->targetReplan = false;
+	ag->targetField = 0;
 	ag->targetState = DT_CROWDAGENT_TARGET_NONE;
 	
 	return true;
@@ -676,9 +1070,9 @@ int dtCrowd::getActiveAgents(dtCrowdAgent** agents, const int maxAgents)
 
 void dtCrowd::updateMoveRequest(const float /*dt*/)
 {
-	const int PATH_MAX_AGENTS = 8;
-	dtCrowdAgent* queue[PATH_MAX_AGENTS];
+	dtCrowdAgent** queue = m_pathRequestAgents;
 	int nqueue = 0;
+	int nquick = 0;
 	
 	// Fire off new requests.
 	for (int i = 0; i < m_maxAgents; ++i)
@@ -691,8 +1085,33 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
 			continue;
 
-		if (ag->targetState == DT_CROWDAGENT_TARGET_REQUESTING)
+		if (ag->targetState == DT_CROWDAGENT_TARGET_REQUESTING && ag->targetField)
+		{
+			// Take the path from the flow field, agents outside of it search for their path.
+			dtPolyRef* res = m_pathResult;
+			const int nres = ag->targetField->getPath(ag->corridor.getFirstPoly(), res, m_maxPathResult);
+			float reqPos[3];
+			dtVcopy(reqPos, ag->targetPos);
+			if (nres > 0 && res[nres-1] != ag->targetRef)
+			{
+				// Partial path, constrain target position inside the last polygon.
+				m_navquery->closestPointOnPoly(res[nres-1], ag->targetPos, reqPos, 0);
+			}
+			if (nres > 0)
+			{
+				ag->corridor.setCorridor(reqPos, res, nres);
+				ag->boundary.reset();
+				ag->partial = false;
+				ag->targetState = DT_CROWDAGENT_TARGET_VALID;
+				ag->targetReplanTime = 0.0;
+				continue;
+			}
+		}
+
+		if (ag->targetState == DT_CROWDAGENT_TARGET_REQUESTING && nquick < m_pathParams.maxQuickSearches)
 		{
+			nquick++;
+			
 			const dtPolyRef* path = ag->corridor.getPath();
 			const int npath = ag->corridor.getPathCount();
 			dtAssert(npath);
@@ -703,9 +1122,8 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 			int reqPathCount = 0;
 
 			// Quick search towards the goal.
-			static const int MAX_ITER = 20;
 			m_navquery->initSlicedFindPath(path[0], ag->targetRef, ag->npos, ag->targetPos, &m_filters[ag->params.queryFilterType]);
-			m_navquery->updateSlicedFindPath(MAX_ITER, 0);
+			m_navquery->updateSlicedFindPath(m_pathParams.quickSearchIters, 0);
 			dtStatus status = 0;
 			if (ag->targetReplan) // && npath > 10)
 			{
@@ -764,7 +1182,7 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 		
 		if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE)
 		{
-			nqueue = addToPathQueue(ag, queue, nqueue, PATH_MAX_AGENTS);
+			nqueue = addToPathQueue(ag, queue, nqueue, m_pathParams.maxQueuedRequests);
 		}
 	}
 
@@ -772,14 +1190,17 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 	{
 		dtCrowdAgent* ag = queue[i];
 		ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), ag->targetRef,
-											 ag->corridor.getTarget(), ag->targetPos, &m_filters[ag->params.queryFilterType]);
-		if (ag->targetPathqRef != DT_PATHQ_INVALID)
-			ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
+											 ag->corridor.getTarget(), ag->targetPos, &m_filters[ag->params.queryFilterType],
+											 getPathRequestPriority(ag));
+		if (ag->targetPathqRef == DT_PATHQ_INVALID)
+			break;
+		ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
 	}
 
 	
 	// Update requests.
-	m_pathq.update(MAX_ITERS_PER_UPDATE);
+	if (!m_pathParams.userPathQueueUpdate)
+		m_pathq.update(m_pathParams.maxQueueIters);
 
 	dtStatus status;
 
@@ -889,6 +1310,8 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 					// Force to update boundary.
 					ag->boundary.reset();
 					ag->targetState = DT_CROWDAGENT_TARGET_VALID;
+					// The path was searched over several updates, the tiles may have changed meanwhile.
+					ag->pathCheck = dtMax(ag->pathCheck, PATH_CHECK_PATH);
 				}
 				else
 				{
@@ -904,14 +1327,41 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 }
 
 
+void dtCrowd::updateGrid(dtCrowdAgent** agents, const int nagents)
+{
+	// The agents are stored in the grid by their index in the agent pool. When the same agents
+	// are in the grid and none of them has moved to another cell, only their bounds are updated.
+	bool rebuild = m_grid->getItemCount() != nagents;
+	for (int i = 0; i < nagents && !rebuild; ++i)
+	{
+		const dtCrowdAgent* ag = agents[i];
+		const float* p = ag->npos;
+		const float r = ag->params.radius;
+		if (!m_grid->moveItem(getAgentIndex(ag), p[0]-r, p[2]-r, p[0]+r, p[2]+r))
+			rebuild = true;
+	}
+	if (!rebuild)
+		return;
+	
+	m_grid->clear();
+	for (int i = 0; i < nagents; ++i)
+	{
+		const dtCrowdAgent* ag = agents[i];
+		const float* p = ag->npos;
+		const float r = ag->params.radius;
+		m_grid->addItem(getAgentIndex(ag), p[0]-r, p[2]-r, p[0]+r, p[2]+r);
+	}
+	m_grid->build();
+}
+
 void dtCrowd::updateTopologyOptimization(dtCrowdAgent** agents, const int nagents, const float dt)
 {
-	if (!nagents)
+	const int maxOpt = dtMin(m_maintenanceParams.maxTopologyOptimizations, m_maxAgents);
+	if (!nagents || !maxOpt)
 		return;
 	
-	const float OPT_TIME_THR = 0.5f; // seconds
-	const int OPT_MAX_AGENTS = 1;
-	dtCrowdAgent* queue[OPT_MAX_AGENTS];
+	const float OPT_TIME_THR = m_maintenanceParams.topologyOptimizationDelay;
+	dtCrowdAgent** queue = m_optQueue;
 	int nqueue = 0;
 	
 	for (int i = 0; i < nagents; ++i)
@@ -923,9 +1373,12 @@ void dtCrowd::updateTopologyOptimization(dtCrowdAgent** agents, const int nagent
 			continue;
 		if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_TOPO) == 0)
 			continue;
-		ag->topologyOptTime += dt;
+		if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
+			continue;
+		// Agents at a lower level of detail wait longer between optimizations.
+		ag->topologyOptTime += dt / (float)m_lodUpdateInterval[ag->lod];
 		if (ag->topologyOptTime >= OPT_TIME_THR)
-			nqueue = addToOptQueue(ag, queue, nqueue, OPT_MAX_AGENTS);
+			nqueue = addToOptQueue(ag, queue, nqueue, maxOpt);
 	}
 
 	for (int i = 0; i < nqueue; ++i)
@@ -937,92 +1390,214 @@ void dtCrowd::updateTopologyOptimization(dtCrowdAgent** agents, const int nagent
 
 }
 
-void dtCrowd::checkPathValidity(dtCrowdAgent** agents, const int nagents, const float dt)
+static bool containsTile(const int* tiles, const int ntiles, const int tile)
 {
-	static const int CHECK_LOOKAHEAD = 10;
-	static const float TARGET_REPLAN_DELAY = 1.0; // seconds
+	int lo = 0, hi = ntiles-1;
+	while (lo <= hi)
+	{
+		const int mid = (lo+hi)/2;
+		if (tiles[mid] < tile)
+			lo = mid+1;
+		else if (tiles[mid] > tile)
+			hi = mid-1;
+		else
+			return true;
+	}
+	return false;
+}
+
+void dtCrowd::updateTileChanges(dtCrowdAgent** agents, const int nagents)
+{
+	const dtNavMesh* nav = m_navquery->getAttachedNavMesh();
+	const unsigned int changeCount = nav->getTileChangeCount();
+	if (changeCount == m_tileChangeCount)
+		return;
+	
+	// The changed tiles are returned sorted by index, without duplicates.
+	int tiles[DT_MAX_TILE_CHANGES];
+	const int ntiles = nav->getChangedTiles(m_tileChangeCount, tiles, DT_MAX_TILE_CHANGES);
+	m_tileChangeCount = changeCount;
+	
+	// Drop the wall segments of the changed tiles.
+	for (int i = 0; i < m_workerCount; ++i)
+	{
+		if (ntiles < 0)
+			m_workerWallCaches[i]->clear();
+		else
+			m_workerWallCaches[i]->invalidateTiles(tiles, ntiles);
+	}
 	
 	for (int i = 0; i < nagents; ++i)
 	{
 		dtCrowdAgent* ag = agents[i];
 		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+		// Too many changes to tell which tiles changed, check all the agents.
+		if (ntiles < 0)
+		{
+			ag->pathCheck = PATH_CHECK_POSITION;
+			ag->boundary.reset();
 			continue;
-			
-		ag->targetReplanTime += dt;
-
-		bool replan = false;
-
-		// First check that the current location is valid.
-		const int idx = getAgentIndex(ag);
-		float agentPos[3];
-		dtPolyRef agentRef = ag->corridor.getFirstPoly();
-		dtVcopy(agentPos, ag->npos);
-		if (!m_navquery->isValidPolyRef(agentRef, &m_filters[ag->params.queryFilterType]))
+		}
+		
+		const dtPolyRef* path = ag->corridor.getPath();
+		const int npath = ag->corridor.getPathCount();
+		for (int j = 0; j < npath+1; ++j)
 		{
-			// Current location is not valid, try to reposition.
-			// TODO: this can snap agents, how to handle that?
-			float nearest[3];
-			dtVcopy(nearest, agentPos);
-			agentRef = 0;
-			m_navquery->findNearestPoly(ag->npos, m_agentPlacementHalfExtents, &m_filters[ag->params.queryFilterType], &agentRef, nearest);
-			dtVcopy(agentPos, nearest);
-
-			if (!agentRef)
+			// The target is checked along with the path.
+			const dtPolyRef ref = j < npath ? path[j] : ag->targetRef;
+			if (!ref || !containsTile(tiles, ntiles, (int)nav->decodePolyIdTile(ref)))
+				continue;
+			if (j == 0)
 			{
-				// Could not find location in navmesh, set state to invalid.
-				ag->corridor.reset(0, agentPos);
-				ag->partial = false;
+				// The walls around the agent may have changed too.
+				ag->pathCheck = PATH_CHECK_POSITION;
 				ag->boundary.reset();
-				ag->state = DT_CROWDAGENT_STATE_INVALID;
-				continue;
+				break;
 			}
-
-			// Make sure the first polygon is valid, but leave other valid
-			// polygons in the path so that replanner can adjust the path better.
-			ag->corridor.fixPathStart(agentRef, agentPos);
-//			ag->corridor.trimInvalidPath(agentRef, agentPos, m_navquery, &m_filter);
-			ag->boundary.reset();
-			dtVcopy(ag->npos, agentPos);
-
-			replan = true;
+			ag->pathCheck = dtMax(ag->pathCheck, PATH_CHECK_PATH);
+			break;
 		}
+	}
+}
 
-		// If the agent does not have move target or is controlled by velocity, no need to recover the target nor replan.
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-			continue;
+// Makes sure that the agent stands on a valid polygon and that its path corridor and target are
+// still valid. Returns true if the path to the target must be planned again.
+bool dtCrowd::validateAgentPath(dtCrowdAgent* ag)
+{
+	bool replan = false;
 
-		// Try to recover move request position.
-		if (ag->targetState != DT_CROWDAGENT_TARGET_NONE && ag->targetState != DT_CROWDAGENT_TARGET_FAILED)
+	// First check that the current location is valid.
+	float agentPos[3];
+	dtPolyRef agentRef = ag->corridor.getFirstPoly();
+	dtVcopy(agentPos, ag->npos);
+	if (!m_navquery->isValidPolyRef(agentRef, &m_filters[ag->params.queryFilterType]))
+	{
+		// Current location is not valid, try to reposition.
+		// TODO: this can snap agents, how to handle that?
+		float nearest[3];
+		dtVcopy(nearest, agentPos);
+		agentRef = 0;
+		m_navquery->findNearestPoly(ag->npos, m_agentPlacementHalfExtents, &m_filters[ag->params.queryFilterType], &agentRef, nearest);
+		dtVcopy(agentPos, nearest);
+
+		if (!agentRef)
 		{
-			if (!m_navquery->isValidPolyRef(ag->targetRef, &m_filters[ag->params.queryFilterType]))
-			{
-				// Current target is not valid, try to reposition.
-				float nearest[3];
-				dtVcopy(nearest, ag->targetPos);
-				ag->targetRef = 0;
-				m_navquery->findNearestPoly(ag->targetPos, m_agentPlacementHalfExtents, &m_filters[ag->params.queryFilterType], &ag->targetRef, nearest);
-				dtVcopy(ag->targetPos, nearest);
-				replan = true;
-			}
-			if (!ag->targetRef)
-			{
-				// Failed to reposition target, fail moverequest.
-				ag->corridor.reset(agentRef, agentPos);
-				ag->partial = false;
-				ag->targetState = DT_CROWDAGENT_TARGET_NONE;
-			}
+			// Could not find location in navmesh, set state to invalid.
+			ag->corridor.reset(0, agentPos);
+			ag->partial = false;
+			ag->boundary.reset();
+			ag->state = DT_CROWDAGENT_STATE_INVALID;
+			return false;
 		}
 
-		// If nearby corridor is not valid, replan.
-		if (!ag->corridor.isValid(CHECK_LOOKAHEAD, m_navquery, &m_filters[ag->params.queryFilterType]))
+		// Make sure the first polygon is valid, but leave other valid
+		// polygons in the path so that replanner can adjust the path better.
+		ag->corridor.fixPathStart(agentRef, agentPos);
+//		ag->corridor.trimInvalidPath(agentRef, agentPos, m_navquery, &m_filter);
+		ag->boundary.reset();
+		dtVcopy(ag->npos, agentPos);
+
+		replan = true;
+	}
+
+	// If the agent does not have move target or is controlled by velocity, no need to recover the target nor replan.
+	if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+		return false;
+
+	// Try to recover move request position.
+	if (ag->targetState != DT_CROWDAGENT_TARGET_FAILED)
+	{
+		if (!m_navquery->isValidPolyRef(ag->targetRef, &m_filters[ag->params.queryFilterType]))
 		{
-			// Fix current path.
-//			ag->corridor.trimInvalidPath(agentRef, agentPos, m_navquery, &m_filter);
-//			ag->boundary.reset();
+			// Current target is not valid, try to reposition.
+			float nearest[3];
+			dtVcopy(nearest, ag->targetPos);
+			ag->targetRef = 0;
+			m_navquery->findNearestPoly(ag->targetPos, m_agentPlacementHalfExtents, &m_filters[ag->params.queryFilterType], &ag->targetRef, nearest);
+			dtVcopy(ag->targetPos, nearest);
 			replan = true;
 		}
+		if (!ag->targetRef)
+		{
+			// Failed to reposition target, fail moverequest.
+			ag->corridor.reset(agentRef, agentPos);
+			ag->partial = false;
+			ag->targetState = DT_CROWDAGENT_TARGET_NONE;
+			return false;
+		}
+	}
+
+	// If the corridor is not valid, replan. The whole corridor is checked,
+	// the agent is not checked again until the tiles along it change.
+	if (!ag->corridor.isValid(ag->corridor.getPathCount(), m_navquery, &m_filters[ag->params.queryFilterType]))
+	{
+		// Fix current path.
+//		ag->corridor.trimInvalidPath(agentRef, agentPos, m_navquery, &m_filter);
+//		ag->boundary.reset();
+		replan = true;
+	}
+	
+	return replan;
+}
+
+void dtCrowd::checkPathValidity(dtCrowdAgent** agents, const int nagents, const float dt)
+{
+	static const int CHECK_LOOKAHEAD = 10;
+	static const float TARGET_REPLAN_DELAY = 1.0; // seconds
+	
+	// Validate the agents affected by tile changes, the agents standing on a changed tile first.
+	// The others keep their request until the next update.
+	int nchecks = 0;
+	for (int level = PATH_CHECK_POSITION; level > PATH_CHECK_NONE && nchecks < m_maintenanceParams.maxPathChecks; --level)
+	{
+		for (int i = 0; i < nagents && nchecks < m_maintenanceParams.maxPathChecks; ++i)
+		{
+			dtCrowdAgent* ag = agents[i];
+			if (ag->pathCheck != level || ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			ag->pathCheck = PATH_CHECK_NONE;
+			nchecks++;
+			if (validateAgentPath(ag))
+				requestMoveTargetReplan(getAgentIndex(ag), ag->targetRef, ag->targetPos);
+		}
+	}
+	
+	// Validate a few more agents in turn to notice the changes which are not recorded as tile changes.
+	const int nsweep = dtMin(m_maintenanceParams.pathSweepChecks, nagents);
+	for (int i = 0; i < nsweep; ++i)
+	{
+		m_pathSweepCursor = (m_pathSweepCursor + 1) % nagents;
+		dtCrowdAgent* ag = agents[m_pathSweepCursor];
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			continue;
+		if (validateAgentPath(ag))
+			requestMoveTargetReplan(getAgentIndex(ag), ag->targetRef, ag->targetPos);
+	}
+	
+	for (int i = 0; i < nagents; ++i)
+	{
+		dtCrowdAgent* ag = agents[i];
 		
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			continue;
+			
+		ag->targetReplanTime += dt;
+
+		// If the agent does not have move target or is controlled by velocity, no need to replan.
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			continue;
+
+		bool replan = false;
+
+		// Follow the goal of the flow field when a new table has been finished.
+		if (ag->targetField && ag->targetFieldVersion != ag->targetField->getVersion())
+		{
+			ag->targetRef = ag->targetField->getGoalRef();
+			dtVcopy(ag->targetPos, ag->targetField->getGoalPos());
+			ag->targetFieldVersion = ag->targetField->getVersion();
+			replan = true;
+		}
+
 		// If the end of the path is near and it is not the requested location, replan.
 		if (ag->targetState == DT_CROWDAGENT_TARGET_VALID)
 		{
@@ -1034,298 +1609,343 @@ void dtCrowd::checkPathValidity(dtCrowdAgent** agents, const int nagents, const
 
 		// Try to replan path to goal.
 		if (replan)
-		{
-			if (ag->targetState != DT_CROWDAGENT_TARGET_NONE)
-			{
-				requestMoveTargetReplan(idx, ag->targetRef, ag->targetPos);
-			}
-		}
+			requestMoveTargetReplan(getAgentIndex(ag), ag->targetRef, ag->targetPos);
 	}
 }
 	
-void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
+dtCrowdTask::~dtCrowdTask()
 {
-	m_velocitySampleCount = 0;
-	
-	const int debugIdx = debug ? debug->idx : -1;
-	
-	dtCrowdAgent** agents = m_activeAgents;
-	int nagents = getActiveAgents(agents, m_maxAgents);
+	// Defined out of line to fix the weak v-tables warning
+}
 
-	// Check that all agents still have valid paths.
-	checkPathValidity(agents, nagents, dt);
-	
-	// Update async move request and path finder.
-	updateMoveRequest(dt);
+dtCrowdTaskRunner::~dtCrowdTaskRunner()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
 
-	// Optimize path topology.
-	updateTopologyOptimization(agents, nagents, dt);
-	
-	// Register agents to proximity grid.
-	m_grid->clear();
-	for (int i = 0; i < nagents; ++i)
+/// The phases of dtCrowd::update which can be split across workers.
+/// Each phase only writes the state of the agents assigned to the worker.
+enum dtCrowdUpdatePhase
+{
+	PHASE_NEIGHBOURS,
+	PHASE_CORNERS,
+	PHASE_STEERING,
+	PHASE_VELOCITY_PLANNING,
+	PHASE_INTEGRATE,
+	PHASE_COLLISION_DISPLACEMENT,
+	PHASE_COLLISION_APPLY,
+	PHASE_MOVE
+};
+
+/// Processes one phase of the crowd update for a contiguous range of agents per worker.
+class dtCrowdPhaseTask : public dtCrowdTask
+{
+public:
+	dtCrowd* crowd;
+	int phase;
+	dtCrowdAgent** agents;
+	int nagents;
+	int workerCount;
+	float dt;
+	dtCrowdAgentDebugInfo* debug;
+	
+	virtual void execute(const int worker)
 	{
-		dtCrowdAgent* ag = agents[i];
-		const float* p = ag->npos;
-		const float r = ag->params.radius;
-		m_grid->addItem((unsigned short)i, p[0]-r, p[2]-r, p[0]+r, p[2]+r);
+		const int begin = nagents * worker / workerCount;
+		const int end = nagents * (worker+1) / workerCount;
+		crowd->updatePhase(phase, worker, agents, begin, end, dt, debug);
 	}
-	
-	// Get nearby navmesh segments and agents to collide with.
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
+};
 
-		// Update the collision boundary after certain distance has been passed or
-		// if it has become invalid.
-		const float updateThr = ag->params.collisionQueryRange*0.25f;
-		if (dtVdist2DSqr(ag->npos, ag->boundary.getCenter()) > dtSqr(updateThr) ||
-			!ag->boundary.isValid(m_navquery, &m_filters[ag->params.queryFilterType]))
-		{
-			ag->boundary.update(ag->corridor.getFirstPoly(), ag->npos, ag->params.collisionQueryRange,
-								m_navquery, &m_filters[ag->params.queryFilterType]);
-		}
-		// Query neighbour agents
-		ag->nneis = getNeighbours(ag->npos, ag->params.height, ag->params.collisionQueryRange,
-								  ag, ag->neis, DT_CROWDAGENT_MAX_NEIGHBOURS,
-								  agents, nagents, m_grid);
-		for (int j = 0; j < ag->nneis; j++)
-			ag->neis[j].idx = getAgentIndex(agents[ag->neis[j].idx]);
+void dtCrowd::runPhase(const int phase, dtCrowdAgent** agents, const int nagents, const float dt, dtCrowdAgentDebugInfo* debug)
+{
+	if (!m_taskRunner || m_workerCount < 2 || nagents < 2)
+	{
+		updatePhase(phase, 0, agents, 0, nagents, dt, debug);
+		return;
 	}
 	
-	// Find next corner to steer to.
-	for (int i = 0; i < nagents; ++i)
+	dtCrowdPhaseTask task;
+	task.crowd = this;
+	task.phase = phase;
+	task.agents = agents;
+	task.nagents = nagents;
+	task.workerCount = m_workerCount;
+	task.dt = dt;
+	task.debug = debug;
+	m_taskRunner->run(&task, m_workerCount);
+}
+
+void dtCrowd::updatePhase(const int phase, const int worker, dtCrowdAgent** agents,
+						  const int begin, const int end, const float dt, dtCrowdAgentDebugInfo* debug)
+{
+	dtNavMeshQuery* navquery = m_workerNavQueries[worker];
+	dtObstacleAvoidanceQuery* obstacleQuery = m_workerObstacleQueries[worker];
+	const int debugIdx = debug ? debug->idx : -1;
+	
+	switch (phase)
 	{
-		dtCrowdAgent* ag = agents[i];
-		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-			continue;
-		
-		// Find corners for steering
-		ag->ncorners = ag->corridor.findCorners(ag->cornerVerts, ag->cornerFlags, ag->cornerPolys,
-												DT_CROWDAGENT_MAX_CORNERS, m_navquery, &m_filters[ag->params.queryFilterType]);
-		
-		// Check to see if the corner after the next corner is directly visible,
-		// and short cut to there.
-		if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_VIS) && ag->ncorners > 0)
+	case PHASE_NEIGHBOURS:
+		for (int i = begin; i < end; ++i)
 		{
-			const float* target = &ag->cornerVerts[dtMin(1,ag->ncorners-1)*3];
-			ag->corridor.optimizePathVisibility(target, ag->params.pathOptimizationRange, m_navquery, &m_filters[ag->params.queryFilterType]);
+			dtCrowdAgent* ag = agents[i];
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
 			
-			// Copy data for debug purposes.
-			if (debugIdx == i)
+			// Agents which do not avoid or collide do not need any neighbours.
+			if (ag->lod == DT_CROWDAGENT_LOD_CORRIDOR || ag->lod == DT_CROWDAGENT_LOD_FROZEN)
 			{
-				dtVcopy(debug->optStart, ag->corridor.getPos());
-				dtVcopy(debug->optEnd, target);
+				ag->nneis = 0;
+				continue;
 			}
-		}
-		else
-		{
-			// Copy data for debug purposes.
-			if (debugIdx == i)
+			// Reduced agents keep their neighbours between the updates,
+			// except the ones which were removed from the crowd since.
+			if (ag->lod == DT_CROWDAGENT_LOD_REDUCED && !isLODUpdate(ag))
 			{
-				dtVset(debug->optStart, 0,0,0);
-				dtVset(debug->optEnd, 0,0,0);
+				int nneis = 0;
+				for (int j = 0; j < ag->nneis; ++j)
+				{
+					if (m_agents[ag->neis[j].idx].active)
+						ag->neis[nneis++] = ag->neis[j];
+				}
+				ag->nneis = nneis;
+				continue;
 			}
+
+			// Update the collision boundary after certain distance has been passed or
+			// if it has become invalid.
+			const float updateThr = ag->params.collisionQueryRange*0.25f;
+			if (dtVdist2DSqr(ag->npos, ag->boundary.getCenter()) > dtSqr(updateThr) ||
+				!ag->boundary.isValid(navquery, &m_filters[ag->params.queryFilterType]))
+			{
+				ag->boundary.update(ag->corridor.getFirstPoly(), ag->npos, ag->params.collisionQueryRange,
+									navquery, &m_filters[ag->params.queryFilterType], m_workerWallCaches[worker]);
+			}
+			// Query neighbour agents
+			ag->nneis = getNeighbours(ag->npos, ag->params.height, ag->params.collisionQueryRange,
+									  ag, ag->neis, DT_CROWDAGENT_MAX_NEIGHBOURS,
+									  m_agents, m_grid);
 		}
-	}
-	
-	// Trigger off-mesh connections (depends on corners).
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
-		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-			continue;
+		break;
 		
-		// Check 
-		const float triggerRadius = ag->params.radius*2.25f;
-		if (overOffmeshConnection(ag, triggerRadius))
+	case PHASE_CORNERS:
+		for (int i = begin; i < end; ++i)
 		{
-			// Prepare to off-mesh connection.
-			const int idx = (int)(ag - m_agents);
-			dtCrowdAgentAnimation* anim = &m_agentAnims[idx];
+			dtCrowdAgent* ag = agents[i];
 			
-			// Adjust the path over the off-mesh connection.
-			dtPolyRef refs[2];
-			if (ag->corridor.moveOverOffmeshConnection(ag->cornerPolys[ag->ncorners-1], refs,
-													   anim->startPos, anim->endPos, m_navquery))
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+				continue;
+			if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
+				continue;
+			
+			// Find corners for steering
+			ag->ncorners = ag->corridor.findCorners(ag->cornerVerts, ag->cornerFlags, ag->cornerPolys,
+													DT_CROWDAGENT_MAX_CORNERS, navquery, &m_filters[ag->params.queryFilterType]);
+			
+			// Check to see if the corner after the next corner is directly visible,
+			// and short cut to there.
+			if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_VIS) && ag->ncorners > 0 && isLODUpdate(ag))
 			{
-				dtVcopy(anim->initPos, ag->npos);
-				anim->polyRef = refs[1];
-				anim->active = true;
-				anim->t = 0.0f;
-				anim->tmax = (dtVdist2D(anim->startPos, anim->endPos) / ag->params.maxSpeed) * 0.5f;
+				const float* target = &ag->cornerVerts[dtMin(1,ag->ncorners-1)*3];
+				ag->corridor.optimizePathVisibility(target, ag->params.pathOptimizationRange, navquery, &m_filters[ag->params.queryFilterType]);
 				
-				ag->state = DT_CROWDAGENT_STATE_OFFMESH;
-				ag->ncorners = 0;
-				ag->nneis = 0;
-				continue;
+				// Copy data for debug purposes.
+				if (debugIdx == i)
+				{
+					dtVcopy(debug->optStart, ag->corridor.getPos());
+					dtVcopy(debug->optEnd, target);
+				}
 			}
 			else
 			{
-				// Path validity check will ensure that bad/blocked connections will be replanned.
+				// Copy data for debug purposes.
+				if (debugIdx == i)
+				{
+					dtVset(debug->optStart, 0,0,0);
+					dtVset(debug->optEnd, 0,0,0);
+				}
 			}
 		}
-	}
+		break;
 		
-	// Calculate steering.
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
+	case PHASE_STEERING:
+		for (int i = begin; i < end; ++i)
+		{
+			dtCrowdAgent* ag = agents[i];
 
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE)
-			continue;
-		
-		float dvel[3] = {0,0,0};
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			if (ag->targetState == DT_CROWDAGENT_TARGET_NONE)
+				continue;
+			
+			float dvel[3] = {0,0,0};
 
-		if (ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-		{
-			dtVcopy(dvel, ag->targetPos);
-			ag->desiredSpeed = dtVlen(ag->targetPos);
-		}
-		else
-		{
-			// Calculate steering direction.
-			if (ag->params.updateFlags & DT_CROWD_ANTICIPATE_TURNS)
-				calcSmoothSteerDirection(ag, dvel);
+			if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
+			{
+				dtVcopy(ag->dvel, dvel);
+				continue;
+			}
+
+			if (ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			{
+				dtVcopy(dvel, ag->targetPos);
+				ag->desiredSpeed = dtVlen(ag->targetPos);
+			}
 			else
-				calcStraightSteerDirection(ag, dvel);
-			
-			// Calculate speed scale, which tells the agent to slowdown at the end of the path.
-			const float slowDownRadius = ag->params.radius*2;	// TODO: make less hacky.
-			const float speedScale = getDistanceToGoal(ag, slowDownRadius) / slowDownRadius;
+			{
+				// Calculate steering direction.
+				if (ag->params.updateFlags & DT_CROWD_ANTICIPATE_TURNS)
+					calcSmoothSteerDirection(ag, dvel);
+				else
+					calcStraightSteerDirection(ag, dvel);
 				
-			ag->desiredSpeed = ag->params.maxSpeed;
-			dtVscale(dvel, dvel, ag->desiredSpeed * speedScale);
-		}
+				// Calculate speed scale, which tells the agent to slowdown at the end of the path.
+				const float slowDownRadius = ag->params.radius*2;	// TODO: make less hacky.
+				const float speedScale = getDistanceToGoal(ag, slowDownRadius) / slowDownRadius;
+					
+				ag->desiredSpeed = ag->params.maxSpeed;
+				dtVscale(dvel, dvel, ag->desiredSpeed * speedScale);
+			}
 
-		// Separation
-		if (ag->params.updateFlags & DT_CROWD_SEPARATION)
-		{
-			const float separationDist = ag->params.collisionQueryRange; 
-			const float invSeparationDist = 1.0f / separationDist; 
-			const float separationWeight = ag->params.separationWeight;
-			
-			float w = 0;
-			float disp[3] = {0,0,0};
-			
-			for (int j = 0; j < ag->nneis; ++j)
+			// Separation
+			if (ag->params.updateFlags & DT_CROWD_SEPARATION)
 			{
-				const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
+				const float separationDist = ag->params.collisionQueryRange; 
+				const float invSeparationDist = 1.0f / separationDist; 
+				const float separationWeight = ag->params.separationWeight;
 				
-				float diff[3];
-				dtVsub(diff, ag->npos, nei->npos);
-				diff[1] = 0;
+				float w = 0;
+				float disp[3] = {0,0,0};
 				
-				const float distSqr = dtVlenSqr(diff);
-				if (distSqr < 0.00001f)
-					continue;
-				if (distSqr > dtSqr(separationDist))
-					continue;
-				const float dist = dtMathSqrtf(distSqr);
-				const float weight = separationWeight * (1.0f - dtSqr(dist*invSeparationDist));
+				for (int j = 0; j < ag->nneis; ++j)
+				{
+					const float* neiPos = &m_agentPos[ag->neis[j].idx*3];
+					
+					float diff[3];
+					dtVsub(diff, ag->npos, neiPos);
+					diff[1] = 0;
+					
+					const float distSqr = dtVlenSqr(diff);
+					if (distSqr < 0.00001f)
+						continue;
+					if (distSqr > dtSqr(separationDist))
+						continue;
+					const float dist = dtMathSqrtf(distSqr);
+					const float weight = separationWeight * (1.0f - dtSqr(dist*invSeparationDist));
+					
+					dtVmad(disp, disp, diff, weight/dist);
+					w += 1.0f;
+				}
 				
-				dtVmad(disp, disp, diff, weight/dist);
-				w += 1.0f;
+				if (w > 0.0001f)
+				{
+					// Adjust desired velocity.
+					dtVmad(dvel, dvel, disp, 1.0f/w);
+					// Clamp desired velocity to desired speed.
+					const float speedSqr = dtVlenSqr(dvel);
+					const float desiredSqr = dtSqr(ag->desiredSpeed);
+					if (speedSqr > desiredSqr)
+						dtVscale(dvel, dvel, desiredSqr/speedSqr);
+				}
 			}
 			
-			if (w > 0.0001f)
-			{
-				// Adjust desired velocity.
-				dtVmad(dvel, dvel, disp, 1.0f/w);
-				// Clamp desired velocity to desired speed.
-				const float speedSqr = dtVlenSqr(dvel);
-				const float desiredSqr = dtSqr(ag->desiredSpeed);
-				if (speedSqr > desiredSqr)
-					dtVscale(dvel, dvel, desiredSqr/speedSqr);
-			}
+			// Set the desired velocity.
+			dtVcopy(ag->dvel, dvel);
 		}
+		break;
 		
-		// Set the desired velocity.
-		dtVcopy(ag->dvel, dvel);
-	}
-	
-	// Velocity planning.	
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
-		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		
-		if (ag->params.updateFlags & DT_CROWD_OBSTACLE_AVOIDANCE)
+	case PHASE_VELOCITY_PLANNING:
+		for (int i = begin; i < end; ++i)
 		{
-			m_obstacleQuery->reset();
+			dtCrowdAgent* ag = agents[i];
 			
-			// Add neighbours as obstacles.
-			for (int j = 0; j < ag->nneis; ++j)
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			
+			if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
 			{
-				const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
-				m_obstacleQuery->addCircle(nei->npos, nei->params.radius, nei->vel, nei->dvel);
+				dtVset(ag->nvel, 0,0,0);
+				continue;
 			}
-
-			// Append neighbour segments as obstacles.
-			for (int j = 0; j < ag->boundary.getSegmentCount(); ++j)
+			// Reduced agents keep their avoidance velocity between the updates.
+			if (ag->lod == DT_CROWDAGENT_LOD_REDUCED && !isLODUpdate(ag))
+				continue;
+			
+			if ((ag->params.updateFlags & DT_CROWD_OBSTACLE_AVOIDANCE) && ag->lod != DT_CROWDAGENT_LOD_CORRIDOR)
 			{
-				const float* s = ag->boundary.getSegment(j);
-				if (dtTriArea2D(ag->npos, s, s+3) < 0.0f)
-					continue;
-				m_obstacleQuery->addSegment(s, s+3);
-			}
+				obstacleQuery->reset();
+				
+				// Add neighbours as obstacles.
+				for (int j = 0; j < ag->nneis; ++j)
+				{
+					const int nei = ag->neis[j].idx;
+					obstacleQuery->addCircle(&m_agentPos[nei*3], m_agentRadius[nei], &m_agentVel[nei*3], &m_agentDvel[nei*3]);
+				}
 
-			dtObstacleAvoidanceDebugData* vod = 0;
-			if (debugIdx == i) 
-				vod = debug->vod;
-			
-			// Sample new safe velocity.
-			bool adaptive = true;
-			int ns = 0;
+				// Append neighbour segments as obstacles.
+				for (int j = 0; j < ag->boundary.getSegmentCount(); ++j)
+				{
+					const float* s = ag->boundary.getSegment(j);
+					if (dtTriArea2D(ag->npos, s, s+3) < 0.0f)
+						continue;
+					obstacleQuery->addSegment(s, s+3);
+				}
 
-			const dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[ag->params.obstacleAvoidanceType];
+				dtObstacleAvoidanceDebugData* vod = 0;
+				if (debugIdx == i) 
+					vod = debug->vod;
 				
-			if (adaptive)
-			{
-				ns = m_obstacleQuery->sampleVelocityAdaptive(ag->npos, ag->params.radius, ag->desiredSpeed,
-															 ag->vel, ag->dvel, ag->nvel, params, vod);
+				// Sample new safe velocity.
+				int ns = 0;
+
+				const dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[ag->params.obstacleAvoidanceType];
+					
+				if (params->mode == DT_OBSTACLE_AVOIDANCE_ORCA)
+				{
+					ns = obstacleQuery->computeVelocityORCA(ag->npos, ag->params.radius, ag->desiredSpeed,
+															ag->vel, ag->dvel, ag->nvel, dt, params, vod);
+				}
+				else if (params->mode == DT_OBSTACLE_AVOIDANCE_GRID)
+				{
+					ns = obstacleQuery->sampleVelocityGrid(ag->npos, ag->params.radius, ag->desiredSpeed,
+														   ag->vel, ag->dvel, ag->nvel, params, vod);
+				}
+				else
+				{
+					ns = obstacleQuery->sampleVelocityAdaptive(ag->npos, ag->params.radius, ag->desiredSpeed,
+															   ag->vel, ag->dvel, ag->nvel, params, vod);
+				}
+				m_workerSampleCounts[worker] += ns;
 			}
 			else
 			{
-				ns = m_obstacleQuery->sampleVelocityGrid(ag->npos, ag->params.radius, ag->desiredSpeed,
-														 ag->vel, ag->dvel, ag->nvel, params, vod);
+				// If not using velocity planning, new velocity is directly the desired velocity.
+				dtVcopy(ag->nvel, ag->dvel);
 			}
-			m_velocitySampleCount += ns;
 		}
-		else
+		break;
+		
+	case PHASE_INTEGRATE:
+		for (int i = begin; i < end; ++i)
 		{
-			// If not using velocity planning, new velocity is directly the desired velocity.
-			dtVcopy(ag->nvel, ag->dvel);
+			dtCrowdAgent* ag = agents[i];
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			// Frozen agents stop at once.
+			if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
+				dtVset(ag->vel, 0,0,0);
+			else
+				integrate(ag, dt);
 		}
-	}
-
-	// Integrate.
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		integrate(ag, dt);
-	}
-	
-	// Handle collisions.
-	static const float COLLISION_RESOLVE_FACTOR = 0.7f;
-	
-	for (int iter = 0; iter < 4; ++iter)
+		break;
+		
+	case PHASE_COLLISION_DISPLACEMENT:
 	{
-		for (int i = 0; i < nagents; ++i)
+		static const float COLLISION_RESOLVE_FACTOR = 0.7f;
+		
+		for (int i = begin; i < end; ++i)
 		{
 			dtCrowdAgent* ag = agents[i];
 			const int idx0 = getAgentIndex(ag);
@@ -1335,22 +1955,22 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 
 			dtVset(ag->disp, 0,0,0);
 			
+			const float radius = m_agentRadius[idx0];
 			float w = 0;
 
 			for (int j = 0; j < ag->nneis; ++j)
 			{
-				const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
-				const int idx1 = getAgentIndex(nei);
+				const int idx1 = ag->neis[j].idx;
 
 				float diff[3];
-				dtVsub(diff, ag->npos, nei->npos);
+				dtVsub(diff, ag->npos, &m_agentPos[idx1*3]);
 				diff[1] = 0;
 				
 				float dist = dtVlenSqr(diff);
-				if (dist > dtSqr(ag->params.radius + nei->params.radius))
+				if (dist > dtSqr(radius + m_agentRadius[idx1]))
 					continue;
 				dist = dtMathSqrtf(dist);
-				float pen = (ag->params.radius + nei->params.radius) - dist;
+				float pen = (radius + m_agentRadius[idx1]) - dist;
 				if (dist < 0.0001f)
 				{
 					// Agents on top of each other, try to choose diverging separation directions.
@@ -1376,8 +1996,11 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 				dtVscale(ag->disp, ag->disp, iw);
 			}
 		}
+		break;
+	}
 		
-		for (int i = 0; i < nagents; ++i)
+	case PHASE_COLLISION_APPLY:
+		for (int i = begin; i < end; ++i)
 		{
 			dtCrowdAgent* ag = agents[i];
 			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
@@ -1385,28 +2008,125 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 			
 			dtVadd(ag->npos, ag->npos, ag->disp);
 		}
+		break;
+		
+	case PHASE_MOVE:
+		for (int i = begin; i < end; ++i)
+		{
+			dtCrowdAgent* ag = agents[i];
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
+				continue;
+			
+			// Move along navmesh.
+			ag->corridor.movePosition(ag->npos, navquery, &m_filters[ag->params.queryFilterType]);
+			// Get valid constrained position back.
+			dtVcopy(ag->npos, ag->corridor.getPos());
+
+			// If not using path, truncate the corridor to just one poly.
+			if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			{
+				ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
+				ag->partial = false;
+			}
+		}
+		break;
 	}
+}
+
+void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
+{
+	m_velocitySampleCount = 0;
 	
+	dtCrowdAgent** agents = m_activeAgents;
+	int nagents = getActiveAgents(agents, m_maxAgents);
+
+	// Check that all agents still have valid paths, the agents whose paths cross changed tiles first.
+	updateTileChanges(agents, nagents);
+	checkPathValidity(agents, nagents, dt);
+	
+	// Update async move request and path finder.
+	updateMoveRequest(dt);
+
+	// Optimize path topology.
+	updateTopologyOptimization(agents, nagents, dt);
+	
+	// Register agents to proximity grid.
+	updateGrid(agents, nagents);
+	
+	// Get nearby navmesh segments and agents to collide with.
+	runPhase(PHASE_NEIGHBOURS, agents, nagents, dt, debug);
+	
+	// Find next corner to steer to.
+	runPhase(PHASE_CORNERS, agents, nagents, dt, debug);
+	
+	// Trigger off-mesh connections (depends on corners).
 	for (int i = 0; i < nagents; ++i)
 	{
 		dtCrowdAgent* ag = agents[i];
+		
 		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
 			continue;
-		
-		// Move along navmesh.
-		ag->corridor.movePosition(ag->npos, m_navquery, &m_filters[ag->params.queryFilterType]);
-		// Get valid constrained position back.
-		dtVcopy(ag->npos, ag->corridor.getPos());
-
-		// If not using path, truncate the corridor to just one poly.
 		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			continue;
+		if (ag->lod == DT_CROWDAGENT_LOD_FROZEN)
+			continue;
+		
+		// Check 
+		const float triggerRadius = ag->params.radius*2.25f;
+		if (overOffmeshConnection(ag, triggerRadius))
 		{
-			ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
-			ag->partial = false;
+			// Prepare to off-mesh connection.
+			const int idx = (int)(ag - m_agents);
+			dtCrowdAgentAnimation* anim = &m_agentAnims[idx];
+			
+			// Adjust the path over the off-mesh connection.
+			dtPolyRef refs[2];
+			if (ag->corridor.moveOverOffmeshConnection(ag->cornerPolys[ag->ncorners-1], refs,
+													   anim->startPos, anim->endPos, m_navquery))
+			{
+				dtVcopy(anim->initPos, ag->npos);
+				anim->polyRef = refs[1];
+				anim->active = true;
+				anim->t = 0.0f;
+				anim->tmax = (dtVdist2D(anim->startPos, anim->endPos) / ag->params.maxSpeed) * 0.5f;
+				
+				ag->state = DT_CROWDAGENT_STATE_OFFMESH;
+				ag->ncorners = 0;
+				ag->nneis = 0;
+				continue;
+			}
+			else
+			{
+				// Path validity check will ensure that bad/blocked connections will be replanned.
+			}
 		}
+	}
+		
+	// Calculate steering.
+	runPhase(PHASE_STEERING, agents, nagents, dt, debug);
+	
+	// Velocity planning.
+	for (int i = 0; i < m_workerCount; ++i)
+		m_workerSampleCounts[i] = 0;
+	runPhase(PHASE_VELOCITY_PLANNING, agents, nagents, dt, debug);
+	for (int i = 0; i < m_workerCount; ++i)
+		m_velocitySampleCount += m_workerSampleCounts[i];
 
+	// Integrate.
+	runPhase(PHASE_INTEGRATE, agents, nagents, dt, debug);
+	
+	// Handle collisions. The displacements are calculated for all agents before they are applied.
+	for (int iter = 0; iter < 4; ++iter)
+	{
+		runPhase(PHASE_COLLISION_DISPLACEMENT, agents, nagents, dt, debug);
+		runPhase(PHASE_COLLISION_APPLY, agents, nagents, dt, debug);
 	}
 	
+	// Move along navmesh.
+	runPhase(PHASE_MOVE, agents, nagents, dt, debug);
+	
 	// Update agents using off-mesh connection.
 	for (int i = 0; i < nagents; ++i)
 	{
@@ -1446,4 +2166,5 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 		dtVset(ag->dvel, 0,0,0);
 	}
 	
+	m_updateCount++;
 }
@@ -0,0 +1,269 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include "DetourFlowField.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include "DetourAtomic.h"
+
+
+dtFlowField* dtAllocFlowField()
+{
+	void* mem = dtAlloc(sizeof(dtFlowField), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtFlowField;
+}
+
+void dtFreeFlowField(dtFlowField* ptr)
+{
+	if (!ptr) return;
+	ptr->~dtFlowField();
+	dtFree(ptr);
+}
+
+
+dtFlowField::dtFlowField() :
+	m_nav(0),
+	m_openList(0),
+	m_current(-1),
+	m_building(-1),
+	m_filter(0),
+	m_buildStatus(0),
+	m_version(0),
+	m_maxTiles(0)
+{
+	memset(m_pools, 0, sizeof(m_pools));
+	memset(m_goals, 0, sizeof(m_goals));
+	memset(m_tileRefs, 0, sizeof(m_tileRefs));
+}
+
+dtFlowField::~dtFlowField()
+{
+	purge();
+}
+
+void dtFlowField::purge()
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		if (m_pools[i])
+		{
+			m_pools[i]->~dtNodePool();
+			dtFree(m_pools[i]);
+			m_pools[i] = 0;
+		}
+		dtFree(m_tileRefs[i]);
+		m_tileRefs[i] = 0;
+	}
+	if (m_openList)
+	{
+		m_openList->~dtNodeQueue();
+		dtFree(m_openList);
+		m_openList = 0;
+	}
+	m_nav = 0;
+	m_maxTiles = 0;
+	m_current = -1;
+	m_building = -1;
+	m_filter = 0;
+	m_buildStatus = 0;
+}
+
+bool dtFlowField::init(const dtNavMesh* nav, const int maxNodes)
+{
+	purge();
+	
+	if (!nav || maxNodes <= 0 || maxNodes > (int)DT_NULL_IDX)
+		return false;
+	
+	m_nav = nav;
+	
+	for (int i = 0; i < 2; ++i)
+	{
+		void* mem = dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM);
+		if (!mem)
+			return false;
+		m_pools[i] = new(mem) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+	}
+	
+	void* mem = dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM);
+	if (!mem)
+		return false;
+	m_openList = new(mem) dtNodeQueue(maxNodes);
+	
+	m_maxTiles = nav->getMaxTiles();
+	for (int i = 0; i < 2; ++i)
+	{
+		m_tileRefs[i] = (dtTileRef*)dtAlloc(sizeof(dtTileRef)*m_maxTiles, DT_ALLOC_PERM);
+		if (!m_tileRefs[i])
+			return false;
+		memset(m_tileRefs[i], 0, sizeof(dtTileRef)*m_maxTiles);
+	}
+	
+	return true;
+}
+
+void dtFlowField::snapshotTiles(dtTileRef* tileRefs) const
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		tileRefs[i] = dtAtomicLoad(&tile->header) ? m_nav->getTileRef(tile) : 0;
+	}
+}
+
+bool dtFlowField::isUpToDate() const
+{
+	const int idx = m_building != -1 ? m_building : m_current;
+	if (idx == -1)
+		return true;
+	
+	const dtTileRef* tileRefs = m_tileRefs[idx];
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		const dtTileRef ref = dtAtomicLoad(&tile->header) ? m_nav->getTileRef(tile) : 0;
+		if (ref != tileRefs[i])
+			return false;
+	}
+	return true;
+}
+
+/// @par
+///
+/// The table being built, if any, is dropped. The finished table stays available
+/// until the new one is finished.
+dtStatus dtFlowField::setGoal(dtPolyRef goalRef, const float* goalPos, const dtQueryFilter* filter)
+{
+	dtAssert(m_nav);
+	
+	if (!m_nav->isValidPolyRef(goalRef) || !goalPos || !dtVisfinite(goalPos) || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	m_building = m_current == 0 ? 1 : 0;
+	dtNodePool* pool = m_pools[m_building];
+	pool->clear();
+	m_openList->clear();
+	
+	m_goals[m_building].ref = goalRef;
+	dtVcopy(m_goals[m_building].pos, goalPos);
+	m_filter = filter;
+	snapshotTiles(m_tileRefs[m_building]);
+	
+	dtNode* goalNode = pool->getNode(goalRef);
+	dtVcopy(goalNode->pos, goalPos);
+	goalNode->pidx = 0;
+	goalNode->cost = 0;
+	goalNode->total = 0;
+	goalNode->id = goalRef;
+	goalNode->flags = DT_NODE_OPEN;
+	m_openList->push(goalNode);
+	
+	m_buildStatus = DT_IN_PROGRESS;
+	
+	return m_buildStatus;
+}
+
+dtStatus dtFlowField::update(const dtNavMeshQuery* query, const int maxIters, int* doneIters)
+{
+	if (doneIters)
+		*doneIters = 0;
+	
+	if (m_building == -1)
+		return isReady() ? DT_SUCCESS : DT_FAILURE;
+	if (!query || query->getAttachedNavMesh() != m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const dtStatus status = query->updateReverseDijkstraSearch(m_filter, m_pools[m_building], m_openList,
+															   maxIters, doneIters);
+	if (dtStatusFailed(status))
+		return status;
+	m_buildStatus |= status & DT_STATUS_DETAIL_MASK;
+	if (dtStatusInProgress(status))
+		return m_buildStatus;
+	
+	// The table is finished, make it current.
+	m_current = m_building;
+	m_building = -1;
+	m_version++;
+	m_buildStatus = (m_buildStatus & ~DT_IN_PROGRESS) | DT_SUCCESS;
+	
+	return m_buildStatus;
+}
+
+dtPolyRef dtFlowField::getNextPoly(dtPolyRef ref) const
+{
+	if (m_current == -1)
+		return 0;
+	dtNodePool* pool = m_pools[m_current];
+	const dtNode* node = pool->findNode(ref, 0);
+	if (!node || !(node->flags & DT_NODE_CLOSED) || !node->pidx)
+		return 0;
+	return pool->getNodeAtIdx(node->pidx)->id;
+}
+
+bool dtFlowField::getCost(dtPolyRef ref, float* cost) const
+{
+	if (m_current == -1)
+		return false;
+	const dtNode* node = m_pools[m_current]->findNode(ref, 0);
+	if (!node || !(node->flags & DT_NODE_CLOSED))
+		return false;
+	*cost = node->total;
+	return true;
+}
+
+int dtFlowField::getPath(dtPolyRef startRef, dtPolyRef* path, const int maxPath) const
+{
+	if (m_current == -1 || maxPath < 1)
+		return 0;
+	
+	dtNodePool* pool = m_pools[m_current];
+	const dtNode* node = pool->findNode(startRef, 0);
+	if (!node || !(node->flags & DT_NODE_CLOSED))
+		return 0;
+	
+	int n = 0;
+	while (node && n < maxPath)
+	{
+		if (!m_nav->isValidPolyRef(node->id))
+			break;
+		path[n++] = node->id;
+		node = pool->getNodeAtIdx(node->pidx);
+	}
+	return n;
+}
+
+int dtFlowField::getMemUsed() const
+{
+	int mem = sizeof(*this) + (int)sizeof(dtTileRef)*m_maxTiles*2;
+	for (int i = 0; i < 2; ++i)
+	{
+		if (m_pools[i])
+			mem += m_pools[i]->getMemUsed();
+	}
+	if (m_openList)
+		mem += m_openList->getMemUsed();
+	return mem;
+}
@@ -18,12 +18,217 @@
 
 #include <float.h>
 #include <string.h>
+#include <new>
 #include "DetourLocalBoundary.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourCommon.h"
+#include "DetourAlloc.h"
 #include "DetourAssert.h"
 
 
+dtWallSegmentCache* dtAllocWallSegmentCache()
+{
+	void* mem = dtAlloc(sizeof(dtWallSegmentCache), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtWallSegmentCache;
+}
+
+void dtFreeWallSegmentCache(dtWallSegmentCache* ptr)
+{
+	if (!ptr) return;
+	ptr->~dtWallSegmentCache();
+	dtFree(ptr);
+}
+
+#ifdef DT_POLYREF64
+inline unsigned int hashWallRef(dtPolyRef a)
+{
+	a = (~a) + (a << 18);
+	a = a ^ (a >> 31);
+	a = a * 21;
+	a = a ^ (a >> 11);
+	a = a + (a << 6);
+	a = a ^ (a >> 22);
+	return (unsigned int)a;
+}
+#else
+inline unsigned int hashWallRef(dtPolyRef a)
+{
+	a += ~(a<<15);
+	a ^=  (a>>10);
+	a +=  (a<<3);
+	a ^=  (a>>6);
+	a += ~(a<<11);
+	a ^=  (a>>16);
+	return (unsigned int)a;
+}
+#endif
+
+dtWallSegmentCache::dtWallSegmentCache() :
+	m_entries(0),
+	m_tableSize(0),
+	m_maxPolys(0),
+	m_npolys(0),
+	m_segs(0),
+	m_maxSegs(0),
+	m_nsegs(0),
+	m_stamp(1),
+	m_hits(0),
+	m_misses(0)
+{
+}
+
+dtWallSegmentCache::~dtWallSegmentCache()
+{
+	purge();
+}
+
+void dtWallSegmentCache::purge()
+{
+	dtFree(m_entries);
+	m_entries = 0;
+	dtFree(m_segs);
+	m_segs = 0;
+	m_tableSize = 0;
+	m_maxPolys = 0;
+	m_maxSegs = 0;
+}
+
+bool dtWallSegmentCache::init(const int maxPolys, const int maxSegs)
+{
+	dtAssert(maxPolys > 0);
+	dtAssert(maxSegs >= MAX_SEGS_PER_POLY);
+	
+	purge();
+	
+	// Keep the hash table at most half full.
+	m_maxPolys = maxPolys;
+	m_tableSize = (int)dtNextPow2((unsigned int)maxPolys*2);
+	m_entries = (Entry*)dtAlloc(sizeof(Entry)*m_tableSize, DT_ALLOC_PERM);
+	if (!m_entries)
+		return false;
+	memset(m_entries, 0, sizeof(Entry)*m_tableSize);
+	
+	m_maxSegs = maxSegs;
+	m_segs = (float*)dtAlloc(sizeof(float)*6*m_maxSegs, DT_ALLOC_PERM);
+	if (!m_segs)
+		return false;
+	
+	m_stamp = 1;
+	m_npolys = 0;
+	m_nsegs = 0;
+	m_hits = 0;
+	m_misses = 0;
+	
+	return true;
+}
+
+void dtWallSegmentCache::clear()
+{
+	// Changing the stamp frees all the entries at once.
+	m_stamp++;
+	if (m_stamp == 0)
+	{
+		memset(m_entries, 0, sizeof(Entry)*m_tableSize);
+		m_stamp = 1;
+	}
+	m_npolys = 0;
+	m_nsegs = 0;
+}
+
+void dtWallSegmentCache::invalidateTiles(const int* tiles, const int ntiles)
+{
+	if (!ntiles || !m_npolys)
+		return;
+	
+	// The entries are kept so that the hash chains stay intact, only their segments are dropped.
+	for (int i = 0; i < m_tableSize; ++i)
+	{
+		Entry* e = &m_entries[i];
+		if (e->stamp != m_stamp || e->nsegs < 0)
+			continue;
+		int lo = 0, hi = ntiles-1;
+		while (lo <= hi)
+		{
+			const int mid = (lo+hi)/2;
+			if (tiles[mid] < e->tile)
+				lo = mid+1;
+			else if (tiles[mid] > e->tile)
+				hi = mid-1;
+			else
+			{
+				e->nsegs = -1;
+				break;
+			}
+		}
+	}
+}
+
+int dtWallSegmentCache::getWallSegments(dtPolyRef ref, const dtQueryFilter* filter,
+										const dtNavMeshQuery* navquery, const float** segs)
+{
+	const unsigned short includeFlags = filter->getIncludeFlags();
+	const unsigned short excludeFlags = filter->getExcludeFlags();
+	const int mask = m_tableSize-1;
+	
+	int idx = (int)(hashWallRef(ref) & (unsigned int)mask);
+	while (m_entries[idx].stamp == m_stamp)
+	{
+		const Entry* e = &m_entries[idx];
+		if (e->ref == ref && e->filter == filter &&
+			e->includeFlags == includeFlags && e->excludeFlags == excludeFlags)
+			break;
+		idx = (idx+1) & mask;
+	}
+	
+	Entry* e = &m_entries[idx];
+	const bool found = e->stamp == m_stamp;
+	if (found && e->nsegs >= 0)
+	{
+		m_hits++;
+		*segs = &m_segs[e->firstSeg*6];
+		return e->nsegs;
+	}
+	
+	m_misses++;
+	int nsegs = 0;
+	*segs = m_tmpSegs;
+	if (dtStatusFailed(navquery->getPolyWallSegments(ref, filter, m_tmpSegs, 0, &nsegs, MAX_SEGS_PER_POLY)))
+		return 0;
+	
+	// Start over when the cache is full, the polygons around the agents are quickly found again.
+	if (m_nsegs + nsegs > m_maxSegs || (!found && m_npolys >= m_maxPolys))
+	{
+		clear();
+		idx = (int)(hashWallRef(ref) & (unsigned int)mask);
+		e = &m_entries[idx];
+	}
+	
+	if (e->stamp != m_stamp)
+	{
+		e->ref = ref;
+		e->filter = filter;
+		e->includeFlags = includeFlags;
+		e->excludeFlags = excludeFlags;
+		e->stamp = m_stamp;
+		e->tile = (int)navquery->getAttachedNavMesh()->decodePolyIdTile(ref);
+		m_npolys++;
+	}
+	e->firstSeg = m_nsegs;
+	e->nsegs = nsegs;
+	memcpy(&m_segs[m_nsegs*6], m_tmpSegs, sizeof(float)*6*nsegs);
+	m_nsegs += nsegs;
+	
+	*segs = &m_segs[e->firstSeg*6];
+	return nsegs;
+}
+
+size_t dtWallSegmentCache::getMemUsed() const
+{
+	return sizeof(*this) + sizeof(Entry)*m_tableSize + sizeof(float)*6*m_maxSegs;
+}
+
+
 dtLocalBoundary::dtLocalBoundary() :
 	m_nsegs(0),
 	m_npolys(0)
@@ -81,8 +286,13 @@ void dtLocalBoundary::addSegment(const float dist, const float* s)
 		m_nsegs++;
 }
 
+/// @par
+///
+/// When a wall segment cache is given, the wall segments of the polygons around
+/// the agent are taken from it, the cache must be kept up to date with the changes
+/// of the navigation mesh tiles. (See: dtWallSegmentCache::invalidateTiles)
 void dtLocalBoundary::update(dtPolyRef ref, const float* pos, const float collisionQueryRange,
-							 dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+							 dtNavMeshQuery* navquery, const dtQueryFilter* filter, dtWallSegmentCache* cache)
 {
 	static const int MAX_SEGS_PER_POLY = DT_VERTS_PER_POLYGON*3;
 	
@@ -106,10 +316,14 @@ void dtLocalBoundary::update(dtPolyRef ref, const float* pos, const float collis
 	int nsegs = 0;
 	for (int j = 0; j < m_npolys; ++j)
 	{
-		navquery->getPolyWallSegments(m_polys[j], filter, segs, 0, &nsegs, MAX_SEGS_PER_POLY);
+		const float* polySegs = segs;
+		if (cache)
+			nsegs = cache->getWallSegments(m_polys[j], filter, navquery, &polySegs);
+		else
+			navquery->getPolyWallSegments(m_polys[j], filter, segs, 0, &nsegs, MAX_SEGS_PER_POLY);
 		for (int k = 0; k < nsegs; ++k)
 		{
-			const float* s = &segs[k*6];
+			const float* s = &polySegs[k*6];
 			// Skip too distant segments.
 			float tseg;
 			const float distSqr = dtDistancePtSegSqr2D(pos, s, s+3, tseg);
@@ -25,49 +25,48 @@
 #include <float.h>
 #include <new>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DT_OBSTACLE_AVOIDANCE_SSE
+#include <emmintrin.h>
+#endif
+
 static const float DT_PI = 3.14159265f;
 
-static int sweepCircleCircle(const float* c0, const float r0, const float* v,
-							 const float* c1, const float r1,
-							 float& tmin, float& tmax)
-{
-	static const float EPS = 0.0001f;
-	float s[3];
-	dtVsub(s,c1,c0);
-	float r = r0+r1;
-	float c = dtVdot2D(s,s) - r*r;
-	float a = dtVdot2D(v,v);
-	if (a < EPS) return 0;	// not moving
-	
-	// Overlap, calc time to exit.
-	float b = dtVdot2D(v,s);
-	float d = b*b - a*c;
-	if (d < 0.0f) return 0; // no intersection.
-	a = 1.0f / a;
-	const float rd = dtMathSqrtf(d);
-	tmin = (b - rd) * a;
-	tmax = (b + rd) * a;
-	return 1;
-}
+#ifdef DT_OBSTACLE_AVOIDANCE_SSE
 
-static int isectRaySeg(const float* ap, const float* u,
-					   const float* bp, const float* bq,
-					   float& t)
-{
-	float v[3], w[3];
-	dtVsub(v,bq,bp);
-	dtVsub(w,ap,bp);
-	float d = dtVperp2D(u,v);
-	if (dtMathFabsf(d) < 1e-6f) return 0;
-	d = 1.0f/d;
-	t = dtVperp2D(v,w) * d;
-	if (t < 0 || t > 1) return 0;
-	float s = dtVperp2D(u,w) * d;
-	if (s < 0 || s > 1) return 0;
-	return 1;
-}
+// Number of sampled velocities evaluated at once, a multiple of the lane count.
+static const int DT_SAMPLE_BATCH = 4;
+
+// Four float lanes used to evaluate several sampled velocities at once.
+typedef __m128 dtFloat4;
+typedef __m128 dtMask4;
+
+inline dtFloat4 dtSet4(const float v) { return _mm_set1_ps(v); }
+inline dtFloat4 dtLoad4(const float* v) { return _mm_loadu_ps(v); }
+inline void dtStore4(float* dst, const dtFloat4 v) { _mm_storeu_ps(dst, v); }
+inline dtFloat4 dtAdd4(const dtFloat4 a, const dtFloat4 b) { return _mm_add_ps(a, b); }
+inline dtFloat4 dtSub4(const dtFloat4 a, const dtFloat4 b) { return _mm_sub_ps(a, b); }
+inline dtFloat4 dtMul4(const dtFloat4 a, const dtFloat4 b) { return _mm_mul_ps(a, b); }
+inline dtFloat4 dtDiv4(const dtFloat4 a, const dtFloat4 b) { return _mm_div_ps(a, b); }
+inline dtFloat4 dtSqrt4(const dtFloat4 a) { return _mm_sqrt_ps(a); }
+inline dtFloat4 dtMin4(const dtFloat4 a, const dtFloat4 b) { return _mm_min_ps(a, b); }
+inline dtFloat4 dtMax4(const dtFloat4 a, const dtFloat4 b) { return _mm_max_ps(a, b); }
+inline dtFloat4 dtAbs4(const dtFloat4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline dtMask4 dtLess4(const dtFloat4 a, const dtFloat4 b) { return _mm_cmplt_ps(a, b); }
+inline dtMask4 dtGreaterEqual4(const dtFloat4 a, const dtFloat4 b) { return _mm_cmpge_ps(a, b); }
+inline dtMask4 dtLessEqual4(const dtFloat4 a, const dtFloat4 b) { return _mm_cmple_ps(a, b); }
+inline dtMask4 dtGreater4(const dtFloat4 a, const dtFloat4 b) { return _mm_cmpgt_ps(a, b); }
+inline dtMask4 dtAnd4(const dtMask4 a, const dtMask4 b) { return _mm_and_ps(a, b); }
+inline dtFloat4 dtSelect4(const dtMask4 m, const dtFloat4 a, const dtFloat4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+inline bool dtAll4(const dtMask4 m) { return _mm_movemask_ps(m) == 0xf; }
 
+#else
 
+// Without SIMD the sampled velocities are evaluated one by one,
+// so that each one uses the best penalty so far to bail out early.
+static const int DT_SAMPLE_BATCH = 1;
+
+#endif
 
 dtObstacleAvoidanceDebugData* dtAllocObstacleAvoidanceDebugData()
 {
@@ -191,6 +190,22 @@ void dtObstacleAvoidanceDebugData::normalizeSamples()
 }
 
 
+void dtInitObstacleAvoidanceParams(dtObstacleAvoidanceParams* params)
+{
+	memset(params, 0, sizeof(dtObstacleAvoidanceParams));
+	params->velBias = 0.4f;
+	params->weightDesVel = 2.0f;
+	params->weightCurVel = 0.75f;
+	params->weightSide = 0.75f;
+	params->weightToi = 2.5f;
+	params->horizTime = 2.5f;
+	params->gridSize = 33;
+	params->adaptiveDivs = 7;
+	params->adaptiveRings = 2;
+	params->adaptiveDepth = 5;
+	params->mode = DT_OBSTACLE_AVOIDANCE_ADAPTIVE;
+}
+
 dtObstacleAvoidanceQuery* dtAllocObstacleAvoidanceQuery()
 {
 	void* mem = dtAlloc(sizeof(dtObstacleAvoidanceQuery), DT_ALLOC_PERM);
@@ -215,7 +230,11 @@ dtObstacleAvoidanceQuery::dtObstacleAvoidanceQuery() :
 	m_ncircles(0),
 	m_maxSegments(0),
 	m_segments(0),
-	m_nsegments(0)
+	m_nsegments(0),
+	m_circleSoA(0),
+	m_segmentSoA(0),
+	m_lines(0),
+	m_projLines(0)
 {
 }
 
@@ -223,6 +242,10 @@ dtObstacleAvoidanceQuery::~dtObstacleAvoidanceQuery()
 {
 	dtFree(m_circles);
 	dtFree(m_segments);
+	dtFree(m_circleSoA);
+	dtFree(m_segmentSoA);
+	dtFree(m_lines);
+	dtFree(m_projLines);
 }
 
 bool dtObstacleAvoidanceQuery::init(const int maxCircles, const int maxSegments)
@@ -241,6 +264,21 @@ bool dtObstacleAvoidanceQuery::init(const int maxCircles, const int maxSegments)
 		return false;
 	memset(m_segments, 0, sizeof(dtObstacleSegment)*m_maxSegments);
 	
+	m_circleSoA = (float*)dtAlloc(sizeof(float)*DT_CIRCLE_SOA_SIZE*dtMax(m_maxCircles, 1), DT_ALLOC_PERM);
+	if (!m_circleSoA)
+		return false;
+	m_segmentSoA = (float*)dtAlloc(sizeof(float)*DT_SEGMENT_SOA_SIZE*dtMax(m_maxSegments, 1), DT_ALLOC_PERM);
+	if (!m_segmentSoA)
+		return false;
+	
+	const int maxLines = dtMax(m_maxCircles + m_maxSegments, 1);
+	m_lines = (dtObstacleLine*)dtAlloc(sizeof(dtObstacleLine)*maxLines, DT_ALLOC_PERM);
+	if (!m_lines)
+		return false;
+	m_projLines = (dtObstacleLine*)dtAlloc(sizeof(dtObstacleLine)*maxLines, DT_ALLOC_PERM);
+	if (!m_projLines)
+		return false;
+	
 	return true;
 }
 
@@ -273,8 +311,18 @@ void dtObstacleAvoidanceQuery::addSegment(const float* p, const float* q)
 	dtVcopy(seg->q, q);
 }
 
-void dtObstacleAvoidanceQuery::prepare(const float* pos, const float* dvel)
+void dtObstacleAvoidanceQuery::prepare(const float* pos, const float rad, const float* dvel)
 {
+	float* cvelx = m_circleSoA;
+	float* cvelz = cvelx + m_maxCircles;
+	float* cdpx = cvelz + m_maxCircles;
+	float* cdpz = cdpx + m_maxCircles;
+	float* cnpx = cdpz + m_maxCircles;
+	float* cnpz = cnpx + m_maxCircles;
+	float* csx = cnpz + m_maxCircles;
+	float* csz = csx + m_maxCircles;
+	float* cc = csz + m_maxCircles;
+	
 	// Prepare obstacles
 	for (int i = 0; i < m_ncircles; ++i)
 	{
@@ -301,8 +349,32 @@ void dtObstacleAvoidanceQuery::prepare(const float* pos, const float* dvel)
 			cir->np[0] = cir->dp[2];
 			cir->np[2] = -cir->dp[0];
 		}
+		
+		cvelx[i] = cir->vel[0];
+		cvelz[i] = cir->vel[2];
+		cdpx[i] = cir->dp[0];
+		cdpz[i] = cir->dp[2];
+		cnpx[i] = cir->np[0];
+		cnpz[i] = cir->np[2];
+		
+		// The parts of the circle sweep test which do not depend on the sampled velocity.
+		float s[3];
+		dtVsub(s, cir->p, pos);
+		const float r = rad + cir->rad;
+		csx[i] = s[0];
+		csz[i] = s[2];
+		cc[i] = dtVdot2D(s,s) - r*r;
 	}	
 
+	float* stouch = m_segmentSoA;
+	float* snormx = stouch + m_maxSegments;
+	float* snormz = snormx + m_maxSegments;
+	float* sdirx = snormz + m_maxSegments;
+	float* sdirz = sdirx + m_maxSegments;
+	float* swx = sdirz + m_maxSegments;
+	float* swz = swx + m_maxSegments;
+	float* sperp = swz + m_maxSegments;
+	
 	for (int i = 0; i < m_nsegments; ++i)
 	{
 		dtObstacleSegment* seg = &m_segments[i];
@@ -311,125 +383,308 @@ void dtObstacleAvoidanceQuery::prepare(const float* pos, const float* dvel)
 		const float r = 0.01f;
 		float t;
 		seg->touch = dtDistancePtSegSqr2D(pos, seg->p, seg->q, t) < dtSqr(r);
+		
+		float dir[3], w[3];
+		dtVsub(dir, seg->q, seg->p);
+		dtVsub(w, pos, seg->p);
+		stouch[i] = seg->touch ? 1.0f : 0.0f;
+		snormx[i] = -dir[2];
+		snormz[i] = dir[0];
+		sdirx[i] = dir[0];
+		sdirz[i] = dir[2];
+		swx[i] = w[0];
+		swz[i] = w[2];
+		sperp[i] = dtVperp2D(dir, w);
 	}	
 }
 
 
-/* Calculate the collision penalty for a given velocity vector
+/* Calculate the collision penalties for a batch of sampled velocities, and keep the best one.
  * 
- * @param vcand sampled velocity
+ * The candidates are evaluated in lockstep against each obstacle, and a candidate
+ * which cannot beat the current best penalty gets the best penalty instead.
+ * The result is the same as evaluating the candidates one by one.
+ *
+ * @param vcands sampled velocities [(x, y, z) * nvcands]
  * @param dvel desired velocity
- * @param minPenalty threshold penalty for early out
+ * @param minPenalty best penalty so far, used as the threshold for early out
+ * @param bestVel velocity with the best penalty so far
  */
-float dtObstacleAvoidanceQuery::processSample(const float* vcand, const float cs,
-											  const float* pos, const float rad,
+void dtObstacleAvoidanceQuery::processSamples(const float* vcands, const int nvcands, const float cs,
 											  const float* vel, const float* dvel,
-											  const float minPenalty,
+											  float& minPenalty, float* bestVel,
 											  dtObstacleAvoidanceDebugData* debug)
 {
-	// penalty for straying away from the desired and current velocities
-	const float vpen = m_params.weightDesVel * (dtVdist2D(vcand, dvel) * m_invVmax);
-	const float vcpen = m_params.weightCurVel * (dtVdist2D(vcand, vel) * m_invVmax);
-
-	// find the threshold hit time to bail out based on the early out penalty
-	// (see how the penalty is calculated below to understand)
-	float minPen = minPenalty - vpen - vcpen;
-	float tThresold = (m_params.weightToi / minPen - 0.1f) * m_params.horizTime;
-	if (tThresold - m_params.horizTime > -FLT_EPSILON)
-		return minPenalty; // already too much
-
-	// Find min time of impact and exit amongst all obstacles.
-	float tmin = m_params.horizTime;
-	float side = 0;
-	int nside = 0;
+	static const int N = DT_SAMPLE_BATCH;
+	dtAssert(nvcands > 0 && nvcands <= N);
 	
-	for (int i = 0; i < m_ncircles; ++i)
+	float vpen[N], vcpen[N], tThresold[N];
+	float vxs[N], vzs[N];
+	
+	for (int j = 0; j < N; ++j)
 	{
-		const dtObstacleCircle* cir = &m_circles[i];
-			
-		// RVO
-		float vab[3];
-		dtVscale(vab, vcand, 2);
-		dtVsub(vab, vab, vel);
-		dtVsub(vab, vab, cir->vel);
+		// Unused slots repeat the last candidate.
+		const float* vcand = &vcands[dtMin(j, nvcands-1)*3];
+		vxs[j] = vcand[0];
+		vzs[j] = vcand[2];
 		
-		// Side
-		side += dtClamp(dtMin(dtVdot2D(cir->dp,vab)*0.5f+0.5f, dtVdot2D(cir->np,vab)*2), 0.0f, 1.0f);
-		nside++;
+		// penalty for straying away from the desired and current velocities
+		vpen[j] = m_params.weightDesVel * (dtVdist2D(vcand, dvel) * m_invVmax);
+		vcpen[j] = m_params.weightCurVel * (dtVdist2D(vcand, vel) * m_invVmax);
 		
-		float htmin = 0, htmax = 0;
-		if (!sweepCircleCircle(pos,rad, vab, cir->p,cir->rad, htmin, htmax))
-			continue;
-		
-		// Handle overlapping obstacles.
-		if (htmin < 0.0f && htmax > 0.0f)
-		{
-			// Avoid more when overlapped.
-			htmin = -htmin * 0.5f;
-		}
+		// find the threshold hit time to bail out based on the early out penalty
+		// (see how the penalty is calculated below to understand)
+		const float minPen = minPenalty - vpen[j] - vcpen[j];
+		tThresold[j] = (m_params.weightToi / minPen - 0.1f) * m_params.horizTime;
+	}
+	
+	const float* cvelx = m_circleSoA;
+	const float* cvelz = cvelx + m_maxCircles;
+	const float* cdpx = cvelz + m_maxCircles;
+	const float* cdpz = cdpx + m_maxCircles;
+	const float* cnpx = cdpz + m_maxCircles;
+	const float* cnpz = cnpx + m_maxCircles;
+	const float* csx = cnpz + m_maxCircles;
+	const float* csz = csx + m_maxCircles;
+	const float* cc = csz + m_maxCircles;
+	
+	const float* stouch = m_segmentSoA;
+	const float* snormx = stouch + m_maxSegments;
+	const float* snormz = snormx + m_maxSegments;
+	const float* sdirx = snormz + m_maxSegments;
+	const float* sdirz = sdirx + m_maxSegments;
+	const float* swx = sdirz + m_maxSegments;
+	const float* swz = swx + m_maxSegments;
+	const float* sperp = swz + m_maxSegments;
+	
+	float tmins[N], sides[N];
+	
+#ifdef DT_OBSTACLE_AVOIDANCE_SSE
+	// Evaluate the candidates four at a time.
+	static const int NV = DT_SAMPLE_BATCH/4;
+	dtFloat4 vx[NV], vz[NV], thr[NV], tmin[NV], side[NV];
+	for (int k = 0; k < NV; ++k)
+	{
+		vx[k] = dtLoad4(&vxs[k*4]);
+		vz[k] = dtLoad4(&vzs[k*4]);
+		thr[k] = dtLoad4(&tThresold[k*4]);
+		tmin[k] = dtSet4(m_params.horizTime);
+		side[k] = dtSet4(0.0f);
+	}
+	
+	const dtFloat4 zero = dtSet4(0.0f);
+	const dtFloat4 one = dtSet4(1.0f);
+	const dtFloat4 two = dtSet4(2.0f);
+	const dtFloat4 half = dtSet4(0.5f);
+	const dtFloat4 velx = dtSet4(vel[0]);
+	const dtFloat4 velz = dtSet4(vel[2]);
+	
+	// Find min time of impact and exit amongst all obstacles.
+	// The hit time only decreases, once it is below the threshold the candidate is discarded.
+	for (int i = 0; i < m_ncircles; ++i)
+	{
+		const dtFloat4 dpx = dtSet4(cdpx[i]), dpz = dtSet4(cdpz[i]);
+		const dtFloat4 npx = dtSet4(cnpx[i]), npz = dtSet4(cnpz[i]);
+		const dtFloat4 sx = dtSet4(csx[i]), sz = dtSet4(csz[i]);
+		const dtFloat4 c = dtSet4(cc[i]);
 		
-		if (htmin >= 0.0f)
+		bool discarded = true;
+		for (int k = 0; k < NV; ++k)
 		{
+			// RVO
+			const dtFloat4 vabx = dtSub4(dtSub4(dtMul4(vx[k], two), velx), dtSet4(cvelx[i]));
+			const dtFloat4 vabz = dtSub4(dtSub4(dtMul4(vz[k], two), velz), dtSet4(cvelz[i]));
+			
+			// Side
+			const dtFloat4 sa = dtAdd4(dtMul4(dtAdd4(dtMul4(dpx, vabx), dtMul4(dpz, vabz)), half), half);
+			const dtFloat4 sb = dtMul4(dtAdd4(dtMul4(npx, vabx), dtMul4(npz, vabz)), two);
+			side[k] = dtAdd4(side[k], dtMax4(dtMin4(dtMin4(sa, sb), one), zero));
+			
+			// Sweep circle against circle.
+			const dtFloat4 a = dtAdd4(dtMul4(vabx, vabx), dtMul4(vabz, vabz));
+			const dtFloat4 b = dtAdd4(dtMul4(vabx, sx), dtMul4(vabz, sz));
+			const dtFloat4 d = dtSub4(dtMul4(b, b), dtMul4(a, c));
+			const dtMask4 hit = dtAnd4(dtGreaterEqual4(a, dtSet4(0.0001f)), dtGreaterEqual4(d, zero));
+			const dtFloat4 ia = dtDiv4(one, dtSelect4(hit, a, one));
+			const dtFloat4 rd = dtSqrt4(dtSelect4(hit, d, zero));
+			dtFloat4 htmin = dtMul4(dtSub4(b, rd), ia);
+			const dtFloat4 htmax = dtMul4(dtAdd4(b, rd), ia);
+			
+			// Handle overlapping obstacles, avoid more when overlapped.
+			const dtMask4 overlap = dtAnd4(dtLess4(htmin, zero), dtGreater4(htmax, zero));
+			htmin = dtSelect4(overlap, dtMul4(htmin, dtSet4(-0.5f)), htmin);
+			
 			// The closest obstacle is somewhere ahead of us, keep track of nearest obstacle.
-			if (htmin < tmin)
-			{
-				tmin = htmin;
-				if (tmin < tThresold)
-					return minPenalty;
-			}
+			const dtMask4 closer = dtAnd4(hit, dtAnd4(dtGreaterEqual4(htmin, zero), dtLess4(htmin, tmin[k])));
+			tmin[k] = dtSelect4(closer, htmin, tmin[k]);
+			
+			discarded = discarded && dtAll4(dtLess4(tmin[k], thr[k]));
 		}
+		if (discarded)
+			break;
 	}
 
 	for (int i = 0; i < m_nsegments; ++i)
 	{
-		const dtObstacleSegment* seg = &m_segments[i];
-		float htmin = 0;
-		
-		if (seg->touch)
+		bool discarded = true;
+		if (stouch[i] != 0.0f)
 		{
 			// Special case when the agent is very close to the segment.
-			float sdir[3], snorm[3];
-			dtVsub(sdir, seg->q, seg->p);
-			snorm[0] = -sdir[2];
-			snorm[2] = sdir[0];
-			// If the velocity is pointing towards the segment, no collision.
-			if (dtVdot2D(snorm, vcand) < 0.0f)
-				continue;
-			// Else immediate collision.
-			htmin = 0.0f;
+			const dtFloat4 nx = dtSet4(snormx[i]), nz = dtSet4(snormz[i]);
+			for (int k = 0; k < NV; ++k)
+			{
+				// If the velocity is pointing towards the segment, no collision.
+				// Else immediate collision.
+				const dtMask4 facing = dtGreaterEqual4(dtAdd4(dtMul4(nx, vx[k]), dtMul4(nz, vz[k])), zero);
+				tmin[k] = dtSelect4(facing, dtMin4(tmin[k], zero), tmin[k]);
+				discarded = discarded && dtAll4(dtLess4(tmin[k], thr[k]));
+			}
 		}
 		else
 		{
-			if (!isectRaySeg(pos, vcand, seg->p, seg->q, htmin))
-				continue;
+			const dtFloat4 dirx = dtSet4(sdirx[i]), dirz = dtSet4(sdirz[i]);
+			const dtFloat4 wx = dtSet4(swx[i]), wz = dtSet4(swz[i]);
+			const dtFloat4 perp = dtSet4(sperp[i]);
+			for (int k = 0; k < NV; ++k)
+			{
+				// Intersect the velocity ray against the segment.
+				const dtFloat4 d = dtSub4(dtMul4(vz[k], dirx), dtMul4(vx[k], dirz));
+				const dtMask4 valid = dtGreaterEqual4(dtAbs4(d), dtSet4(1e-6f));
+				const dtFloat4 id = dtDiv4(one, dtSelect4(valid, d, one));
+				const dtFloat4 t = dtMul4(perp, id);
+				const dtFloat4 s = dtMul4(dtSub4(dtMul4(vz[k], wx), dtMul4(vx[k], wz)), id);
+				const dtMask4 hit = dtAnd4(dtAnd4(valid, dtAnd4(dtGreaterEqual4(t, zero), dtLessEqual4(t, one))),
+										   dtAnd4(dtGreaterEqual4(s, zero), dtLessEqual4(s, one)));
+				
+				// Avoid less when facing walls.
+				const dtFloat4 htmin = dtMul4(t, two);
+				
+				// The closest obstacle is somewhere ahead of us, keep track of nearest obstacle.
+				tmin[k] = dtSelect4(dtAnd4(hit, dtLess4(htmin, tmin[k])), htmin, tmin[k]);
+				discarded = discarded && dtAll4(dtLess4(tmin[k], thr[k]));
+			}
 		}
+		if (discarded)
+			break;
+	}
+	
+	for (int k = 0; k < NV; ++k)
+	{
+		dtStore4(&tmins[k*4], tmin[k]);
+		dtStore4(&sides[k*4], side[k]);
+	}
+#else
+	for (int j = 0; j < nvcands; ++j)
+	{
+		const float vx = vxs[j];
+		const float vz = vzs[j];
+		float tmin = m_params.horizTime;
+		float side = 0;
+		tmins[j] = tmin;
+		sides[j] = side;
 		
-		// Avoid less when facing walls.
-		htmin *= 2.0f;
+		// Already too much.
+		if (tThresold[j] - m_params.horizTime > -FLT_EPSILON)
+			continue;
+		
+		// Find min time of impact and exit amongst all obstacles.
+		for (int i = 0; i < m_ncircles && tmin >= tThresold[j]; ++i)
+		{
+			// RVO
+			const float vabx = vx*2 - vel[0] - cvelx[i];
+			const float vabz = vz*2 - vel[2] - cvelz[i];
+			
+			// Side
+			side += dtClamp(dtMin((cdpx[i]*vabx + cdpz[i]*vabz)*0.5f+0.5f, (cnpx[i]*vabx + cnpz[i]*vabz)*2), 0.0f, 1.0f);
+			
+			// Sweep circle against circle.
+			static const float EPS = 0.0001f;
+			const float a = vabx*vabx + vabz*vabz;
+			if (a < EPS) continue;	// not moving
+			const float b = vabx*csx[i] + vabz*csz[i];
+			const float d = b*b - a*cc[i];
+			if (d < 0.0f) continue; // no intersection.
+			const float ia = 1.0f / a;
+			const float rd = dtMathSqrtf(d);
+			float htmin = (b - rd) * ia;
+			const float htmax = (b + rd) * ia;
+			
+			// Handle overlapping obstacles.
+			if (htmin < 0.0f && htmax > 0.0f)
+			{
+				// Avoid more when overlapped.
+				htmin = -htmin * 0.5f;
+			}
+			
+			// The closest obstacle is somewhere ahead of us, keep track of nearest obstacle.
+			if (htmin >= 0.0f && htmin < tmin)
+				tmin = htmin;
+		}
 		
-		// The closest obstacle is somewhere ahead of us, keep track of nearest obstacle.
-		if (htmin < tmin)
+		for (int i = 0; i < m_nsegments && tmin >= tThresold[j]; ++i)
 		{
-			tmin = htmin;
-			if (tmin < tThresold)
-				return minPenalty;
+			float htmin = 0;
+			if (stouch[i] != 0.0f)
+			{
+				// Special case when the agent is very close to the segment.
+				// If the velocity is pointing towards the segment, no collision.
+				if (snormx[i]*vx + snormz[i]*vz < 0.0f)
+					continue;
+				// Else immediate collision.
+				htmin = 0.0f;
+			}
+			else
+			{
+				// Intersect the velocity ray against the segment.
+				float d = vz*sdirx[i] - vx*sdirz[i];
+				if (dtMathFabsf(d) < 1e-6f) continue;
+				d = 1.0f/d;
+				const float t = sperp[i] * d;
+				if (t < 0 || t > 1) continue;
+				const float s = (vz*swx[i] - vx*swz[i]) * d;
+				if (s < 0 || s > 1) continue;
+				htmin = t;
+			}
+			
+			// Avoid less when facing walls.
+			htmin *= 2.0f;
+			
+			// The closest obstacle is somewhere ahead of us, keep track of nearest obstacle.
+			if (htmin < tmin)
+				tmin = htmin;
 		}
+		
+		tmins[j] = tmin;
+		sides[j] = side;
 	}
+#endif
 	
-	// Normalize side bias, to prevent it dominating too much.
-	if (nside)
-		side /= nside;
-	
-	const float spen = m_params.weightSide * side;
-	const float tpen = m_params.weightToi * (1.0f/(0.1f+tmin*m_invHorizTime));
-	
-	const float penalty = vpen + vcpen + spen + tpen;
-	
-	// Store different penalties for debug viewing
-	if (debug)
-		debug->addSample(vcand, cs, penalty, vpen, vcpen, spen, tpen);
-	
-	return penalty;
+	for (int j = 0; j < nvcands; ++j)
+	{
+		// Already too much.
+		if (tThresold[j] - m_params.horizTime > -FLT_EPSILON || tmins[j] < tThresold[j])
+			continue;
+		
+		// Normalize side bias, to prevent it dominating too much.
+		float sideBias = sides[j];
+		if (m_ncircles)
+			sideBias /= m_ncircles;
+		
+		const float spen = m_params.weightSide * sideBias;
+		const float tpen = m_params.weightToi * (1.0f/(0.1f+tmins[j]*m_invHorizTime));
+		
+		const float penalty = vpen[j] + vcpen[j] + spen + tpen;
+		
+		// Store different penalties for debug viewing
+		if (debug)
+			debug->addSample(&vcands[j*3], cs, penalty, vpen[j], vcpen[j], spen, tpen);
+		
+		if (penalty < minPenalty)
+		{
+			minPenalty = penalty;
+			dtVcopy(bestVel, &vcands[j*3]);
+		}
+	}
 }
 
 int dtObstacleAvoidanceQuery::sampleVelocityGrid(const float* pos, const float rad, const float vmax,
@@ -437,7 +692,7 @@ int dtObstacleAvoidanceQuery::sampleVelocityGrid(const float* pos, const float r
 												 const dtObstacleAvoidanceParams* params,
 												 dtObstacleAvoidanceDebugData* debug)
 {
-	prepare(pos, dvel);
+	prepare(pos, rad, dvel);
 	
 	memcpy(&m_params, params, sizeof(dtObstacleAvoidanceParams));
 	m_invHorizTime = 1.0f / m_params.horizTime;
@@ -456,27 +711,35 @@ int dtObstacleAvoidanceQuery::sampleVelocityGrid(const float* pos, const float r
 		
 	float minPenalty = FLT_MAX;
 	int ns = 0;
+	
+	float vcands[DT_SAMPLE_BATCH*3];
+	int nvcands = 0;
 		
 	for (int y = 0; y < m_params.gridSize; ++y)
 	{
 		for (int x = 0; x < m_params.gridSize; ++x)
 		{
-			float vcand[3];
+			float* vcand = &vcands[nvcands*3];
 			vcand[0] = cvx + x*cs - half;
 			vcand[1] = 0;
 			vcand[2] = cvz + y*cs - half;
 			
 			if (dtSqr(vcand[0])+dtSqr(vcand[2]) > dtSqr(vmax+cs/2)) continue;
 			
-			const float penalty = processSample(vcand, cs, pos,rad,vel,dvel, minPenalty, debug);
-			ns++;
-			if (penalty < minPenalty)
+			nvcands++;
+			if (nvcands == DT_SAMPLE_BATCH)
 			{
-				minPenalty = penalty;
-				dtVcopy(nvel, vcand);
+				processSamples(vcands, nvcands, cs, vel, dvel, minPenalty, nvel, debug);
+				ns += nvcands;
+				nvcands = 0;
 			}
 		}
 	}
+	if (nvcands > 0)
+	{
+		processSamples(vcands, nvcands, cs, vel, dvel, minPenalty, nvel, debug);
+		ns += nvcands;
+	}
 	
 	return ns;
 }
@@ -509,7 +772,7 @@ int dtObstacleAvoidanceQuery::sampleVelocityAdaptive(const float* pos, const flo
 													 const dtObstacleAvoidanceParams* params,
 													 dtObstacleAvoidanceDebugData* debug)
 {
-	prepare(pos, dvel);
+	prepare(pos, rad, dvel);
 	
 	memcpy(&m_params, params, sizeof(dtObstacleAvoidanceParams));
 	m_invHorizTime = 1.0f / m_params.horizTime;
@@ -590,23 +853,31 @@ int dtObstacleAvoidanceQuery::sampleVelocityAdaptive(const float* pos, const flo
 		float bvel[3];
 		dtVset(bvel, 0,0,0);
 		
+		float vcands[DT_SAMPLE_BATCH*3];
+		int nvcands = 0;
+		
 		for (int i = 0; i < npat; ++i)
 		{
-			float vcand[3];
+			float* vcand = &vcands[nvcands*3];
 			vcand[0] = res[0] + pat[i*2+0]*cr;
 			vcand[1] = 0;
 			vcand[2] = res[2] + pat[i*2+1]*cr;
 			
 			if (dtSqr(vcand[0])+dtSqr(vcand[2]) > dtSqr(vmax+0.001f)) continue;
 			
-			const float penalty = processSample(vcand,cr/10, pos,rad,vel,dvel, minPenalty, debug);
-			ns++;
-			if (penalty < minPenalty)
+			nvcands++;
+			if (nvcands == DT_SAMPLE_BATCH)
 			{
-				minPenalty = penalty;
-				dtVcopy(bvel, vcand);
+				processSamples(vcands, nvcands, cr/10, vel, dvel, minPenalty, bvel, debug);
+				ns += nvcands;
+				nvcands = 0;
 			}
 		}
+		if (nvcands > 0)
+		{
+			processSamples(vcands, nvcands, cr/10, vel, dvel, minPenalty, bvel, debug);
+			ns += nvcands;
+		}
 
 		dtVcopy(res, bvel);
 
@@ -617,3 +888,348 @@ int dtObstacleAvoidanceQuery::sampleVelocityAdaptive(const float* pos, const flo
 	
 	return ns;
 }
+
+
+// The ORCA half-planes and the linear programs solving them follow RVO2 by van den Berg et al.
+// All vectors are 2D (x, z).
+
+static const float DT_ORCA_EPS = 0.00001f;
+
+inline float dtDet2(const float* a, const float* b)
+{
+	return a[0]*b[1] - a[1]*b[0];
+}
+
+inline float dtDot2(const float* a, const float* b)
+{
+	return a[0]*b[0] + a[1]*b[1];
+}
+
+// Returns how far the velocity is on the forbidden side of the line.
+inline float dtLineViolation(const dtObstacleLine& line, const float* v)
+{
+	const float d[2] = { line.point[0] - v[0], line.point[1] - v[1] };
+	return dtDet2(line.dir, d);
+}
+
+// Builds the half-plane of velocities which do not collide with an obstacle within the time horizon.
+//  @param relPos position of the obstacle relative to the agent
+//  @param relVel velocity of the agent relative to the obstacle
+//  @param responsibility share of the avoidance taken by the agent, 0.5 for reciprocal avoidance
+static void buildORCALine(dtObstacleLine& line, const float* vel, const float* relPos, const float* relVel,
+						  const float combinedRadius, const float invHorizTime, const float invTimeStep,
+						  const float responsibility)
+{
+	const float distSqr = dtDot2(relPos, relPos);
+	const float combinedRadiusSqr = dtSqr(combinedRadius);
+	float u[2];
+	
+	if (distSqr > combinedRadiusSqr)
+	{
+		// No collision. Vector from the cutoff center to the relative velocity.
+		const float w[2] = { relVel[0] - invHorizTime*relPos[0], relVel[1] - invHorizTime*relPos[1] };
+		const float wLenSqr = dtDot2(w, w);
+		const float dot1 = dtDot2(w, relPos);
+		
+		if (dot1 < 0.0f && dtSqr(dot1) > combinedRadiusSqr*wLenSqr)
+		{
+			// Project on the cutoff circle.
+			const float wLen = dtMathSqrtf(wLenSqr);
+			const float unitW[2] = { w[0]/wLen, w[1]/wLen };
+			line.dir[0] = unitW[1];
+			line.dir[1] = -unitW[0];
+			u[0] = (combinedRadius*invHorizTime - wLen) * unitW[0];
+			u[1] = (combinedRadius*invHorizTime - wLen) * unitW[1];
+		}
+		else
+		{
+			// Project on the legs.
+			const float leg = dtMathSqrtf(distSqr - combinedRadiusSqr);
+			if (dtDet2(relPos, w) > 0.0f)
+			{
+				// Left leg.
+				line.dir[0] = (relPos[0]*leg - relPos[1]*combinedRadius) / distSqr;
+				line.dir[1] = (relPos[0]*combinedRadius + relPos[1]*leg) / distSqr;
+			}
+			else
+			{
+				// Right leg.
+				line.dir[0] = -(relPos[0]*leg + relPos[1]*combinedRadius) / distSqr;
+				line.dir[1] = -(-relPos[0]*combinedRadius + relPos[1]*leg) / distSqr;
+			}
+			const float dot2 = dtDot2(relVel, line.dir);
+			u[0] = dot2*line.dir[0] - relVel[0];
+			u[1] = dot2*line.dir[1] - relVel[1];
+		}
+	}
+	else
+	{
+		// Collision. Project on the cutoff circle of the time step, to separate during the next step.
+		const float w[2] = { relVel[0] - invTimeStep*relPos[0], relVel[1] - invTimeStep*relPos[1] };
+		const float wLen = dtMathSqrtf(dtDot2(w, w));
+		if (wLen < DT_ORCA_EPS)
+		{
+			// Exactly on top of each other, any direction will do.
+			line.dir[0] = 1.0f;
+			line.dir[1] = 0.0f;
+			u[0] = 0.0f;
+			u[1] = combinedRadius*invTimeStep;
+		}
+		else
+		{
+			const float unitW[2] = { w[0]/wLen, w[1]/wLen };
+			line.dir[0] = unitW[1];
+			line.dir[1] = -unitW[0];
+			u[0] = (combinedRadius*invTimeStep - wLen) * unitW[0];
+			u[1] = (combinedRadius*invTimeStep - wLen) * unitW[1];
+		}
+	}
+	
+	line.point[0] = vel[0] + responsibility*u[0];
+	line.point[1] = vel[1] + responsibility*u[1];
+}
+
+// Finds the velocity on the line closest to the optimal velocity, within the previous lines and the speed limit.
+static bool linearProgram1(const dtObstacleLine* lines, const int lineNo, const float radius,
+						   const float* optVel, const bool directionOpt, float* result)
+{
+	const dtObstacleLine& line = lines[lineNo];
+	const float dot = dtDot2(line.point, line.dir);
+	const float discriminant = dtSqr(dot) + dtSqr(radius) - dtDot2(line.point, line.point);
+	
+	// Max speed circle fully invalidates the line.
+	if (discriminant < 0.0f)
+		return false;
+	
+	const float sqrtDiscriminant = dtMathSqrtf(discriminant);
+	float tLeft = -dot - sqrtDiscriminant;
+	float tRight = -dot + sqrtDiscriminant;
+	
+	for (int i = 0; i < lineNo; ++i)
+	{
+		const float denominator = dtDet2(line.dir, lines[i].dir);
+		const float d[2] = { line.point[0] - lines[i].point[0], line.point[1] - lines[i].point[1] };
+		const float numerator = dtDet2(lines[i].dir, d);
+		
+		if (dtMathFabsf(denominator) <= DT_ORCA_EPS)
+		{
+			// The lines are parallel.
+			if (numerator < 0.0f)
+				return false;
+			continue;
+		}
+		
+		const float t = numerator / denominator;
+		if (denominator >= 0.0f)
+			tRight = dtMin(tRight, t);	// Line i bounds line lineNo on the right.
+		else
+			tLeft = dtMax(tLeft, t);	// Line i bounds line lineNo on the left.
+		
+		if (tLeft > tRight)
+			return false;
+	}
+	
+	float t;
+	if (directionOpt)
+	{
+		// Optimize direction.
+		t = dtDot2(optVel, line.dir) > 0.0f ? tRight : tLeft;
+	}
+	else
+	{
+		// Optimize closest point.
+		const float d[2] = { optVel[0] - line.point[0], optVel[1] - line.point[1] };
+		t = dtClamp(dtDot2(line.dir, d), tLeft, tRight);
+	}
+	result[0] = line.point[0] + t*line.dir[0];
+	result[1] = line.point[1] + t*line.dir[1];
+	
+	return true;
+}
+
+// Finds the velocity closest to the optimal velocity which satisfies all the lines.
+// Returns the number of lines if successful, otherwise the line which failed.
+static int linearProgram2(const dtObstacleLine* lines, const int nlines, const float radius,
+						  const float* optVel, const bool directionOpt, float* result)
+{
+	if (directionOpt)
+	{
+		// Optimize direction. Note that the optimization velocity is of unit length in this case.
+		result[0] = optVel[0] * radius;
+		result[1] = optVel[1] * radius;
+	}
+	else if (dtDot2(optVel, optVel) > dtSqr(radius))
+	{
+		// Optimize closest point and outside circle.
+		const float len = dtMathSqrtf(dtDot2(optVel, optVel));
+		result[0] = optVel[0] / len * radius;
+		result[1] = optVel[1] / len * radius;
+	}
+	else
+	{
+		// Optimize closest point and inside circle.
+		result[0] = optVel[0];
+		result[1] = optVel[1];
+	}
+	
+	for (int i = 0; i < nlines; ++i)
+	{
+		if (dtLineViolation(lines[i], result) > 0.0f)
+		{
+			// Result does not satisfy constraint i. Compute new optimal result.
+			const float prev[2] = { result[0], result[1] };
+			if (!linearProgram1(lines, i, radius, optVel, directionOpt, result))
+			{
+				result[0] = prev[0];
+				result[1] = prev[1];
+				return i;
+			}
+		}
+	}
+	
+	return nlines;
+}
+
+// Finds the velocity which minimizes the maximum violation of the agent lines,
+// when there is no velocity satisfying all of them. The obstacle lines are kept as hard constraints.
+static void linearProgram3(const dtObstacleLine* lines, const int nlines, const int nobstLines, const int beginLine,
+						   const float radius, dtObstacleLine* projLines, float* result)
+{
+	float distance = 0.0f;
+	
+	for (int i = beginLine; i < nlines; ++i)
+	{
+		if (dtLineViolation(lines[i], result) <= distance)
+			continue;
+		
+		// Result does not satisfy constraint of line i.
+		int nproj = 0;
+		for (int j = 0; j < nobstLines; ++j)
+			projLines[nproj++] = lines[j];
+		
+		for (int j = nobstLines; j < i; ++j)
+		{
+			dtObstacleLine line;
+			const float determinant = dtDet2(lines[i].dir, lines[j].dir);
+			
+			if (dtMathFabsf(determinant) <= DT_ORCA_EPS)
+			{
+				// Line i and line j are parallel.
+				if (dtDot2(lines[i].dir, lines[j].dir) > 0.0f)
+				{
+					// Line i and line j point in the same direction.
+					continue;
+				}
+				// Line i and line j point in opposite direction.
+				line.point[0] = 0.5f * (lines[i].point[0] + lines[j].point[0]);
+				line.point[1] = 0.5f * (lines[i].point[1] + lines[j].point[1]);
+			}
+			else
+			{
+				const float d[2] = { lines[i].point[0] - lines[j].point[0], lines[i].point[1] - lines[j].point[1] };
+				const float t = dtDet2(lines[j].dir, d) / determinant;
+				line.point[0] = lines[i].point[0] + t*lines[i].dir[0];
+				line.point[1] = lines[i].point[1] + t*lines[i].dir[1];
+			}
+			
+			line.dir[0] = lines[j].dir[0] - lines[i].dir[0];
+			line.dir[1] = lines[j].dir[1] - lines[i].dir[1];
+			const float len = dtMathSqrtf(dtDot2(line.dir, line.dir));
+			if (len > DT_ORCA_EPS)
+			{
+				line.dir[0] /= len;
+				line.dir[1] /= len;
+			}
+			projLines[nproj++] = line;
+		}
+		
+		const float prev[2] = { result[0], result[1] };
+		const float optDir[2] = { -lines[i].dir[1], lines[i].dir[0] };
+		if (linearProgram2(projLines, nproj, radius, optDir, true, result) < nproj)
+		{
+			// This should in principle not happen. The result is by definition already
+			// in the feasible region of this linear program. If it fails, it is due to
+			// small floating point error, and the current result is kept.
+			result[0] = prev[0];
+			result[1] = prev[1];
+		}
+		
+		distance = dtLineViolation(lines[i], result);
+	}
+}
+
+int dtObstacleAvoidanceQuery::computeVelocityORCA(const float* pos, const float rad, const float vmax,
+												  const float* vel, const float* dvel, float* nvel,
+												  const float dt, const dtObstacleAvoidanceParams* params,
+												  dtObstacleAvoidanceDebugData* debug)
+{
+	dtAssert(dt > 0.0f);
+	
+	if (debug)
+		debug->reset();
+	
+	const float invHorizTime = 1.0f / params->horizTime;
+	const float invTimeStep = 1.0f / dt;
+	const float vel2[2] = { vel[0], vel[2] };
+	int nlines = 0;
+	
+	// The navmesh already keeps the agent away from the walls, the segments only prevent
+	// the agent from crossing them during the next time step. Their lines come first,
+	// so that they are kept when the problem is infeasible.
+	for (int i = 0; i < m_nsegments; ++i)
+	{
+		const dtObstacleSegment* seg = &m_segments[i];
+		float t;
+		const float distSqr = dtDistancePtSegSqr2D(pos, seg->p, seg->q, t);
+		
+		// Normal pointing away from the segment.
+		float n[2];
+		float dist = 0.0f;
+		if (distSqr > dtSqr(0.01f))
+		{
+			dist = dtMathSqrtf(distSqr);
+			n[0] = (pos[0] - (seg->p[0] + (seg->q[0]-seg->p[0])*t)) / dist;
+			n[1] = (pos[2] - (seg->p[2] + (seg->q[2]-seg->p[2])*t)) / dist;
+		}
+		else
+		{
+			// Touching the segment, use the segment normal on the side of the agent.
+			const float d[2] = { seg->q[0]-seg->p[0], seg->q[2]-seg->p[2] };
+			const float len = dtMathSqrtf(dtDot2(d, d));
+			if (len < DT_ORCA_EPS)
+				continue;
+			n[0] = d[1] / len;
+			n[1] = -d[0] / len;
+		}
+		
+		// The velocity towards the segment is limited to the distance covered in one step.
+		dtObstacleLine& line = m_lines[nlines++];
+		line.point[0] = -n[0] * dist * invTimeStep;
+		line.point[1] = -n[1] * dist * invTimeStep;
+		line.dir[0] = n[1];
+		line.dir[1] = -n[0];
+	}
+	const int nobstLines = nlines;
+	
+	// Other agents avoid this agent too, each one takes half of the responsibility.
+	for (int i = 0; i < m_ncircles; ++i)
+	{
+		const dtObstacleCircle* cir = &m_circles[i];
+		const float relPos[2] = { cir->p[0] - pos[0], cir->p[2] - pos[2] };
+		const float relVel[2] = { vel[0] - cir->vel[0], vel[2] - cir->vel[2] };
+		buildORCALine(m_lines[nlines++], vel2, relPos, relVel, rad + cir->rad, invHorizTime, invTimeStep, 0.5f);
+	}
+	
+	const float optVel[2] = { dvel[0], dvel[2] };
+	float result[2];
+	const int lineFail = linearProgram2(m_lines, nlines, vmax, optVel, false, result);
+	if (lineFail < nlines)
+		linearProgram3(m_lines, nlines, nobstLines, lineFail, vmax, m_projLines, result);
+	
+	dtVset(nvel, result[0], 0.0f, result[1]);
+	
+	if (debug)
+		debug->addSample(nvel, vmax*0.1f, 0, 0, 0, 0, 0);
+	
+	return nlines;
+}
@@ -21,17 +21,30 @@
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourAlloc.h"
+#include "DetourAtomic.h"
 #include "DetourCommon.h"
 
+// The owner of a request. The thread calling request() fills free requests and
+// reads finished ones, the thread calling update() searches the pending ones.
+// Changing the owner publishes the request to the other thread.
+enum PathQueryOwner
+{
+	DT_PATHQ_FREE = 0,
+	DT_PATHQ_PENDING,
+	DT_PATHQ_DONE
+};
+
+static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+
 
 dtPathQueue::dtPathQueue() :
+	m_queue(0),
+	m_maxQueue(0),
 	m_nextHandle(1),
 	m_maxPathSize(0),
-	m_queueHead(0),
+	m_activeQuery(-1),
 	m_navquery(0)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-		m_queue[i].path = 0;
 }
 
 dtPathQueue::~dtPathQueue()
@@ -43,76 +56,111 @@ void dtPathQueue::purge()
 {
 	dtFreeNavMeshQuery(m_navquery);
 	m_navquery = 0;
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
+	for (int i = 0; i < m_maxQueue; ++i)
 		dtFree(m_queue[i].path);
-		m_queue[i].path = 0;
-	}
+	dtFree(m_queue);
+	m_queue = 0;
+	m_maxQueue = 0;
+	m_activeQuery = -1;
 }
 
-bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav)
+bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, const dtNavMesh* nav, const int maxRequests)
 {
 	purge();
 
+	if (maxRequests < 1)
+		return false;
+
 	m_navquery = dtAllocNavMeshQuery();
 	if (!m_navquery)
 		return false;
 	if (dtStatusFailed(m_navquery->init(nav, maxSearchNodeCount)))
 		return false;
 	
+	m_queue = (PathQuery*)dtAlloc(sizeof(PathQuery)*maxRequests, DT_ALLOC_PERM);
+	if (!m_queue)
+		return false;
+	memset(m_queue, 0, sizeof(PathQuery)*maxRequests);
+	m_maxQueue = maxRequests;
+	
 	m_maxPathSize = maxPathSize;
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	for (int i = 0; i < m_maxQueue; ++i)
 	{
 		m_queue[i].ref = DT_PATHQ_INVALID;
+		m_queue[i].owner = DT_PATHQ_FREE;
 		m_queue[i].path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPathSize, DT_ALLOC_PERM);
 		if (!m_queue[i].path)
 			return false;
 	}
 	
-	m_queueHead = 0;
+	m_activeQuery = -1;
 	
 	return true;
 }
 
+int dtPathQueue::getMemUsed() const
+{
+	int mem = sizeof(*this) + sizeof(PathQuery)*m_maxQueue;
+	for (int i = 0; i < m_maxQueue; ++i)
+	{
+		if (m_queue[i].path)
+			mem += sizeof(dtPolyRef)*m_maxPathSize;
+	}
+	if (m_navquery)
+	{
+		dtNavMeshQueryMemoryUsage usage;
+		m_navquery->getMemoryUsage(&usage);
+		mem += (int)usage.total;
+	}
+	return mem;
+}
+
 void dtPathQueue::update(const int maxIters)
 {
-	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+	// Age the finished requests, the unread ones are freed by request() once they expire.
+	for (int i = 0; i < m_maxQueue; ++i)
+	{
+		PathQuery& q = m_queue[i];
+		if (dtAtomicLoad(&q.owner) == DT_PATHQ_DONE && q.keepAlive <= MAX_KEEP_ALIVE)
+			dtAtomicStore(&q.keepAlive, q.keepAlive+1);
+	}
 
 	// Update path request until there is nothing to update
 	// or upto maxIters pathfinder iterations has been consumed.
 	int iterCount = maxIters;
 	
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	while (iterCount > 0)
 	{
-		PathQuery& q = m_queue[m_queueHead % MAX_QUEUE];
-		
-		// Skip inactive requests.
-		if (q.ref == DT_PATHQ_INVALID)
-		{
-			m_queueHead++;
-			continue;
-		}
-		
-		// Handle completed request.
-		if (dtStatusSucceed(q.status) || dtStatusFailed(q.status))
+		// Pick the next request, the one in progress is finished first.
+		if (m_activeQuery == -1)
 		{
-			// If the path result has not been read in few frames, free the slot.
-			q.keepAlive++;
-			if (q.keepAlive > MAX_KEEP_ALIVE)
+			for (int i = 0; i < m_maxQueue; ++i)
 			{
-				q.ref = DT_PATHQ_INVALID;
-				q.status = 0;
+				const PathQuery& q = m_queue[i];
+				if (dtAtomicLoad(&q.owner) != DT_PATHQ_PENDING)
+					continue;
+				if (m_activeQuery == -1)
+				{
+					m_activeQuery = i;
+					continue;
+				}
+				// Higher priority first, then older requests first.
+				const PathQuery& best = m_queue[m_activeQuery];
+				if (q.priority > best.priority ||
+					(q.priority == best.priority && (int)(q.ref - best.ref) < 0))
+					m_activeQuery = i;
 			}
+			if (m_activeQuery == -1)
+				break;
 			
-			m_queueHead++;
-			continue;
+			// Handle query start.
+			PathQuery& q = m_queue[m_activeQuery];
+			q.npath = 0;
+			q.status = m_navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
 		}
 		
-		// Handle query start.
-		if (q.status == 0)
-		{
-			q.status = m_navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
-		}		
+		PathQuery& q = m_queue[m_activeQuery];
+		
 		// Handle query in progress.
 		if (dtStatusInProgress(q.status))
 		{
@@ -124,23 +172,28 @@ void dtPathQueue::update(const int maxIters)
 		{
 			q.status = m_navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
 		}
-
-		if (iterCount <= 0)
-			break;
-
-		m_queueHead++;
+		
+		// Handle completed request.
+		if (!dtStatusInProgress(q.status))
+		{
+			q.keepAlive = 0;
+			dtAtomicStore(&q.owner, (int)DT_PATHQ_DONE);
+			m_activeQuery = -1;
+		}
 	}
 }
 
 dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
 									const float* startPos, const float* endPos,
-									const dtQueryFilter* filter)
+									const dtQueryFilter* filter, const float priority)
 {
-	// Find empty slot
+	// Find empty slot, or a result which has not been read in few updates.
 	int slot = -1;
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	for (int i = 0; i < m_maxQueue; ++i)
 	{
-		if (m_queue[i].ref == DT_PATHQ_INVALID)
+		const int owner = dtAtomicLoad(&m_queue[i].owner);
+		if (owner == DT_PATHQ_FREE ||
+			(owner == DT_PATHQ_DONE && dtAtomicLoad(&m_queue[i].keepAlive) > MAX_KEEP_ALIVE))
 		{
 			slot = i;
 			break;
@@ -159,42 +212,64 @@ dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
 	q.startRef = startRef;
 	dtVcopy(q.endPos, endPos);
 	q.endRef = endRef;
+	q.priority = priority;
 	
 	q.status = 0;
 	q.npath = 0;
 	q.filter = filter;
-	q.keepAlive = 0;
+	
+	dtAtomicStore(&q.owner, (int)DT_PATHQ_PENDING);
 	
 	return ref;
 }
 
 dtStatus dtPathQueue::getRequestStatus(dtPathQueueRef ref) const
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	for (int i = 0; i < m_maxQueue; ++i)
 	{
 		if (m_queue[i].ref == ref)
-			return m_queue[i].status;
+		{
+			const int owner = dtAtomicLoad(&m_queue[i].owner);
+			if (owner == DT_PATHQ_PENDING)
+				return DT_IN_PROGRESS;
+			if (owner == DT_PATHQ_DONE)
+				return m_queue[i].status;
+			return DT_FAILURE;
+		}
 	}
 	return DT_FAILURE;
 }
 
 dtStatus dtPathQueue::getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	for (int i = 0; i < m_maxQueue; ++i)
 	{
 		if (m_queue[i].ref == ref)
 		{
 			PathQuery& q = m_queue[i];
+			if (dtAtomicLoad(&q.owner) != DT_PATHQ_DONE)
+				return DT_FAILURE;
 			dtStatus details = q.status & DT_STATUS_DETAIL_MASK;
-			// Free request for reuse.
-			q.ref = DT_PATHQ_INVALID;
-			q.status = 0;
 			// Copy path
 			int n = dtMin(q.npath, maxPath);
 			memcpy(path, q.path, sizeof(dtPolyRef)*n);
 			*pathSize = n;
+			// Free request for reuse.
+			q.ref = DT_PATHQ_INVALID;
+			dtAtomicStore(&q.owner, (int)DT_PATHQ_FREE);
 			return details | DT_SUCCESS;
 		}
 	}
 	return DT_FAILURE;
 }
+
+int dtPathQueue::getPendingRequestCount() const
+{
+	int n = 0;
+	for (int i = 0; i < m_maxQueue; ++i)
+	{
+		if (dtAtomicLoad(&m_queue[i].owner) == DT_PATHQ_PENDING)
+			n++;
+	}
+	return n;
+}
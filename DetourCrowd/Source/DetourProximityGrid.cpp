@@ -46,44 +46,78 @@ inline int hashPos2(int x, int y, int n)
 }
 
 
+dtProximityQuery::~dtProximityQuery()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+
 dtProximityGrid::dtProximityGrid() :
 	m_cellSize(0),
 	m_invCellSize(0),
-	m_pool(0),
-	m_poolHead(0),
-	m_poolSize(0),
+	m_maxItems(0),
+	m_itemCount(0),
+	m_addedIds(0),
+	m_addedBounds(0),
+	m_ids(0),
+	m_cells(0),
+	m_bounds(0),
+	m_slots(0),
 	m_buckets(0),
-	m_bucketsSize(0)
+	m_bucketsSize(0),
+	m_maxExtent(0),
+	m_built(false)
 {
 }
 
 dtProximityGrid::~dtProximityGrid()
 {
 	dtFree(m_buckets);
-	dtFree(m_pool);
+	dtFree(m_slots);
+	dtFree(m_bounds);
+	dtFree(m_cells);
+	dtFree(m_ids);
+	dtFree(m_addedBounds);
+	dtFree(m_addedIds);
 }
 
-bool dtProximityGrid::init(const int poolSize, const float cellSize)
+bool dtProximityGrid::init(const int maxItems, const float cellSize)
 {
-	dtAssert(poolSize > 0);
+	dtAssert(maxItems > 0);
 	dtAssert(cellSize > 0.0f);
 	
 	m_cellSize = cellSize;
 	m_invCellSize = 1.0f / m_cellSize;
 	
-	// Allocate hashs buckets
-	m_bucketsSize = dtNextPow2(poolSize);
-	m_buckets = (unsigned short*)dtAlloc(sizeof(unsigned short)*m_bucketsSize, DT_ALLOC_PERM);
+	// Allocate hash buckets, one more to mark the end of the last bucket.
+	m_bucketsSize = dtNextPow2(maxItems);
+	m_buckets = (int*)dtAlloc(sizeof(int)*(m_bucketsSize+1), DT_ALLOC_PERM);
 	if (!m_buckets)
 		return false;
 	
-	// Allocate pool of items.
-	m_poolSize = poolSize;
-	m_poolHead = 0;
-	m_pool = (Item*)dtAlloc(sizeof(Item)*m_poolSize, DT_ALLOC_PERM);
-	if (!m_pool)
+	// Allocate items.
+	m_maxItems = maxItems;
+	m_addedIds = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	if (!m_addedIds)
+		return false;
+	m_addedBounds = (float*)dtAlloc(sizeof(float)*4*m_maxItems, DT_ALLOC_PERM);
+	if (!m_addedBounds)
+		return false;
+	m_ids = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	if (!m_ids)
+		return false;
+	m_cells = (int*)dtAlloc(sizeof(int)*2*m_maxItems, DT_ALLOC_PERM);
+	if (!m_cells)
 		return false;
+	m_bounds = (float*)dtAlloc(sizeof(float)*4*m_maxItems, DT_ALLOC_PERM);
+	if (!m_bounds)
+		return false;
+	m_slots = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	if (!m_slots)
+		return false;
+	memset(m_slots, 0xff, sizeof(int)*m_maxItems);
 	
+	m_itemCount = 0;
 	clear();
 	
 	return true;
@@ -91,57 +125,179 @@ bool dtProximityGrid::init(const int poolSize, const float cellSize)
 
 void dtProximityGrid::clear()
 {
-	memset(m_buckets, 0xff, sizeof(unsigned short)*m_bucketsSize);
-	m_poolHead = 0;
-	m_bounds[0] = 0xffff;
-	m_bounds[1] = 0xffff;
-	m_bounds[2] = -0xffff;
-	m_bounds[3] = -0xffff;
+	if (m_built)
+	{
+		for (int i = 0; i < m_itemCount; ++i)
+			m_slots[m_ids[i]] = -1;
+	}
+	m_itemCount = 0;
+	m_built = false;
+	m_maxExtent = 0;
+	memset(m_buckets, 0, sizeof(int)*(m_bucketsSize+1));
+	m_cellBounds[0] = 0xffff;
+	m_cellBounds[1] = 0xffff;
+	m_cellBounds[2] = -0xffff;
+	m_cellBounds[3] = -0xffff;
 }
 
-void dtProximityGrid::addItem(const unsigned short id,
+void dtProximityGrid::addItem(const int id,
 							  const float minx, const float miny,
 							  const float maxx, const float maxy)
 {
-	const int iminx = (int)dtMathFloorf(minx * m_invCellSize);
-	const int iminy = (int)dtMathFloorf(miny * m_invCellSize);
-	const int imaxx = (int)dtMathFloorf(maxx * m_invCellSize);
-	const int imaxy = (int)dtMathFloorf(maxy * m_invCellSize);
+	dtAssert(id >= 0 && id < m_maxItems);
+	if (m_itemCount >= m_maxItems)
+		return;
+	
+	const int idx = m_itemCount++;
+	m_addedIds[idx] = id;
+	float* b = &m_addedBounds[idx*4];
+	b[0] = minx;
+	b[1] = miny;
+	b[2] = maxx;
+	b[3] = maxy;
+	
+	// The grid needs to be rebuilt before the item can be found.
+	m_built = false;
+}
+
+void dtProximityGrid::expandCellBounds(const int x, const int y)
+{
+	m_cellBounds[0] = dtMin(m_cellBounds[0], x);
+	m_cellBounds[1] = dtMin(m_cellBounds[1], y);
+	m_cellBounds[2] = dtMax(m_cellBounds[2], x);
+	m_cellBounds[3] = dtMax(m_cellBounds[3], y);
+}
+
+void dtProximityGrid::build()
+{
+	const int n = m_itemCount;
+	const float halfCell = 0.5f * m_invCellSize;
+	
+	// Count the items in each bucket.
+	memset(m_buckets, 0, sizeof(int)*(m_bucketsSize+1));
+	for (int i = 0; i < n; ++i)
+	{
+		const float* b = &m_addedBounds[i*4];
+		const int x = (int)dtMathFloorf((b[0]+b[2]) * halfCell);
+		const int y = (int)dtMathFloorf((b[1]+b[3]) * halfCell);
+		m_buckets[hashPos2(x, y, m_bucketsSize)]++;
+	}
+	
+	// Compute the end of each bucket.
+	int sum = 0;
+	for (int i = 0; i < m_bucketsSize; ++i)
+	{
+		sum += m_buckets[i];
+		m_buckets[i] = sum;
+	}
+	m_buckets[m_bucketsSize] = sum;
+	
+	// Scatter the items in reverse order so that each bucket keeps the insertion order,
+	// and the bucket offsets are moved to the start of each bucket.
+	m_maxExtent = 0;
+	for (int i = n-1; i >= 0; --i)
+	{
+		const float* b = &m_addedBounds[i*4];
+		const int x = (int)dtMathFloorf((b[0]+b[2]) * halfCell);
+		const int y = (int)dtMathFloorf((b[1]+b[3]) * halfCell);
+		const int idx = --m_buckets[hashPos2(x, y, m_bucketsSize)];
+		
+		m_ids[idx] = m_addedIds[i];
+		m_cells[idx*2+0] = x;
+		m_cells[idx*2+1] = y;
+		float* ib = &m_bounds[idx*4];
+		ib[0] = b[0];
+		ib[1] = b[1];
+		ib[2] = b[2];
+		ib[3] = b[3];
+		m_slots[m_addedIds[i]] = idx;
+		
+		m_maxExtent = dtMax(m_maxExtent, dtMax(b[2]-b[0], b[3]-b[1]) * 0.5f);
+		expandCellBounds(x, y);
+	}
+	
+	m_built = true;
+}
+
+bool dtProximityGrid::moveItem(const int id,
+							   const float minx, const float miny,
+							   const float maxx, const float maxy)
+{
+	dtAssert(id >= 0 && id < m_maxItems);
+	if (!m_built)
+		return false;
+	const int idx = m_slots[id];
+	if (idx < 0)
+		return false;
 	
-	m_bounds[0] = dtMin(m_bounds[0], iminx);
-	m_bounds[1] = dtMin(m_bounds[1], iminy);
-	m_bounds[2] = dtMax(m_bounds[2], imaxx);
-	m_bounds[3] = dtMax(m_bounds[3], imaxy);
+	const float halfCell = 0.5f * m_invCellSize;
+	const int x = (int)dtMathFloorf((minx+maxx) * halfCell);
+	const int y = (int)dtMathFloorf((miny+maxy) * halfCell);
+	if (x != m_cells[idx*2+0] || y != m_cells[idx*2+1])
+		return false;
+	
+	float* b = &m_bounds[idx*4];
+	b[0] = minx;
+	b[1] = miny;
+	b[2] = maxx;
+	b[3] = maxy;
+	m_maxExtent = dtMax(m_maxExtent, dtMax(maxx-minx, maxy-miny) * 0.5f);
+	
+	return true;
+}
+
+int dtProximityGrid::queryItems(const float minx, const float miny,
+								const float maxx, const float maxy,
+								int* ids, const int maxIds) const
+{
+	if (!m_built)
+		return 0;
+	
+	// Items are stored at their center, expand the query by the largest item extent.
+	const int iminx = (int)dtMathFloorf((minx - m_maxExtent) * m_invCellSize);
+	const int iminy = (int)dtMathFloorf((miny - m_maxExtent) * m_invCellSize);
+	const int imaxx = (int)dtMathFloorf((maxx + m_maxExtent) * m_invCellSize);
+	const int imaxy = (int)dtMathFloorf((maxy + m_maxExtent) * m_invCellSize);
+	
+	int n = 0;
 	
 	for (int y = iminy; y <= imaxy; ++y)
 	{
 		for (int x = iminx; x <= imaxx; ++x)
 		{
-			if (m_poolHead < m_poolSize)
+			const int h = hashPos2(x, y, m_bucketsSize);
+			for (int i = m_buckets[h]; i < m_buckets[h+1]; ++i)
 			{
-				const int h = hashPos2(x, y, m_bucketsSize);
-				const unsigned short idx = (unsigned short)m_poolHead;
-				m_poolHead++;
-				Item& item = m_pool[idx];
-				item.x = (short)x;
-				item.y = (short)y;
-				item.id = id;
-				item.next = m_buckets[h];
-				m_buckets[h] = idx;
+				if (m_cells[i*2+0] != x || m_cells[i*2+1] != y)
+					continue;
+				const float* b = &m_bounds[i*4];
+				if (minx > b[2] || maxx < b[0] || miny > b[3] || maxy < b[1])
+					continue;
+				if (n >= maxIds)
+					return n;
+				ids[n++] = m_ids[i];
 			}
 		}
 	}
+	
+	return n;
 }
 
-int dtProximityGrid::queryItems(const float minx, const float miny,
-								const float maxx, const float maxy,
-								unsigned short* ids, const int maxIds) const
+void dtProximityGrid::queryItems(const float minx, const float miny,
+								 const float maxx, const float maxy,
+								 dtProximityQuery* query) const
 {
-	const int iminx = (int)dtMathFloorf(minx * m_invCellSize);
-	const int iminy = (int)dtMathFloorf(miny * m_invCellSize);
-	const int imaxx = (int)dtMathFloorf(maxx * m_invCellSize);
-	const int imaxy = (int)dtMathFloorf(maxy * m_invCellSize);
+	dtAssert(query);
+	if (!m_built)
+		return;
 	
+	const int iminx = (int)dtMathFloorf((minx - m_maxExtent) * m_invCellSize);
+	const int iminy = (int)dtMathFloorf((miny - m_maxExtent) * m_invCellSize);
+	const int imaxx = (int)dtMathFloorf((maxx + m_maxExtent) * m_invCellSize);
+	const int imaxy = (int)dtMathFloorf((maxy + m_maxExtent) * m_invCellSize);
+	
+	static const int batchSize = 32;
+	int ids[batchSize];
 	int n = 0;
 	
 	for (int y = iminy; y <= imaxy; ++y)
@@ -149,45 +305,40 @@ int dtProximityGrid::queryItems(const float minx, const float miny,
 		for (int x = iminx; x <= imaxx; ++x)
 		{
 			const int h = hashPos2(x, y, m_bucketsSize);
-			unsigned short idx = m_buckets[h];
-			while (idx != 0xffff)
+			for (int i = m_buckets[h]; i < m_buckets[h+1]; ++i)
 			{
-				Item& item = m_pool[idx];
-				if ((int)item.x == x && (int)item.y == y)
+				if (m_cells[i*2+0] != x || m_cells[i*2+1] != y)
+					continue;
+				const float* b = &m_bounds[i*4];
+				if (minx > b[2] || maxx < b[0] || miny > b[3] || maxy < b[1])
+					continue;
+				ids[n++] = m_ids[i];
+				if (n == batchSize)
 				{
-					// Check if the id exists already.
-					const unsigned short* end = ids + n;
-					unsigned short* i = ids;
-					while (i != end && *i != item.id)
-						++i;
-					// Item not found, add it.
-					if (i == end)
-					{
-						if (n >= maxIds)
-							return n;
-						ids[n++] = item.id;
-					}
+					query->process(ids, n);
+					n = 0;
 				}
-				idx = item.next;
 			}
 		}
 	}
 	
-	return n;
+	// Process the last batch.
+	if (n > 0)
+		query->process(ids, n);
 }
 
 int dtProximityGrid::getItemCountAt(const int x, const int y) const
 {
+	if (!m_built)
+		return 0;
+	
 	int n = 0;
 	
 	const int h = hashPos2(x, y, m_bucketsSize);
-	unsigned short idx = m_buckets[h];
-	while (idx != 0xffff)
+	for (int i = m_buckets[h]; i < m_buckets[h+1]; ++i)
 	{
-		Item& item = m_pool[idx];
-		if ((int)item.x == x && (int)item.y == y)
+		if (m_cells[i*2+0] == x && m_cells[i*2+1] == y)
 			n++;
-		idx = item.next;
 	}
 	
 	return n;
@@ -12,6 +12,12 @@ enum dtCompressedTileFlags
 	DT_COMPRESSEDTILE_FREE_DATA = 0x01	///< Navmesh owns the tile memory and should free it.
 };
 
+/// A magic number used to detect the compatibility of tile cache obstacle states.
+static const int DT_TILECACHE_STATE_MAGIC = 'D'<<24 | 'T'<<16 | 'C'<<8 | 'S';
+
+/// A version number used to detect the compatibility of tile cache obstacle states.
+static const int DT_TILECACHE_STATE_VERSION = 1;
+
 struct dtCompressedTile
 {
 	unsigned int salt;						///< Counter describing modifications to the tile.
@@ -36,7 +42,8 @@ enum ObstacleType
 {
 	DT_OBSTACLE_CYLINDER,
 	DT_OBSTACLE_BOX, // AABB
-	DT_OBSTACLE_ORIENTED_BOX // OBB
+	DT_OBSTACLE_ORIENTED_BOX, // OBB
+	DT_OBSTACLE_CONVEX // Convex polygon prism
 };
 
 struct dtObstacleCylinder
@@ -59,6 +66,16 @@ struct dtObstacleOrientedBox
 	float rotAux[ 2 ]; //{ cos(0.5f*angle)*sin(-0.5f*angle); cos(0.5f*angle)*cos(0.5f*angle) - 0.5 }
 };
 
+/// The maximum number of vertices of a convex obstacle.
+static const int DT_MAX_CONVEX_OBSTACLE_VERTS = 12;
+
+struct dtObstacleConvex
+{
+	float verts[ DT_MAX_CONVEX_OBSTACLE_VERTS * 3 ]; ///< The polygon vertices, the y values are not used.
+	float hmin, hmax;
+	int nverts;
+};
+
 static const int DT_MAX_TOUCHED_TILES = 8;
 struct dtTileCacheObstacle
 {
@@ -67,6 +84,7 @@ struct dtTileCacheObstacle
 		dtObstacleCylinder cylinder;
 		dtObstacleBox box;
 		dtObstacleOrientedBox orientedBox;
+		dtObstacleConvex convex;
 	};
 
 	dtCompressedTileRef touched[DT_MAX_TOUCHED_TILES];
@@ -76,6 +94,7 @@ struct dtTileCacheObstacle
 	unsigned char state;
 	unsigned char ntouched;
 	unsigned char npending;
+	unsigned char areaId;					///< The area the obstacle marks, DT_TILECACHE_NULL_AREA when unwalkable.
 	dtTileCacheObstacle* next;
 };
 
@@ -92,12 +111,44 @@ struct dtTileCacheParams
 	int maxObstacles;
 };
 
+/// Configures how much work each call to #dtTileCache::update does.
+struct dtTileCacheUpdateParams
+{
+	int maxRequestsPerUpdate;	///< The maximum number of obstacle requests processed per update. [Limit: >= 1]
+	int maxTilesPerUpdate;		///< The maximum number of tiles rebuilt per update, per worker when a task runner is set. [Limit: >= 1]
+};
+
 struct dtTileCacheMeshProcess
 {
 	virtual ~dtTileCacheMeshProcess();
 	virtual void process(struct dtNavMeshCreateParams* params, unsigned char* polyAreas, unsigned short* polyFlags) = 0;
 };
 
+/// A unit of work handed by the tile cache to a #dtTileCacheTaskRunner.
+class dtTileCacheTask
+{
+public:
+	virtual ~dtTileCacheTask();
+	
+	/// Processes the share of the work assigned to the specified worker.
+	///  @param[in]		worker	The worker index. [Limits: 0 <= value < worker count]
+	virtual void execute(const int worker) = 0;
+};
+
+/// Runs the tile builds of #dtTileCache::update on the user's threads.
+/// @see dtTileCache::setTaskRunner
+class dtTileCacheTaskRunner
+{
+public:
+	virtual ~dtTileCacheTaskRunner();
+	
+	/// Calls dtTileCacheTask::execute once for each worker index and returns when all the calls have finished.
+	/// The calls may run concurrently, each worker index must be used by only one thread at a time.
+	///  @param[in]		task			The task to run.
+	///  @param[in]		workerCount		The number of workers to run the task on.
+	virtual void run(dtTileCacheTask* task, const int workerCount) = 0;
+};
+
 class dtTileCache
 {
 public:
@@ -134,16 +185,46 @@ public:
 	dtStatus removeTile(dtCompressedTileRef ref, unsigned char** data, int* dataSize);
 	
 	// Cylinder obstacle.
-	dtStatus addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result);
+	dtStatus addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result,
+						 const unsigned char areaId = 0);
 
 	// Aabb obstacle.
-	dtStatus addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result);
+	dtStatus addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result,
+							const unsigned char areaId = 0);
 
 	// Box obstacle: can be rotated in Y.
-	dtStatus addBoxObstacle(const float* center, const float* halfExtents, const float yRadians, dtObstacleRef* result);
+	dtStatus addBoxObstacle(const float* center, const float* halfExtents, const float yRadians, dtObstacleRef* result,
+							const unsigned char areaId = 0);
+	
+	/// Adds a convex polygon prism obstacle.
+	///  @param[in]		verts	The vertices of the convex polygon, the y values are not used. [(x, y, z) * @p nverts]
+	///  @param[in]		nverts	The number of vertices. [Limits: 3 <= value <= #DT_MAX_CONVEX_OBSTACLE_VERTS]
+	///  @param[in]		hmin	The height of the bottom of the prism.
+	///  @param[in]		hmax	The height of the top of the prism.
+	///  @param[out]	result	The reference of the obstacle. [opt]
+	///  @param[in]		areaId	The area the obstacle marks, 0 (DT_TILECACHE_NULL_AREA) to make it unwalkable.
+	/// @return The status flags for the operation.
+	dtStatus addConvexObstacle(const float* verts, const int nverts, const float hmin, const float hmax,
+							   dtObstacleRef* result, const unsigned char areaId = 0);
 	
 	dtStatus removeObstacle(const dtObstacleRef ref);
 	
+	/// Moves an obstacle without removing it, the tiles it leaves and the tiles it enters are rebuilt once.
+	///  @param[in]		ref		The obstacle to move.
+	///  @param[in]		pos		The new position: the bottom center of a cylinder, the center of a box,
+	///  						the bottom center of the bounds of a convex obstacle. [(x, y, z)]
+	/// @return The status flags for the operation.
+	dtStatus moveObstacle(const dtObstacleRef ref, const float* pos);
+	
+	/// Starts a batch of obstacle changes.
+	/// The changes made until the matching #endBatch are all processed by the same update,
+	/// so that each tile they touch is rebuilt once. Batches can be nested.
+	void beginBatch();
+	
+	/// Ends a batch of obstacle changes started by #beginBatch.
+	/// @return The status flags for the operation.
+	dtStatus endBatch();
+	
 	dtStatus queryTiles(const float* bmin, const float* bmax,
 						dtCompressedTileRef* results, int* resultCount, const int maxResults) const;
 	
@@ -159,6 +240,88 @@ public:
 	
 	dtStatus buildNavMeshTile(const dtCompressedTileRef ref, class dtNavMesh* navmesh);
 	
+	/// Builds the navigation mesh tile data of a compressed tile without touching the navigation mesh.
+	/// Can be called from several threads at once, as long as each thread uses its own allocator
+	/// and the tile cache is not changed meanwhile.
+	///  @param[in]		ref			The reference of the compressed tile to build.
+	///  @param[in]		talloc		The allocator used for the intermediate build data.
+	///  @param[out]	navData		The navigation mesh tile data, allocated using #dtAlloc, or null if the tile is empty.
+	///  @param[out]	navDataSize	The size of the tile data.
+	/// @return The status flags for the operation.
+	dtStatus buildNavMeshTileData(const dtCompressedTileRef ref, struct dtTileCacheAlloc* talloc,
+								  unsigned char** navData, int* navDataSize) const;
+	
+	/// Replaces the navigation mesh tile at the location of a compressed tile.
+	///  @param[in]		ref			The reference of the compressed tile that was built.
+	///  @param[in]		navData		The data returned by #buildNavMeshTileData. The navigation mesh takes
+	///  							the ownership of the data, it is freed if the tile cannot be added.
+	///  @param[in]		navDataSize	The size of the tile data.
+	///  @param[in]		navmesh		The mesh to affect.
+	/// @return The status flags for the operation.
+	dtStatus swapNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+							 class dtNavMesh* navmesh);
+	
+	/// Sets the task runner used by #update to build several tiles at once.
+	/// Each update then builds dtTileCacheUpdateParams::maxTilesPerUpdate tiles per worker,
+	/// and swaps them into the navigation mesh on the calling thread.
+	///  @param[in]		runner			The task runner, or null to build one tile per update. [opt]
+	///  @param[in]		allocs			The allocator of each worker. [(alloc) * @p workerCount]
+	///  @param[in]		workerCount		The number of workers. Ignored if @p runner is null. [Limit: >= 1]
+	/// @return The status flags for the operation.
+	dtStatus setTaskRunner(dtTileCacheTaskRunner* runner, struct dtTileCacheAlloc** allocs, const int workerCount);
+	
+	/// Gets the number of workers used by #update.
+	inline int getWorkerCount() const { return m_workerCount; }
+	
+	/// Sets how much work each call to #update does.
+	///  @param[in]		params	The new configuration.
+	/// @return The status flags for the operation.
+	dtStatus setUpdateParams(const dtTileCacheUpdateParams* params);
+	
+	/// Gets how much work each call to #update does.
+	/// @return The update configuration.
+	const dtTileCacheUpdateParams* getUpdateParams() const { return &m_updateParams; }
+	
+	/// Gets the number of obstacle requests waiting to be processed by #update.
+	inline int getRequestCount() const { return m_nreqs; }
+	
+	/// Gets the number of tiles waiting to be rebuilt by #update.
+	inline int getUpdateCount() const { return m_nupdate; }
+	
+	/// Sets the memory budget of the cache of decompressed layers.
+	/// Rebuilding a tile whose layer is cached skips the decompression, and reuses the polygons
+	/// of the contours that did not change since the previous build. The least recently built layers
+	/// are dropped to stay within the budget.
+	///  @param[in]		maxSize		The maximum size of the cached layers, in bytes, or zero to disable the cache. [Limit: >= 0]
+	/// @return The status flags for the operation.
+	dtStatus setLayerCacheSize(const int maxSize);
+	
+	/// Gets the memory budget of the cache of decompressed layers.
+	/// @return The maximum size of the cached layers, in bytes.
+	inline int getLayerCacheSize() const { return m_layerCacheMaxSize; }
+	
+	/// Gets the memory used by the cache of decompressed layers.
+	/// @return The size of the cached layers, in bytes.
+	inline int getLayerCacheUsedSize() const { return m_layerCacheUsedSize; }
+	
+	/// Gets the size of the buffer required by #storeObstacleState to store the obstacle state.
+	/// @return The size of the obstacle state.
+	int getObstacleStateSize() const;
+	
+	/// Stores the obstacles, the pending obstacle requests and the queued tile rebuilds into a buffer.
+	/// Fails while a batch is open.
+	///  @param[out]	data			The buffer to store the state in.
+	///  @param[in]		maxDataSize		The size of the buffer. [Limit: >= #getObstacleStateSize]
+	/// @return The status flags for the operation.
+	dtStatus storeObstacleState(unsigned char* data, const int maxDataSize) const;
+	
+	/// Restores the obstacle state stored by #storeObstacleState.
+	/// The tile cache must use the same number of obstacle bits as the one that stored the state.
+	///  @param[in]		data			The obstacle state.
+	///  @param[in]		maxDataSize		The size of the state data.
+	/// @return The status flags for the operation.
+	dtStatus restoreObstacleState(const unsigned char* data, const int maxDataSize);
+	
 	void calcTightTileBounds(const struct dtTileCacheLayerHeader* header, float* bmin, float* bmax) const;
 	
 	void getObstacleBounds(const struct dtTileCacheObstacle* ob, float* bmin, float* bmax) const;
@@ -187,21 +350,21 @@ public:
 	/// Encodes an obstacle id.
 	inline dtObstacleRef encodeObstacleId(unsigned int salt, unsigned int it) const
 	{
-		return ((dtObstacleRef)salt << 16) | (dtObstacleRef)it;
+		return ((dtObstacleRef)salt << m_obstacleBits) | (dtObstacleRef)it;
 	}
 	
 	/// Decodes an obstacle salt.
 	inline unsigned int decodeObstacleIdSalt(dtObstacleRef ref) const
 	{
-		const dtObstacleRef saltMask = ((dtObstacleRef)1<<16)-1;
-		return (unsigned int)((ref >> 16) & saltMask);
+		const dtObstacleRef saltMask = ((dtObstacleRef)1<<m_obstacleSaltBits)-1;
+		return (unsigned int)((ref >> m_obstacleBits) & saltMask);
 	}
 	
 	/// Decodes an obstacle id.
 	inline unsigned int decodeObstacleIdObstacle(dtObstacleRef ref) const
 	{
-		const dtObstacleRef tileMask = ((dtObstacleRef)1<<16)-1;
-		return (unsigned int)(ref & tileMask);
+		const dtObstacleRef obstacleMask = ((dtObstacleRef)1<<m_obstacleBits)-1;
+		return (unsigned int)(ref & obstacleMask);
 	}
 	
 	
@@ -213,15 +376,61 @@ private:
 	enum ObstacleRequestAction
 	{
 		REQUEST_ADD,
-		REQUEST_REMOVE
+		REQUEST_REMOVE,
+		REQUEST_MOVE
 	};
 	
 	struct ObstacleRequest
 	{
 		int action;
 		dtObstacleRef ref;
+		float pos[3];			///< The new position of a moved obstacle.
+		int continued;			///< Set if the next request belongs to the same batch.
+	};
+	
+	struct LayerCacheUpdate
+	{
+		unsigned char* grids;		///< Decompressed grids to add to the layer cache, or null.
+		unsigned char* polys;		///< Contour polygons of the build, or null.
+		int polysSize;
+	};
+	
+	struct TileBuildResult
+	{
+		dtCompressedTileRef ref;
+		unsigned char* navData;
+		int navDataSize;
+		LayerCacheUpdate cacheUpdate;
+		dtStatus status;
+	};
+	
+	struct LayerCacheEntry
+	{
+		dtCompressedTileRef ref;	///< The tile the grids belong to, or zero if the entry is empty.
+		unsigned char* grids;		///< The heights, areas and connections of the layer.
+		unsigned char* polys;		///< The contour polygons of the last build of the tile, or null.
+		int polysSize;
+		int size;					///< The size of the grids and the contour polygons.
+		int prev;					///< The previous, more recently used, entry or -1.
+		int next;					///< The next, less recently used, entry or -1.
 	};
 	
+	dtTileCacheObstacle* allocObstacle(const unsigned char type, const unsigned char areaId);
+	dtObstacleRef queueAddObstacle(dtTileCacheObstacle* ob);
+	void setObstaclePosition(dtTileCacheObstacle* ob, const float* pos);
+	void linkObstacle(dtTileCacheObstacle* ob);
+	void unlinkObstacle(dtTileCacheObstacle* ob);
+	void completeObstacleRequest(dtTileCacheObstacle* ob);
+	void updateObstacleStates(const dtCompressedTileRef ref);
+	void queueTileUpdate(const dtCompressedTileRef ref);
+	void buildWorkerTiles(const int worker, const int nbuild);
+	dtStatus buildNavMeshTileData(const dtCompressedTileRef ref, struct dtTileCacheAlloc* talloc,
+								  unsigned char** navData, int* navDataSize, LayerCacheUpdate* cacheUpdate) const;
+	void cacheLayer(const dtCompressedTileRef ref, const LayerCacheUpdate* update);
+	void unlinkCachedLayer(const int idx);
+	void dropCachedLayer(const int idx);
+	friend class dtTileCacheBuildTask;
+	
 	int m_tileLutSize;						///< Tile hash lookup size (must be pot).
 	int m_tileLutMask;						///< Tile hash lookup mask.
 	
@@ -241,13 +450,36 @@ private:
 	dtTileCacheObstacle* m_obstacles;
 	dtTileCacheObstacle* m_nextFreeObstacle;
 	
-	static const int MAX_REQUESTS = 64;
-	ObstacleRequest m_reqs[MAX_REQUESTS];
+	unsigned int m_obstacleSaltBits;		///< Number of salt bits in the obstacle ID.
+	unsigned int m_obstacleBits;			///< Number of obstacle bits in the obstacle ID.
+	
+	unsigned int* m_tileObstacles;			///< First obstacle link per tile index.
+	unsigned int* m_obstacleLinks;			///< Next obstacle link per touched tile of each obstacle.
+	
+	dtTileCacheUpdateParams m_updateParams;
+	
+	ObstacleRequest* m_reqs;				///< Obstacle requests, in submission order.
 	int m_nreqs;
+	int m_maxReqs;
+	int m_batchDepth;						///< Number of nested open batches.
+	int m_batchStart;						///< First request of the open batch.
 	
-	static const int MAX_UPDATE = 64;
-	dtCompressedTileRef m_update[MAX_UPDATE];
+	dtCompressedTileRef* m_update;			///< Tiles to rebuild, in queuing order.
 	int m_nupdate;
+	int m_maxUpdate;
+	dtCompressedTileRef* m_tileUpdateRefs;	///< Queued reference per tile index, used to queue each tile once.
+	
+	dtTileCacheTaskRunner* m_taskRunner;
+	int m_workerCount;
+	dtTileCacheAlloc** m_workerAllocs;		///< Allocator per worker.
+	TileBuildResult* m_buildResults;		///< Tiles built during the update.
+	int m_maxBuildResults;
+	
+	LayerCacheEntry* m_layerCache;			///< Decompressed layer per tile index.
+	int m_layerCacheHead;					///< Most recently used cached layer, or -1.
+	int m_layerCacheTail;					///< Least recently used cached layer, or -1.
+	int m_layerCacheMaxSize;
+	int m_layerCacheUsedSize;
 };
 
 dtTileCache* dtAllocTileCache();
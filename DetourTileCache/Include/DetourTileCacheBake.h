@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILECACHEBAKE_H
+#define DETOURTILECACHEBAKE_H
+
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+
+/// The compressed data of a tile cache layer.
+struct dtTileCacheLayerData
+{
+	unsigned char* data;	///< The layer data built by #dtBuildTileCacheLayer.
+	int dataSize;			///< The size of the layer data.
+};
+
+/// Configures #dtBakeTileCacheLayers.
+struct dtTileCacheBakeParams
+{
+	int tilesX;				///< The number of tiles along the x-axis. [Limit: >= 0]
+	int tilesY;				///< The number of tiles along the z-axis. [Limit: >= 0]
+	int maxLayersPerTile;	///< The maximum number of layers per tile. [Limit: >= 1]
+	int maxTilesInFlight;	///< The maximum number of tiles whose layers are held in memory at once. [Limit: >= 1]
+};
+
+/// Builds the layers of the tiles baked by #dtBakeTileCacheLayers, usually by rasterizing the geometry
+/// of the tile with Recast and passing the heightfield layers to #dtBuildTileCacheLayer.
+struct dtTileCacheLayerSource
+{
+	virtual ~dtTileCacheLayerSource();
+	
+	/// Builds the compressed layers of a tile.
+	/// Called concurrently from the workers, each worker index is used by only one thread at a time.
+	///  @param[in]		tx			The x-location of the tile.
+	///  @param[in]		ty			The y-location of the tile.
+	///  @param[in]		worker		The index of the calling worker.
+	///  @param[out]	layers		The layers of the tile, allocated using #dtAlloc. [(layer) * @p maxLayers]
+	///  @param[in]		maxLayers	The maximum number of layers.
+	///  @param[out]	layerCount	The number of layers. The layers are freed by the bake, even on failure.
+	/// @return The status flags for the operation.
+	virtual dtStatus buildTileLayers(const int tx, const int ty, const int worker,
+									 dtTileCacheLayerData* layers, const int maxLayers, int* layerCount) = 0;
+};
+
+/// Receives the layers baked by #dtBakeTileCacheLayers, for instance to write them to a tile cache set file.
+struct dtTileCacheLayerSink
+{
+	virtual ~dtTileCacheLayerSink();
+	
+	/// Adds a baked layer.
+	/// Called on the thread calling #dtBakeTileCacheLayers, in tile order.
+	///  @param[in]		data		The layer data. The sink takes the ownership of the data and frees it using #dtFree.
+	///  @param[in]		dataSize	The size of the layer data.
+	/// @return The status flags for the operation.
+	virtual dtStatus addLayer(unsigned char* data, const int dataSize) = 0;
+};
+
+/// Bakes the layers of a grid of tiles.
+///  @param[in]		params			The bake configuration.
+///  @param[in]		source			Builds the layers of the tiles.
+///  @param[in]		sink			Receives the layers.
+///  @param[in]		runner			The task runner building several tiles at once, or null to build them in turn. [opt]
+///  @param[in]		workerCount		The number of workers. Ignored if @p runner is null. [Limit: >= 1]
+/// @return The status flags for the operation.
+dtStatus dtBakeTileCacheLayers(const dtTileCacheBakeParams* params,
+							   dtTileCacheLayerSource* source, dtTileCacheLayerSink* sink,
+							   dtTileCacheTaskRunner* runner, const int workerCount);
+
+#endif // DETOURTILECACHEBAKE_H
@@ -118,6 +118,16 @@ dtStatus dtDecompressTileCacheLayer(dtTileCacheAlloc* alloc, dtTileCacheCompress
 									unsigned char* compressed, const int compressedSize,
 									dtTileCacheLayer** layerOut);
 
+/// Creates a layer from uncompressed grids, the same way #dtDecompressTileCacheLayer does after decompressing them.
+///  @param[in]		alloc		The allocator of the layer.
+///  @param[in]		header		The layer header.
+///  @param[in]		grids		The heights, areas and connections of the layer, one grid after the other.
+///  							[Size: 3 * width * height]
+///  @param[out]	layerOut	The layer, to be freed using #dtFreeTileCacheLayer.
+/// @return The status flags for the operation.
+dtStatus dtCreateTileCacheLayer(dtTileCacheAlloc* alloc, const dtTileCacheLayerHeader* header,
+								const unsigned char* grids, dtTileCacheLayer** layerOut);
+
 dtTileCacheContourSet* dtAllocTileCacheContourSet(dtTileCacheAlloc* alloc);
 void dtFreeTileCacheContourSet(dtTileCacheAlloc* alloc, dtTileCacheContourSet* cset);
 
@@ -133,6 +143,22 @@ dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float c
 dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
 					   const float* center, const float* halfExtents, const float* rotAux, const unsigned char areaId);
 
+/// Marks the cells of the layer inside of a convex polygon prism with the specified area.
+/// The holes of the layer are not marked.
+///  @param[in,out]	layer	The layer to mark.
+///  @param[in]		orig	The origin of the layer. [(x, y, z)]
+///  @param[in]		cs		The cell size.
+///  @param[in]		ch		The cell height.
+///  @param[in]		verts	The vertices of the convex polygon, the y values are not used. [(x, y, z) * @p nverts]
+///  @param[in]		nverts	The number of vertices. [Limit: >= 3]
+///  @param[in]		hmin	The height of the bottom of the prism.
+///  @param[in]		hmax	The height of the top of the prism.
+///  @param[in]		areaId	The area to mark the cells with.
+/// @return The status flags for the operation.
+dtStatus dtMarkConvexPolyArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+							  const float* verts, const int nverts, const float hmin, const float hmax,
+							  const unsigned char areaId);
+
 dtStatus dtBuildTileCacheRegions(dtTileCacheAlloc* alloc,
 								 dtTileCacheLayer& layer,
 								 const int walkableClimb);
@@ -146,6 +172,23 @@ dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
 								  dtTileCacheContourSet& lcset,
 								  dtTileCachePolyMesh& mesh);
 
+/// Builds the polygon mesh of a layer, reusing the polygons of the contours that did not change since a previous build.
+/// The contours away from a new obstacle keep their polygons, only the contours around it are triangulated again.
+/// The mesh is the same as the one built without the previous polygons.
+///  @param[in]		alloc			The allocator of the temporary data and the mesh.
+///  @param[in]		lcset			The contours of the layer.
+///  @param[out]	mesh			The polygon mesh.
+///  @param[in]		prevPolys		The contour polygons returned by the previous build of the layer, or null. [opt]
+///  @param[in]		prevPolysSize	The size of the previous contour polygons.
+///  @param[out]	outPolys		The contour polygons of this build, allocated using #dtAlloc, or null. [opt]
+///  @param[out]	outPolysSize	The size of the contour polygons of this build. [opt]
+/// @return The status flags for the operation.
+dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
+								  dtTileCacheContourSet& lcset,
+								  dtTileCachePolyMesh& mesh,
+								  const unsigned char* prevPolys, const int prevPolysSize,
+								  unsigned char** outPolys, int* outPolysSize);
+
 /// Swaps the endianness of the compressed tile data's header (#dtTileCacheLayerHeader).
 /// Tile layer data does not need endian swapping as it consist only of bytes.
 ///  @param[in,out]	data		The tile data array.
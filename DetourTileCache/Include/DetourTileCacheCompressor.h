@@ -0,0 +1,42 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILECACHECOMPRESSOR_H
+#define DETOURTILECACHECOMPRESSOR_H
+
+#include "DetourTileCacheBuilder.h"
+
+/// A compressor tuned for the layer data built by #dtBuildTileCacheLayer.
+///
+/// Each height is replaced by its difference with a prediction from the cells on the left and above,
+/// and each area and connection is xored with the cell above, which leaves long runs of zeros.
+/// Then the grids are packed with a byte oriented LZ coder whose matches also encode long runs.
+/// Buffers which are not made of three square grids are only packed.
+/// The compressor has no state and can be used from several threads at once.
+struct dtTileCacheLayerCompressor : public dtTileCacheCompressor
+{
+	virtual ~dtTileCacheLayerCompressor();
+	
+	virtual int maxCompressedSize(const int bufferSize);
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize);
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize);
+};
+
+#endif // DETOURTILECACHECOMPRESSOR_H
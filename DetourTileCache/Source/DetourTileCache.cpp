@@ -23,14 +23,28 @@ void dtFreeTileCache(dtTileCache* tc)
 	dtFree(tc);
 }
 
-static bool contains(const dtCompressedTileRef* a, const int n, const dtCompressedTileRef v)
+// Grows the array to hold at least n items, keeping its contents.
+template<class T> static bool reserveArray(T** arr, int* capacity, const int n)
 {
-	for (int i = 0; i < n; ++i)
-		if (a[i] == v)
-			return true;
-	return false;
+	if (n <= *capacity)
+		return true;
+	int newCapacity = dtMax(*capacity*2, 64);
+	while (newCapacity < n)
+		newCapacity *= 2;
+	T* newArr = (T*)dtAlloc(sizeof(T)*newCapacity, DT_ALLOC_PERM);
+	if (!newArr)
+		return false;
+	if (*capacity)
+		memcpy(newArr, *arr, sizeof(T)*(*capacity));
+	dtFree(*arr);
+	*arr = newArr;
+	*capacity = newCapacity;
+	return true;
 }
 
+// Obstacle links index the touched tiles of the obstacles: obstacle index * DT_MAX_TOUCHED_TILES + touched tile index.
+static const unsigned int OBSTACLE_NULL_LINK = 0xffffffff;
+
 inline int computeTileHash(int x, int y, const int mask)
 {
 	const unsigned int h1 = 0x8da6b343; // Large multiplicative constants;
@@ -73,11 +87,33 @@ dtTileCache::dtTileCache() :
 	m_tmproc(0),
 	m_obstacles(0),
 	m_nextFreeObstacle(0),
+	m_obstacleSaltBits(0),
+	m_obstacleBits(0),
+	m_tileObstacles(0),
+	m_obstacleLinks(0),
+	m_reqs(0),
 	m_nreqs(0),
-	m_nupdate(0)
+	m_maxReqs(0),
+	m_batchDepth(0),
+	m_batchStart(0),
+	m_update(0),
+	m_nupdate(0),
+	m_maxUpdate(0),
+	m_tileUpdateRefs(0),
+	m_taskRunner(0),
+	m_workerCount(1),
+	m_workerAllocs(0),
+	m_buildResults(0),
+	m_maxBuildResults(0),
+	m_layerCache(0),
+	m_layerCacheHead(-1),
+	m_layerCacheTail(-1),
+	m_layerCacheMaxSize(0),
+	m_layerCacheUsedSize(0)
 {
 	memset(&m_params, 0, sizeof(m_params));
-	memset(m_reqs, 0, sizeof(ObstacleRequest) * MAX_REQUESTS);
+	m_updateParams.maxRequestsPerUpdate = 1024;
+	m_updateParams.maxTilesPerUpdate = 1;
 }
 	
 dtTileCache::~dtTileCache()
@@ -92,10 +128,28 @@ dtTileCache::~dtTileCache()
 	}
 	dtFree(m_obstacles);
 	m_obstacles = 0;
+	dtFree(m_tileObstacles);
+	m_tileObstacles = 0;
+	dtFree(m_obstacleLinks);
+	m_obstacleLinks = 0;
 	dtFree(m_posLookup);
 	m_posLookup = 0;
 	dtFree(m_tiles);
 	m_tiles = 0;
+	dtFree(m_reqs);
+	m_reqs = 0;
+	dtFree(m_update);
+	m_update = 0;
+	dtFree(m_tileUpdateRefs);
+	m_tileUpdateRefs = 0;
+	dtFree(m_workerAllocs);
+	m_workerAllocs = 0;
+	dtFree(m_buildResults);
+	m_buildResults = 0;
+	while (m_layerCacheHead != -1)
+		dropCachedLayer(m_layerCacheHead);
+	dtFree(m_layerCache);
+	m_layerCache = 0;
 	m_nreqs = 0;
 	m_nupdate = 0;
 }
@@ -138,6 +192,9 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 		m_obstacles[i].next = m_nextFreeObstacle;
 		m_nextFreeObstacle = &m_obstacles[i];
 	}
+	m_obstacleLinks = (unsigned int*)dtAlloc(sizeof(unsigned int)*m_params.maxObstacles*DT_MAX_TOUCHED_TILES, DT_ALLOC_PERM);
+	if (!m_obstacleLinks)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
 	// Init tiles
 	m_tileLutSize = dtNextPow2(m_params.maxTiles/4);
@@ -150,8 +207,21 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	m_posLookup = (dtCompressedTile**)dtAlloc(sizeof(dtCompressedTile*)*m_tileLutSize, DT_ALLOC_PERM);
 	if (!m_posLookup)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_tileUpdateRefs = (dtCompressedTileRef*)dtAlloc(sizeof(dtCompressedTileRef)*m_params.maxTiles, DT_ALLOC_PERM);
+	if (!m_tileUpdateRefs)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_tileObstacles = (unsigned int*)dtAlloc(sizeof(unsigned int)*m_params.maxTiles, DT_ALLOC_PERM);
+	if (!m_tileObstacles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	for (int i = 0; i < m_params.maxTiles; ++i)
+		m_tileObstacles[i] = OBSTACLE_NULL_LINK;
+	m_layerCache = (LayerCacheEntry*)dtAlloc(sizeof(LayerCacheEntry)*m_params.maxTiles, DT_ALLOC_PERM);
+	if (!m_layerCache)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_layerCache, 0, sizeof(LayerCacheEntry)*m_params.maxTiles);
 	memset(m_tiles, 0, sizeof(dtCompressedTile)*m_params.maxTiles);
 	memset(m_posLookup, 0, sizeof(dtCompressedTile*)*m_tileLutSize);
+	memset(m_tileUpdateRefs, 0, sizeof(dtCompressedTileRef)*m_params.maxTiles);
 	m_nextFreeTile = 0;
 	for (int i = m_params.maxTiles-1; i >= 0; --i)
 	{
@@ -166,6 +236,12 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	m_saltBits = dtMin((unsigned int)31, 32 - m_tileBits);
 	if (m_saltBits < 10)
 		return DT_FAILURE | DT_INVALID_PARAM;
+	// Keep at least 16 obstacle bits so that small caches use the same IDs as before,
+	// the salt is stored in 16 bits.
+	m_obstacleBits = dtMax((unsigned int)16, dtIlog2(dtNextPow2((unsigned int)m_params.maxObstacles)));
+	m_obstacleSaltBits = 32 - m_obstacleBits;
+	if (m_obstacleSaltBits < 10)
+		return DT_FAILURE | DT_INVALID_PARAM;
 	
 	return DT_SUCCESS;
 }
@@ -244,6 +320,29 @@ dtTileCacheMeshProcess::~dtTileCacheMeshProcess()
 	// Defined out of line to fix the weak v-tables warning
 }
 
+dtTileCacheTask::~dtTileCacheTask()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+dtTileCacheTaskRunner::~dtTileCacheTaskRunner()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+/// Builds the tiles of an update, each worker takes every worker count-th tile.
+class dtTileCacheBuildTask : public dtTileCacheTask
+{
+public:
+	dtTileCache* tileCache;
+	int nbuild;
+	
+	virtual void execute(const int worker)
+	{
+		tileCache->buildWorkerTiles(worker, nbuild);
+	}
+};
+
 dtStatus dtTileCache::addTile(unsigned char* data, const int dataSize, unsigned char flags, dtCompressedTileRef* result)
 {
 	// Make sure the data is in right format.
@@ -320,6 +419,9 @@ dtStatus dtTileCache::removeTile(dtCompressedTileRef ref, unsigned char** data,
 		cur = cur->next;
 	}
 	
+	if (m_layerCache[tileIndex].grids)
+		dropCachedLayer((int)tileIndex);
+	
 	// Reset tile.
 	if (tile->flags & DT_COMPRESSEDTILE_FREE_DATA)
 	{
@@ -356,95 +458,80 @@ dtStatus dtTileCache::removeTile(dtCompressedTileRef ref, unsigned char** data,
 }
 
 
-dtStatus dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+dtTileCacheObstacle* dtTileCache::allocObstacle(const unsigned char type, const unsigned char areaId)
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
-	
-	dtTileCacheObstacle* ob = 0;
-	if (m_nextFreeObstacle)
-	{
-		ob = m_nextFreeObstacle;
-		m_nextFreeObstacle = ob->next;
-		ob->next = 0;
-	}
+	dtTileCacheObstacle* ob = m_nextFreeObstacle;
 	if (!ob)
-		return DT_FAILURE | DT_OUT_OF_MEMORY;
+		return 0;
+	m_nextFreeObstacle = ob->next;
 	
 	unsigned short salt = ob->salt;
 	memset(ob, 0, sizeof(dtTileCacheObstacle));
 	ob->salt = salt;
 	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->type = DT_OBSTACLE_CYLINDER;
-	dtVcopy(ob->cylinder.pos, pos);
-	ob->cylinder.radius = radius;
-	ob->cylinder.height = height;
-	
+	ob->type = type;
+	ob->areaId = areaId;
+	return ob;
+}
+
+dtObstacleRef dtTileCache::queueAddObstacle(dtTileCacheObstacle* ob)
+{
+	// The request array has been reserved by the caller.
 	ObstacleRequest* req = &m_reqs[m_nreqs++];
 	memset(req, 0, sizeof(ObstacleRequest));
 	req->action = REQUEST_ADD;
 	req->ref = getObstacleRef(ob);
+	return req->ref;
+}
+
+dtStatus dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result,
+								  const unsigned char areaId)
+{
+	if (!reserveArray(&m_reqs, &m_maxReqs, m_nreqs+1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_CYLINDER, areaId);
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	dtVcopy(ob->cylinder.pos, pos);
+	ob->cylinder.radius = radius;
+	ob->cylinder.height = height;
+	
+	const dtObstacleRef ref = queueAddObstacle(ob);
 	if (result)
-		*result = req->ref;
+		*result = ref;
 	
 	return DT_SUCCESS;
 }
 
-dtStatus dtTileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result)
+dtStatus dtTileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result,
+									 const unsigned char areaId)
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	if (!reserveArray(&m_reqs, &m_maxReqs, m_nreqs+1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	dtTileCacheObstacle* ob = 0;
-	if (m_nextFreeObstacle)
-	{
-		ob = m_nextFreeObstacle;
-		m_nextFreeObstacle = ob->next;
-		ob->next = 0;
-	}
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_BOX, areaId);
 	if (!ob)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	
-	unsigned short salt = ob->salt;
-	memset(ob, 0, sizeof(dtTileCacheObstacle));
-	ob->salt = salt;
-	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->type = DT_OBSTACLE_BOX;
 	dtVcopy(ob->box.bmin, bmin);
 	dtVcopy(ob->box.bmax, bmax);
 	
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
-	req->action = REQUEST_ADD;
-	req->ref = getObstacleRef(ob);
-	
+	const dtObstacleRef ref = queueAddObstacle(ob);
 	if (result)
-		*result = req->ref;
+		*result = ref;
 	
 	return DT_SUCCESS;
 }
 
-dtStatus dtTileCache::addBoxObstacle(const float* center, const float* halfExtents, const float yRadians, dtObstacleRef* result)
+dtStatus dtTileCache::addBoxObstacle(const float* center, const float* halfExtents, const float yRadians, dtObstacleRef* result,
+									 const unsigned char areaId)
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	if (!reserveArray(&m_reqs, &m_maxReqs, m_nreqs+1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 
-	dtTileCacheObstacle* ob = 0;
-	if (m_nextFreeObstacle)
-	{
-		ob = m_nextFreeObstacle;
-		m_nextFreeObstacle = ob->next;
-		ob->next = 0;
-	}
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_ORIENTED_BOX, areaId);
 	if (!ob)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-
-	unsigned short salt = ob->salt;
-	memset(ob, 0, sizeof(dtTileCacheObstacle));
-	ob->salt = salt;
-	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->type = DT_OBSTACLE_ORIENTED_BOX;
 	dtVcopy(ob->orientedBox.center, center);
 	dtVcopy(ob->orientedBox.halfExtents, halfExtents);
 
@@ -453,23 +540,48 @@ dtStatus dtTileCache::addBoxObstacle(const float* center, const float* halfExten
 	ob->orientedBox.rotAux[0] = coshalf*sinhalf;
 	ob->orientedBox.rotAux[1] = coshalf*coshalf - 0.5f;
 
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
-	req->action = REQUEST_ADD;
-	req->ref = getObstacleRef(ob);
-
+	const dtObstacleRef ref = queueAddObstacle(ob);
 	if (result)
-		*result = req->ref;
+		*result = ref;
 
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// The polygon can be wound either way, the obstacle marks the cells whose centers are inside
+/// of it or within half a cell of its edges, and whose heights are between @p hmin and @p hmax.
+/// A single convex obstacle can replace a cluster of box obstacles around a prop, each tile
+/// it touches is then rebuilt for one obstacle instead of many.
+dtStatus dtTileCache::addConvexObstacle(const float* verts, const int nverts, const float hmin, const float hmax,
+										dtObstacleRef* result, const unsigned char areaId)
+{
+	if (!verts || nverts < 3 || nverts > DT_MAX_CONVEX_OBSTACLE_VERTS || hmin > hmax)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!reserveArray(&m_reqs, &m_maxReqs, m_nreqs+1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_CONVEX, areaId);
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memcpy(ob->convex.verts, verts, sizeof(float)*nverts*3);
+	ob->convex.nverts = nverts;
+	ob->convex.hmin = hmin;
+	ob->convex.hmax = hmax;
+	
+	const dtObstacleRef ref = queueAddObstacle(ob);
+	if (result)
+		*result = ref;
+	
+	return DT_SUCCESS;
+}
+
 dtStatus dtTileCache::removeObstacle(const dtObstacleRef ref)
 {
 	if (!ref)
 		return DT_SUCCESS;
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	if (!reserveArray(&m_reqs, &m_maxReqs, m_nreqs+1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
 	ObstacleRequest* req = &m_reqs[m_nreqs++];
 	memset(req, 0, sizeof(ObstacleRequest));
@@ -479,6 +591,49 @@ dtStatus dtTileCache::removeObstacle(const dtObstacleRef ref)
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// Unlike removing and adding the obstacle again, the obstacle keeps its reference, and the tiles
+/// it leaves and enters are queued together, so a tile covered by both positions is rebuilt once.
+/// The obstacle is in the #DT_OBSTACLE_PROCESSING state until the tiles at the new position are rebuilt.
+dtStatus dtTileCache::moveObstacle(const dtObstacleRef ref, const float* pos)
+{
+	if (!getObstacleByRef(ref))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!reserveArray(&m_reqs, &m_maxReqs, m_nreqs+1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	ObstacleRequest* req = &m_reqs[m_nreqs++];
+	memset(req, 0, sizeof(ObstacleRequest));
+	req->action = REQUEST_MOVE;
+	req->ref = ref;
+	dtVcopy(req->pos, pos);
+	
+	return DT_SUCCESS;
+}
+
+void dtTileCache::beginBatch()
+{
+	if (m_batchDepth++ == 0)
+		m_batchStart = m_nreqs;
+}
+
+/// @par
+///
+/// The requests of a batch are held back by #update until the outermost batch ends,
+/// and they are then processed by a single update regardless of dtTileCacheUpdateParams::maxRequestsPerUpdate.
+dtStatus dtTileCache::endBatch()
+{
+	if (m_batchDepth == 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (--m_batchDepth == 0)
+	{
+		for (int i = m_batchStart; i < m_nreqs-1; ++i)
+			m_reqs[i].continued = 1;
+	}
+	return DT_SUCCESS;
+}
+
 dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 								 dtCompressedTileRef* results, int* resultCount, const int maxResults) const 
 {
@@ -520,123 +675,701 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// The obstacle requests are processed in submission order. A tile touched by several obstacle changes
+/// is only queued once, until it is rebuilt.
 dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 							 bool* upToDate)
 {
-	if (m_nupdate == 0)
+	dtStatus status = DT_SUCCESS;
+	
+	// Process requests, the ones of an open batch are held back.
+	const int nvisible = m_batchDepth > 0 ? m_batchStart : m_nreqs;
+	int nprocessed = 0;
+	for (; nprocessed < nvisible; ++nprocessed)
 	{
-		// Process requests.
-		for (int i = 0; i < m_nreqs; ++i)
+		// Stop at the budget, unless in the middle of a batch.
+		if (nprocessed >= m_updateParams.maxRequestsPerUpdate && !m_reqs[nprocessed-1].continued)
+			break;
+		
+		// Make room for all the tiles the obstacle can leave and touch.
+		if (!reserveArray(&m_update, &m_maxUpdate, m_nupdate + DT_MAX_TOUCHED_TILES*2))
 		{
-			ObstacleRequest* req = &m_reqs[i];
-			
-			unsigned int idx = decodeObstacleIdObstacle(req->ref);
-			if ((int)idx >= m_params.maxObstacles)
-				continue;
-			dtTileCacheObstacle* ob = &m_obstacles[idx];
-			unsigned int salt = decodeObstacleIdSalt(req->ref);
-			if (ob->salt != salt)
+			status = DT_FAILURE | DT_OUT_OF_MEMORY;
+			break;
+		}
+		
+		ObstacleRequest* req = &m_reqs[nprocessed];
+		
+		unsigned int idx = decodeObstacleIdObstacle(req->ref);
+		if ((int)idx >= m_params.maxObstacles)
+			continue;
+		dtTileCacheObstacle* ob = &m_obstacles[idx];
+		unsigned int salt = decodeObstacleIdSalt(req->ref);
+		if (ob->salt != salt)
+			continue;
+		
+		if (req->action == REQUEST_MOVE)
+		{
+			if (ob->state == DT_OBSTACLE_REMOVING)
 				continue;
+			// Rebuild the tiles the obstacle leaves.
+			for (int j = 0; j < ob->ntouched; ++j)
+				queueTileUpdate(ob->touched[j]);
+			unlinkObstacle(ob);
+			setObstaclePosition(ob, req->pos);
+			ob->state = DT_OBSTACLE_PROCESSING;
+		}
+		
+		if (req->action == REQUEST_ADD || req->action == REQUEST_MOVE)
+		{
+			// Find touched tiles.
+			float bmin[3], bmax[3];
+			getObstacleBounds(ob, bmin, bmax);
+
+			int ntouched = 0;
+			queryTiles(bmin, bmax, ob->touched, &ntouched, DT_MAX_TOUCHED_TILES);
+			ob->ntouched = (unsigned char)ntouched;
+			linkObstacle(ob);
+		}
+		else if (req->action == REQUEST_REMOVE)
+		{
+			// Prepare to remove obstacle.
+			ob->state = DT_OBSTACLE_REMOVING;
+		}
+		
+		// Add tiles to update list.
+		ob->npending = 0;
+		for (int j = 0; j < ob->ntouched; ++j)
+		{
+			queueTileUpdate(ob->touched[j]);
+			ob->pending[ob->npending++] = ob->touched[j];
+		}
+		
+		// Obstacles outside of the tiles are done right away.
+		if (ob->npending == 0)
+			completeObstacleRequest(ob);
+	}
+	
+	m_nreqs -= nprocessed;
+	if (m_nreqs > 0)
+		memmove(m_reqs, m_reqs+nprocessed, m_nreqs*sizeof(ObstacleRequest));
+	if (m_batchDepth > 0)
+		m_batchStart -= nprocessed;
+	
+	// Process updates
+	if (m_nupdate)
+	{
+		const int workerCount = m_taskRunner ? m_workerCount : 1;
+		const int nbuild = dtMin(m_nupdate, m_updateParams.maxTilesPerUpdate * workerCount);
+		
+		if (m_taskRunner)
+		{
+			if (!reserveArray(&m_buildResults, &m_maxBuildResults, nbuild))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
 			
-			if (req->action == REQUEST_ADD)
+			// Build the tiles on the workers, then swap them in order.
+			for (int i = 0; i < nbuild; ++i)
 			{
-				// Find touched tiles.
-				float bmin[3], bmax[3];
-				getObstacleBounds(ob, bmin, bmax);
-
-				int ntouched = 0;
-				queryTiles(bmin, bmax, ob->touched, &ntouched, DT_MAX_TOUCHED_TILES);
-				ob->ntouched = (unsigned char)ntouched;
-				// Add tiles to update list.
-				ob->npending = 0;
-				for (int j = 0; j < ob->ntouched; ++j)
-				{
-					if (m_nupdate < MAX_UPDATE)
-					{
-						if (!contains(m_update, m_nupdate, ob->touched[j]))
-							m_update[m_nupdate++] = ob->touched[j];
-						ob->pending[ob->npending++] = ob->touched[j];
-					}
-				}
+				TileBuildResult* res = &m_buildResults[i];
+				res->ref = m_update[i];
+				res->navData = 0;
+				res->navDataSize = 0;
+				memset(&res->cacheUpdate, 0, sizeof(LayerCacheUpdate));
+				res->status = DT_FAILURE;
 			}
-			else if (req->action == REQUEST_REMOVE)
+			
+			dtTileCacheBuildTask task;
+			task.tileCache = this;
+			task.nbuild = nbuild;
+			m_taskRunner->run(&task, m_workerCount);
+			
+			for (int i = 0; i < nbuild; ++i)
 			{
-				// Prepare to remove obstacle.
-				ob->state = DT_OBSTACLE_REMOVING;
-				// Add tiles to update list.
-				ob->npending = 0;
-				for (int j = 0; j < ob->ntouched; ++j)
-				{
-					if (m_nupdate < MAX_UPDATE)
-					{
-						if (!contains(m_update, m_nupdate, ob->touched[j]))
-							m_update[m_nupdate++] = ob->touched[j];
-						ob->pending[ob->npending++] = ob->touched[j];
-					}
-				}
+				TileBuildResult* res = &m_buildResults[i];
+				cacheLayer(res->ref, &res->cacheUpdate);
+				dtStatus tileStatus = res->status;
+				if (dtStatusSucceed(tileStatus))
+					tileStatus = swapNavMeshTile(res->ref, res->navData, res->navDataSize, navmesh);
+				if (dtStatusFailed(tileStatus) && dtStatusSucceed(status))
+					status = tileStatus;
+			}
+		}
+		else
+		{
+			// Build mesh
+			for (int i = 0; i < nbuild; ++i)
+			{
+				const dtStatus tileStatus = buildNavMeshTile(m_update[i], navmesh);
+				if (dtStatusFailed(tileStatus) && dtStatusSucceed(status))
+					status = tileStatus;
 			}
 		}
 		
-		m_nreqs = 0;
+		for (int i = 0; i < nbuild; ++i)
+		{
+			const dtCompressedTileRef ref = m_update[i];
+			const unsigned int idx = decodeTileIdTile(ref);
+			if (m_tileUpdateRefs[idx] == ref)
+				m_tileUpdateRefs[idx] = 0;
+			updateObstacleStates(ref);
+		}
+		
+		m_nupdate -= nbuild;
+		if (m_nupdate > 0)
+			memmove(m_update, m_update+nbuild, m_nupdate*sizeof(dtCompressedTileRef));
 	}
 	
-	dtStatus status = DT_SUCCESS;
-	// Process updates
-	if (m_nupdate)
+	if (upToDate)
+		*upToDate = m_nupdate == 0 && m_nreqs == 0;
+
+	return status;
+}
+
+
+void dtTileCache::setObstaclePosition(dtTileCacheObstacle* ob, const float* pos)
+{
+	if (ob->type == DT_OBSTACLE_CYLINDER)
 	{
-		// Build mesh
-		const dtCompressedTileRef ref = m_update[0];
-		status = buildNavMeshTile(ref, navmesh);
-		m_nupdate--;
-		if (m_nupdate > 0)
-			memmove(m_update, m_update+1, m_nupdate*sizeof(dtCompressedTileRef));
+		dtVcopy(ob->cylinder.pos, pos);
+	}
+	else if (ob->type == DT_OBSTACLE_BOX)
+	{
+		float halfExtents[3];
+		dtVsub(halfExtents, ob->box.bmax, ob->box.bmin);
+		dtVscale(halfExtents, halfExtents, 0.5f);
+		dtVsub(ob->box.bmin, pos, halfExtents);
+		dtVadd(ob->box.bmax, pos, halfExtents);
+	}
+	else if (ob->type == DT_OBSTACLE_ORIENTED_BOX)
+	{
+		dtVcopy(ob->orientedBox.center, pos);
+	}
+	else if (ob->type == DT_OBSTACLE_CONVEX)
+	{
+		float bmin[3], bmax[3];
+		getObstacleBounds(ob, bmin, bmax);
+		const float dx = pos[0] - (bmin[0]+bmax[0])*0.5f;
+		const float dy = pos[1] - bmin[1];
+		const float dz = pos[2] - (bmin[2]+bmax[2])*0.5f;
+		for (int i = 0; i < ob->convex.nverts; ++i)
+		{
+			ob->convex.verts[i*3+0] += dx;
+			ob->convex.verts[i*3+2] += dz;
+		}
+		ob->convex.hmin += dy;
+		ob->convex.hmax += dy;
+	}
+}
 
-		// Update obstacle states.
-		for (int i = 0; i < m_params.maxObstacles; ++i)
+void dtTileCache::linkObstacle(dtTileCacheObstacle* ob)
+{
+	// Push the obstacle at the front of the list of each tile it touches.
+	const unsigned int first = (unsigned int)(ob - m_obstacles) * DT_MAX_TOUCHED_TILES;
+	for (int j = 0; j < (int)ob->ntouched; ++j)
+	{
+		const unsigned int idx = decodeTileIdTile(ob->touched[j]);
+		m_obstacleLinks[first + j] = m_tileObstacles[idx];
+		m_tileObstacles[idx] = first + j;
+	}
+}
+
+void dtTileCache::unlinkObstacle(dtTileCacheObstacle* ob)
+{
+	const unsigned int first = (unsigned int)(ob - m_obstacles) * DT_MAX_TOUCHED_TILES;
+	for (int j = 0; j < (int)ob->ntouched; ++j)
+	{
+		const unsigned int link = first + j;
+		unsigned int* prev = &m_tileObstacles[decodeTileIdTile(ob->touched[j])];
+		while (*prev != OBSTACLE_NULL_LINK && *prev != link)
+			prev = &m_obstacleLinks[*prev];
+		if (*prev == link)
+			*prev = m_obstacleLinks[link];
+	}
+	ob->ntouched = 0;
+}
+
+void dtTileCache::completeObstacleRequest(dtTileCacheObstacle* ob)
+{
+	if (ob->state == DT_OBSTACLE_PROCESSING)
+	{
+		ob->state = DT_OBSTACLE_PROCESSED;
+	}
+	else if (ob->state == DT_OBSTACLE_REMOVING)
+	{
+		unlinkObstacle(ob);
+		ob->state = DT_OBSTACLE_EMPTY;
+		// Update salt, salt should never be zero.
+		ob->salt = (unsigned short)((ob->salt+1) & ((1<<m_obstacleSaltBits)-1));
+		if (ob->salt == 0)
+			ob->salt++;
+		// Return obstacle to free list.
+		ob->next = m_nextFreeObstacle;
+		m_nextFreeObstacle = ob;
+	}
+}
+
+void dtTileCache::updateObstacleStates(const dtCompressedTileRef ref)
+{
+	// Only the obstacles linked to the tile can be waiting for it.
+	unsigned int link = m_tileObstacles[decodeTileIdTile(ref)];
+	while (link != OBSTACLE_NULL_LINK)
+	{
+		// Completing a removal unlinks the obstacle, read the next link first.
+		const unsigned int next = m_obstacleLinks[link];
+		dtTileCacheObstacle* ob = &m_obstacles[link / DT_MAX_TOUCHED_TILES];
+		if (ob->touched[link % DT_MAX_TOUCHED_TILES] == ref &&
+			(ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING))
 		{
-			dtTileCacheObstacle* ob = &m_obstacles[i];
-			if (ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING)
+			// Remove handled tile from pending list.
+			for (int j = 0; j < (int)ob->npending; j++)
 			{
-				// Remove handled tile from pending list.
-				for (int j = 0; j < (int)ob->npending; j++)
+				if (ob->pending[j] == ref)
 				{
-					if (ob->pending[j] == ref)
-					{
-						ob->pending[j] = ob->pending[(int)ob->npending-1];
-						ob->npending--;
-						break;
-					}
-				}
-				
-				// If all pending tiles processed, change state.
-				if (ob->npending == 0)
-				{
-					if (ob->state == DT_OBSTACLE_PROCESSING)
-					{
-						ob->state = DT_OBSTACLE_PROCESSED;
-					}
-					else if (ob->state == DT_OBSTACLE_REMOVING)
-					{
-						ob->state = DT_OBSTACLE_EMPTY;
-						// Update salt, salt should never be zero.
-						ob->salt = (ob->salt+1) & ((1<<16)-1);
-						if (ob->salt == 0)
-							ob->salt++;
-						// Return obstacle to free list.
-						ob->next = m_nextFreeObstacle;
-						m_nextFreeObstacle = ob;
-					}
+					ob->pending[j] = ob->pending[(int)ob->npending-1];
+					ob->npending--;
+					
+					// If all pending tiles processed, change state.
+					if (ob->npending == 0)
+						completeObstacleRequest(ob);
+					break;
 				}
 			}
 		}
+		link = next;
+	}
+}
+
+void dtTileCache::queueTileUpdate(const dtCompressedTileRef ref)
+{
+	// Tiles are queued once, the rebuild picks up all the obstacle changes made meanwhile.
+	const unsigned int idx = decodeTileIdTile(ref);
+	if (m_tileUpdateRefs[idx] == ref)
+		return;
+	m_tileUpdateRefs[idx] = ref;
+	m_update[m_nupdate++] = ref;
+}
+
+void dtTileCache::buildWorkerTiles(const int worker, const int nbuild)
+{
+	dtTileCacheAlloc* talloc = m_workerAllocs[worker];
+	for (int i = worker; i < nbuild; i += m_workerCount)
+	{
+		TileBuildResult* res = &m_buildResults[i];
+		res->status = buildNavMeshTileData(res->ref, talloc, &res->navData, &res->navDataSize, &res->cacheUpdate);
+	}
+}
+
+/// @par
+///
+/// The cache only holds the layers of the tiles built by #update and #buildNavMeshTile,
+/// hot tiles such as the ones around moving obstacles stay decompressed. Along with each layer,
+/// the cache keeps the contour polygons of the last build of the tile.
+dtStatus dtTileCache::setLayerCacheSize(const int maxSize)
+{
+	if (maxSize < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	m_layerCacheMaxSize = maxSize;
+	while (m_layerCacheUsedSize > m_layerCacheMaxSize)
+		dropCachedLayer(m_layerCacheTail);
+	return DT_SUCCESS;
+}
+
+void dtTileCache::cacheLayer(const dtCompressedTileRef ref, const LayerCacheUpdate* update)
+{
+	const int idx = (int)decodeTileIdTile(ref);
+	LayerCacheEntry* entry = &m_layerCache[idx];
+	const bool cached = entry->grids && entry->ref == ref;
+	if (!getTileByRef(ref) || (!update->grids && !cached))
+	{
+		dtFree(update->grids);
+		dtFree(update->polys);
+		return;
 	}
 	
-	if (upToDate)
-		*upToDate = m_nupdate == 0 && m_nreqs == 0;
+	if (update->grids)
+	{
+		if (entry->grids)
+			dropCachedLayer(idx);
+		const dtCompressedTile* tile = &m_tiles[idx];
+		entry->ref = ref;
+		entry->grids = update->grids;
+		entry->size = (int)tile->header->width * (int)tile->header->height * 3;
+		m_layerCacheUsedSize += entry->size;
+	}
+	else
+	{
+		unlinkCachedLayer(idx);
+	}
+	
+	// Keep the contour polygons of the latest build.
+	if (update->polys)
+	{
+		dtFree(entry->polys);
+		entry->size -= entry->polysSize;
+		m_layerCacheUsedSize -= entry->polysSize;
+		entry->polys = update->polys;
+		entry->polysSize = update->polysSize;
+		entry->size += entry->polysSize;
+		m_layerCacheUsedSize += entry->polysSize;
+	}
+	
+	// Mark the layer as the most recently used.
+	entry->prev = -1;
+	entry->next = m_layerCacheHead;
+	if (m_layerCacheHead != -1)
+		m_layerCache[m_layerCacheHead].prev = idx;
+	m_layerCacheHead = idx;
+	if (m_layerCacheTail == -1)
+		m_layerCacheTail = idx;
+	
+	// The layer is the last one to go.
+	while (m_layerCacheUsedSize > m_layerCacheMaxSize)
+		dropCachedLayer(m_layerCacheTail);
+}
 
-	return status;
+void dtTileCache::unlinkCachedLayer(const int idx)
+{
+	LayerCacheEntry* entry = &m_layerCache[idx];
+	if (entry->prev != -1)
+		m_layerCache[entry->prev].next = entry->next;
+	else
+		m_layerCacheHead = entry->next;
+	if (entry->next != -1)
+		m_layerCache[entry->next].prev = entry->prev;
+	else
+		m_layerCacheTail = entry->prev;
+	entry->prev = -1;
+	entry->next = -1;
 }
 
+void dtTileCache::dropCachedLayer(const int idx)
+{
+	LayerCacheEntry* entry = &m_layerCache[idx];
+	unlinkCachedLayer(idx);
+	m_layerCacheUsedSize -= entry->size;
+	dtFree(entry->grids);
+	dtFree(entry->polys);
+	entry->ref = 0;
+	entry->grids = 0;
+	entry->polys = 0;
+	entry->polysSize = 0;
+	entry->size = 0;
+}
+
+struct dtTileCacheState
+{
+	int magic;								// Magic number, used to identify the data.
+	int version;							// Data version number.
+	int maxObstacles;						// Number of obstacle salts.
+	int obstacleBits;						// Number of obstacle bits in the obstacle references.
+	int nobstacles;							// Number of obstacles in use.
+	int nreqs;								// Number of pending obstacle requests.
+	int nupdate;							// Number of queued tile rebuilds.
+};
+
+// Tiles are stored by location, the compressed tile references change when the tiles are added again.
+struct dtTileCacheTileLocation
+{
+	int tx, ty, tlayer;
+};
+
+struct dtObstacleState
+{
+	int idx;								// Index of the obstacle.
+	dtTileCacheObstacle obstacle;			// The obstacle, its tile references and links are not used.
+	dtTileCacheTileLocation touched[DT_MAX_TOUCHED_TILES];
+	dtTileCacheTileLocation pending[DT_MAX_TOUCHED_TILES];
+};
+
+struct dtObstacleRequestState
+{
+	int action;
+	int idx;								// Index of the obstacle.
+	unsigned int salt;						// Salt of the obstacle.
+	float pos[3];
+	int continued;
+};
+
+static void storeTileLocation(const dtCompressedTile* tile, dtTileCacheTileLocation* loc)
+{
+	// Removed tiles get a location that matches no tile.
+	loc->tx = tile ? tile->header->tx : 0;
+	loc->ty = tile ? tile->header->ty : 0;
+	loc->tlayer = tile ? tile->header->tlayer : -1;
+}
+
+static int calcObstacleStateSize(const int maxObstacles, const int nobstacles, const int nreqs, const int nupdate)
+{
+	return dtAlign4(sizeof(dtTileCacheState)) +
+		dtAlign4(sizeof(unsigned short)*maxObstacles) +
+		dtAlign4(sizeof(dtObstacleState))*nobstacles +
+		dtAlign4(sizeof(dtObstacleRequestState))*nreqs +
+		dtAlign4(sizeof(dtTileCacheTileLocation))*nupdate;
+}
+
+///  @see #storeObstacleState
+int dtTileCache::getObstacleStateSize() const
+{
+	int nobstacles = 0;
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+	{
+		if (m_obstacles[i].state != DT_OBSTACLE_EMPTY)
+			nobstacles++;
+	}
+	return calcObstacleStateSize(m_params.maxObstacles, nobstacles, m_nreqs, m_nupdate);
+}
+
+/// @par
+///
+/// The obstacle state complements the compressed tiles and the navigation mesh tiles: storing all three
+/// lets a tile cache be brought back to the same state without rebuilding any tile.
+/// The obstacles keep their references, and the changes that were not processed yet are carried over.
+/// The layer cache is not stored. The state cannot be stored while a batch is open.
+/// @see #restoreObstacleState
+dtStatus dtTileCache::storeObstacleState(unsigned char* data, const int maxDataSize) const
+{
+	// The requests of an open batch are not ready to be processed yet.
+	if (m_batchDepth > 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	// Make sure there is enough space to store the state.
+	const int sizeReq = getObstacleStateSize();
+	if (maxDataSize < sizeReq)
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	memset(data, 0, sizeReq);
+	
+	dtTileCacheState* state = dtGetThenAdvanceBufferPointer<dtTileCacheState>(data, dtAlign4(sizeof(dtTileCacheState)));
+	unsigned short* salts = dtGetThenAdvanceBufferPointer<unsigned short>(data, dtAlign4(sizeof(unsigned short)*m_params.maxObstacles));
+	
+	state->magic = DT_TILECACHE_STATE_MAGIC;
+	state->version = DT_TILECACHE_STATE_VERSION;
+	state->maxObstacles = m_params.maxObstacles;
+	state->obstacleBits = (int)m_obstacleBits;
+	state->nreqs = m_nreqs;
+	state->nupdate = m_nupdate;
+	
+	// Store the salts of all the obstacles, so that stale references stay invalid after the restore.
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+		salts[i] = m_obstacles[i].salt;
+	
+	// Store obstacles.
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+	{
+		const dtTileCacheObstacle* ob = &m_obstacles[i];
+		if (ob->state == DT_OBSTACLE_EMPTY)
+			continue;
+		dtObstacleState* obState = dtGetThenAdvanceBufferPointer<dtObstacleState>(data, dtAlign4(sizeof(dtObstacleState)));
+		obState->idx = i;
+		memcpy(&obState->obstacle, ob, sizeof(dtTileCacheObstacle));
+		obState->obstacle.next = 0;
+		for (int j = 0; j < ob->ntouched; ++j)
+			storeTileLocation(getTileByRef(ob->touched[j]), &obState->touched[j]);
+		for (int j = 0; j < ob->npending; ++j)
+			storeTileLocation(getTileByRef(ob->pending[j]), &obState->pending[j]);
+		state->nobstacles++;
+	}
+	
+	// Store requests.
+	for (int i = 0; i < m_nreqs; ++i)
+	{
+		const ObstacleRequest* req = &m_reqs[i];
+		dtObstacleRequestState* reqState = dtGetThenAdvanceBufferPointer<dtObstacleRequestState>(data, dtAlign4(sizeof(dtObstacleRequestState)));
+		reqState->action = req->action;
+		reqState->idx = (int)decodeObstacleIdObstacle(req->ref);
+		reqState->salt = decodeObstacleIdSalt(req->ref);
+		dtVcopy(reqState->pos, req->pos);
+		reqState->continued = req->continued;
+	}
+	
+	// Store queued tile rebuilds.
+	for (int i = 0; i < m_nupdate; ++i)
+	{
+		dtTileCacheTileLocation* loc = dtGetThenAdvanceBufferPointer<dtTileCacheTileLocation>(data, dtAlign4(sizeof(dtTileCacheTileLocation)));
+		storeTileLocation(getTileByRef(m_update[i]), loc);
+	}
+	
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The tile cache must be initialized with at least as many obstacles as the stored one, hold no obstacles,
+/// and already hold the compressed tiles. The obstacles are linked to the tiles at the stored locations,
+/// the locations missing from the tile cache are skipped. The tiles are not rebuilt: the navigation mesh
+/// tiles are expected to be restored along with the compressed tiles. The pending requests and tile rebuilds
+/// are processed by the next updates.
+///
+/// The obstacle references are only kept if both tile caches use the same number of obstacle bits,
+/// which is the case when their maximum number of obstacles rounds up to the same power of two
+/// (or both are at most 65536). Other states are rejected, as is a restore while a batch is open.
+/// @see #storeObstacleState
+dtStatus dtTileCache::restoreObstacleState(const unsigned char* data, const int maxDataSize)
+{
+	if (maxDataSize < dtAlign4(sizeof(dtTileCacheState)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const dtTileCacheState* state = dtGetThenAdvanceBufferPointer<const dtTileCacheState>(data, dtAlign4(sizeof(dtTileCacheState)));
+	
+	// Check that the restore is possible.
+	if (state->magic != DT_TILECACHE_STATE_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (state->version != DT_TILECACHE_STATE_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (state->obstacleBits != (int)m_obstacleBits)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (state->maxObstacles < 0 || state->maxObstacles > m_params.maxObstacles ||
+		state->nobstacles < 0 || state->nobstacles > state->maxObstacles ||
+		state->nreqs < 0 || state->nupdate < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxDataSize < calcObstacleStateSize(state->maxObstacles, state->nobstacles, state->nreqs, state->nupdate))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (m_nreqs > 0 || m_nupdate > 0 || m_batchDepth > 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+	{
+		if (m_obstacles[i].state != DT_OBSTACLE_EMPTY)
+			return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
+	// Check the obstacle shapes before anything is restored, they are used to rasterize the tiles.
+	const unsigned char* obData = data + dtAlign4(sizeof(unsigned short)*state->maxObstacles);
+	for (int i = 0; i < state->nobstacles; ++i)
+	{
+		const dtObstacleState* obState = dtGetThenAdvanceBufferPointer<const dtObstacleState>(obData, dtAlign4(sizeof(dtObstacleState)));
+		const dtTileCacheObstacle* ob = &obState->obstacle;
+		if (ob->type > DT_OBSTACLE_CONVEX)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (ob->type == DT_OBSTACLE_CONVEX &&
+			(ob->convex.nverts < 3 || ob->convex.nverts > DT_MAX_CONVEX_OBSTACLE_VERTS))
+			return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
+	if (!reserveArray(&m_reqs, &m_maxReqs, state->nreqs) ||
+		!reserveArray(&m_update, &m_maxUpdate, state->nupdate))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	const unsigned short* salts = dtGetThenAdvanceBufferPointer<const unsigned short>(data, dtAlign4(sizeof(unsigned short)*state->maxObstacles));
+	for (int i = 0; i < state->maxObstacles; ++i)
+		m_obstacles[i].salt = salts[i];
+	
+	// Restore obstacles.
+	for (int i = 0; i < state->nobstacles; ++i)
+	{
+		const dtObstacleState* obState = dtGetThenAdvanceBufferPointer<const dtObstacleState>(data, dtAlign4(sizeof(dtObstacleState)));
+		if (obState->idx < 0 || obState->idx >= state->maxObstacles ||
+			obState->obstacle.state == DT_OBSTACLE_EMPTY || m_obstacles[obState->idx].state != DT_OBSTACLE_EMPTY)
+			continue;
+		dtTileCacheObstacle* ob = &m_obstacles[obState->idx];
+		memcpy(ob, &obState->obstacle, sizeof(dtTileCacheObstacle));
+		ob->next = 0;
+		
+		const int ntouched = dtMin((int)obState->obstacle.ntouched, DT_MAX_TOUCHED_TILES);
+		const int npending = dtMin((int)obState->obstacle.npending, DT_MAX_TOUCHED_TILES);
+		ob->ntouched = 0;
+		ob->npending = 0;
+		for (int j = 0; j < ntouched; ++j)
+		{
+			const dtTileCacheTileLocation* loc = &obState->touched[j];
+			const dtCompressedTile* tile = getTileAt(loc->tx, loc->ty, loc->tlayer);
+			if (tile)
+				ob->touched[ob->ntouched++] = getTileRef(tile);
+		}
+		for (int j = 0; j < npending; ++j)
+		{
+			const dtTileCacheTileLocation* loc = &obState->pending[j];
+			const dtCompressedTile* tile = getTileAt(loc->tx, loc->ty, loc->tlayer);
+			if (tile)
+				ob->pending[ob->npending++] = getTileRef(tile);
+		}
+		linkObstacle(ob);
+		
+		// The obstacle is done if all its pending tiles are missing.
+		if (npending > 0 && ob->npending == 0)
+			completeObstacleRequest(ob);
+	}
+	
+	// Rebuild the free list, lowest indices first like a newly initialized tile cache.
+	m_nextFreeObstacle = 0;
+	for (int i = m_params.maxObstacles-1; i >= 0; --i)
+	{
+		if (m_obstacles[i].state != DT_OBSTACLE_EMPTY)
+			continue;
+		m_obstacles[i].next = m_nextFreeObstacle;
+		m_nextFreeObstacle = &m_obstacles[i];
+	}
+	
+	// Restore requests.
+	for (int i = 0; i < state->nreqs; ++i)
+	{
+		const dtObstacleRequestState* reqState = dtGetThenAdvanceBufferPointer<const dtObstacleRequestState>(data, dtAlign4(sizeof(dtObstacleRequestState)));
+		ObstacleRequest* req = &m_reqs[m_nreqs++];
+		memset(req, 0, sizeof(ObstacleRequest));
+		req->action = reqState->action;
+		req->ref = encodeObstacleId(reqState->salt, (unsigned int)reqState->idx);
+		dtVcopy(req->pos, reqState->pos);
+		req->continued = reqState->continued;
+	}
+	
+	// Restore queued tile rebuilds.
+	for (int i = 0; i < state->nupdate; ++i)
+	{
+		const dtTileCacheTileLocation* loc = dtGetThenAdvanceBufferPointer<const dtTileCacheTileLocation>(data, dtAlign4(sizeof(dtTileCacheTileLocation)));
+		const dtCompressedTile* tile = getTileAt(loc->tx, loc->ty, loc->tlayer);
+		if (tile)
+			queueTileUpdate(getTileRef(tile));
+	}
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileCache::setUpdateParams(const dtTileCacheUpdateParams* params)
+{
+	if (params->maxRequestsPerUpdate < 1 || params->maxTilesPerUpdate < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	memcpy(&m_updateParams, params, sizeof(dtTileCacheUpdateParams));
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The runner is used to decompress, rasterize the obstacles of, and build several tiles at once,
+/// so the compressor and the mesh process passed to #init are called concurrently from the worker threads.
+/// Only the tile swaps and the obstacle state changes are done on the thread calling #update.
+///
+/// The allocators are not owned by the tile cache and must outlive it, or the next call to this function.
+dtStatus dtTileCache::setTaskRunner(dtTileCacheTaskRunner* runner, dtTileCacheAlloc** allocs, const int workerCount)
+{
+	const int count = runner ? workerCount : 1;
+	if (count < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (runner)
+	{
+		if (!allocs)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		for (int i = 0; i < count; ++i)
+		{
+			if (!allocs[i])
+				return DT_FAILURE | DT_INVALID_PARAM;
+		}
+	}
+	
+	dtFree(m_workerAllocs);
+	m_workerAllocs = 0;
+	m_taskRunner = 0;
+	m_workerCount = 1;
+	if (!runner)
+		return DT_SUCCESS;
+	
+	m_workerAllocs = (dtTileCacheAlloc**)dtAlloc(sizeof(dtTileCacheAlloc*)*count, DT_ALLOC_PERM);
+	if (!m_workerAllocs)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memcpy(m_workerAllocs, allocs, sizeof(dtTileCacheAlloc*)*count);
+	m_taskRunner = runner;
+	m_workerCount = count;
+	
+	return DT_SUCCESS;
+}
 
 dtStatus dtTileCache::buildNavMeshTilesAt(const int tx, const int ty, dtNavMesh* navmesh)
 {
@@ -655,82 +1388,139 @@ dtStatus dtTileCache::buildNavMeshTilesAt(const int tx, const int ty, dtNavMesh*
 }
 
 dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh* navmesh)
+{
+	unsigned char* navData = 0;
+	int navDataSize = 0;
+	LayerCacheUpdate cacheUpdate;
+	memset(&cacheUpdate, 0, sizeof(cacheUpdate));
+	dtStatus status = buildNavMeshTileData(ref, m_talloc, &navData, &navDataSize, &cacheUpdate);
+	cacheLayer(ref, &cacheUpdate);
+	if (dtStatusFailed(status))
+		return status;
+	
+	return swapNavMeshTile(ref, navData, navDataSize, navmesh);
+}
+
+static void markObstacleArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+							 const dtTileCacheObstacle* ob)
+{
+	if (ob->type == DT_OBSTACLE_CYLINDER)
+	{
+		dtMarkCylinderArea(layer, orig, cs, ch,
+						   ob->cylinder.pos, ob->cylinder.radius, ob->cylinder.height, ob->areaId);
+	}
+	else if (ob->type == DT_OBSTACLE_BOX)
+	{
+		dtMarkBoxArea(layer, orig, cs, ch, ob->box.bmin, ob->box.bmax, ob->areaId);
+	}
+	else if (ob->type == DT_OBSTACLE_ORIENTED_BOX)
+	{
+		dtMarkBoxArea(layer, orig, cs, ch,
+					  ob->orientedBox.center, ob->orientedBox.halfExtents, ob->orientedBox.rotAux, ob->areaId);
+	}
+	else if (ob->type == DT_OBSTACLE_CONVEX)
+	{
+		dtMarkConvexPolyArea(layer, orig, cs, ch,
+							 ob->convex.verts, ob->convex.nverts, ob->convex.hmin, ob->convex.hmax, ob->areaId);
+	}
+}
+
+dtStatus dtTileCache::buildNavMeshTileData(const dtCompressedTileRef ref, dtTileCacheAlloc* talloc,
+										   unsigned char** navData, int* navDataSize) const
+{
+	return buildNavMeshTileData(ref, talloc, navData, navDataSize, 0);
+}
+
+// Reads the layer cache without changing it, so that the workers can build tiles concurrently.
+// When cacheUpdate is set, a copy of the decompressed grids of a layer that is not cached yet,
+// and the contour polygons of the build are returned for #cacheLayer to add to the cache.
+dtStatus dtTileCache::buildNavMeshTileData(const dtCompressedTileRef ref, dtTileCacheAlloc* talloc,
+										   unsigned char** navData, int* navDataSize, LayerCacheUpdate* cacheUpdate) const
 {	
-	dtAssert(m_talloc);
+	dtAssert(talloc);
 	dtAssert(m_tcomp);
 	
+	*navData = 0;
+	*navDataSize = 0;
+	
 	unsigned int idx = decodeTileIdTile(ref);
-	if (idx > (unsigned int)m_params.maxTiles)
+	if (idx >= (unsigned int)m_params.maxTiles)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	const dtCompressedTile* tile = &m_tiles[idx];
 	unsigned int salt = decodeTileIdSalt(ref);
 	if (tile->salt != salt)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	m_talloc->reset();
+	talloc->reset();
 	
-	NavMeshTileBuildContext bc(m_talloc);
+	NavMeshTileBuildContext bc(talloc);
 	const int walkableClimbVx = (int)(m_params.walkableClimb / m_params.ch);
 	dtStatus status;
 	
-	// Decompress tile layer data. 
-	status = dtDecompressTileCacheLayer(m_talloc, m_tcomp, tile->data, tile->dataSize, &bc.layer);
-	if (dtStatusFailed(status))
-		return status;
+	// Decompress tile layer data, unless it is cached.
+	const LayerCacheEntry* cached = &m_layerCache[idx];
+	const bool isCached = cached->grids && cached->ref == ref;
+	if (isCached)
+	{
+		status = dtCreateTileCacheLayer(talloc, tile->header, cached->grids, &bc.layer);
+		if (dtStatusFailed(status))
+			return status;
+	}
+	else
+	{
+		status = dtDecompressTileCacheLayer(talloc, m_tcomp, tile->data, tile->dataSize, &bc.layer);
+		if (dtStatusFailed(status))
+			return status;
+		
+		const int gridsSize = (int)tile->header->width * (int)tile->header->height * 3;
+		if (cacheUpdate && gridsSize <= m_layerCacheMaxSize)
+		{
+			// Copy before the obstacles are rasterized.
+			cacheUpdate->grids = (unsigned char*)dtAlloc(gridsSize, DT_ALLOC_PERM);
+			if (cacheUpdate->grids)
+				memcpy(cacheUpdate->grids, bc.layer->heights, gridsSize);
+		}
+	}
 	
-	// Rasterize obstacles.
-	for (int i = 0; i < m_params.maxObstacles; ++i)
+	// Rasterize obstacles. The areas are not marked on holes, so the unwalkable obstacles
+	// cut through the obstacles marking areas whatever their order.
+	for (unsigned int link = m_tileObstacles[idx]; link != OBSTACLE_NULL_LINK; link = m_obstacleLinks[link])
 	{
-		const dtTileCacheObstacle* ob = &m_obstacles[i];
+		const dtTileCacheObstacle* ob = &m_obstacles[link / DT_MAX_TOUCHED_TILES];
 		if (ob->state == DT_OBSTACLE_EMPTY || ob->state == DT_OBSTACLE_REMOVING)
 			continue;
-		if (contains(ob->touched, ob->ntouched, ref))
-		{
-			if (ob->type == DT_OBSTACLE_CYLINDER)
-			{
-				dtMarkCylinderArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
-							    ob->cylinder.pos, ob->cylinder.radius, ob->cylinder.height, 0);
-			}
-			else if (ob->type == DT_OBSTACLE_BOX)
-			{
-				dtMarkBoxArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
-					ob->box.bmin, ob->box.bmax, 0);
-			}
-			else if (ob->type == DT_OBSTACLE_ORIENTED_BOX)
-			{
-				dtMarkBoxArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
-					ob->orientedBox.center, ob->orientedBox.halfExtents, ob->orientedBox.rotAux, 0);
-			}
-		}
+		// The list can still hold obstacles of a tile previously stored at the same index.
+		if (ob->touched[link % DT_MAX_TOUCHED_TILES] == ref)
+			markObstacleArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch, ob);
 	}
 	
 	// Build navmesh
-	status = dtBuildTileCacheRegions(m_talloc, *bc.layer, walkableClimbVx);
+	status = dtBuildTileCacheRegions(talloc, *bc.layer, walkableClimbVx);
 	if (dtStatusFailed(status))
 		return status;
 	
-	bc.lcset = dtAllocTileCacheContourSet(m_talloc);
+	bc.lcset = dtAllocTileCacheContourSet(talloc);
 	if (!bc.lcset)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	status = dtBuildTileCacheContours(m_talloc, *bc.layer, walkableClimbVx,
+	status = dtBuildTileCacheContours(talloc, *bc.layer, walkableClimbVx,
 									  m_params.maxSimplificationError, *bc.lcset);
 	if (dtStatusFailed(status))
 		return status;
 	
-	bc.lmesh = dtAllocTileCachePolyMesh(m_talloc);
+	bc.lmesh = dtAllocTileCachePolyMesh(talloc);
 	if (!bc.lmesh)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	status = dtBuildTileCachePolyMesh(m_talloc, *bc.lcset, *bc.lmesh);
+	// Only the contours changed since the previous build of a cached layer are polygonized.
+	const bool keepPolys = cacheUpdate && (isCached || cacheUpdate->grids);
+	status = dtBuildTileCachePolyMesh(talloc, *bc.lcset, *bc.lmesh,
+									  isCached ? cached->polys : 0, isCached ? cached->polysSize : 0,
+									  keepPolys ? &cacheUpdate->polys : 0, keepPolys ? &cacheUpdate->polysSize : 0);
 	if (dtStatusFailed(status))
 		return status;
 	
 	// Early out if the mesh tile is empty.
 	if (!bc.lmesh->npolys)
-	{
-		// Remove existing tile.
-		navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
 		return DT_SUCCESS;
-	}
 	
 	dtNavMeshCreateParams params;
 	memset(&params, 0, sizeof(params));
@@ -758,19 +1548,30 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 		m_tmproc->process(&params, bc.lmesh->areas, bc.lmesh->flags);
 	}
 	
-	unsigned char* navData = 0;
-	int navDataSize = 0;
-	if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+	if (!dtCreateNavMeshData(&params, navData, navDataSize))
 		return DT_FAILURE;
+	
+	return DT_SUCCESS;
+}
 
+dtStatus dtTileCache::swapNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+									  dtNavMesh* navmesh)
+{
+	const dtCompressedTile* tile = getTileByRef(ref);
+	if (!tile)
+	{
+		dtFree(navData);
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
 	// Remove existing tile.
 	navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
-
+	
 	// Add new tile, or leave the location empty.
 	if (navData)
 	{
 		// Let the navmesh own the data.
-		status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
+		dtStatus status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
 		if (dtStatusFailed(status))
 		{
 			dtFree(navData);
@@ -822,4 +1623,18 @@ void dtTileCache::getObstacleBounds(const struct dtTileCacheObstacle* ob, float*
 		bmin[2] = orientedBox.center[2] - maxr;
 		bmax[2] = orientedBox.center[2] + maxr;
 	}
+	else if (ob->type == DT_OBSTACLE_CONVEX)
+	{
+		const dtObstacleConvex &convex = ob->convex;
+
+		dtVcopy(bmin, convex.verts);
+		dtVcopy(bmax, convex.verts);
+		for (int i = 1; i < convex.nverts; ++i)
+		{
+			dtVmin(bmin, &convex.verts[i*3]);
+			dtVmax(bmax, &convex.verts[i*3]);
+		}
+		bmin[1] = convex.hmin;
+		bmax[1] = convex.hmax;
+	}
 }
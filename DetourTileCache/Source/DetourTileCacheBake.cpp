@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourTileCacheBake.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <string.h>
+
+dtTileCacheLayerSource::~dtTileCacheLayerSource()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+dtTileCacheLayerSink::~dtTileCacheLayerSink()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+// Builds one wave of tiles, the workers take every workerCount-th tile.
+class dtTileCacheBakeTask : public dtTileCacheTask
+{
+public:
+	const dtTileCacheBakeParams* params;
+	dtTileCacheLayerSource* source;
+	int workerCount;
+	int firstTile;
+	int ntiles;
+	dtTileCacheLayerData* layers;
+	int* layerCounts;
+	dtStatus* statuses;
+	
+	virtual void execute(const int worker)
+	{
+		for (int i = worker; i < ntiles; i += workerCount)
+		{
+			const int tile = firstTile + i;
+			const int tx = tile % params->tilesX;
+			const int ty = tile / params->tilesX;
+			int nlayers = 0;
+			statuses[i] = source->buildTileLayers(tx, ty, worker, &layers[i*params->maxLayersPerTile],
+												  params->maxLayersPerTile, &nlayers);
+			layerCounts[i] = dtClamp(nlayers, 0, params->maxLayersPerTile);
+		}
+	}
+};
+
+/// @par
+///
+/// The tiles are baked in row order, in waves of dtTileCacheBakeParams::maxTilesInFlight tiles.
+/// The layers of a wave are passed to the sink once the whole wave is built, then the next wave starts,
+/// so that at most one wave of layers is held in memory. The sink receives the layers in the same order
+/// whatever the number of workers.
+///
+/// When a runner is set the source and the compressor it uses are called concurrently from the worker threads.
+dtStatus dtBakeTileCacheLayers(const dtTileCacheBakeParams* params,
+							   dtTileCacheLayerSource* source, dtTileCacheLayerSink* sink,
+							   dtTileCacheTaskRunner* runner, const int workerCount)
+{
+	dtAssert(source);
+	dtAssert(sink);
+	
+	if (!params || params->tilesX < 0 || params->tilesY < 0 ||
+		params->maxLayersPerTile < 1 || params->maxTilesInFlight < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (runner && workerCount < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const int totalTiles = params->tilesX * params->tilesY;
+	const int maxTiles = dtMin(params->maxTilesInFlight, dtMax(totalTiles, 1));
+	const int maxLayers = maxTiles * params->maxLayersPerTile;
+	
+	dtTileCacheLayerData* layers = (dtTileCacheLayerData*)dtAlloc(sizeof(dtTileCacheLayerData)*maxLayers, DT_ALLOC_TEMP);
+	int* layerCounts = (int*)dtAlloc(sizeof(int)*maxTiles, DT_ALLOC_TEMP);
+	dtStatus* statuses = (dtStatus*)dtAlloc(sizeof(dtStatus)*maxTiles, DT_ALLOC_TEMP);
+	if (!layers || !layerCounts || !statuses)
+	{
+		dtFree(layers);
+		dtFree(layerCounts);
+		dtFree(statuses);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	
+	dtTileCacheBakeTask task;
+	task.params = params;
+	task.source = source;
+	task.workerCount = runner ? workerCount : 1;
+	task.layers = layers;
+	task.layerCounts = layerCounts;
+	task.statuses = statuses;
+	
+	dtStatus status = DT_SUCCESS;
+	for (int firstTile = 0; firstTile < totalTiles && dtStatusSucceed(status); firstTile += maxTiles)
+	{
+		const int ntiles = dtMin(maxTiles, totalTiles - firstTile);
+		memset(layers, 0, sizeof(dtTileCacheLayerData)*ntiles*params->maxLayersPerTile);
+		memset(layerCounts, 0, sizeof(int)*ntiles);
+		
+		task.firstTile = firstTile;
+		task.ntiles = ntiles;
+		if (runner)
+			runner->run(&task, workerCount);
+		else
+			task.execute(0);
+		
+		// Pass the layers on in tile order, or free them after a failure.
+		for (int i = 0; i < ntiles; ++i)
+		{
+			if (dtStatusSucceed(status) && dtStatusFailed(statuses[i]))
+				status = statuses[i];
+			for (int j = 0; j < layerCounts[i]; ++j)
+			{
+				dtTileCacheLayerData* layer = &layers[i*params->maxLayersPerTile + j];
+				if (dtStatusSucceed(status))
+				{
+					status = sink->addLayer(layer->data, layer->dataSize);
+				}
+				else
+				{
+					dtFree(layer->data);
+				}
+				layer->data = 0;
+			}
+		}
+	}
+	
+	dtFree(layers);
+	dtFree(layerCounts);
+	dtFree(statuses);
+	
+	return status;
+}
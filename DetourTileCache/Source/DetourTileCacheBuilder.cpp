@@ -1723,12 +1723,143 @@ static dtStatus removeVertex(dtTileCachePolyMesh& mesh, const unsigned short rem
 }
 
 
+// Merges the triangles of a contour into convex polygons.
+static void mergeContourPolys(unsigned short* polys, int& npolys, const unsigned short* verts)
+{
+	int maxVertsPerPoly =MAX_VERTS_PER_POLY ;
+	if (maxVertsPerPoly > 3)
+	{
+		for(;;)
+		{
+			// Find best polygons to merge.
+			int bestMergeVal = 0;
+			int bestPa = 0, bestPb = 0, bestEa = 0, bestEb = 0;
+			
+			for (int j = 0; j < npolys-1; ++j)
+			{
+				unsigned short* pj = &polys[j*MAX_VERTS_PER_POLY];
+				for (int k = j+1; k < npolys; ++k)
+				{
+					unsigned short* pk = &polys[k*MAX_VERTS_PER_POLY];
+					int ea, eb;
+					int v = getPolyMergeValue(pj, pk, verts, ea, eb);
+					if (v > bestMergeVal)
+					{
+						bestMergeVal = v;
+						bestPa = j;
+						bestPb = k;
+						bestEa = ea;
+						bestEb = eb;
+					}
+				}
+			}
+			
+			if (bestMergeVal > 0)
+			{
+				// Found best, merge.
+				unsigned short* pa = &polys[bestPa*MAX_VERTS_PER_POLY];
+				unsigned short* pb = &polys[bestPb*MAX_VERTS_PER_POLY];
+				mergePolys(pa, pb, bestEa, bestEb);
+				memcpy(pb, &polys[(npolys-1)*MAX_VERTS_PER_POLY], sizeof(unsigned short)*MAX_VERTS_PER_POLY);
+				npolys--;
+			}
+			else
+			{
+				// Could not merge any polygons, stop.
+				break;
+			}
+		}
+	}
+}
+
+// The contour polygons start with the record count, followed by the records.
+// Each record holds the contour vertices (x,y,z) and the polygons indexing them.
+struct dtContourPolysRecord
+{
+	unsigned int hash;
+	unsigned short nverts;
+	unsigned short npolys;
+};
+
+inline int getContourPolysRecordSize(const int nverts, const int npolys)
+{
+	return (int)sizeof(dtContourPolysRecord) + dtAlign4(nverts*3) + dtAlign4(npolys*MAX_VERTS_PER_POLY*(int)sizeof(unsigned short));
+}
+
+inline const unsigned char* getContourPolysRecordVerts(const dtContourPolysRecord* rec)
+{
+	return (const unsigned char*)rec + sizeof(dtContourPolysRecord);
+}
+
+inline const unsigned short* getContourPolysRecordPolys(const dtContourPolysRecord* rec)
+{
+	return (const unsigned short*)(getContourPolysRecordVerts(rec) + dtAlign4((int)rec->nverts*3));
+}
+
+static unsigned int hashContour(const dtTileCacheContour& cont)
+{
+	unsigned int h = 2166136261u;
+	for (int i = 0; i < cont.nverts; ++i)
+	{
+		const unsigned char* v = &cont.verts[i*4];
+		h = (h ^ v[0]) * 16777619u;
+		h = (h ^ v[1]) * 16777619u;
+		h = (h ^ v[2]) * 16777619u;
+	}
+	return h;
+}
+
+static bool contourMatchesRecord(const dtTileCacheContour& cont, const dtContourPolysRecord* rec)
+{
+	if ((int)rec->nverts != cont.nverts)
+		return false;
+	const unsigned char* rv = getContourPolysRecordVerts(rec);
+	for (int i = 0; i < cont.nverts; ++i)
+	{
+		const unsigned char* v = &cont.verts[i*4];
+		if (v[0] != rv[i*3+0] || v[1] != rv[i*3+1] || v[2] != rv[i*3+2])
+			return false;
+	}
+	return true;
+}
+
+// Polygons indexing the contour vertices only turn into the same mesh polygons when
+// no two contour vertices can be welded together, that is when they all lie in different columns.
+static bool hasUniqueColumns(const dtTileCacheContour& cont)
+{
+	for (int i = 0; i < cont.nverts; ++i)
+	{
+		const unsigned char* vi = &cont.verts[i*4];
+		for (int j = i+1; j < cont.nverts; ++j)
+		{
+			const unsigned char* vj = &cont.verts[j*4];
+			if (vi[0] == vj[0] && vi[2] == vj[2])
+				return false;
+		}
+	}
+	return true;
+}
+
 dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
 								  dtTileCacheContourSet& lcset,
 								  dtTileCachePolyMesh& mesh)
+{
+	return dtBuildTileCachePolyMesh(alloc, lcset, mesh, 0, 0, 0, 0);
+}
+
+dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
+								  dtTileCacheContourSet& lcset,
+								  dtTileCachePolyMesh& mesh,
+								  const unsigned char* prevPolys, const int prevPolysSize,
+								  unsigned char** outPolys, int* outPolysSize)
 {
 	dtAssert(alloc);
 	
+	if (outPolys)
+		*outPolys = 0;
+	if (outPolysSize)
+		*outPolysSize = 0;
+	
 	int maxVertices = 0;
 	int maxTris = 0;
 	int maxVertsPerCont = 0;
@@ -1797,23 +1928,88 @@ dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
 	if (!polys)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
+	// Index the contour polygons of the previous build by contour hash.
+	int nprev = 0;
+	if (prevPolys && prevPolysSize >= (int)sizeof(int))
+		memcpy(&nprev, prevPolys, sizeof(int));
+	const int prevLutSize = (int)dtNextPow2((unsigned int)dtMax(nprev*2, 1));
+	dtFixedArray<int> prevLut(alloc, prevLutSize);
+	if (!prevLut)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	for (int i = 0; i < prevLutSize; ++i)
+		prevLut[i] = -1;
+	int prevOffset = dtAlign4(sizeof(int));
+	for (int i = 0; i < nprev; ++i)
+	{
+		if (prevOffset + (int)sizeof(dtContourPolysRecord) > prevPolysSize)
+			break;
+		const dtContourPolysRecord* rec = (const dtContourPolysRecord*)(prevPolys + prevOffset);
+		const int recSize = getContourPolysRecordSize(rec->nverts, rec->npolys);
+		if (prevOffset + recSize > prevPolysSize || rec->npolys > rec->nverts)
+			break;
+		int bucket = (int)(rec->hash & (unsigned int)(prevLutSize-1));
+		while (prevLut[bucket] != -1)
+			bucket = (bucket+1) & (prevLutSize-1);
+		prevLut[bucket] = prevOffset;
+		prevOffset += recSize;
+	}
+	
+	// Contour polygons of this build, indexing the contour vertices.
+	const bool recordPolys = outPolys && outPolysSize;
+	const bool localPolys = recordPolys || nprev > 0;
+	dtFixedArray<unsigned short> lverts(alloc, localPolys ? maxVertsPerCont*3 : 0);
+	dtFixedArray<unsigned int> contHashes(alloc, recordPolys ? lcset.nconts : 0);
+	dtFixedArray<int> contPolys(alloc, recordPolys ? lcset.nconts*2 : 0);
+	dtFixedArray<unsigned short> recPolys(alloc, recordPolys ? maxTris*MAX_VERTS_PER_POLY : 0);
+	if (localPolys && !lverts)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	if (recordPolys && (!contHashes || !contPolys || !recPolys))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	int nrecPolys = 0;
+	
 	for (int i = 0; i < lcset.nconts; ++i)
 	{
 		dtTileCacheContour& cont = lcset.conts[i];
 		
+		if (recordPolys)
+			contPolys[i*2+1] = -1;
+		
 		// Skip null contours.
 		if (cont.nverts < 3)
 			continue;
 		
-		// Triangulate contour
-		for (int j = 0; j < cont.nverts; ++j)
-			indices[j] = (unsigned short)j;
+		// Look up the polygons of the same contour in the previous build.
+		const bool local = localPolys && hasUniqueColumns(cont);
+		const unsigned int hash = local ? hashContour(cont) : 0;
+		const dtContourPolysRecord* prevRec = 0;
+		if (local && nprev > 0)
+		{
+			int bucket = (int)(hash & (unsigned int)(prevLutSize-1));
+			while (prevLut[bucket] != -1)
+			{
+				const dtContourPolysRecord* rec = (const dtContourPolysRecord*)(prevPolys + prevLut[bucket]);
+				if (rec->hash == hash && contourMatchesRecord(cont, rec))
+				{
+					prevRec = rec;
+					break;
+				}
+				bucket = (bucket+1) & (prevLutSize-1);
+			}
+		}
 		
-		int ntris = triangulate(cont.nverts, cont.verts, &indices[0], &tris[0]);
-		if (ntris <= 0)
+		int ntris = 0;
+		if (!prevRec)
 		{
-			// TODO: issue warning!
-			ntris = -ntris;
+			// Triangulate contour
+			for (int j = 0; j < cont.nverts; ++j)
+				indices[j] = (unsigned short)j;
+			
+			ntris = triangulate(cont.nverts, cont.verts, &indices[0], &tris[0]);
+			if (ntris <= 0)
+			{
+				// TODO: issue warning!
+				ntris = -ntris;
+			}
 		}
 		
 		// Add and merge vertices.
@@ -1829,76 +2025,61 @@ dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
 			}
 		}
 		
-		// Build initial polygons.
 		int npolys = 0;
 		memset(polys, 0xff, sizeof(unsigned short) * maxVertsPerCont * MAX_VERTS_PER_POLY);
-		for (int j = 0; j < ntris; ++j)
+		if (prevRec)
 		{
-			const unsigned short* t = &tris[j*3];
-			if (t[0] != t[1] && t[0] != t[2] && t[1] != t[2])
-			{
-				polys[npolys*MAX_VERTS_PER_POLY+0] = indices[t[0]];
-				polys[npolys*MAX_VERTS_PER_POLY+1] = indices[t[1]];
-				polys[npolys*MAX_VERTS_PER_POLY+2] = indices[t[2]];
-				npolys++;
-			}
+			npolys = (int)prevRec->npolys;
+			memcpy(polys, getContourPolysRecordPolys(prevRec), sizeof(unsigned short)*npolys*MAX_VERTS_PER_POLY);
 		}
-		if (!npolys)
-			continue;
-		
-		// Merge polygons.
-		int maxVertsPerPoly =MAX_VERTS_PER_POLY ;
-		if (maxVertsPerPoly > 3)
+		else
 		{
-			for(;;)
+			// Build initial polygons.
+			for (int j = 0; j < ntris; ++j)
 			{
-				// Find best polygons to merge.
-				int bestMergeVal = 0;
-				int bestPa = 0, bestPb = 0, bestEa = 0, bestEb = 0;
-				
-				for (int j = 0; j < npolys-1; ++j)
-				{
-					unsigned short* pj = &polys[j*MAX_VERTS_PER_POLY];
-					for (int k = j+1; k < npolys; ++k)
-					{
-						unsigned short* pk = &polys[k*MAX_VERTS_PER_POLY];
-						int ea, eb;
-						int v = getPolyMergeValue(pj, pk, mesh.verts, ea, eb);
-						if (v > bestMergeVal)
-						{
-							bestMergeVal = v;
-							bestPa = j;
-							bestPb = k;
-							bestEa = ea;
-							bestEb = eb;
-						}
-					}
-				}
-				
-				if (bestMergeVal > 0)
+				const unsigned short* t = &tris[j*3];
+				if (t[0] != t[1] && t[0] != t[2] && t[1] != t[2])
 				{
-					// Found best, merge.
-					unsigned short* pa = &polys[bestPa*MAX_VERTS_PER_POLY];
-					unsigned short* pb = &polys[bestPb*MAX_VERTS_PER_POLY];
-					mergePolys(pa, pb, bestEa, bestEb);
-					memcpy(pb, &polys[(npolys-1)*MAX_VERTS_PER_POLY], sizeof(unsigned short)*MAX_VERTS_PER_POLY);
-					npolys--;
+					polys[npolys*MAX_VERTS_PER_POLY+0] = local ? t[0] : indices[t[0]];
+					polys[npolys*MAX_VERTS_PER_POLY+1] = local ? t[1] : indices[t[1]];
+					polys[npolys*MAX_VERTS_PER_POLY+2] = local ? t[2] : indices[t[2]];
+					npolys++;
 				}
-				else
+			}
+			
+			// Merge polygons.
+			if (local)
+			{
+				for (int j = 0; j < cont.nverts; ++j)
 				{
-					// Could not merge any polygons, stop.
-					break;
+					lverts[j*3+0] = (unsigned short)cont.verts[j*4+0];
+					lverts[j*3+1] = (unsigned short)cont.verts[j*4+1];
+					lverts[j*3+2] = (unsigned short)cont.verts[j*4+2];
 				}
+				mergeContourPolys(polys, npolys, lverts);
+			}
+			else
+			{
+				mergeContourPolys(polys, npolys, mesh.verts);
 			}
 		}
 		
+		if (local && recordPolys)
+		{
+			contHashes[i] = hash;
+			contPolys[i*2+0] = nrecPolys;
+			contPolys[i*2+1] = npolys;
+			memcpy(&recPolys[nrecPolys*MAX_VERTS_PER_POLY], polys, sizeof(unsigned short)*npolys*MAX_VERTS_PER_POLY);
+			nrecPolys += npolys;
+		}
+		
 		// Store polygons.
 		for (int j = 0; j < npolys; ++j)
 		{
 			unsigned short* p = &mesh.polys[mesh.npolys*MAX_VERTS_PER_POLY*2];
 			unsigned short* q = &polys[j*MAX_VERTS_PER_POLY];
 			for (int k = 0; k < MAX_VERTS_PER_POLY; ++k)
-				p[k] = q[k];
+				p[k] = (local && q[k] != DT_TILECACHE_NULL_IDX) ? indices[q[k]] : q[k];
 			mesh.areas[mesh.npolys] = cont.area;
 			mesh.npolys++;
 			if (mesh.npolys > maxTris)
@@ -1906,6 +2087,49 @@ dtStatus dtBuildTileCachePolyMesh(dtTileCacheAlloc* alloc,
 		}
 	}
 	
+	if (recordPolys)
+	{
+		int nrecs = 0;
+		int size = dtAlign4(sizeof(int));
+		for (int i = 0; i < lcset.nconts; ++i)
+		{
+			if (contPolys[i*2+1] < 0)
+				continue;
+			size += getContourPolysRecordSize(lcset.conts[i].nverts, contPolys[i*2+1]);
+			nrecs++;
+		}
+		
+		unsigned char* data = (unsigned char*)dtAlloc(size, DT_ALLOC_PERM);
+		if (!data)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(data, 0, size);
+		memcpy(data, &nrecs, sizeof(int));
+		int offset = dtAlign4(sizeof(int));
+		for (int i = 0; i < lcset.nconts; ++i)
+		{
+			const int npolys = contPolys[i*2+1];
+			if (npolys < 0)
+				continue;
+			const dtTileCacheContour& cont = lcset.conts[i];
+			dtContourPolysRecord* rec = (dtContourPolysRecord*)(data + offset);
+			rec->hash = contHashes[i];
+			rec->nverts = (unsigned short)cont.nverts;
+			rec->npolys = (unsigned short)npolys;
+			unsigned char* rv = (unsigned char*)getContourPolysRecordVerts(rec);
+			for (int j = 0; j < cont.nverts; ++j)
+			{
+				rv[j*3+0] = cont.verts[j*4+0];
+				rv[j*3+1] = cont.verts[j*4+1];
+				rv[j*3+2] = cont.verts[j*4+2];
+			}
+			memcpy((unsigned short*)getContourPolysRecordPolys(rec), &recPolys[contPolys[i*2+0]*MAX_VERTS_PER_POLY],
+				   sizeof(unsigned short)*npolys*MAX_VERTS_PER_POLY);
+			offset += getContourPolysRecordSize(cont.nverts, npolys);
+		}
+		*outPolys = data;
+		*outPolysSize = size;
+	}
+	
 	
 	// Remove edge vertices.
 	for (int i = 0; i < mesh.nverts; ++i)
@@ -1977,6 +2201,9 @@ dtStatus dtMarkCylinderArea(dtTileCacheLayer& layer, const float* orig, const fl
 			const float dz = (float)(z+0.5f) - pz;
 			if (dx*dx + dz*dz > r2)
 				continue;
+			// Leave the holes of the layer alone, their heights are not valid.
+			if (layer.areas[x+z*w] == DT_TILECACHE_NULL_AREA)
+				continue;
 			const int y = layer.heights[x+z*w];
 			if (y < miny || y > maxy)
 				continue;
@@ -2016,6 +2243,9 @@ dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float c
 	{
 		for (int x = minx; x <= maxx; ++x)
 		{
+			// Leave the holes of the layer alone, their heights are not valid.
+			if (layer.areas[x+z*w] == DT_TILECACHE_NULL_AREA)
+				continue;
 			const int y = layer.heights[x+z*w];
 			if (y < miny || y > maxy)
 				continue;
@@ -2070,9 +2300,81 @@ dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float c
 			float zrot = rotAux[1]*z2 - rotAux[0]*x2;
 			if (zrot > zhalf || zrot < -zhalf)
 				continue;
+			// Leave the holes of the layer alone, their heights are not valid.
+			if (layer.areas[x+z*w] == DT_TILECACHE_NULL_AREA)
+				continue;
+			const int y = layer.heights[x+z*w];
+			if (y < miny || y > maxy)
+				continue;
+			layer.areas[x+z*w] = areaId;
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtMarkConvexPolyArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+							  const float* verts, const int nverts, const float hmin, const float hmax,
+							  const unsigned char areaId)
+{
+	const int w = (int)layer.header->width;
+	const int h = (int)layer.header->height;
+	const float ics = 1.0f/cs;
+	const float ich = 1.0f/ch;
+
+	float bmin[3], bmax[3];
+	dtVcopy(bmin, verts);
+	dtVcopy(bmax, verts);
+	for (int i = 1; i < nverts; ++i)
+	{
+		dtVmin(bmin, &verts[i*3]);
+		dtVmax(bmax, &verts[i*3]);
+	}
+
+	int minx = (int)floorf((bmin[0]-orig[0])*ics);
+	int miny = (int)floorf((hmin-orig[1])*ich);
+	int minz = (int)floorf((bmin[2]-orig[2])*ics);
+	int maxx = (int)floorf((bmax[0]-orig[0])*ics);
+	int maxy = (int)floorf((hmax-orig[1])*ich);
+	int maxz = (int)floorf((bmax[2]-orig[2])*ics);
+
+	if (maxx < 0) return DT_SUCCESS;
+	if (minx >= w) return DT_SUCCESS;
+	if (maxz < 0) return DT_SUCCESS;
+	if (minz >= h) return DT_SUCCESS;
+
+	if (minx < 0) minx = 0;
+	if (maxx >= w) maxx = w-1;
+	if (minz < 0) minz = 0;
+	if (maxz >= h) maxz = h-1;
+
+	// Like the boxes, the polygon is grown by half a cell so that thin obstacles still mark the cells they cross.
+	const float maxDistSqr = dtSqr(0.5f*cs);
+
+	for (int z = minz; z <= maxz; ++z)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			if (layer.areas[x+z*w] == DT_TILECACHE_NULL_AREA)
+				continue;
 			const int y = layer.heights[x+z*w];
 			if (y < miny || y > maxy)
 				continue;
+			float p[3];
+			p[0] = orig[0] + (x+0.5f)*cs;
+			p[1] = 0.0f;
+			p[2] = orig[2] + (z+0.5f)*cs;
+			if (!dtPointInPolygon(p, verts, nverts))
+			{
+				bool near = false;
+				for (int i = 0, j = nverts-1; i < nverts && !near; j = i++)
+				{
+					float t;
+					near = dtDistancePtSegSqr2D(p, &verts[j*3], &verts[i*3], t) <= maxDistSqr;
+				}
+				if (!near)
+					continue;
+			}
 			layer.areas[x+z*w] = areaId;
 		}
 	}
@@ -2138,6 +2440,38 @@ void dtFreeTileCacheLayer(dtTileCacheAlloc* alloc, dtTileCacheLayer* layer)
 	alloc->free(layer);
 }
 
+// Allocates a layer and its grids as one blob, the grids are left to be filled.
+static dtStatus allocTileCacheLayer(dtTileCacheAlloc* alloc, const dtTileCacheLayerHeader* srcHeader,
+									dtTileCacheLayer** layerOut)
+{
+	const int layerSize = dtAlign4(sizeof(dtTileCacheLayer));
+	const int headerSize = dtAlign4(sizeof(dtTileCacheLayerHeader));
+	const int gridSize = (int)srcHeader->width * (int)srcHeader->height;
+	const int bufferSize = layerSize + headerSize + gridSize*4;
+	
+	unsigned char* buffer = (unsigned char*)alloc->alloc(bufferSize);
+	if (!buffer)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(buffer, 0, bufferSize);
+
+	dtTileCacheLayer* layer = (dtTileCacheLayer*)buffer;
+	dtTileCacheLayerHeader* header = (dtTileCacheLayerHeader*)(buffer + layerSize);
+	unsigned char* grids = buffer + layerSize + headerSize;
+	
+	// Copy header
+	memcpy(header, srcHeader, headerSize);
+	
+	layer->header = header;
+	layer->heights = grids;
+	layer->areas = grids + gridSize;
+	layer->cons = grids + gridSize*2;
+	layer->regs = grids + gridSize*3;
+	
+	*layerOut = layer;
+	
+	return DT_SUCCESS;
+}
+
 dtStatus dtDecompressTileCacheLayer(dtTileCacheAlloc* alloc, dtTileCacheCompressor* comp,
 									unsigned char* compressed, const int compressedSize,
 									dtTileCacheLayer** layerOut)
@@ -2158,38 +2492,48 @@ dtStatus dtDecompressTileCacheLayer(dtTileCacheAlloc* alloc, dtTileCacheCompress
 	if (compressedHeader->version != DT_TILECACHE_VERSION)
 		return DT_FAILURE | DT_WRONG_VERSION;
 	
-	const int layerSize = dtAlign4(sizeof(dtTileCacheLayer));
 	const int headerSize = dtAlign4(sizeof(dtTileCacheLayerHeader));
 	const int gridSize = (int)compressedHeader->width * (int)compressedHeader->height;
-	const int bufferSize = layerSize + headerSize + gridSize*4;
 	
-	unsigned char* buffer = (unsigned char*)alloc->alloc(bufferSize);
-	if (!buffer)
-		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	memset(buffer, 0, bufferSize);
-
-	dtTileCacheLayer* layer = (dtTileCacheLayer*)buffer;
-	dtTileCacheLayerHeader* header = (dtTileCacheLayerHeader*)(buffer + layerSize);
-	unsigned char* grids = buffer + layerSize + headerSize;
-	const int gridsSize = bufferSize - (layerSize + headerSize); 
+	dtTileCacheLayer* layer = 0;
+	dtStatus status = allocTileCacheLayer(alloc, compressedHeader, &layer);
+	if (dtStatusFailed(status))
+		return status;
 	
-	// Copy header
-	memcpy(header, compressedHeader, headerSize);
 	// Decompress grid.
 	int size = 0;
-	dtStatus status = comp->decompress(compressed+headerSize, compressedSize-headerSize,
-									   grids, gridsSize, &size);
+	status = comp->decompress(compressed+headerSize, compressedSize-headerSize,
+							  layer->heights, gridSize*4, &size);
 	if (dtStatusFailed(status))
 	{
-		alloc->free(buffer);
+		alloc->free(layer);
 		return status;
 	}
 	
-	layer->header = header;
-	layer->heights = grids;
-	layer->areas = grids + gridSize;
-	layer->cons = grids + gridSize*2;
-	layer->regs = grids + gridSize*3;
+	*layerOut = layer;
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtCreateTileCacheLayer(dtTileCacheAlloc* alloc, const dtTileCacheLayerHeader* header,
+								const unsigned char* grids, dtTileCacheLayer** layerOut)
+{
+	dtAssert(alloc);
+
+	if (!layerOut)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!header || !grids)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*layerOut = 0;
+	
+	dtTileCacheLayer* layer = 0;
+	dtStatus status = allocTileCacheLayer(alloc, header, &layer);
+	if (dtStatusFailed(status))
+		return status;
+	
+	const int gridSize = (int)header->width * (int)header->height;
+	memcpy(layer->heights, grids, gridSize*3);
 	
 	*layerOut = layer;
 	
@@ -0,0 +1,355 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourTileCacheCompressor.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#include "DetourAlloc.h"
+#include <string.h>
+
+// The compressed stream starts with a flags byte, followed by tokens:
+// - 0LLLLLLL: literal run, the next L+1 bytes are copied as is.
+// - 1LLLLLLL: match, L+MIN_MATCH bytes are copied from earlier output at the 16 bit
+//   little endian offset-1 that follows. When L is 127, extra length bytes come first,
+//   each adding its value, until a byte smaller than 255.
+// Offset 1 repeats the previous byte, so long runs of equal cells cost a few bytes.
+// With LAYER_GRID_PREDICTOR the flags byte is followed by the 16 bit little endian row width.
+static const unsigned char LAYER_DELTA_HEIGHTS = 0x01;	///< The heights are stored as differences to the previous cell.
+static const unsigned char LAYER_GRID_PREDICTOR = 0x02;	///< The grids are stored as differences to the neighbour cells.
+
+static const int MIN_MATCH = 4;			// Matches shorter than this do not pay for their token.
+static const int MAX_LITERALS = 128;
+static const int MAX_OFFSET = 65536;
+static const int HASH_BITS = 13;
+static const int HASH_SIZE = 1 << HASH_BITS;
+
+inline unsigned int hashBytes(const unsigned char* p)
+{
+	const unsigned int v = (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+		((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+inline int matchLength(const unsigned char* data, const int from, const int to, const int n)
+{
+	int len = 0;
+	while (to + len < n && data[from + len] == data[to + len])
+		len++;
+	return len;
+}
+
+// Predicts a height from the cells on the left, above and above left, like the LOCO-I predictor.
+// Follows the slopes, and picks the closest neighbour along the steps.
+inline int predictHeight(const int left, const int up, const int upLeft)
+{
+	if (upLeft >= dtMax(left, up))
+		return dtMin(left, up);
+	if (upLeft <= dtMin(left, up))
+		return dtMax(left, up);
+	return left + up - upLeft;
+}
+
+// Stores each height as its difference to the predicted height.
+static void encodeHeights(const unsigned char* heights, unsigned char* out, const int w)
+{
+	out[0] = heights[0];
+	for (int x = 1; x < w; ++x)
+		out[x] = (unsigned char)(heights[x] - heights[x-1]);
+	for (int y = 1; y < w; ++y)
+	{
+		const unsigned char* row = heights + y*w;
+		const unsigned char* up = row - w;
+		unsigned char* dst = out + y*w;
+		dst[0] = (unsigned char)(row[0] - up[0]);
+		for (int x = 1; x < w; ++x)
+			dst[x] = (unsigned char)(row[x] - predictHeight(row[x-1], up[x], up[x-1]));
+	}
+}
+
+static void decodeHeights(unsigned char* heights, const int w)
+{
+	for (int x = 1; x < w; ++x)
+		heights[x] = (unsigned char)(heights[x] + heights[x-1]);
+	for (int y = 1; y < w; ++y)
+	{
+		unsigned char* row = heights + y*w;
+		const unsigned char* up = row - w;
+		row[0] = (unsigned char)(row[0] + up[0]);
+		for (int x = 1; x < w; ++x)
+			row[x] = (unsigned char)(row[x] + predictHeight(row[x-1], up[x], up[x-1]));
+	}
+}
+
+// Areas and connections mostly repeat the cell above, or the cell on the left along the first row.
+// The cells are stored xored with it, which leaves long runs of zeros.
+static void encodeCells(const unsigned char* cells, unsigned char* out, const int w)
+{
+	const int gridSize = w*w;
+	out[0] = cells[0];
+	for (int i = 1; i < w; ++i)
+		out[i] = (unsigned char)(cells[i] ^ cells[i-1]);
+	for (int i = w; i < gridSize; ++i)
+		out[i] = (unsigned char)(cells[i] ^ cells[i-w]);
+}
+
+static void decodeCells(unsigned char* cells, const int w)
+{
+	const int gridSize = w*w;
+	for (int i = 1; i < w; ++i)
+		cells[i] ^= cells[i-1];
+	for (int i = w; i < gridSize; ++i)
+		cells[i] ^= cells[i-w];
+}
+
+// Returns the row width of square layer grids, or 0 if the buffer is not made of three square grids.
+static int layerGridWidth(const int bufferSize)
+{
+	if (bufferSize <= 0 || (bufferSize % 3) != 0)
+		return 0;
+	const int gridSize = bufferSize / 3;
+	int w = (int)dtMathSqrtf((float)gridSize);
+	while (w*w > gridSize)
+		w--;
+	while ((w+1)*(w+1) <= gridSize)
+		w++;
+	return (w*w == gridSize && w <= 0xffff) ? w : 0;
+}
+
+static unsigned char* writeLiterals(unsigned char* out, const unsigned char* src, int n)
+{
+	while (n > 0)
+	{
+		const int len = dtMin(n, MAX_LITERALS);
+		*out++ = (unsigned char)(len - 1);
+		memcpy(out, src, len);
+		out += len;
+		src += len;
+		n -= len;
+	}
+	return out;
+}
+
+static unsigned char* writeMatch(unsigned char* out, int len, const int offset)
+{
+	len -= MIN_MATCH;
+	if (len < 127)
+	{
+		*out++ = (unsigned char)(0x80 | len);
+	}
+	else
+	{
+		*out++ = 0xff;
+		len -= 127;
+		while (len >= 255)
+		{
+			*out++ = 255;
+			len -= 255;
+		}
+		*out++ = (unsigned char)len;
+	}
+	*out++ = (unsigned char)((offset - 1) & 0xff);
+	*out++ = (unsigned char)((offset - 1) >> 8);
+	return out;
+}
+
+dtTileCacheLayerCompressor::~dtTileCacheLayerCompressor()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+int dtTileCacheLayerCompressor::maxCompressedSize(const int bufferSize)
+{
+	// Every match saves at least the token it adds, so the worst case is all literals.
+	return 3 + bufferSize + (bufferSize + MAX_LITERALS - 1) / MAX_LITERALS;
+}
+
+dtStatus dtTileCacheLayerCompressor::compress(const unsigned char* buffer, const int bufferSize,
+											  unsigned char* compressed, const int maxSize, int* compressedSize)
+{
+	if (bufferSize < 0 || maxSize < maxCompressedSize(bufferSize))
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	
+	unsigned char* mem = (unsigned char*)dtAlloc(sizeof(int)*HASH_SIZE + bufferSize, DT_ALLOC_TEMP);
+	if (!mem)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	int* table = (int*)mem;
+	unsigned char* data = mem + sizeof(int)*HASH_SIZE;
+	memset(table, 0xff, sizeof(int)*HASH_SIZE);
+	
+	// The layer is made of heights, areas and connections of the same size.
+	// Neighbour cells are close, their differences compress better.
+	unsigned char flags = 0;
+	const int w = layerGridWidth(bufferSize);
+	if (w > 0)
+	{
+		const int gridSize = bufferSize / 3;
+		encodeHeights(buffer, data, w);
+		encodeCells(buffer + gridSize, data + gridSize, w);
+		encodeCells(buffer + gridSize*2, data + gridSize*2, w);
+		flags |= LAYER_GRID_PREDICTOR;
+	}
+	else
+	{
+		memcpy(data, buffer, bufferSize);
+	}
+	
+	unsigned char* out = compressed;
+	*out++ = flags;
+	if (flags & LAYER_GRID_PREDICTOR)
+	{
+		*out++ = (unsigned char)(w & 0xff);
+		*out++ = (unsigned char)(w >> 8);
+	}
+	
+	int anchor = 0;
+	int i = 0;
+	while (i + MIN_MATCH <= bufferSize)
+	{
+		// Runs are the most common pattern, try them before the hashed candidate.
+		int bestLen = i > 0 ? matchLength(data, i-1, i, bufferSize) : 0;
+		int bestOffset = 1;
+		
+		const unsigned int h = hashBytes(data + i);
+		const int cand = table[h];
+		table[h] = i;
+		if (cand >= 0 && i - cand > 1 && i - cand <= MAX_OFFSET)
+		{
+			const int len = matchLength(data, cand, i, bufferSize);
+			if (len > bestLen)
+			{
+				bestLen = len;
+				bestOffset = i - cand;
+			}
+		}
+		
+		if (bestLen >= MIN_MATCH)
+		{
+			out = writeLiterals(out, data + anchor, i - anchor);
+			out = writeMatch(out, bestLen, bestOffset);
+			i += bestLen;
+			anchor = i;
+			// Index the end of the match so that the next rows can refer to it.
+			if (i - 1 + MIN_MATCH <= bufferSize)
+				table[hashBytes(data + i - 1)] = i - 1;
+		}
+		else
+		{
+			i++;
+		}
+	}
+	out = writeLiterals(out, data + anchor, bufferSize - anchor);
+	
+	dtFree(mem);
+	
+	*compressedSize = (int)(out - compressed);
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileCacheLayerCompressor::decompress(const unsigned char* compressed, const int compressedSize,
+												unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+{
+	if (compressedSize < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const unsigned char flags = compressed[0];
+	if (flags & ~(LAYER_DELTA_HEIGHTS | LAYER_GRID_PREDICTOR))
+		return DT_FAILURE | DT_WRONG_VERSION;
+	
+	int ip = 1;
+	int w = 0;
+	if (flags & LAYER_GRID_PREDICTOR)
+	{
+		if (compressedSize < 3)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		w = (int)compressed[1] | ((int)compressed[2] << 8);
+		ip = 3;
+	}
+	int op = 0;
+	while (ip < compressedSize)
+	{
+		const int token = compressed[ip++];
+		if (token < 0x80)
+		{
+			const int len = token + 1;
+			if (len > compressedSize - ip)
+				return DT_FAILURE | DT_INVALID_PARAM;
+			if (len > maxBufferSize - op)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			memcpy(buffer + op, compressed + ip, len);
+			ip += len;
+			op += len;
+		}
+		else
+		{
+			int len = token & 0x7f;
+			if (len == 127)
+			{
+				int extra = 255;
+				while (extra == 255)
+				{
+					if (ip >= compressedSize)
+						return DT_FAILURE | DT_INVALID_PARAM;
+					extra = compressed[ip++];
+					len += extra;
+					if (len > maxBufferSize)
+						return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+				}
+			}
+			len += MIN_MATCH;
+			if (compressedSize - ip < 2)
+				return DT_FAILURE | DT_INVALID_PARAM;
+			const int offset = ((int)compressed[ip] | ((int)compressed[ip+1] << 8)) + 1;
+			ip += 2;
+			if (offset > op)
+				return DT_FAILURE | DT_INVALID_PARAM;
+			if (len > maxBufferSize - op)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			
+			unsigned char* dst = buffer + op;
+			const unsigned char* src = dst - offset;
+			if (offset == 1)
+				memset(dst, *src, len);
+			else if (offset >= len)
+				memcpy(dst, src, len);
+			else
+				for (int k = 0; k < len; ++k)
+					dst[k] = src[k];
+			op += len;
+		}
+	}
+	
+	if (flags & LAYER_DELTA_HEIGHTS)
+	{
+		if ((op % 3) != 0)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		const int gridSize = op / 3;
+		for (int i = 1; i < gridSize; ++i)
+			buffer[i] = (unsigned char)(buffer[i] + buffer[i-1]);
+	}
+	if (flags & LAYER_GRID_PREDICTOR)
+	{
+		if (op != 3*w*w)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		const int gridSize = w*w;
+		decodeHeights(buffer, w);
+		decodeCells(buffer + gridSize, w);
+		decodeCells(buffer + gridSize*2, w);
+	}
+	
+	*bufferSize = op;
+	return DT_SUCCESS;
+}
@@ -91,6 +91,7 @@ private:
 	Sample_TempObstacles(const Sample_TempObstacles&);
 	Sample_TempObstacles& operator=(const Sample_TempObstacles&);
 
+	friend struct RecastTileLayerSource;
 	int rasterizeTileLayers(const int tx, const int ty, const rcConfig& cfg, struct TileCacheData* tiles, const int maxTiles);
 };
 
@@ -164,6 +164,7 @@ void CrowdToolState::init(class Sample* sample)
 		memcpy(&params, crowd->getObstacleAvoidanceParams(0), sizeof(dtObstacleAvoidanceParams));
 		
 		// Low (11)
+		params.mode = DT_OBSTACLE_AVOIDANCE_ADAPTIVE;
 		params.velBias = 0.5f;
 		params.adaptiveDivs = 5;
 		params.adaptiveRings = 2;
@@ -191,6 +192,10 @@ void CrowdToolState::init(class Sample* sample)
 		params.adaptiveDepth = 3;
 		
 		crowd->setObstacleAvoidanceParams(3, &params);
+		
+		// ORCA
+		params.mode = DT_OBSTACLE_AVOIDANCE_ORCA;
+		crowd->setObstacleAvoidanceParams(4, &params);
 	}
 }
 
@@ -930,7 +935,7 @@ void CrowdTool::handleMenu()
 			params->m_obstacleAvoidance = !params->m_obstacleAvoidance;
 			m_state->updateAgentParams();
 		}
-		if (imguiSlider("Avoidance Quality", &params->m_obstacleAvoidanceType, 0.0f, 3.0f, 1.0f))
+		if (imguiSlider("Avoidance Quality", &params->m_obstacleAvoidanceType, 0.0f, 4.0f, 1.0f))
 		{
 			m_state->updateAgentParams();
 		}
@@ -980,7 +980,8 @@ static void getPolyCenter(dtNavMesh* navMesh, dtPolyRef ref, float* center)
 		
 	for (int i = 0; i < (int)poly->vertCount; ++i)
 	{
-		const float* v = &tile->verts[poly->verts[i]*3];
+		float v[3];
+		dtGetTileVert(tile, poly->verts[i], v);
 		center[0] += v[0];
 		center[1] += v[1];
 		center[2] += v[2];
@@ -40,6 +40,7 @@
 #include "DetourDebugDraw.h"
 #include "DetourCommon.h"
 #include "DetourTileCache.h"
+#include "DetourTileCacheBake.h"
 #include "NavMeshTesterTool.h"
 #include "OffMeshConnectionTool.h"
 #include "ConvexVolumeTool.h"
@@ -469,6 +470,59 @@ int Sample_TempObstacles::rasterizeTileLayers(
 	return n;
 }
 
+// Bakes the layers of the sample by rasterizing the input geometry with Recast.
+// The sample context is not thread safe, so the bake runs without a task runner.
+struct RecastTileLayerSource : public dtTileCacheLayerSource
+{
+	Sample_TempObstacles* sample;
+	const rcConfig* cfg;
+	
+	RecastTileLayerSource(Sample_TempObstacles* s, const rcConfig* c) : sample(s), cfg(c) {}
+	
+	virtual dtStatus buildTileLayers(const int tx, const int ty, const int /*worker*/,
+									 dtTileCacheLayerData* layers, const int maxLayers, int* layerCount)
+	{
+		TileCacheData tiles[MAX_LAYERS];
+		memset(tiles, 0, sizeof(tiles));
+		const int ntiles = sample->rasterizeTileLayers(tx, ty, *cfg, tiles, rcMin(maxLayers, MAX_LAYERS));
+		for (int i = 0; i < ntiles; ++i)
+		{
+			layers[i].data = tiles[i].data;
+			layers[i].dataSize = tiles[i].dataSize;
+		}
+		*layerCount = ntiles;
+		return DT_SUCCESS;
+	}
+};
+
+// Adds the baked layers to the tile cache and keeps the cache statistics.
+struct TileCacheLayerSink : public dtTileCacheLayerSink
+{
+	dtTileCache* tileCache;
+	int rawLayerSize;
+	int layerCount;
+	int compressedSize;
+	int rawSize;
+	
+	TileCacheLayerSink(dtTileCache* tc, const int layerSize) :
+		tileCache(tc), rawLayerSize(layerSize), layerCount(0), compressedSize(0), rawSize(0) {}
+	
+	virtual dtStatus addLayer(unsigned char* data, const int dataSize)
+	{
+		dtStatus status = tileCache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
+		if (dtStatusFailed(status))
+		{
+			// Skip the layers which do not fit, like the tiles outside the cache.
+			dtFree(data);
+			return DT_SUCCESS;
+		}
+		layerCount++;
+		compressedSize += dataSize;
+		rawSize += rawLayerSize;
+		return DT_SUCCESS;
+	}
+};
+
 
 void drawTiles(duDebugDraw* dd, dtTileCache* tc)
 {
@@ -1312,35 +1366,22 @@ bool Sample_TempObstacles::handleBuild()
 	
 	m_ctx->resetTimers();
 	
-	m_cacheLayerCount = 0;
-	m_cacheCompressedSize = 0;
-	m_cacheRawSize = 0;
+	RecastTileLayerSource source(this, &cfg);
+	TileCacheLayerSink sink(m_tileCache, calcLayerBufferSize(tcparams.width, tcparams.height));
 	
-	for (int y = 0; y < th; ++y)
-	{
-		for (int x = 0; x < tw; ++x)
-		{
-			TileCacheData tiles[MAX_LAYERS];
-			memset(tiles, 0, sizeof(tiles));
-			int ntiles = rasterizeTileLayers(x, y, cfg, tiles, MAX_LAYERS);
-
-			for (int i = 0; i < ntiles; ++i)
-			{
-				TileCacheData* tile = &tiles[i];
-				status = m_tileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
-				if (dtStatusFailed(status))
-				{
-					dtFree(tile->data);
-					tile->data = 0;
-					continue;
-				}
-				
-				m_cacheLayerCount++;
-				m_cacheCompressedSize += tile->dataSize;
-				m_cacheRawSize += calcLayerBufferSize(tcparams.width, tcparams.height);
-			}
-		}
-	}
+	dtTileCacheBakeParams bakeParams;
+	bakeParams.tilesX = tw;
+	bakeParams.tilesY = th;
+	bakeParams.maxLayersPerTile = MAX_LAYERS;
+	bakeParams.maxTilesInFlight = tw;
+	
+	status = dtBakeTileCacheLayers(&bakeParams, &source, &sink, 0, 1);
+	if (dtStatusFailed(status))
+		m_ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not bake tile cache layers.");
+	
+	m_cacheLayerCount = sink.layerCount;
+	m_cacheCompressedSize = sink.compressedSize;
+	m_cacheRawSize = sink.rawSize;
 
 	// Build initial meshes
 	m_ctx->startTimer(RC_TIMER_TOTAL);
@@ -1395,8 +1436,11 @@ void Sample_TempObstacles::getTilePos(const float* pos, int& tx, int& ty)
 }
 
 static const int TILECACHESET_MAGIC = 'T'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'TSET';
-static const int TILECACHESET_VERSION = 1;
+static const int TILECACHESET_VERSION = 2;
 
+// The set stores the compressed tiles, then the navmesh tiles, then the obstacle state,
+// so that loading it restores the tile cache without rebuilding any tile.
+// Version 1 sets only hold the compressed tiles, their navmesh tiles are built when loading.
 struct TileCacheSetHeader
 {
 	int magic;
@@ -1406,12 +1450,25 @@ struct TileCacheSetHeader
 	dtTileCacheParams cacheParams;
 };
 
+// Follows the header since version 2.
+struct TileCacheSetContents
+{
+	int numNavTiles;
+	int obstacleStateSize;
+};
+
 struct TileCacheTileHeader
 {
 	dtCompressedTileRef tileRef;
 	int dataSize;
 };
 
+struct TileCacheNavTileHeader
+{
+	dtTileRef tileRef;
+	int dataSize;
+};
+
 void Sample_TempObstacles::saveAll(const char* path)
 {
 	if (!m_tileCache) return;
@@ -1435,6 +1492,18 @@ void Sample_TempObstacles::saveAll(const char* path)
 	memcpy(&header.meshParams, m_navMesh->getParams(), sizeof(dtNavMeshParams));
 	fwrite(&header, sizeof(TileCacheSetHeader), 1, fp);
 
+	const dtNavMesh* navMesh = m_navMesh;
+	TileCacheSetContents contents;
+	contents.numNavTiles = 0;
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize) continue;
+		contents.numNavTiles++;
+	}
+	contents.obstacleStateSize = m_tileCache->getObstacleStateSize();
+	fwrite(&contents, sizeof(TileCacheSetContents), 1, fp);
+
 	// Store tiles.
 	for (int i = 0; i < m_tileCache->getTileCount(); ++i)
 	{
@@ -1449,6 +1518,29 @@ void Sample_TempObstacles::saveAll(const char* path)
 		fwrite(tile->data, tile->dataSize, 1, fp);
 	}
 
+	// Store navmesh tiles.
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize) continue;
+
+		TileCacheNavTileHeader tileHeader;
+		tileHeader.tileRef = navMesh->getTileRef(tile);
+		tileHeader.dataSize = tile->dataSize;
+		fwrite(&tileHeader, sizeof(tileHeader), 1, fp);
+
+		fwrite(tile->data, tile->dataSize, 1, fp);
+	}
+
+	// Store obstacles.
+	unsigned char* state = (unsigned char*)dtAlloc(contents.obstacleStateSize, DT_ALLOC_TEMP);
+	if (state)
+	{
+		m_tileCache->storeObstacleState(state, contents.obstacleStateSize);
+		fwrite(state, contents.obstacleStateSize, 1, fp);
+		dtFree(state);
+	}
+
 	fclose(fp);
 }
 
@@ -1471,12 +1563,25 @@ void Sample_TempObstacles::loadAll(const char* path)
 		fclose(fp);
 		return;
 	}
-	if (header.version != TILECACHESET_VERSION)
+	if (header.version != 1 && header.version != TILECACHESET_VERSION)
 	{
 		fclose(fp);
 		return;
 	}
 	
+	TileCacheSetContents contents;
+	memset(&contents, 0, sizeof(TileCacheSetContents));
+	if (header.version >= 2)
+	{
+		size_t contentsReadReturnCode = fread(&contents, sizeof(TileCacheSetContents), 1, fp);
+		if( contentsReadReturnCode != 1)
+		{
+			// Error or early EOF
+			fclose(fp);
+			return;
+		}
+	}
+	
 	m_navMesh = dtAllocNavMesh();
 	if (!m_navMesh)
 	{
@@ -1536,9 +1641,54 @@ void Sample_TempObstacles::loadAll(const char* path)
 			dtFree(data);
 		}
 
-		if (tile)
+		// Version 1 sets do not store the navmesh tiles.
+		if (tile && header.version == 1)
 			m_tileCache->buildNavMeshTile(tile, m_navMesh);
 	}
 	
+	// Read navmesh tiles, they are added back with the same references.
+	for (int i = 0; i < contents.numNavTiles; ++i)
+	{
+		TileCacheNavTileHeader tileHeader;
+		size_t tileHeaderReadReturnCode = fread(&tileHeader, sizeof(tileHeader), 1, fp);
+		if( tileHeaderReadReturnCode != 1)
+		{
+			// Error or early EOF
+			fclose(fp);
+			return;
+		}
+		if (!tileHeader.tileRef || !tileHeader.dataSize)
+			break;
+
+		unsigned char* data = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
+		if (!data) break;
+		size_t tileDataReadReturnCode = fread(data, tileHeader.dataSize, 1, fp);
+		if( tileDataReadReturnCode != 1)
+		{
+			// Error or early EOF
+			dtFree(data);
+			fclose(fp);
+			return;
+		}
+		
+		status = m_navMesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA, tileHeader.tileRef, 0);
+		if (dtStatusFailed(status))
+		{
+			dtFree(data);
+		}
+	}
+	
+	// Read obstacles.
+	if (contents.obstacleStateSize > 0)
+	{
+		unsigned char* state = (unsigned char*)dtAlloc(contents.obstacleStateSize, DT_ALLOC_TEMP);
+		if (state)
+		{
+			if (fread(state, contents.obstacleStateSize, 1, fp) == 1)
+				m_tileCache->restoreObstacleState(state, contents.obstacleStateSize);
+			dtFree(state);
+		}
+	}
+	
 	fclose(fp);
 }
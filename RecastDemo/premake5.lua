@@ -219,7 +219,8 @@ project "Tests"
 		"../Recast/Source",
 		"../Tests/Recast",
 		"../Tests",
-		"../Tests/Contrib"
+		"../Tests/Contrib",
+		"../RecastDemo/Contrib/fastlz"
 	}
 	files { 
 		"../Tests/*.h",
@@ -230,9 +231,15 @@ project "Tests"
 		"../Tests/Detour/*.h",
 		"../Tests/Detour/*.cpp",
 		"../Tests/DetourCrowd/*.cpp",
-		"../Tests/Contrib/catch2/*.cpp"
+		"../Tests/DetourTileCache/*.h",
+		"../Tests/DetourTileCache/*.cpp",
+		"../Tests/Contrib/catch2/*.cpp",
+		"../RecastDemo/Contrib/fastlz/*.c"
 	}
 
+	-- the tile cache benchmarks read the demo meshes
+	defines { 'RECASTNAVIGATION_TEST_MESH_DIR="' .. path.getabsolute("Bin/Meshes") .. '"' }
+
 	-- project dependencies
 	links { 
 		"DebugUtils",
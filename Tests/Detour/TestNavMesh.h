@@ -0,0 +1,150 @@
+#ifndef TESTNAVMESH_H
+#define TESTNAVMESH_H
+
+#include <string.h>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+
+// Builds tile data for a flat tile made of quadsPerSide x quadsPerSide square polygons.
+// The tile borders are marked as portals so that neighbour tiles get connected.
+// Optionally adds bidirectional off-mesh connections. [(ax, ay, az, bx, by, bz) * offMeshConCount]
+inline bool buildTestTileData(int tx, int ty, int layer, float height,
+							  int quadsPerSide, float cs, unsigned char** outData, int* outDataSize,
+							  const float* offMeshConVerts = 0, int offMeshConCount = 0)
+{
+	static const int NVP = 6;
+	const int vertsPerSide = quadsPerSide + 1;
+	const int nverts = vertsPerSide * vertsPerSide;
+	const int npolys = quadsPerSide * quadsPerSide;
+	const float tileSize = quadsPerSide * cs;
+
+	unsigned short* verts = new unsigned short[nverts * 3];
+	unsigned short* polys = new unsigned short[npolys * NVP * 2];
+	unsigned short* flags = new unsigned short[npolys];
+	unsigned char* areas = new unsigned char[npolys];
+
+	for (int z = 0; z < vertsPerSide; ++z)
+	{
+		for (int x = 0; x < vertsPerSide; ++x)
+		{
+			unsigned short* v = &verts[(z * vertsPerSide + x) * 3];
+			v[0] = (unsigned short)x;
+			v[1] = 0;
+			v[2] = (unsigned short)z;
+		}
+	}
+
+	memset(polys, 0xff, sizeof(unsigned short) * npolys * NVP * 2);
+	for (int z = 0; z < quadsPerSide; ++z)
+	{
+		for (int x = 0; x < quadsPerSide; ++x)
+		{
+			const int i = z * quadsPerSide + x;
+			unsigned short* p = &polys[i * NVP * 2];
+			p[0] = (unsigned short)(z * vertsPerSide + x);
+			p[1] = (unsigned short)((z + 1) * vertsPerSide + x);
+			p[2] = (unsigned short)((z + 1) * vertsPerSide + x + 1);
+			p[3] = (unsigned short)(z * vertsPerSide + x + 1);
+			// Edges: x-, z+, x+, z-. Border edges are portals to the neighbour tiles.
+			p[NVP + 0] = x > 0 ? (unsigned short)(i - 1) : (unsigned short)(0x8000 | 0);
+			p[NVP + 1] = z < quadsPerSide - 1 ? (unsigned short)(i + quadsPerSide) : (unsigned short)(0x8000 | 1);
+			p[NVP + 2] = x < quadsPerSide - 1 ? (unsigned short)(i + 1) : (unsigned short)(0x8000 | 2);
+			p[NVP + 3] = z > 0 ? (unsigned short)(i - quadsPerSide) : (unsigned short)(0x8000 | 3);
+			flags[i] = 1;
+			areas[i] = 0;
+		}
+	}
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = verts;
+	params.vertCount = nverts;
+	params.polys = polys;
+	params.polyFlags = flags;
+	params.polyAreas = areas;
+	params.polyCount = npolys;
+	params.nvp = NVP;
+	params.tileX = tx;
+	params.tileY = ty;
+	params.tileLayer = layer;
+	params.bmin[0] = tx * tileSize;
+	params.bmin[1] = height;
+	params.bmin[2] = ty * tileSize;
+	params.bmax[0] = (tx + 1) * tileSize;
+	params.bmax[1] = height + 1.0f;
+	params.bmax[2] = (ty + 1) * tileSize;
+	params.walkableHeight = 2.0f;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 0.5f;
+	params.cs = cs;
+	params.ch = 0.5f;
+	params.buildBvTree = true;
+
+	float* offMeshConRad = new float[offMeshConCount + 1];
+	unsigned short* offMeshConFlags = new unsigned short[offMeshConCount + 1];
+	unsigned char* offMeshConAreas = new unsigned char[offMeshConCount + 1];
+	unsigned char* offMeshConDir = new unsigned char[offMeshConCount + 1];
+	for (int i = 0; i < offMeshConCount; ++i)
+	{
+		offMeshConRad[i] = 0.5f;
+		offMeshConFlags[i] = 1;
+		offMeshConAreas[i] = 0;
+		offMeshConDir[i] = 1;
+	}
+	params.offMeshConVerts = offMeshConVerts;
+	params.offMeshConRad = offMeshConRad;
+	params.offMeshConFlags = offMeshConFlags;
+	params.offMeshConAreas = offMeshConAreas;
+	params.offMeshConDir = offMeshConDir;
+	params.offMeshConCount = offMeshConCount;
+
+	const bool ok = dtCreateNavMeshData(&params, outData, outDataSize);
+
+	delete[] verts;
+	delete[] polys;
+	delete[] flags;
+	delete[] areas;
+	delete[] offMeshConRad;
+	delete[] offMeshConFlags;
+	delete[] offMeshConAreas;
+	delete[] offMeshConDir;
+	return ok;
+}
+
+// Initializes a tiled navmesh with tilesX x tilesY tiles and the given number of layers per tile.
+// Each layer is placed layerSpacing units above the previous one.
+inline bool initTestNavMesh(dtNavMesh* navmesh, int tilesX, int tilesY, int layers = 1,
+							float layerSpacing = 10.0f, int quadsPerSide = 4, float cs = 1.0f)
+{
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = quadsPerSide * cs;
+	params.tileHeight = quadsPerSide * cs;
+	params.maxTiles = tilesX * tilesY * layers;
+	params.maxPolys = quadsPerSide * quadsPerSide;
+	if (dtStatusFailed(navmesh->init(&params)))
+		return false;
+
+	for (int y = 0; y < tilesY; ++y)
+	{
+		for (int x = 0; x < tilesX; ++x)
+		{
+			for (int l = 0; l < layers; ++l)
+			{
+				unsigned char* data = 0;
+				int dataSize = 0;
+				if (!buildTestTileData(x, y, l, l * layerSpacing, quadsPerSide, cs, &data, &dataSize))
+					return false;
+				if (dtStatusFailed(navmesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)))
+				{
+					dtFree(data);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+#endif // TESTNAVMESH_H
@@ -0,0 +1,561 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+
+#include "TestNavMesh.h"
+
+// Simple run-length codec, good enough to shrink the zeroed parts of the tile data.
+struct TestRleCompressor : public dtNavMeshTileCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return bufferSize * 2;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize)
+	{
+		int n = 0;
+		for (int i = 0; i < bufferSize;)
+		{
+			int run = 1;
+			while (i + run < bufferSize && run < 255 && buffer[i + run] == buffer[i])
+				run++;
+			if (n + 2 > maxCompressedSize)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			compressed[n++] = (unsigned char)run;
+			compressed[n++] = buffer[i];
+			i += run;
+		}
+		*compressedSize = n;
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		int n = 0;
+		for (int i = 0; i + 1 < compressedSize; i += 2)
+		{
+			const int run = compressed[i];
+			if (n + run > maxBufferSize)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			memset(buffer + n, compressed[i + 1], run);
+			n += run;
+		}
+		*bufferSize = n;
+		return DT_SUCCESS;
+	}
+};
+
+TEST_CASE("dtNavMesh::compressTile")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 3, 1));
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 256)));
+
+	TestRleCompressor comp;
+	navmesh->setTileCompressor(&comp);
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = {0.5f, 1.0f, 0.5f};
+	const float startPos[3] = {0.5f, 0.0f, 0.5f};
+	const float endPos[3] = {11.5f, 0.0f, 0.5f};
+	dtPolyRef startRef = 0;
+	dtPolyRef endRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+	const dtTileRef middleRef = navmesh->getTileRefAt(1, 0, 0);
+	const dtPolyRef middlePoly = navmesh->getPolyRefBase(navmesh->getTileByRef(middleRef));
+
+	static const int MAX_PATH = 64;
+	dtPolyRef path[MAX_PATH];
+	int npath = 0;
+
+	SECTION("Compressed tile is removed from the graph and restored on touch")
+	{
+		REQUIRE(dtStatusSucceed(navmesh->compressTile(middleRef)));
+		CHECK(navmesh->isTileCompressed(middleRef));
+		CHECK_FALSE(navmesh->isValidPolyRef(middlePoly));
+		CHECK(navmesh->getTileAt(1, 0, 0) == 0);
+		CHECK(navmesh->getTileByRef(middleRef) == 0);
+
+		// The compressed tile keeps its slot but has no state to store.
+		const dtMeshTile* compressed = ((const dtNavMesh*)navmesh)->getTile((int)navmesh->decodePolyIdTile((dtPolyRef)middleRef));
+		unsigned char state[256];
+		CHECK(navmesh->getTileStateSize(compressed) == 0);
+		CHECK(dtStatusFailed(navmesh->storeTileState(compressed, state, sizeof(state))));
+
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, MAX_PATH)));
+		CHECK(path[npath - 1] != endRef);
+
+		dtNavMeshCompressionStats stats;
+		navmesh->getCompressionStats(&stats);
+		CHECK(stats.compressedTileCount == 1);
+		CHECK(stats.compressedSize < stats.uncompressedSize);
+
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		REQUIRE(dtStatusSucceed(navmesh->touchTileAndPolyByRef(middlePoly, &tile, &poly)));
+		CHECK_FALSE(navmesh->isTileCompressed(middleRef));
+		CHECK(navmesh->getTileRefAt(1, 0, 0) == middleRef);
+		CHECK(navmesh->isValidPolyRef(middlePoly));
+
+		REQUIRE(dtStatusSucceed(navmesh->touchTileAndPolyByRef(middlePoly, &tile, &poly)));
+
+		// Invalid references are neither hits nor misses.
+		CHECK(dtStatusFailed(navmesh->touchTileAndPolyByRef(middlePoly | 100, &tile, &poly)));
+		CHECK(dtStatusFailed(navmesh->touchTileAndPolyByRef(navmesh->encodePolyId(navmesh->decodePolyIdSalt(middlePoly) + 1, navmesh->decodePolyIdTile(middlePoly), 0), &tile, &poly)));
+
+		navmesh->getCompressionStats(&stats);
+		CHECK(stats.compressedTileCount == 0);
+		CHECK(stats.compressedSize == 0);
+		CHECK(stats.missCount == 1);
+		CHECK(stats.hitCount == 1);
+
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, MAX_PATH)));
+		CHECK(path[npath - 1] == endRef);
+	}
+
+	SECTION("Compressed tile can be removed")
+	{
+		REQUIRE(dtStatusSucceed(navmesh->compressTile(middleRef)));
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(middleRef, 0, 0)));
+		CHECK_FALSE(navmesh->isTileCompressed(middleRef));
+		CHECK(dtStatusFailed(navmesh->decompressTile(middleRef)));
+
+		dtNavMeshCompressionStats stats;
+		navmesh->getCompressionStats(&stats);
+		CHECK(stats.compressedTileCount == 0);
+	}
+
+	SECTION("Decompression fails if the location was taken")
+	{
+		REQUIRE(dtStatusSucceed(navmesh->compressTile(middleRef)));
+		unsigned char* data = 0;
+		int dataSize = 0;
+		REQUIRE(buildTestTileData(1, 0, 0, 0.0f, 4, 1.0f, &data, &dataSize));
+		// All tile slots are in use, so free one first.
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(2, 0, 0), 0, 0)));
+		REQUIRE(dtStatusSucceed(navmesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		CHECK(dtStatusDetail(navmesh->decompressTile(middleRef), DT_ALREADY_OCCUPIED));
+		CHECK(navmesh->isTileCompressed(middleRef));
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtQuantizeNavMeshData")
+{
+	const float offMeshConVerts[6] = {1.5f, 0.0f, 1.5f, 2.5f, 3.0f, 2.5f};
+	unsigned char* data = 0;
+	int dataSize = 0;
+	REQUIRE(buildTestTileData(0, 0, 0, 0.25f, 4, 0.5f, &data, &dataSize, offMeshConVerts, 1));
+
+	unsigned char* qdata = 0;
+	int qdataSize = 0;
+	REQUIRE(dtQuantizeNavMeshData(data, dataSize, 0.5f, 0.5f, &qdata, &qdataSize));
+	CHECK(qdataSize < dataSize);
+	CHECK(((const dtMeshHeader*)qdata)->magic == DT_NAVMESH_QUANTIZED_MAGIC);
+
+	SECTION("Round trip restores the tile data")
+	{
+		unsigned char* rdata = 0;
+		int rdataSize = 0;
+		REQUIRE(dtDequantizeNavMeshData(qdata, qdataSize, &rdata, &rdataSize));
+		REQUIRE(rdataSize == dataSize);
+
+		dtNavMesh* expected = dtAllocNavMesh();
+		dtNavMesh* actual = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(expected->init(data, dataSize, DT_TILE_FREE_DATA)));
+		REQUIRE(dtStatusSucceed(actual->init(rdata, rdataSize, DT_TILE_FREE_DATA)));
+
+		const dtMeshTile* a = ((const dtNavMesh*)expected)->getTile(0);
+		const dtMeshTile* b = ((const dtNavMesh*)actual)->getTile(0);
+		REQUIRE(a->header->vertCount == b->header->vertCount);
+		for (int i = 0; i < a->header->vertCount * 3; ++i)
+			CHECK(a->verts[i] == b->verts[i]);
+		REQUIRE(a->header->polyCount == b->header->polyCount);
+		CHECK(memcmp(a->offMeshCons, b->offMeshCons, sizeof(dtOffMeshConnection) * a->header->offMeshConCount) == 0);
+
+		dtFreeNavMesh(expected);
+		dtFreeNavMesh(actual);
+		dtFree(qdata);
+	}
+
+	SECTION("Quantized tiles stay quantized and answer queries like the original tile")
+	{
+		dtNavMesh* expected = dtAllocNavMesh();
+		dtNavMesh* actual = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(expected->init(data, dataSize, DT_TILE_FREE_DATA)));
+		REQUIRE(dtStatusSucceed(actual->init(qdata, qdataSize, DT_TILE_FREE_DATA)));
+
+		const dtMeshTile* a = ((const dtNavMesh*)expected)->getTile(0);
+		const dtMeshTile* b = ((const dtNavMesh*)actual)->getTile(0);
+		REQUIRE(b->header);
+		CHECK(b->header->magic == DT_NAVMESH_QUANTIZED_MAGIC);
+		CHECK(b->data == qdata);
+		CHECK(b->quantVerts != 0);
+		CHECK(a->quantVerts == 0);
+		REQUIRE(a->header->vertCount == b->header->vertCount);
+		for (int i = 0; i < a->header->vertCount; ++i)
+		{
+			float va[3], vb[3];
+			dtGetTileVert(a, i, va);
+			dtGetTileVert(b, i, vb);
+			CHECK(va[0] == vb[0]);
+			CHECK(va[1] == vb[1]);
+			CHECK(va[2] == vb[2]);
+		}
+
+		dtNavMeshMemoryUsage expectedUsage, actualUsage;
+		expected->getMemoryUsage(&expectedUsage);
+		actual->getMemoryUsage(&actualUsage);
+		CHECK(actualUsage.total < expectedUsage.total);
+		CHECK(actualUsage.total - actualUsage.lookup == (size_t)qdataSize);
+
+		dtNavMeshQuery* expectedQuery = dtAllocNavMeshQuery();
+		dtNavMeshQuery* actualQuery = dtAllocNavMeshQuery();
+		REQUIRE(dtStatusSucceed(expectedQuery->init(expected, 128)));
+		REQUIRE(dtStatusSucceed(actualQuery->init(actual, 128)));
+		dtQueryFilter filter;
+		const float ext[3] = {0.5f, 1.0f, 0.5f};
+		const float startPos[3] = {0.2f, 0.25f, 0.3f};
+		const float endPos[3] = {1.8f, 0.25f, 1.7f};
+
+		dtPolyRef startRef[2], endRef[2];
+		float nearest[2][3];
+		REQUIRE(dtStatusSucceed(expectedQuery->findNearestPoly(startPos, ext, &filter, &startRef[0], nearest[0])));
+		REQUIRE(dtStatusSucceed(actualQuery->findNearestPoly(startPos, ext, &filter, &startRef[1], nearest[1])));
+		CHECK(startRef[0] == startRef[1]);
+		CHECK(memcmp(nearest[0], nearest[1], sizeof(nearest[0])) == 0);
+		REQUIRE(dtStatusSucceed(expectedQuery->findNearestPoly(endPos, ext, &filter, &endRef[0], 0)));
+		REQUIRE(dtStatusSucceed(actualQuery->findNearestPoly(endPos, ext, &filter, &endRef[1], 0)));
+		CHECK(endRef[0] == endRef[1]);
+
+		float height[2];
+		REQUIRE(dtStatusSucceed(expectedQuery->getPolyHeight(startRef[0], startPos, &height[0])));
+		REQUIRE(dtStatusSucceed(actualQuery->getPolyHeight(startRef[1], startPos, &height[1])));
+		CHECK(height[0] == height[1]);
+
+		dtPolyRef path[2][16];
+		int pathCount[2];
+		REQUIRE(dtStatusSucceed(expectedQuery->findPath(startRef[0], endRef[0], startPos, endPos, &filter, path[0], &pathCount[0], 16)));
+		REQUIRE(dtStatusSucceed(actualQuery->findPath(startRef[1], endRef[1], startPos, endPos, &filter, path[1], &pathCount[1], 16)));
+		REQUIRE(pathCount[0] == pathCount[1]);
+		CHECK(memcmp(path[0], path[1], sizeof(dtPolyRef) * pathCount[0]) == 0);
+
+		float straight[2][16*3];
+		int straightCount[2];
+		REQUIRE(dtStatusSucceed(expectedQuery->findStraightPath(startPos, endPos, path[0], pathCount[0], straight[0], 0, 0, &straightCount[0], 16)));
+		REQUIRE(dtStatusSucceed(actualQuery->findStraightPath(startPos, endPos, path[1], pathCount[1], straight[1], 0, 0, &straightCount[1], 16)));
+		REQUIRE(straightCount[0] == straightCount[1]);
+		CHECK(memcmp(straight[0], straight[1], sizeof(float) * 3 * straightCount[0]) == 0);
+
+		float t[2], hitNormal[2][3];
+		dtPolyRef rayPath[2][16];
+		int rayPathCount[2];
+		const float farPos[3] = {3.0f, 0.25f, 1.0f};
+		REQUIRE(dtStatusSucceed(expectedQuery->raycast(startRef[0], startPos, farPos, &filter, &t[0], hitNormal[0], rayPath[0], &rayPathCount[0], 16)));
+		REQUIRE(dtStatusSucceed(actualQuery->raycast(startRef[1], startPos, farPos, &filter, &t[1], hitNormal[1], rayPath[1], &rayPathCount[1], 16)));
+		CHECK(t[0] == t[1]);
+		CHECK(t[1] < 1.0f);
+		CHECK(memcmp(hitNormal[0], hitNormal[1], sizeof(hitNormal[0])) == 0);
+		REQUIRE(rayPathCount[0] == rayPathCount[1]);
+		CHECK(memcmp(rayPath[0], rayPath[1], sizeof(dtPolyRef) * rayPathCount[0]) == 0);
+
+		// The off-mesh connection vertices are kept as floats and are snapped to the mesh when linked.
+		const dtPoly* offMeshPoly = &b->polys[b->header->offMeshBase];
+		float startA[3], endA[3], startB[3], endB[3];
+		dtGetTileVert(a, a->polys[a->header->offMeshBase].verts[0], startA);
+		dtGetTileVert(a, a->polys[a->header->offMeshBase].verts[1], endA);
+		dtGetTileVert(b, offMeshPoly->verts[0], startB);
+		dtGetTileVert(b, offMeshPoly->verts[1], endB);
+		CHECK(memcmp(startA, startB, sizeof(startA)) == 0);
+		CHECK(memcmp(endA, endB, sizeof(endA)) == 0);
+
+		dtFreeNavMeshQuery(expectedQuery);
+		dtFreeNavMeshQuery(actualQuery);
+		dtFreeNavMesh(expected);
+		dtFreeNavMesh(actual);
+	}
+}
+
+TEST_CASE("dtNavMesh::getMemoryUsage")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 2, 2));
+	const dtNavMesh* cnavmesh = navmesh;
+
+	size_t tileDataSize = 0;
+	for (int i = 0; i < cnavmesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = cnavmesh->getTile(i);
+		if (tile->header)
+			tileDataSize += tile->dataSize;
+	}
+
+	dtNavMeshMemoryUsage usage;
+	navmesh->getMemoryUsage(&usage);
+	CHECK(usage.lookup > 0);
+	CHECK(usage.compressedTiles == 0);
+	CHECK(usage.tileHeaders + usage.polys + usage.links + usage.detailMeshes + usage.bvTrees + usage.offMeshCons == tileDataSize);
+	CHECK(usage.total == tileDataSize + usage.lookup);
+
+	SECTION("Peak usage is kept after removing tiles")
+	{
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(0, 0, 0), 0, 0)));
+
+		dtNavMeshMemoryUsage current;
+		navmesh->getMemoryUsage(&current);
+		CHECK(current.total < usage.total);
+		CHECK(current.polys < usage.polys);
+
+		dtNavMeshMemoryUsage peak;
+		navmesh->getPeakMemoryUsage(&peak);
+		CHECK(peak.total == usage.total);
+		CHECK(peak.polys == usage.polys);
+
+		navmesh->resetPeakMemoryUsage();
+		navmesh->getPeakMemoryUsage(&peak);
+		CHECK(peak.total == current.total);
+	}
+
+	SECTION("Compressed tiles are accounted separately")
+	{
+		TestRleCompressor comp;
+		navmesh->setTileCompressor(&comp);
+		REQUIRE(dtStatusSucceed(navmesh->compressTile(navmesh->getTileRefAt(1, 1, 0))));
+
+		dtNavMeshCompressionStats stats;
+		navmesh->getCompressionStats(&stats);
+		dtNavMeshMemoryUsage current;
+		navmesh->getMemoryUsage(&current);
+		CHECK(current.compressedTiles > stats.compressedSize);
+		CHECK(current.total == tileDataSize - stats.uncompressedSize + current.lookup + current.compressedTiles);
+	}
+
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtNavMesh::getChangedTiles")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 2, 2));
+
+	const unsigned int since = navmesh->getTileChangeCount();
+	CHECK(since > 0);
+	int tiles[DT_MAX_TILE_CHANGES];
+	CHECK(navmesh->getChangedTiles(since, tiles, DT_MAX_TILE_CHANGES) == 0);
+
+	SECTION("Tile and polygon changes are recorded")
+	{
+		// Removing the tile changes its three neighbours too.
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(1, 0, 0), 0, 0)));
+		REQUIRE(navmesh->getChangedTiles(since, tiles, DT_MAX_TILE_CHANGES) == 4);
+		for (int i = 0; i < 4; ++i)
+			CHECK(tiles[i] == i);
+		
+		// An inner polygon only changes its own tile.
+		const dtMeshTile* tile = navmesh->getTileAt(0, 1, 0);
+		const int tileIndex = (int)navmesh->decodePolyIdTile(navmesh->getTileRef(tile));
+		unsigned int changeCount = navmesh->getTileChangeCount();
+		REQUIRE(dtStatusSucceed(navmesh->setPolyArea(navmesh->getPolyRefBase(tile) | 5, 1)));
+		REQUIRE(navmesh->getChangedTiles(changeCount, tiles, DT_MAX_TILE_CHANGES) == 1);
+		CHECK(tiles[0] == tileIndex);
+		
+		// A polygon on the tile border also changes the tiles it is linked to.
+		changeCount = navmesh->getTileChangeCount();
+		REQUIRE(dtStatusSucceed(navmesh->setPolyFlags(navmesh->getPolyRefBase(tile), 2)));
+		REQUIRE(navmesh->getChangedTiles(changeCount, tiles, DT_MAX_TILE_CHANGES) == 2);
+		CHECK(std::count(tiles, tiles + 2, tileIndex) == 1);
+		CHECK(std::count(tiles, tiles + 2, (int)navmesh->decodePolyIdTile(navmesh->getTileRefAt(0, 0, 0))) == 1);
+		CHECK(navmesh->getChangedTiles(navmesh->getTileChangeCount(), tiles, DT_MAX_TILE_CHANGES) == 0);
+	}
+
+	SECTION("Repeated changes of the same tiles are returned once")
+	{
+		const dtPolyRef ref = (dtPolyRef)navmesh->getTileRefAt(0, 0, 0);
+		for (int i = 0; i < DT_MAX_TILE_CHANGES * 4; ++i)
+			REQUIRE(dtStatusSucceed(navmesh->setPolyFlags(ref, 1)));
+		CHECK(navmesh->getChangedTiles(since, tiles, DT_MAX_TILE_CHANGES) == 1);
+		
+		// Rebuilding a tile many times changes the same tiles.
+		for (int i = 0; i < 100; ++i)
+		{
+			unsigned char* data = 0;
+			int dataSize = 0;
+			REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(1, 1, 0), 0, 0)));
+			REQUIRE(buildTestTileData(1, 1, 0, 0.0f, 4, 1.0f, &data, &dataSize));
+			REQUIRE(dtStatusSucceed(navmesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+		CHECK(navmesh->getChangedTiles(since, tiles, DT_MAX_TILE_CHANGES) == 4);
+		CHECK(navmesh->getChangedTiles(since, tiles, 3) == -1);
+	}
+
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtNavMesh concurrent readers")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 3, 1));
+
+	// The writer keeps the data of the moving tile, readers may still be reading it after removal.
+	REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(1, 0, 0), 0, 0)));
+	unsigned char* data = 0;
+	int dataSize = 0;
+	REQUIRE(buildTestTileData(1, 0, 0, 0.0f, 4, 1.0f, &data, &dataSize));
+	dtTileRef movingRef = 0;
+	REQUIRE(dtStatusSucceed(navmesh->addTile(data, dataSize, 0, 0, &movingRef)));
+
+	const dtPolyRef staticBase = navmesh->getPolyRefBase(navmesh->getTileAt(0, 0, 0));
+	const dtPolyRef staleRef = (dtPolyRef)movingRef | 5;
+	REQUIRE(dtStatusSucceed(navmesh->removeTile(movingRef, 0, 0)));
+	REQUIRE(dtStatusSucceed(navmesh->addTile(data, dataSize, 0, 0, &movingRef)));
+
+	std::atomic<bool> stop(false);
+	std::atomic<int> staticFailures(0);
+	std::atomic<int> staleSuccesses(0);
+	std::atomic<int> badPolys(0);
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 3; ++i)
+	{
+		readers.emplace_back([&]() {
+			while (!stop.load())
+			{
+				const dtMeshTile* tile = 0;
+				const dtPoly* poly = 0;
+				if (navmesh->getTileRefAt(0, 0, 0) == 0 || dtStatusFailed(navmesh->getTileAndPolyByRef(staticBase | 3, &tile, &poly)))
+					staticFailures++;
+				else if (poly->vertCount != 4)
+					badPolys++;
+
+				const dtTileRef ref = navmesh->getTileRefAt(1, 0, 0);
+				if (ref && dtStatusSucceed(navmesh->getTileAndPolyByRef((dtPolyRef)ref | 7, &tile, &poly)))
+				{
+					if (poly->vertCount != 4)
+						badPolys++;
+				}
+
+				if (navmesh->isValidPolyRef(staleRef))
+					staleSuccesses++;
+			}
+		});
+	}
+
+	// Move the tile in and out while the readers are running.
+	// Failures are only recorded here, the readers must be joined before asserting.
+	dtTileRef ref = movingRef;
+	bool writerOk = true;
+	for (int i = 0; i < 2000 && writerOk; ++i)
+	{
+		unsigned char* removedData = 0;
+		int removedDataSize = 0;
+		writerOk = dtStatusSucceed(navmesh->removeTile(ref, &removedData, &removedDataSize)) && removedData == data &&
+				   dtStatusSucceed(navmesh->addTile(removedData, removedDataSize, 0, 0, &ref));
+	}
+
+	stop = true;
+	for (size_t i = 0; i < readers.size(); ++i)
+		readers[i].join();
+
+	REQUIRE(writerOk);
+	CHECK(staticFailures == 0);
+	CHECK(badPolys == 0);
+	CHECK(staleSuccesses == 0);
+	CHECK(navmesh->isValidPolyRef((dtPolyRef)ref | 7));
+	CHECK(!navmesh->isValidPolyRef(staleRef));
+
+	dtFreeNavMesh(navmesh);
+	dtFree(data);
+}
+
+TEST_CASE("dtNavMesh concurrent readers across lookup buckets")
+{
+	// 64 tiles share 16 lookup buckets.
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 8, 8));
+
+	// Two tiles in different buckets keep swapping their slots: each one is added back
+	// to the slot the other one was just removed from, moving the slots between buckets.
+	const int moving[2][2] = { { 0, 0 }, { 5, 3 } };
+	unsigned char* data[2] = { 0, 0 };
+	int dataSize[2] = { 0, 0 };
+	dtTileRef refs[2] = { 0, 0 };
+	for (int i = 0; i < 2; ++i)
+	{
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(moving[i][0], moving[i][1], 0), 0, 0)));
+		REQUIRE(buildTestTileData(moving[i][0], moving[i][1], 0, 0.0f, 4, 1.0f, &data[i], &dataSize[i]));
+		REQUIRE(dtStatusSucceed(navmesh->addTile(data[i], dataSize[i], 0, 0, &refs[i])));
+	}
+
+	// The other tiles of the two buckets, they are found after the moving tiles in the bucket chains.
+	const int staticTiles[6][2] = { { 6, 0 }, { 5, 1 }, { 0, 2 }, { 4, 4 }, { 4, 6 }, { 3, 7 } };
+
+	std::atomic<bool> stop(false);
+	std::atomic<int> missedTiles(0);
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 3; ++i)
+	{
+		readers.emplace_back([&]() {
+			const dtMeshTile* tiles[4];
+			while (!stop.load())
+			{
+				for (int j = 0; j < 6; ++j)
+				{
+					const int x = staticTiles[j][0];
+					const int y = staticTiles[j][1];
+					if (!navmesh->getTileAt(x, y, 0) || !navmesh->getTileRefAt(x, y, 0) ||
+						navmesh->getTilesAt(x, y, tiles, 4) != 1)
+						missedTiles++;
+				}
+			}
+		});
+	}
+
+	// The writer yields after each swap, so that the readers get preempted anywhere in their walk.
+	dtTileRef ref0 = refs[0], ref1 = refs[1];
+	bool writerOk = true;
+	for (int i = 0; i < 2000 && writerOk; ++i)
+	{
+		writerOk = dtStatusSucceed(navmesh->removeTile(ref0, 0, 0)) &&
+				   dtStatusSucceed(navmesh->removeTile(ref1, 0, 0)) &&
+				   dtStatusSucceed(navmesh->addTile(data[0], dataSize[0], 0, 0, &ref0)) &&
+				   dtStatusSucceed(navmesh->addTile(data[1], dataSize[1], 0, 0, &ref1));
+		std::this_thread::yield();
+	}
+
+	stop = true;
+	for (size_t i = 0; i < readers.size(); ++i)
+		readers[i].join();
+
+	REQUIRE(writerOk);
+	CHECK(missedTiles == 0);
+	CHECK(navmesh->getTileAt(moving[0][0], moving[0][1], 0));
+	CHECK(navmesh->getTileAt(moving[1][0], moving[1][1], 0));
+
+	dtFreeNavMesh(navmesh);
+	dtFree(data[0]);
+	dtFree(data[1]);
+}
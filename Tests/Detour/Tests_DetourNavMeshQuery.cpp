@@ -0,0 +1,125 @@
+#include "catch2/catch_all.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+#include "TestNavMesh.h"
+
+TEST_CASE("dtNavMeshQuery::queryPolygons")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 8, 8, 2));
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 256)));
+
+	dtQueryFilter filter;
+	static const int MAX_POLYS = 4096;
+	dtPolyRef polys[MAX_POLYS];
+	int npolys = 0;
+
+	SECTION("Wide query returns the polygons of all tiles and layers")
+	{
+		const float center[3] = {16.0f, 5.0f, 16.0f};
+		const float halfExtents[3] = {100.0f, 100.0f, 100.0f};
+		REQUIRE(dtStatusSucceed(query->queryPolygons(center, halfExtents, &filter, polys, &npolys, MAX_POLYS)));
+		CHECK(npolys == 8 * 8 * 2 * 16);
+	}
+
+	SECTION("Wide query skips layers outside of the query height")
+	{
+		const float center[3] = {16.0f, 10.5f, 16.0f};
+		const float halfExtents[3] = {100.0f, 1.0f, 100.0f};
+		REQUIRE(dtStatusSucceed(query->queryPolygons(center, halfExtents, &filter, polys, &npolys, MAX_POLYS)));
+		CHECK(npolys == 8 * 8 * 16);
+		for (int i = 0; i < npolys; ++i)
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navmesh->getTileAndPolyByRefUnsafe(polys[i], &tile, &poly);
+			CHECK(tile->header->layer == 1);
+		}
+	}
+
+	SECTION("Small query only returns polygons in the touched tile layer")
+	{
+		const float center[3] = {1.5f, 0.5f, 1.5f};
+		const float halfExtents[3] = {0.25f, 1.0f, 0.25f};
+		REQUIRE(dtStatusSucceed(query->queryPolygons(center, halfExtents, &filter, polys, &npolys, MAX_POLYS)));
+		REQUIRE(npolys > 0);
+		for (int i = 0; i < npolys; ++i)
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navmesh->getTileAndPolyByRefUnsafe(polys[i], &tile, &poly);
+			CHECK(tile->header->x == 0);
+			CHECK(tile->header->y == 0);
+			CHECK(tile->header->layer == 0);
+		}
+	}
+
+	SECTION("Removed tiles are not returned")
+	{
+		for (int y = 0; y < 8; ++y)
+		{
+			for (int x = 0; x < 8; x += 2)
+				REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(x, y, 0), 0, 0)));
+		}
+		const float center[3] = {16.0f, 0.5f, 16.0f};
+		const float halfExtents[3] = {100.0f, 1.0f, 100.0f};
+		REQUIRE(dtStatusSucceed(query->queryPolygons(center, halfExtents, &filter, polys, &npolys, MAX_POLYS)));
+		CHECK(npolys == 4 * 8 * 16);
+		for (int i = 0; i < npolys; ++i)
+			CHECK(navmesh->isValidPolyRef(polys[i]));
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtNavMeshQuery::getMemoryUsage")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 1));
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 256)));
+
+	dtNavMeshQueryMemoryUsage usage;
+	query->getMemoryUsage(&usage);
+	CHECK(usage.maxNodes == 256);
+	CHECK(usage.peakNodeCount == 0);
+	CHECK(usage.nodePool > usage.tinyNodePool);
+	CHECK(usage.total > usage.nodePool + usage.tinyNodePool + usage.openList);
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = {0.1f, 1.0f, 0.1f};
+	const float startPos[3] = {0.5f, 0.0f, 0.5f};
+	const float endPos[3] = {15.5f, 0.0f, 3.5f};
+	dtPolyRef startRef = 0;
+	dtPolyRef endRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+	static const int MAX_PATH = 64;
+	dtPolyRef path[MAX_PATH];
+	int npath = 0;
+	REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, MAX_PATH)));
+
+	// The peak is kept when the next search clears the node pool.
+	REQUIRE(dtStatusSucceed(query->findPath(startRef, startRef, startPos, startPos, &filter, path, &npath, MAX_PATH)));
+
+	dtNavMeshQueryMemoryUsage after;
+	query->getMemoryUsage(&after);
+	CHECK(after.peakNodeCount >= npath);
+	CHECK(after.peakNodeCount > 1);
+	CHECK(after.peakNodeCount <= after.maxNodes);
+	CHECK(after.total == usage.total);
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourCrowd.h"
+#include "DetourNavMesh.h"
+
+#include "TestCrowd.h"
+
+// TODO: Implement benchmarking for platforms other than posix.
+#ifdef __unix__
+#include <unistd.h>
+#ifdef _POSIX_TIMERS
+#include <time.h>
+#include <stdint.h>
+
+static int64_t crowdBenchNowNanos()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &tp);
+	return tp.tv_nsec + 1000000000LL * tp.tv_sec;
+}
+
+// Measures the average cost of dtCrowd::update per agent once the agents are moving.
+static void benchCrowdUpdate(const int agentCount, const int updateCount,
+							 const unsigned char avoidanceMode = DT_OBSTACLE_AVOIDANCE_ADAPTIVE)
+{
+	// 10x10 tiles of 16x16 polygons, large enough to spread 10k agents.
+	static const int TILES = 10;
+	static const int QUADS = 16;
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, TILES, TILES, 1, 10.0f, QUADS, 1.0f));
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+	dtObstacleAvoidanceParams params;
+	memcpy(&params, crowd->getObstacleAvoidanceParams(3), sizeof(params));
+	params.mode = avoidanceMode;
+	crowd->setObstacleAvoidanceParams(3, &params);
+	REQUIRE(addTestAgents(crowd, agentCount, (float)(TILES * QUADS)));
+
+	// Let the path requests resolve before measuring.
+	for (int i = 0; i < 10; ++i)
+		crowd->update(0.1f, 0);
+
+	const int64_t begin = crowdBenchNowNanos();
+	for (int i = 0; i < updateCount; ++i)
+		crowd->update(0.1f, 0);
+	const int64_t nanos = crowdBenchNowNanos() - begin;
+
+	printf("BM_dtCrowd_update_%s_%-10d %d updates in %10ld nanos: %10.2f nanos/agent/update\n",
+		   avoidanceMode == DT_OBSTACLE_AVOIDANCE_ORCA ? "orca" : "sampled", agentCount, updateCount, (long)nanos, double(nanos) / ((double)updateCount * agentCount));
+
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("BM_dtCrowd_update", "[.bench]")
+{
+	SECTION("1k agents")
+	{
+		benchCrowdUpdate(1000, 20);
+	}
+	SECTION("5k agents")
+	{
+		benchCrowdUpdate(5000, 10);
+	}
+	SECTION("10k agents")
+	{
+		benchCrowdUpdate(10000, 5);
+	}
+	SECTION("1k agents with ORCA")
+	{
+		benchCrowdUpdate(1000, 20, DT_OBSTACLE_AVOIDANCE_ORCA);
+	}
+	SECTION("10k agents with ORCA")
+	{
+		benchCrowdUpdate(10000, 5, DT_OBSTACLE_AVOIDANCE_ORCA);
+	}
+}
+
+// Measures the time needed for all the agents to get a path to a new shared goal.
+static void benchCrowdRetarget(const int agentCount, const bool useFlowField)
+{
+	static const int TILES = 10;
+	static const int QUADS = 16;
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, TILES, TILES, 1, 10.0f, QUADS, 1.0f));
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+	REQUIRE(addTestAgents(crowd, agentCount, (float)(TILES * QUADS)));
+	for (int i = 0; i < 10; ++i)
+		crowd->update(0.1f, 0);
+
+	// Retreat to the corner of the mesh.
+	const dtNavMeshQuery* query = crowd->getNavMeshQuery();
+	const float goalPos[3] = {0.5f, 0.0f, 0.5f};
+	dtPolyRef goalRef = 0;
+	float nearest[3];
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(goalPos, crowd->getQueryHalfExtents(), crowd->getFilter(0), &goalRef, nearest)));
+
+	dtFlowField* field = dtAllocFlowField();
+	REQUIRE(field);
+	REQUIRE(field->init(navmesh, TILES * TILES * QUADS * QUADS));
+
+	const int64_t begin = crowdBenchNowNanos();
+	if (useFlowField)
+	{
+		field->setGoal(goalRef, nearest, crowd->getFilter(0));
+		REQUIRE(dtStatusSucceed(field->update(query, TILES * TILES * QUADS * QUADS)));
+		for (int i = 0; i < agentCount; ++i)
+			crowd->requestMoveFlowField(i, field);
+	}
+	else
+	{
+		for (int i = 0; i < agentCount; ++i)
+			crowd->requestMoveTarget(i, goalRef, nearest);
+	}
+	int updates = 0;
+	for (bool waiting = true; waiting && updates < 300; ++updates)
+	{
+		crowd->update(0.1f, 0);
+		waiting = false;
+		for (int i = 0; i < agentCount && !waiting; ++i)
+			waiting = crowd->getAgent(i)->targetState != DT_CROWDAGENT_TARGET_VALID;
+	}
+	const int64_t nanos = crowdBenchNowNanos() - begin;
+
+	printf("BM_dtCrowd_retarget_%s_%-10d %4d updates in %10ld nanos\n",
+		   useFlowField ? "flowfield" : "pathqueue", agentCount, updates, (long)nanos);
+
+	dtFreeFlowField(field);
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("BM_dtCrowd_retarget", "[.bench]")
+{
+	SECTION("500 agents with the path queue")
+	{
+		benchCrowdRetarget(500, false);
+	}
+	SECTION("500 agents with a flow field")
+	{
+		benchCrowdRetarget(500, true);
+	}
+}
+
+#endif // _POSIX_TIMERS
+#endif // __unix__
@@ -0,0 +1,64 @@
+#ifndef TESTCROWD_H
+#define TESTCROWD_H
+
+#include <string.h>
+
+#include "DetourCrowd.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+#include "../Detour/TestNavMesh.h"
+
+// Fills the agent parameters used by the crowd tests.
+inline void initTestAgentParams(dtCrowdAgentParams* params)
+{
+	memset(params, 0, sizeof(dtCrowdAgentParams));
+	params->radius = 0.3f;
+	params->height = 2.0f;
+	params->maxAcceleration = 8.0f;
+	params->maxSpeed = 3.5f;
+	params->collisionQueryRange = params->radius * 12.0f;
+	params->pathOptimizationRange = params->radius * 30.0f;
+	params->separationWeight = 2.0f;
+	params->updateFlags = DT_CROWD_ANTICIPATE_TURNS | DT_CROWD_OPTIMIZE_VIS | DT_CROWD_OPTIMIZE_TOPO |
+		DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_SEPARATION;
+	params->obstacleAvoidanceType = 3;
+}
+
+// Adds agentCount agents on a grid in the lower left quarter of the navmesh and
+// sends each of them to the mirrored position in the upper right quarter,
+// so that the agents have to pass each other.
+inline bool addTestAgents(dtCrowd* crowd, int agentCount, float meshSize)
+{
+	dtCrowdAgentParams params;
+	initTestAgentParams(&params);
+
+	const dtNavMeshQuery* query = crowd->getNavMeshQuery();
+	const dtQueryFilter* filter = crowd->getFilter(0);
+	const float* halfExtents = crowd->getQueryHalfExtents();
+
+	int side = 1;
+	while (side * side < agentCount)
+		side++;
+	const float spacing = meshSize * 0.45f / side;
+
+	for (int i = 0; i < agentCount; ++i)
+	{
+		const float pos[3] = {0.5f + (i % side) * spacing, 0.0f, 0.5f + (i / side) * spacing};
+		const float target[3] = {meshSize - pos[2], 0.0f, meshSize - pos[0]};
+
+		const int idx = crowd->addAgent(pos, &params);
+		if (idx < 0)
+			return false;
+
+		dtPolyRef targetRef = 0;
+		float nearest[3];
+		if (dtStatusFailed(query->findNearestPoly(target, halfExtents, filter, &targetRef, nearest)) || !targetRef)
+			return false;
+		if (!crowd->requestMoveTarget(idx, targetRef, nearest))
+			return false;
+	}
+	return true;
+}
+
+#endif // TESTCROWD_H
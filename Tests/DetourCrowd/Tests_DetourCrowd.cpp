@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourCommon.h"
+#include "DetourCrowd.h"
+#include "DetourNavMesh.h"
+
+#include "TestCrowd.h"
+
+// Runs the workers on short lived threads, the calling thread runs the first worker.
+struct TestThreadTaskRunner : public dtCrowdTaskRunner
+{
+	virtual void run(dtCrowdTask* task, const int workerCount)
+	{
+		std::vector<std::thread> threads;
+		for (int i = 1; i < workerCount; ++i)
+			threads.emplace_back([task, i]() { task->execute(i); });
+		task->execute(0);
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+};
+
+TEST_CASE("dtCrowd::setTaskRunner")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const float meshSize = 16.0f;
+	const int agentCount = 60;
+
+	dtCrowd* serial = dtAllocCrowd();
+	REQUIRE(serial);
+	REQUIRE(serial->init(agentCount, 0.6f, navmesh));
+	REQUIRE(addTestAgents(serial, agentCount, meshSize));
+
+	TestThreadTaskRunner runner;
+	dtCrowd* parallel = dtAllocCrowd();
+	REQUIRE(parallel);
+	REQUIRE(parallel->setTaskRunner(&runner, 4));
+	REQUIRE(parallel->init(agentCount, 0.6f, navmesh));
+	REQUIRE(parallel->getWorkerCount() == 4);
+	REQUIRE(addTestAgents(parallel, agentCount, meshSize));
+
+	SECTION("Parallel update gives the same result as the serial update")
+	{
+		for (int step = 0; step < 60; ++step)
+		{
+			serial->update(0.1f, 0);
+			parallel->update(0.1f, 0);
+			REQUIRE(serial->getVelocitySampleCount() == parallel->getVelocitySampleCount());
+		}
+
+		CHECK(serial->getVelocitySampleCount() > 0);
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* a = serial->getAgent(i);
+			const dtCrowdAgent* b = parallel->getAgent(i);
+			CHECK(memcmp(a->npos, b->npos, sizeof(a->npos)) == 0);
+			CHECK(memcmp(a->vel, b->vel, sizeof(a->vel)) == 0);
+			CHECK(a->corridor.getFirstPoly() == b->corridor.getFirstPoly());
+		}
+	}
+
+	SECTION("Worker count can be changed between updates")
+	{
+		parallel->update(0.1f, 0);
+		REQUIRE(parallel->setTaskRunner(&runner, 2));
+		CHECK(parallel->getWorkerCount() == 2);
+		parallel->update(0.1f, 0);
+		REQUIRE(parallel->setTaskRunner(0, 0));
+		CHECK(parallel->getWorkerCount() == 1);
+		parallel->update(0.1f, 0);
+	}
+
+	dtFreeCrowd(parallel);
+	dtFreeCrowd(serial);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtCrowd neighbours")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const int agentCount = 100;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+
+	// Pack the agents densely so that there are many more candidates than neighbour slots.
+	dtCrowdAgentParams params;
+	initTestAgentParams(&params);
+	float prevPos[agentCount][3];
+	for (int i = 0; i < agentCount; ++i)
+	{
+		const float pos[3] = {4.0f + (i % 10) * 0.2f, 0.0f, 4.0f + (i / 10) * 0.2f};
+		REQUIRE(crowd->addAgent(pos, &params) == i);
+	}
+	for (int i = 0; i < agentCount; ++i)
+		memcpy(prevPos[i], crowd->getAgent(i)->npos, sizeof(prevPos[i]));
+
+	// The neighbours are gathered from the positions at the start of the update.
+	crowd->update(0.1f, 0);
+
+	for (int i = 0; i < agentCount; ++i)
+	{
+		std::vector<float> dists;
+		for (int j = 0; j < agentCount; ++j)
+		{
+			if (j == i) continue;
+			const float dx = prevPos[j][0] - prevPos[i][0];
+			const float dz = prevPos[j][2] - prevPos[i][2];
+			const float distSqr = dx*dx + dz*dz;
+			if (distSqr <= params.collisionQueryRange*params.collisionQueryRange)
+				dists.push_back(distSqr);
+		}
+		std::sort(dists.begin(), dists.end());
+
+		const dtCrowdAgent* ag = crowd->getAgent(i);
+		REQUIRE(ag->nneis == DT_CROWDAGENT_MAX_NEIGHBOURS);
+		for (int j = 0; j < ag->nneis; ++j)
+		{
+			CHECK(ag->neis[j].idx != i);
+			CHECK(ag->neis[j].dist == Catch::Approx(dists[j]));
+		}
+	}
+
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtCrowd packed agent state")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const int agentCount = 20;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+	REQUIRE(addTestAgents(crowd, agentCount, 16.0f));
+
+	dtCrowdAgentParams params;
+	initTestAgentParams(&params);
+	params.radius = 0.4f;
+	crowd->updateAgentParameters(3, &params);
+
+	for (int step = 0; step < 10; ++step)
+		crowd->update(0.1f, 0);
+
+	// The agents read and write their motion state in the packed arrays.
+	const float* positions = crowd->getAgentPositions();
+	const float* velocities = crowd->getAgentVelocities();
+	const float* radii = crowd->getAgentRadii();
+	for (int i = 0; i < agentCount; ++i)
+	{
+		const dtCrowdAgent* ag = crowd->getAgent(i);
+		CHECK(ag->npos == &positions[i*3]);
+		CHECK(ag->vel == &velocities[i*3]);
+		CHECK(radii[i] == ag->params.radius);
+	}
+	CHECK(radii[3] == 0.4f);
+	CHECK(dtVlen(&velocities[0]) > 0.0f);
+
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtCrowd level of detail")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const float meshSize = 16.0f;
+	const int agentCount = 60;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+	REQUIRE(addTestAgents(crowd, agentCount, meshSize));
+
+	// Let the agents get their paths and start moving.
+	for (int step = 0; step < 5; ++step)
+		crowd->update(0.1f, 0);
+
+	float startPos[agentCount][3];
+	for (int i = 0; i < agentCount; ++i)
+		memcpy(startPos[i], crowd->getAgent(i)->npos, sizeof(startPos[i]));
+
+	SECTION("Frozen agents do not move")
+	{
+		for (int i = 0; i < agentCount; ++i)
+			REQUIRE(crowd->setAgentLOD(i, DT_CROWDAGENT_LOD_FROZEN));
+		for (int step = 0; step < 10; ++step)
+		{
+			crowd->update(0.1f, 0);
+			CHECK(crowd->getVelocitySampleCount() == 0);
+		}
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			CHECK(memcmp(ag->npos, startPos[i], sizeof(startPos[i])) == 0);
+			CHECK(dtVlenSqr(ag->vel) == 0.0f);
+		}
+	}
+
+	SECTION("Corridor agents follow their path without avoidance")
+	{
+		for (int i = 0; i < agentCount; ++i)
+			REQUIRE(crowd->setAgentLOD(i, DT_CROWDAGENT_LOD_CORRIDOR));
+		for (int step = 0; step < 10; ++step)
+		{
+			crowd->update(0.1f, 0);
+			CHECK(crowd->getVelocitySampleCount() == 0);
+		}
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			CHECK(ag->nneis == 0);
+			CHECK(dtVdist2D(ag->npos, startPos[i]) > 0.5f);
+		}
+	}
+
+	SECTION("Reduced agents plan their velocities in staggered updates")
+	{
+		dtCrowd* full = dtAllocCrowd();
+		REQUIRE(full);
+		REQUIRE(full->init(agentCount, 0.6f, navmesh));
+		REQUIRE(addTestAgents(full, agentCount, meshSize));
+		for (int step = 0; step < 5; ++step)
+			full->update(0.1f, 0);
+
+		for (int i = 0; i < agentCount; ++i)
+			REQUIRE(crowd->setAgentLOD(i, DT_CROWDAGENT_LOD_REDUCED));
+		int reducedSamples = 0;
+		int fullSamples = 0;
+		for (int step = 0; step < 8; ++step)
+		{
+			crowd->update(0.1f, 0);
+			full->update(0.1f, 0);
+			// Only about a quarter of the agents plan at each update.
+			CHECK(crowd->getVelocitySampleCount() > 0);
+			reducedSamples += crowd->getVelocitySampleCount();
+			fullSamples += full->getVelocitySampleCount();
+		}
+		CHECK(reducedSamples * 2 < fullSamples);
+
+		// Some agents are blocked by the others, check that the crowd as a whole keeps moving.
+		float travelled = 0.0f;
+		for (int i = 0; i < agentCount; ++i)
+			travelled += dtVdist2D(crowd->getAgent(i)->npos, startPos[i]);
+		CHECK(travelled / agentCount > 0.5f);
+
+		dtFreeCrowd(full);
+	}
+
+	SECTION("Removed agents are dropped from the neighbours of reduced agents")
+	{
+		for (int i = 0; i < agentCount; ++i)
+			REQUIRE(crowd->setAgentLOD(i, DT_CROWDAGENT_LOD_REDUCED));
+		REQUIRE(crowd->setLODUpdateInterval(DT_CROWDAGENT_LOD_REDUCED, 4));
+		for (int step = 0; step < 4; ++step)
+			crowd->update(0.1f, 0);
+
+		// Remove an agent which somebody currently sees as a neighbour.
+		int removed = -1;
+		for (int i = 0; i < agentCount && removed == -1; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			if (ag->nneis > 0)
+				removed = ag->neis[0].idx;
+		}
+		REQUIRE(removed != -1);
+		crowd->removeAgent(removed);
+
+		for (int step = 0; step < 4; ++step)
+		{
+			crowd->update(0.1f, 0);
+			for (int i = 0; i < agentCount; ++i)
+			{
+				const dtCrowdAgent* ag = crowd->getAgent(i);
+				if (!ag->active)
+					continue;
+				for (int j = 0; j < ag->nneis; ++j)
+					CHECK(ag->neis[j].idx != removed);
+			}
+		}
+	}
+
+	SECTION("Update intervals")
+	{
+		CHECK(crowd->getLODUpdateInterval(DT_CROWDAGENT_LOD_FULL) == 1);
+		CHECK(crowd->setLODUpdateInterval(DT_CROWDAGENT_LOD_REDUCED, 2));
+		CHECK(crowd->getLODUpdateInterval(DT_CROWDAGENT_LOD_REDUCED) == 2);
+		CHECK_FALSE(crowd->setLODUpdateInterval(DT_CROWDAGENT_LOD_CORRIDOR, 0));
+		CHECK_FALSE(crowd->setLODUpdateInterval(DT_CROWDAGENT_LOD_FULL, 2));
+		CHECK_FALSE(crowd->setAgentLOD(0, DT_CROWDAGENT_MAX_LODS));
+		CHECK(crowd->getLODUpdateInterval(DT_CROWDAGENT_MAX_LODS) == 0);
+	}
+
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtCrowd::setPathParams")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const float meshSize = 16.0f;
+	const int agentCount = 60;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+
+	dtCrowdPathParams params = *crowd->getPathParams();
+
+	SECTION("Invalid parameters are rejected")
+	{
+		params.maxQueuedRequests = 0;
+		CHECK_FALSE(crowd->setPathParams(&params));
+		CHECK(crowd->getPathParams()->maxQueuedRequests > 0);
+	}
+
+	SECTION("The queue can be resized after init")
+	{
+		params.maxQueuedRequests = agentCount;
+		REQUIRE(crowd->setPathParams(&params));
+		CHECK(crowd->getPathQueue()->getMaxRequests() == agentCount);
+	}
+
+	SECTION("The path queue can be updated on another thread")
+	{
+		params.maxQueuedRequests = agentCount;
+		params.userPathQueueUpdate = true;
+		REQUIRE(crowd->setPathParams(&params));
+		REQUIRE(addTestAgents(crowd, agentCount, meshSize));
+
+		std::atomic<bool> quit(false);
+		std::thread worker([crowd, &quit]()
+		{
+			while (!quit.load())
+				crowd->updatePathQueue();
+		});
+
+		for (int step = 0; step < 20; ++step)
+		{
+			crowd->update(0.1f, 0);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		quit.store(true);
+		worker.join();
+
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			CHECK(ag->targetState == DT_CROWDAGENT_TARGET_VALID);
+			CHECK(ag->corridor.getLastPoly() == ag->targetRef);
+		}
+	}
+
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtCrowd::requestMoveFlowField")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const float meshSize = 16.0f;
+	const int agentCount = 60;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+	REQUIRE(addTestAgents(crowd, agentCount, meshSize));
+
+	const dtNavMeshQuery* query = crowd->getNavMeshQuery();
+	const float goalPos[3] = {meshSize - 1.5f, 0.0f, meshSize - 1.5f};
+	dtPolyRef goalRef = 0;
+	float nearest[3];
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(goalPos, crowd->getQueryHalfExtents(), crowd->getFilter(0), &goalRef, nearest)));
+
+	dtFlowField* field = dtAllocFlowField();
+	REQUIRE(field);
+	REQUIRE(field->init(navmesh, 1024));
+	CHECK_FALSE(crowd->requestMoveFlowField(0, field));
+	REQUIRE(dtStatusInProgress(field->setGoal(goalRef, goalPos, crowd->getFilter(0))));
+	REQUIRE(dtStatusSucceed(field->update(query, 100000)));
+
+	for (int i = 0; i < agentCount; ++i)
+		REQUIRE(crowd->requestMoveFlowField(i, field));
+	crowd->update(0.1f, 0);
+
+	// All the agents took their path from the flow field.
+	CHECK(crowd->getPathQueue()->getPendingRequestCount() == 0);
+	for (int i = 0; i < agentCount; ++i)
+	{
+		const dtCrowdAgent* ag = crowd->getAgent(i);
+		CHECK(ag->targetState == DT_CROWDAGENT_TARGET_VALID);
+		CHECK(ag->corridor.getLastPoly() == goalRef);
+	}
+
+	// Moving the goal of the flow field moves the goal of the agents.
+	const float newGoalPos[3] = {1.5f, 0.0f, meshSize - 1.5f};
+	dtPolyRef newGoalRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(newGoalPos, crowd->getQueryHalfExtents(), crowd->getFilter(0), &newGoalRef, nearest)));
+	REQUIRE(dtStatusInProgress(field->setGoal(newGoalRef, newGoalPos, crowd->getFilter(0))));
+	REQUIRE(dtStatusSucceed(field->update(query, 100000)));
+	crowd->update(0.1f, 0);
+
+	CHECK(crowd->getPathQueue()->getPendingRequestCount() == 0);
+	for (int i = 0; i < agentCount; ++i)
+	{
+		const dtCrowdAgent* ag = crowd->getAgent(i);
+		CHECK(ag->targetRef == newGoalRef);
+		CHECK(ag->targetState == DT_CROWDAGENT_TARGET_VALID);
+		CHECK(ag->corridor.getLastPoly() == newGoalRef);
+	}
+
+	// A regular move request stops following the flow field.
+	REQUIRE(crowd->requestMoveTarget(0, goalRef, goalPos));
+	CHECK(crowd->getAgent(0)->targetField == 0);
+
+	dtFreeFlowField(field);
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
+
+// Returns true if the agent's path corridor crosses the specified tile.
+static bool crossesTile(const dtNavMesh* navmesh, const dtCrowdAgent* ag, const int tileIndex)
+{
+	const dtPolyRef* path = ag->corridor.getPath();
+	for (int i = 0; i < ag->corridor.getPathCount(); ++i)
+	{
+		if ((int)navmesh->decodePolyIdTile(path[i]) == tileIndex)
+			return true;
+	}
+	return false;
+}
+
+TEST_CASE("dtCrowd::setMaintenanceParams")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	const float meshSize = 16.0f;
+	const int agentCount = 60;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd);
+	REQUIRE(crowd->init(agentCount, 0.6f, navmesh));
+
+	// The agents walk across this tile, but do not start nor end on it.
+	const dtTileRef tileRef = navmesh->getTileRefAt(2, 1, 0);
+	const int tileIndex = (int)navmesh->decodePolyIdTile((dtPolyRef)tileRef);
+	const dtMeshTile* tile = navmesh->getTileByRef(tileRef);
+	const dtPolyRef polyBase = navmesh->getPolyRefBase(tile);
+	for (int i = 0; i < tile->header->polyCount; ++i)
+		REQUIRE(dtStatusSucceed(navmesh->setPolyFlags(polyBase | (dtPolyRef)i, 3)));
+
+	REQUIRE(addTestAgents(crowd, agentCount, meshSize));
+	for (int step = 0; step < 10; ++step)
+		crowd->update(0.1f, 0);
+
+	dtCrowdMaintenanceParams params = *crowd->getMaintenanceParams();
+	params.pathSweepChecks = 0;
+	REQUIRE(crowd->setMaintenanceParams(&params));
+
+	int crossing = 0;
+	for (int i = 0; i < agentCount; ++i)
+	{
+		const dtCrowdAgent* ag = crowd->getAgent(i);
+		REQUIRE(ag->targetState == DT_CROWDAGENT_TARGET_VALID);
+		if (crossesTile(navmesh, ag, tileIndex))
+			crossing++;
+	}
+	REQUIRE(crossing > 0);
+
+	SECTION("Invalid parameters are rejected")
+	{
+		params.maxPathChecks = 0;
+		CHECK_FALSE(crowd->setMaintenanceParams(&params));
+		CHECK(crowd->getMaintenanceParams()->maxPathChecks > 0);
+	}
+
+	SECTION("Removing a tile replans the agents crossing it")
+	{
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(tileRef, 0, 0)));
+		crowd->update(0.1f, 0);
+
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			if (ag->targetState == DT_CROWDAGENT_TARGET_VALID)
+				CHECK_FALSE(crossesTile(navmesh, ag, tileIndex));
+		}
+
+		for (int step = 0; step < 20; ++step)
+			crowd->update(0.1f, 0);
+
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			CHECK(ag->targetState == DT_CROWDAGENT_TARGET_VALID);
+			for (int j = 0; j < ag->corridor.getPathCount(); ++j)
+				CHECK(crowd->getNavMeshQuery()->isValidPolyRef(ag->corridor.getPath()[j], crowd->getFilter(0)));
+		}
+	}
+
+	SECTION("Filter changes are noticed by the sweep")
+	{
+		crowd->getEditableFilter(0)->setExcludeFlags(2);
+
+		// Filter changes are not tile changes, the agents keep their paths.
+		for (int step = 0; step < 5; ++step)
+			crowd->update(0.1f, 0);
+		int stillCrossing = 0;
+		for (int i = 0; i < agentCount; ++i)
+		{
+			if (crossesTile(navmesh, crowd->getAgent(i), tileIndex))
+				stillCrossing++;
+		}
+		CHECK(stillCrossing > 0);
+
+		params.pathSweepChecks = agentCount;
+		REQUIRE(crowd->setMaintenanceParams(&params));
+		for (int step = 0; step < 20; ++step)
+			crowd->update(0.1f, 0);
+
+		for (int i = 0; i < agentCount; ++i)
+		{
+			const dtCrowdAgent* ag = crowd->getAgent(i);
+			CHECK(ag->targetState == DT_CROWDAGENT_TARGET_VALID);
+			CHECK_FALSE(crossesTile(navmesh, ag, tileIndex));
+		}
+	}
+
+	SECTION("Topology optimizations are limited by the budget")
+	{
+		params.maxTopologyOptimizations = 3;
+		params.topologyOptimizationDelay = 0.0f;
+		REQUIRE(crowd->setMaintenanceParams(&params));
+		crowd->update(0.1f, 0);
+
+		int optimized = 0;
+		for (int i = 0; i < agentCount; ++i)
+		{
+			if (crowd->getAgent(i)->topologyOptTime == 0.0f)
+				optimized++;
+		}
+		CHECK(optimized == 3);
+	}
+
+	dtFreeCrowd(crowd);
+	dtFreeNavMesh(navmesh);
+}
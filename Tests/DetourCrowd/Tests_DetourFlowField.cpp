@@ -0,0 +1,168 @@
+#include "catch2/catch_all.hpp"
+
+#include "DetourFlowField.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+#include "../Detour/TestNavMesh.h"
+
+static dtPolyRef findTestPoly(const dtNavMeshQuery* query, const dtQueryFilter* filter, const float* pos)
+{
+	const float halfExtents[3] = {1.0f, 2.0f, 1.0f};
+	dtPolyRef ref = 0;
+	float nearest[3];
+	query->findNearestPoly(pos, halfExtents, filter, &ref, nearest);
+	return ref;
+}
+
+TEST_CASE("dtFlowField")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 512)));
+
+	dtQueryFilter filter;
+	const float goalPos[3] = {15.5f, 0.0f, 15.5f};
+	const float startPos[3] = {0.5f, 0.0f, 0.5f};
+	const dtPolyRef goalRef = findTestPoly(query, &filter, goalPos);
+	const dtPolyRef startRef = findTestPoly(query, &filter, startPos);
+	REQUIRE(goalRef);
+	REQUIRE(startRef);
+
+	dtFlowField* field = dtAllocFlowField();
+	REQUIRE(field);
+	REQUIRE(field->init(navmesh, 1024));
+	CHECK_FALSE(field->isReady());
+	REQUIRE(dtStatusInProgress(field->setGoal(goalRef, goalPos, &filter)));
+
+	SECTION("Points every polygon towards the goal")
+	{
+		REQUIRE(dtStatusSucceed(field->update(query, 100000)));
+		REQUIRE(field->isReady());
+		CHECK(field->getGoalRef() == goalRef);
+		CHECK(field->getVersion() == 1);
+
+		float cost = -1.0f;
+		REQUIRE(field->getCost(goalRef, &cost));
+		CHECK(cost == 0.0f);
+		CHECK(field->getNextPoly(goalRef) == 0);
+
+		dtPolyRef path[256];
+		const int npath = field->getPath(startRef, path, 256);
+		REQUIRE(npath > 1);
+		CHECK(path[0] == startRef);
+		CHECK(path[npath-1] == goalRef);
+
+		// The costs decrease along the path and match the cost of the path search.
+		float prevCost = 0.0f;
+		REQUIRE(field->getCost(startRef, &prevCost));
+		for (int i = 1; i < npath; ++i)
+		{
+			CHECK(field->getNextPoly(path[i-1]) == path[i]);
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			REQUIRE(dtStatusSucceed(navmesh->getTileAndPolyByRef(path[i-1], &tile, &poly)));
+			bool linked = false;
+			for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+				linked = linked || tile->links[j].ref == path[i];
+			CHECK(linked);
+			REQUIRE(field->getCost(path[i], &cost));
+			CHECK(cost < prevCost);
+			prevCost = cost;
+		}
+
+		dtPolyRef searchPath[256];
+		int nsearchPath = 0;
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, goalRef, startPos, goalPos, &filter, searchPath, &nsearchPath, 256)));
+		CHECK(npath == nsearchPath);
+	}
+
+	SECTION("The build can be spread over several updates")
+	{
+		dtFlowField* reference = dtAllocFlowField();
+		REQUIRE(reference);
+		REQUIRE(reference->init(navmesh, 1024));
+		REQUIRE(dtStatusInProgress(reference->setGoal(goalRef, goalPos, &filter)));
+		REQUIRE(dtStatusSucceed(reference->update(query, 100000)));
+
+		int updates = 0;
+		dtStatus status = DT_IN_PROGRESS;
+		while (dtStatusInProgress(status))
+		{
+			CHECK_FALSE(field->isReady());
+			int iters = 0;
+			status = field->update(query, 10, &iters);
+			CHECK(iters <= 10);
+			updates++;
+		}
+		REQUIRE(dtStatusSucceed(status));
+		CHECK(updates > 1);
+
+		const dtMeshTile* tile = navmesh->getTileAt(1, 2, 0);
+		REQUIRE(tile);
+		const dtPolyRef base = navmesh->getPolyRefBase(tile);
+		for (int i = 0; i < tile->header->polyCount; ++i)
+			CHECK(field->getNextPoly(base | (dtPolyRef)i) == reference->getNextPoly(base | (dtPolyRef)i));
+
+		dtFreeFlowField(reference);
+	}
+
+	SECTION("Detects tile changes and keeps the previous table while rebuilding")
+	{
+		REQUIRE(dtStatusSucceed(field->update(query, 100000)));
+		CHECK(field->isUpToDate());
+
+		// Remove a tile in the middle of the mesh.
+		const dtTileRef tileRef = navmesh->getTileRefAt(2, 1, 0);
+		REQUIRE(tileRef);
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(tileRef, 0, 0)));
+		CHECK_FALSE(field->isUpToDate());
+
+		REQUIRE(dtStatusInProgress(field->setGoal(goalRef, goalPos, &filter)));
+		CHECK(field->isReady());
+		CHECK(field->getVersion() == 1);
+		CHECK(field->isUpToDate());
+
+		// The old table stops at the removed polygons.
+		const float pos[3] = {8.5f, 0.0f, 4.5f};
+		const dtPolyRef ref = findTestPoly(query, &filter, pos);
+		REQUIRE(ref);
+		dtPolyRef path[256];
+		int npath = field->getPath(ref, path, 256);
+		REQUIRE(npath > 0);
+		for (int i = 0; i < npath; ++i)
+			CHECK(navmesh->isValidPolyRef(path[i]));
+
+		REQUIRE(dtStatusSucceed(field->update(query, 100000)));
+		CHECK(field->getVersion() == 2);
+		npath = field->getPath(ref, path, 256);
+		REQUIRE(npath > 1);
+		CHECK(path[npath-1] == goalRef);
+
+		unsigned char* data = 0;
+		int dataSize = 0;
+		REQUIRE(buildTestTileData(2, 1, 0, 0.0f, 4, 1.0f, &data, &dataSize));
+		REQUIRE(dtStatusSucceed(navmesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		CHECK_FALSE(field->isUpToDate());
+	}
+
+	SECTION("Reports polygons which do not fit in the table")
+	{
+		REQUIRE(field->init(navmesh, 32));
+		REQUIRE(dtStatusInProgress(field->setGoal(goalRef, goalPos, &filter)));
+		const dtStatus status = field->update(query, 100000);
+		REQUIRE(dtStatusSucceed(status));
+		CHECK(dtStatusDetail(status, DT_OUT_OF_NODES));
+
+		dtPolyRef path[256];
+		CHECK(field->getPath(startRef, path, 256) == 0);
+		CHECK(field->getNextPoly(startRef) == 0);
+	}
+
+	dtFreeFlowField(field);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
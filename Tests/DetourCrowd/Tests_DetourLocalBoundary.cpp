@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <string.h>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourLocalBoundary.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+#include "../Detour/TestNavMesh.h"
+
+TEST_CASE("dtWallSegmentCache")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 2, 2));
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 256)));
+	dtQueryFilter filter;
+
+	dtWallSegmentCache* cache = dtAllocWallSegmentCache();
+	REQUIRE(cache);
+	REQUIRE(cache->init(16, 64));
+
+	const float* segs = 0;
+	float expected[DT_VERTS_PER_POLYGON*3*6];
+	int nexpected = 0;
+
+	SECTION("Cached segments match the navigation mesh")
+	{
+		// There are more polygons than the cache holds, it starts over when it is full.
+		int npolys = 0;
+		for (int i = 0; i < navmesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)navmesh)->getTile(i);
+			if (!tile->header)
+				continue;
+			const dtPolyRef base = navmesh->getPolyRefBase(tile);
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				const dtPolyRef ref = base | (dtPolyRef)j;
+				REQUIRE(dtStatusSucceed(query->getPolyWallSegments(ref, &filter, expected, 0, &nexpected, DT_VERTS_PER_POLYGON*3)));
+				for (int k = 0; k < 2; ++k)
+				{
+					REQUIRE(cache->getWallSegments(ref, &filter, query, &segs) == nexpected);
+					CHECK(memcmp(segs, expected, sizeof(float)*6*nexpected) == 0);
+				}
+				npolys++;
+			}
+		}
+		CHECK(cache->getMissCount() == npolys);
+		CHECK(cache->getHitCount() == npolys);
+	}
+
+	SECTION("Filters with different flags are cached separately")
+	{
+		const dtPolyRef ref = navmesh->getPolyRefBase(navmesh->getTileAt(0, 0, 0));
+		cache->getWallSegments(ref, &filter, query, &segs);
+		filter.setExcludeFlags(2);
+		cache->getWallSegments(ref, &filter, query, &segs);
+		CHECK(cache->getMissCount() == 2);
+		cache->getWallSegments(ref, &filter, query, &segs);
+		CHECK(cache->getHitCount() == 1);
+	}
+
+	SECTION("Removing a tile invalidates the walls of its neighbours")
+	{
+		// The polygon in the x+ corner of the tile borders the removed tile.
+		const dtMeshTile* tile = navmesh->getTileAt(0, 0, 0);
+		const dtPolyRef ref = navmesh->getPolyRefBase(tile) | 3;
+		const dtPolyRef otherRef = navmesh->getPolyRefBase(navmesh->getTileAt(0, 1, 0));
+		CHECK(cache->getWallSegments(ref, &filter, query, &segs) == 1);
+		cache->getWallSegments(otherRef, &filter, query, &segs);
+
+		const unsigned int since = navmesh->getTileChangeCount();
+		REQUIRE(dtStatusSucceed(navmesh->removeTile(navmesh->getTileRefAt(1, 0, 0), 0, 0)));
+		int tiles[DT_MAX_TILE_CHANGES];
+		const int ntiles = navmesh->getChangedTiles(since, tiles, DT_MAX_TILE_CHANGES);
+		REQUIRE(ntiles > 0);
+		std::sort(tiles, tiles + ntiles);
+		cache->invalidateTiles(tiles, ntiles);
+
+		REQUIRE(dtStatusSucceed(query->getPolyWallSegments(ref, &filter, expected, 0, &nexpected, DT_VERTS_PER_POLYGON*3)));
+		CHECK(nexpected == 2);
+		REQUIRE(cache->getWallSegments(ref, &filter, query, &segs) == nexpected);
+		CHECK(memcmp(segs, expected, sizeof(float)*6*nexpected) == 0);
+		CHECK(cache->getMissCount() == 3);
+
+		// The tile at (0, 1) does not touch the removed tile across an edge, but shares a corner with it.
+		cache->getWallSegments(otherRef, &filter, query, &segs);
+		CHECK(cache->getMissCount() == 4);
+	}
+
+	SECTION("Changing a border polygon invalidates the walls across the tile border")
+	{
+		// The polygon in the x+ corner of the tile borders the first polygon of the tile at (1, 0).
+		const dtPolyRef ref = navmesh->getPolyRefBase(navmesh->getTileAt(0, 0, 0)) | 3;
+		const dtPolyRef neiRef = navmesh->getPolyRefBase(navmesh->getTileAt(1, 0, 0));
+		CHECK(cache->getWallSegments(ref, &filter, query, &segs) == 1);
+
+		const unsigned int since = navmesh->getTileChangeCount();
+		REQUIRE(dtStatusSucceed(navmesh->setPolyFlags(neiRef, 0)));
+		int tiles[DT_MAX_TILE_CHANGES];
+		const int ntiles = navmesh->getChangedTiles(since, tiles, DT_MAX_TILE_CHANGES);
+		REQUIRE(ntiles == 2);
+		cache->invalidateTiles(tiles, ntiles);
+
+		// The excluded neighbour is a wall now.
+		REQUIRE(dtStatusSucceed(query->getPolyWallSegments(ref, &filter, expected, 0, &nexpected, DT_VERTS_PER_POLYGON*3)));
+		CHECK(nexpected == 2);
+		REQUIRE(cache->getWallSegments(ref, &filter, query, &segs) == nexpected);
+		CHECK(memcmp(segs, expected, sizeof(float)*6*nexpected) == 0);
+	}
+
+	dtFreeWallSegmentCache(cache);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtLocalBoundary::update")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 2, 2));
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 256)));
+	dtQueryFilter filter;
+
+	dtWallSegmentCache* cache = dtAllocWallSegmentCache();
+	REQUIRE(cache);
+	REQUIRE(cache->init(64, 256));
+
+	SECTION("The boundary is the same with a wall segment cache")
+	{
+		const float halfExtents[3] = {1.0f, 1.0f, 1.0f};
+		for (int i = 0; i < 16; ++i)
+		{
+			const float pos[3] = {0.25f + i * 0.5f, 0.0f, 0.75f + i * 0.25f};
+			dtPolyRef ref = 0;
+			float nearest[3];
+			REQUIRE(dtStatusSucceed(query->findNearestPoly(pos, halfExtents, &filter, &ref, nearest)));
+
+			dtLocalBoundary boundary;
+			dtLocalBoundary cachedBoundary;
+			boundary.update(ref, nearest, 3.0f, query, &filter);
+			cachedBoundary.update(ref, nearest, 3.0f, query, &filter, cache);
+			REQUIRE(cachedBoundary.getSegmentCount() == boundary.getSegmentCount());
+			for (int j = 0; j < boundary.getSegmentCount(); ++j)
+				CHECK(memcmp(cachedBoundary.getSegment(j), boundary.getSegment(j), sizeof(float)*6) == 0);
+		}
+
+		// The agents walking next to each other share most of the polygons.
+		CHECK(cache->getHitCount() > cache->getMissCount());
+	}
+
+	dtFreeWallSegmentCache(cache);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
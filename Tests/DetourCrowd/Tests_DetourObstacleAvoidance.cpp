@@ -0,0 +1,169 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourCommon.h"
+#include "DetourObstacleAvoidance.h"
+
+namespace
+{
+void initTestParams(dtObstacleAvoidanceParams* params)
+{
+    memset(params, 0, sizeof(dtObstacleAvoidanceParams));
+    params->velBias = 0.5f;
+    params->weightDesVel = 2.0f;
+    params->weightCurVel = 0.75f;
+    params->weightSide = 0.75f;
+    params->weightToi = 2.5f;
+    params->horizTime = 2.5f;
+    params->gridSize = 33;
+    params->adaptiveDivs = 7;
+    params->adaptiveRings = 2;
+    params->adaptiveDepth = 5;
+    params->mode = DT_OBSTACLE_AVOIDANCE_ADAPTIVE;
+}
+}
+
+TEST_CASE("dtObstacleAvoidanceQuery")
+{
+    dtObstacleAvoidanceQuery* query = dtAllocObstacleAvoidanceQuery();
+    REQUIRE(query != nullptr);
+    REQUIRE(query->init(6, 8));
+
+    dtObstacleAvoidanceParams params;
+    initTestParams(&params);
+
+    const float pos[3] = {0, 0, 0};
+    const float rad = 0.6f;
+    const float vmax = 3.5f;
+    const float vel[3] = {0, 0, 3};
+    const float dvel[3] = {0, 0, 3};
+
+    SECTION("Should keep the desired velocity when there are no obstacles")
+    {
+        float nvel[3];
+        const int nadaptive = query->sampleVelocityAdaptive(pos, rad, vmax, vel, dvel, nvel, &params);
+        CHECK(nadaptive > 0);
+        CHECK(nvel[0] == Catch::Approx(0.0f).margin(0.1f));
+        CHECK(nvel[2] == Catch::Approx(3.0f).margin(0.1f));
+
+        const int ngrid = query->sampleVelocityGrid(pos, rad, vmax, vel, dvel, nvel, &params);
+        CHECK(ngrid > 0);
+        CHECK(nvel[0] == Catch::Approx(0.0f).margin(0.2f));
+        CHECK(nvel[2] == Catch::Approx(3.0f).margin(0.2f));
+    }
+
+    SECTION("Should steer around an obstacle ahead")
+    {
+        const float cpos[3] = {0, 0, 2};
+        const float cvel[3] = {0, 0, 0};
+        query->addCircle(cpos, 0.6f, cvel, cvel);
+
+        // The chosen velocity must not hit the obstacle within the time horizon.
+        float nvel[3];
+        query->sampleVelocityAdaptive(pos, rad, vmax, vel, dvel, nvel, &params);
+        CHECK(fabsf(nvel[0]) > 0.5f);
+
+        query->sampleVelocityGrid(pos, rad, vmax, vel, dvel, nvel, &params);
+        CHECK(fabsf(nvel[0]) > 0.5f);
+    }
+
+    SECTION("Should not move through a wall it touches")
+    {
+        const float p[3] = {-2, 0, 0.005f};
+        const float q[3] = {2, 0, 0.005f};
+        query->addSegment(p, q);
+
+        float nvel[3];
+        query->sampleVelocityAdaptive(pos, rad, vmax, vel, dvel, nvel, &params);
+        CHECK(nvel[2] < 0.5f);
+    }
+
+    SECTION("Should record the evaluated samples for debugging")
+    {
+        const float cpos[3] = {0.5f, 0, 2};
+        const float cvel[3] = {0, 0, -1};
+        query->addCircle(cpos, 0.6f, cvel, cvel);
+
+        dtObstacleAvoidanceDebugData* debug = dtAllocObstacleAvoidanceDebugData();
+        REQUIRE(debug != nullptr);
+        REQUIRE(debug->init(2048));
+
+        float nvel[3];
+        const int ns = query->sampleVelocityGrid(pos, rad, vmax, vel, dvel, nvel, &params, debug);
+        REQUIRE(debug->getSampleCount() > 0);
+        CHECK(debug->getSampleCount() <= ns);
+
+        // The chosen velocity is one of the recorded samples with the lowest penalty.
+        float minPenalty = FLT_MAX;
+        int best = -1;
+        for (int i = 0; i < debug->getSampleCount(); ++i)
+        {
+            if (debug->getSamplePenalty(i) < minPenalty)
+            {
+                minPenalty = debug->getSamplePenalty(i);
+                best = i;
+            }
+        }
+        REQUIRE(best >= 0);
+        CHECK(memcmp(debug->getSampleVelocity(best), nvel, sizeof(nvel)) == 0);
+
+        dtFreeObstacleAvoidanceDebugData(debug);
+    }
+
+    SECTION("Should keep the desired velocity with ORCA when there are no obstacles")
+    {
+        float nvel[3];
+        query->computeVelocityORCA(pos, rad, vmax, vel, dvel, nvel, 0.1f, &params);
+        CHECK(nvel[0] == Catch::Approx(0.0f));
+        CHECK(nvel[2] == Catch::Approx(3.0f));
+
+        // The velocity is limited to the max speed.
+        const float fast[3] = {0, 0, 5};
+        query->computeVelocityORCA(pos, rad, vmax, vel, fast, nvel, 0.1f, &params);
+        CHECK(nvel[2] == Catch::Approx(vmax));
+    }
+
+    SECTION("Should find reciprocal ORCA velocities which do not collide")
+    {
+        // Two agents walking towards each other.
+        const float posA[3] = {0, 0, 0};
+        const float posB[3] = {0.1f, 0, 4};
+        const float velA[3] = {0, 0, 2};
+        const float velB[3] = {0, 0, -2};
+
+        float nvelA[3], nvelB[3];
+        query->addCircle(posB, rad, velB, velB);
+        const int nlines = query->computeVelocityORCA(posA, rad, vmax, velA, velA, nvelA, 0.1f, &params);
+        CHECK(nlines == 1);
+        query->reset();
+        query->addCircle(posA, rad, velA, velA);
+        query->computeVelocityORCA(posB, rad, vmax, velB, velB, nvelB, 0.1f, &params);
+
+        // The agents pass each other without overlapping within the time horizon.
+        const float dx = posB[0] - posA[0], dz = posB[2] - posA[2];
+        const float vx = nvelB[0] - nvelA[0], vz = nvelB[2] - nvelA[2];
+        const float t = dtClamp(-(dx*vx + dz*vz) / (vx*vx + vz*vz), 0.0f, params.horizTime);
+        const float minDist = sqrtf((dx + vx*t)*(dx + vx*t) + (dz + vz*t)*(dz + vz*t));
+        CHECK(minDist >= rad*2 - 0.01f);
+
+        // Both agents still make progress.
+        CHECK(nvelA[2] > 0.0f);
+        CHECK(nvelB[2] < 0.0f);
+    }
+
+    SECTION("Should not move through a wall it touches with ORCA")
+    {
+        const float p[3] = {-2, 0, 0.005f};
+        const float q[3] = {2, 0, 0.005f};
+        query->addSegment(p, q);
+
+        float nvel[3];
+        query->computeVelocityORCA(pos, rad, vmax, vel, dvel, nvel, 0.1f, &params);
+        CHECK(nvel[2] <= 0.001f);
+    }
+
+    dtFreeObstacleAvoidanceQuery(query);
+}
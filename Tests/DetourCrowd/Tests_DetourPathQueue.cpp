@@ -0,0 +1,134 @@
+#include <atomic>
+#include <thread>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPathQueue.h"
+
+#include "../Detour/TestNavMesh.h"
+
+static dtPolyRef findTestPoly(const dtNavMeshQuery* query, const dtQueryFilter* filter, const float* pos)
+{
+	const float halfExtents[3] = {1.0f, 2.0f, 1.0f};
+	dtPolyRef ref = 0;
+	float nearest[3];
+	query->findNearestPoly(pos, halfExtents, filter, &ref, nearest);
+	return ref;
+}
+
+TEST_CASE("dtPathQueue")
+{
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(initTestNavMesh(navmesh, 4, 4));
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(navmesh, 512)));
+
+	dtQueryFilter filter;
+	const float startPos[3] = {0.5f, 0.0f, 0.5f};
+	const float endPos[3] = {15.5f, 0.0f, 15.5f};
+	const dtPolyRef startRef = findTestPoly(query, &filter, startPos);
+	const dtPolyRef endRef = findTestPoly(query, &filter, endPos);
+	REQUIRE(startRef);
+	REQUIRE(endRef);
+
+	const int maxRequests = 20;
+	dtPathQueue pathq;
+	REQUIRE(pathq.init(256, 4096, navmesh, maxRequests));
+	CHECK(pathq.getMaxRequests() == maxRequests);
+
+	SECTION("Holds the configured number of requests")
+	{
+		for (int i = 0; i < maxRequests; ++i)
+			CHECK(pathq.request(startRef, endRef, startPos, endPos, &filter) != DT_PATHQ_INVALID);
+		CHECK(pathq.request(startRef, endRef, startPos, endPos, &filter) == DT_PATHQ_INVALID);
+		CHECK(pathq.getPendingRequestCount() == maxRequests);
+	}
+
+	SECTION("Processes the requests by priority")
+	{
+		dtPathQueueRef refs[3];
+		refs[0] = pathq.request(startRef, endRef, startPos, endPos, &filter, 1.0f);
+		refs[1] = pathq.request(startRef, endRef, startPos, endPos, &filter, 3.0f);
+		refs[2] = pathq.request(startRef, endRef, startPos, endPos, &filter, 2.0f);
+
+		// Run just enough iterations to finish one request at a time.
+		const int order[3] = {1, 2, 0};
+		for (int i = 0; i < 3; ++i)
+		{
+			while (dtStatusInProgress(pathq.getRequestStatus(refs[order[i]])))
+			{
+				for (int j = i + 1; j < 3; ++j)
+					REQUIRE(dtStatusInProgress(pathq.getRequestStatus(refs[order[j]])));
+				pathq.update(1);
+			}
+			REQUIRE(dtStatusSucceed(pathq.getRequestStatus(refs[order[i]])));
+		}
+
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(dtStatusSucceed(pathq.getPathResult(refs[0], path, &npath, 256)));
+		CHECK(npath > 1);
+		CHECK(path[0] == startRef);
+		CHECK(path[npath-1] == endRef);
+		CHECK(dtStatusFailed(pathq.getRequestStatus(refs[0])));
+	}
+
+	SECTION("Frees the results which are not read")
+	{
+		for (int i = 0; i < maxRequests; ++i)
+			REQUIRE(pathq.request(startRef, endRef, startPos, endPos, &filter) != DT_PATHQ_INVALID);
+		pathq.update(100000);
+		REQUIRE(pathq.getPendingRequestCount() == 0);
+		CHECK(pathq.request(startRef, endRef, startPos, endPos, &filter) == DT_PATHQ_INVALID);
+		for (int i = 0; i < 3; ++i)
+			pathq.update(100);
+		CHECK(pathq.request(startRef, endRef, startPos, endPos, &filter) != DT_PATHQ_INVALID);
+	}
+
+	SECTION("Can be updated on another thread")
+	{
+		std::atomic<bool> quit(false);
+		std::thread worker([&pathq, &quit]()
+		{
+			while (!quit.load())
+				pathq.update(10);
+		});
+
+		int finished = 0;
+		dtPathQueueRef refs[maxRequests] = {};
+		for (int step = 0; step < 100000 && finished < 100; ++step)
+		{
+			for (int i = 0; i < maxRequests; ++i)
+			{
+				if (refs[i] == DT_PATHQ_INVALID)
+				{
+					refs[i] = pathq.request(startRef, endRef, startPos, endPos, &filter, (float)i);
+					continue;
+				}
+				const dtStatus status = pathq.getRequestStatus(refs[i]);
+				if (dtStatusInProgress(status))
+					continue;
+				REQUIRE(dtStatusSucceed(status));
+				dtPolyRef path[256];
+				int npath = 0;
+				REQUIRE(dtStatusSucceed(pathq.getPathResult(refs[i], path, &npath, 256)));
+				REQUIRE(npath > 1);
+				CHECK(path[npath-1] == endRef);
+				refs[i] = DT_PATHQ_INVALID;
+				finished++;
+			}
+			std::this_thread::yield();
+		}
+
+		quit.store(true);
+		worker.join();
+		CHECK(finished >= 100);
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navmesh);
+}
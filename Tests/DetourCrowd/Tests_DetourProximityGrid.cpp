@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourProximityGrid.h"
+
+namespace
+{
+class CollectItems : public dtProximityQuery
+{
+public:
+    std::vector<int> ids;
+    int batches = 0;
+
+    void process(const int* batch, const int count) override
+    {
+        ids.insert(ids.end(), batch, batch + count);
+        batches++;
+    }
+};
+}
+
+TEST_CASE("dtProximityGrid")
+{
+    dtProximityGrid* grid = dtAllocProximityGrid();
+    REQUIRE(grid != nullptr);
+
+    SECTION("Should find every item of a dense cluster once")
+    {
+        const int itemCount = 100;
+        REQUIRE(grid->init(itemCount, 1.0f));
+        for (int i = 0; i < itemCount; ++i)
+        {
+            const float x = (i % 10) * 0.1f;
+            const float y = (i / 10) * 0.1f;
+            grid->addItem(i, x - 0.5f, y - 0.5f, x + 0.5f, y + 0.5f);
+        }
+        grid->build();
+        CHECK(grid->getItemCount() == itemCount);
+
+        CollectItems query;
+        grid->queryItems(0.4f, 0.4f, 0.6f, 0.6f, &query);
+        std::sort(query.ids.begin(), query.ids.end());
+        REQUIRE(query.ids.size() == itemCount);
+        for (int i = 0; i < itemCount; ++i)
+            CHECK(query.ids[i] == i);
+        CHECK(query.batches == 4);
+
+        int ids[16];
+        CHECK(grid->queryItems(0.4f, 0.4f, 0.6f, 0.6f, ids, 16) == 16);
+    }
+
+    SECTION("Should only return items overlapping the query area")
+    {
+        REQUIRE(grid->init(4, 2.0f));
+        grid->addItem(0, 0.0f, 0.0f, 1.0f, 1.0f);
+        grid->addItem(1, 5.0f, 5.0f, 6.0f, 6.0f);
+        grid->addItem(2, -10.0f, -10.0f, 10.0f, 10.0f);
+        grid->build();
+
+        int ids[4];
+        const int n = grid->queryItems(5.5f, 5.5f, 5.5f, 5.5f, ids, 4);
+        REQUIRE(n == 2);
+        std::vector<int> found(ids, ids + n);
+        std::sort(found.begin(), found.end());
+        CHECK(found[0] == 1);
+        CHECK(found[1] == 2);
+
+        CHECK(grid->getItemCountAt(0, 0) == 2);
+        CHECK(grid->getItemCountAt(2, 2) == 1);
+    }
+
+    SECTION("Should support more than 65535 items")
+    {
+        const int itemCount = 70000;
+        REQUIRE(grid->init(itemCount, 1.0f));
+        for (int i = 0; i < itemCount; ++i)
+        {
+            const float x = (float)(i % 300);
+            const float y = (float)(i / 300);
+            grid->addItem(i, x + 0.25f, y + 0.25f, x + 0.75f, y + 0.75f);
+        }
+        grid->build();
+
+        int ids[4];
+        const int last = itemCount - 1;
+        const float x = (float)(last % 300) + 0.5f;
+        const float y = (float)(last / 300) + 0.5f;
+        REQUIRE(grid->queryItems(x, y, x, y, ids, 4) == 1);
+        CHECK(ids[0] == last);
+    }
+
+    SECTION("Should move items within their cell without rebuilding")
+    {
+        REQUIRE(grid->init(2, 4.0f));
+        grid->addItem(0, 0.5f, 0.5f, 1.5f, 1.5f);
+        grid->addItem(1, 8.5f, 8.5f, 9.5f, 9.5f);
+        grid->build();
+
+        CHECK(grid->moveItem(0, 2.0f, 2.0f, 3.0f, 3.0f));
+        int ids[2];
+        REQUIRE(grid->queryItems(2.5f, 2.5f, 2.5f, 2.5f, ids, 2) == 1);
+        CHECK(ids[0] == 0);
+        CHECK(grid->queryItems(1.0f, 1.0f, 1.0f, 1.0f, ids, 2) == 0);
+
+        // Moving to another cell requires a rebuild.
+        CHECK_FALSE(grid->moveItem(0, 4.5f, 4.5f, 5.5f, 5.5f));
+
+        grid->clear();
+        CHECK(grid->getItemCount() == 0);
+        CHECK_FALSE(grid->moveItem(1, 8.5f, 8.5f, 9.5f, 9.5f));
+    }
+
+    dtFreeProximityGrid(grid);
+}
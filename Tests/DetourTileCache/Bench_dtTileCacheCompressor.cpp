@@ -0,0 +1,239 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "Recast.h"
+#include "DetourTileCacheBuilder.h"
+#include "DetourTileCacheCompressor.h"
+#include "fastlz.h"
+
+// TODO: Implement benchmarking for platforms other than posix.
+#ifdef __unix__
+#include <unistd.h>
+#ifdef _POSIX_TIMERS
+#include <time.h>
+#include <stdint.h>
+
+static int64_t tileCacheBenchNowNanos()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &tp);
+	return tp.tv_nsec + 1000000000LL * tp.tv_sec;
+}
+
+// The compressor used by RecastDemo.
+struct BenchFastLZCompressor : public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return (int)(bufferSize * 1.05f) + 66;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int /*maxCompressedSize*/, int* compressedSize)
+	{
+		*compressedSize = fastlz_compress((const void*)buffer, bufferSize, compressed);
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		*bufferSize = fastlz_decompress(compressed, compressedSize, buffer, maxBufferSize);
+		return *bufferSize < 0 ? DT_FAILURE : DT_SUCCESS;
+	}
+};
+
+// Reads the vertices and the triangulated faces of an obj file.
+static bool loadObj(const char* path, std::vector<float>& verts, std::vector<int>& tris)
+{
+	FILE* fp = fopen(path, "r");
+	if (!fp)
+		return false;
+	char line[512];
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (line[0] == 'v' && line[1] == ' ')
+		{
+			float v[3];
+			if (sscanf(line + 2, "%f %f %f", &v[0], &v[1], &v[2]) == 3)
+				verts.insert(verts.end(), v, v + 3);
+		}
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			int face[32];
+			int n = 0;
+			char* s = line + 2;
+			while (n < 32)
+			{
+				while (*s == ' ' || *s == '\t')
+					s++;
+				int idx = 0;
+				int read = 0;
+				if (sscanf(s, "%d%n", &idx, &read) != 1)
+					break;
+				face[n++] = idx < 0 ? (int)verts.size() / 3 + idx : idx - 1;
+				s += read;
+				// Skip texture and normal indices.
+				while (*s && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r')
+					s++;
+			}
+			for (int i = 2; i < n; ++i)
+			{
+				tris.push_back(face[0]);
+				tris.push_back(face[i - 1]);
+				tris.push_back(face[i]);
+			}
+		}
+	}
+	fclose(fp);
+	return !tris.empty();
+}
+
+// Rasterizes the mesh into 48x48 cell tiles and collects the grids of every layer,
+// laid out as dtBuildTileCacheLayer passes them to the compressor.
+static void buildMeshLayers(const std::vector<float>& verts, const std::vector<int>& tris,
+							std::vector<std::vector<unsigned char> >& layers)
+{
+	const float cs = 0.3f;
+	const float ch = 0.2f;
+	const int tileSize = 48;
+	const int walkableHeight = (int)ceilf(2.0f / ch);
+	const int walkableClimb = (int)floorf(0.9f / ch);
+	const int walkableRadius = (int)ceilf(0.6f / cs);
+	const int borderSize = walkableRadius + 3;
+	const int size = tileSize + borderSize * 2;
+
+	const int nverts = (int)verts.size() / 3;
+	const int ntris = (int)tris.size() / 3;
+	float bmin[3], bmax[3];
+	rcCalcBounds(&verts[0], nverts, bmin, bmax);
+	std::vector<unsigned char> areas(ntris);
+	rcContext ctx(false);
+
+	const float tcs = tileSize * cs;
+	const int tw = (int)((bmax[0] - bmin[0]) / tcs) + 1;
+	const int th = (int)((bmax[2] - bmin[2]) / tcs) + 1;
+	for (int ty = 0; ty < th; ++ty)
+	{
+		for (int tx = 0; tx < tw; ++tx)
+		{
+			float tbmin[3], tbmax[3];
+			tbmin[0] = bmin[0] + tx * tcs - borderSize * cs;
+			tbmin[1] = bmin[1];
+			tbmin[2] = bmin[2] + ty * tcs - borderSize * cs;
+			tbmax[0] = bmin[0] + (tx + 1) * tcs + borderSize * cs;
+			tbmax[1] = bmax[1];
+			tbmax[2] = bmin[2] + (ty + 1) * tcs + borderSize * cs;
+
+			rcHeightfield* hf = rcAllocHeightfield();
+			rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+			rcHeightfieldLayerSet* lset = rcAllocHeightfieldLayerSet();
+			REQUIRE(rcCreateHeightfield(&ctx, *hf, size, size, tbmin, tbmax, cs, ch));
+			memset(&areas[0], 0, areas.size());
+			rcMarkWalkableTriangles(&ctx, 45.0f, &verts[0], nverts, &tris[0], ntris, &areas[0]);
+			REQUIRE(rcRasterizeTriangles(&ctx, &verts[0], nverts, &tris[0], &areas[0], ntris, *hf, walkableClimb));
+			rcFilterLowHangingWalkableObstacles(&ctx, walkableClimb, *hf);
+			rcFilterLedgeSpans(&ctx, walkableHeight, walkableClimb, *hf);
+			rcFilterWalkableLowHeightSpans(&ctx, walkableHeight, *hf);
+			REQUIRE(rcBuildCompactHeightfield(&ctx, walkableHeight, walkableClimb, *hf, *chf));
+			REQUIRE(rcErodeWalkableArea(&ctx, walkableRadius, *chf));
+			REQUIRE(rcBuildHeightfieldLayers(&ctx, *chf, borderSize, walkableHeight, *lset));
+
+			for (int i = 0; i < lset->nlayers; ++i)
+			{
+				const rcHeightfieldLayer* layer = &lset->layers[i];
+				const int gridSize = layer->width * layer->height;
+				std::vector<unsigned char> grids(gridSize * 3);
+				memcpy(&grids[0], layer->heights, gridSize);
+				memcpy(&grids[gridSize], layer->areas, gridSize);
+				memcpy(&grids[gridSize * 2], layer->cons, gridSize);
+				layers.push_back(grids);
+			}
+
+			rcFreeHeightfieldLayerSet(lset);
+			rcFreeCompactHeightfield(chf);
+			rcFreeHeightField(hf);
+		}
+	}
+}
+
+// Measures the compressed size and the compression and decompression speed over all the layers.
+static void benchCompressor(const char* name, const char* mesh, dtTileCacheCompressor* comp,
+							const std::vector<std::vector<unsigned char> >& layers, const int iterations)
+{
+	std::vector<std::vector<unsigned char> > compressed(layers.size());
+	std::vector<int> compressedSizes(layers.size());
+	size_t rawSize = 0;
+	size_t compressedSize = 0;
+
+	int64_t begin = tileCacheBenchNowNanos();
+	for (int it = 0; it < iterations; ++it)
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			const int size = (int)layers[i].size();
+			compressed[i].resize(comp->maxCompressedSize(size));
+			REQUIRE(dtStatusSucceed(comp->compress(&layers[i][0], size, &compressed[i][0],
+												   (int)compressed[i].size(), &compressedSizes[i])));
+		}
+	}
+	const int64_t compressNanos = tileCacheBenchNowNanos() - begin;
+
+	std::vector<unsigned char> buffer;
+	begin = tileCacheBenchNowNanos();
+	for (int it = 0; it < iterations; ++it)
+	{
+		for (size_t i = 0; i < layers.size(); ++i)
+		{
+			buffer.resize(layers[i].size());
+			int size = 0;
+			REQUIRE(dtStatusSucceed(comp->decompress(&compressed[i][0], compressedSizes[i],
+													 &buffer[0], (int)buffer.size(), &size)));
+			REQUIRE(size == (int)layers[i].size());
+		}
+	}
+	const int64_t decompressNanos = tileCacheBenchNowNanos() - begin;
+
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		rawSize += layers[i].size();
+		compressedSize += compressedSizes[i];
+	}
+	const double mb = (double)rawSize * iterations / (1024.0 * 1024.0);
+	printf("BM_dtTileCacheCompressor_%-8s %-16s %4d layers: ratio %6.2f, compress %8.1f MB/s, decompress %8.1f MB/s\n",
+		   name, mesh, (int)layers.size(), (double)rawSize / (double)compressedSize,
+		   mb / (compressNanos * 1e-9), mb / (decompressNanos * 1e-9));
+}
+
+TEST_CASE("BM_dtTileCacheCompressor", "[.bench]")
+{
+	const char* meshes[] = { "nav_test.obj", "dungeon.obj", "undulating.obj" };
+	for (int m = 0; m < 3; ++m)
+	{
+		std::vector<float> verts;
+		std::vector<int> tris;
+		const std::string path = std::string(RECASTNAVIGATION_TEST_MESH_DIR) + "/" + meshes[m];
+		if (!loadObj(path.c_str(), verts, tris))
+		{
+			WARN("Could not load " << path);
+			continue;
+		}
+
+		std::vector<std::vector<unsigned char> > layers;
+		buildMeshLayers(verts, tris, layers);
+		REQUIRE(!layers.empty());
+
+		dtTileCacheLayerCompressor layerComp;
+		BenchFastLZCompressor fastlzComp;
+		benchCompressor("layer", meshes[m], &layerComp, layers, 20);
+		benchCompressor("fastlz", meshes[m], &fastlzComp, layers, 20);
+	}
+}
+
+#endif // _POSIX_TIMERS
+#endif // __unix__
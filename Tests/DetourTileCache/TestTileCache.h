@@ -0,0 +1,200 @@
+#ifndef TESTTILECACHE_H
+#define TESTTILECACHE_H
+
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+
+// Stores the layers uncompressed, and counts the decompressed layers.
+struct TestTileCacheCompressor : public dtTileCacheCompressor
+{
+	// Atomic, the layers can be decompressed on worker threads.
+	std::atomic<int> decompressCount;
+
+	TestTileCacheCompressor() : decompressCount(0) {}
+
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return bufferSize;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize)
+	{
+		if (bufferSize > maxCompressedSize)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		memcpy(compressed, buffer, bufferSize);
+		*compressedSize = bufferSize;
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		decompressCount++;
+		if (compressedSize > maxBufferSize)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		memcpy(buffer, compressed, compressedSize);
+		*bufferSize = compressedSize;
+		return DT_SUCCESS;
+	}
+};
+
+// Makes every walkable polygon passable with flag 1, and counts the built tiles.
+struct TestTileCacheMeshProcess : public dtTileCacheMeshProcess
+{
+	// Atomic, the tiles can be built on worker threads.
+	std::atomic<int> processCount;
+
+	TestTileCacheMeshProcess() : processCount(0) {}
+
+	virtual void process(struct dtNavMeshCreateParams* params, unsigned char* polyAreas, unsigned short* polyFlags)
+	{
+		processCount++;
+		for (int i = 0; i < params->polyCount; ++i)
+		{
+			if (polyAreas[i] == DT_TILECACHE_WALKABLE_AREA)
+				polyAreas[i] = 0;
+			polyFlags[i] = 1;
+		}
+	}
+};
+
+// Runs the workers on short lived threads, the calling thread runs the first worker.
+struct TestThreadTileCacheTaskRunner : public dtTileCacheTaskRunner
+{
+	virtual void run(dtTileCacheTask* task, const int workerCount)
+	{
+		std::vector<std::thread> threads;
+		for (int i = 1; i < workerCount; ++i)
+			threads.emplace_back([task, i]() { task->execute(i); });
+		task->execute(0);
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+};
+
+// Builds a flat, fully walkable tile cache layer of tileSize x tileSize cells.
+// The cells along the tile borders are marked as portals so that neighbour tiles get connected.
+inline bool buildTestTileCacheLayer(dtTileCacheCompressor* comp, int tx, int ty, int tileSize, float cs, float ch,
+									unsigned char** outData, int* outDataSize)
+{
+	dtTileCacheLayerHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = DT_TILECACHE_MAGIC;
+	header.version = DT_TILECACHE_VERSION;
+	header.tx = tx;
+	header.ty = ty;
+	header.tlayer = 0;
+	header.bmin[0] = tx * tileSize * cs;
+	header.bmin[1] = 0.0f;
+	header.bmin[2] = ty * tileSize * cs;
+	header.bmax[0] = (tx + 1) * tileSize * cs;
+	header.bmax[1] = 4 * ch;
+	header.bmax[2] = (ty + 1) * tileSize * cs;
+	header.hmin = 0;
+	header.hmax = 0;
+	header.width = (unsigned char)tileSize;
+	header.height = (unsigned char)tileSize;
+	header.minx = 0;
+	header.maxx = (unsigned char)(tileSize - 1);
+	header.miny = 0;
+	header.maxy = (unsigned char)(tileSize - 1);
+
+	const int gridSize = tileSize * tileSize;
+	unsigned char* heights = new unsigned char[gridSize];
+	unsigned char* areas = new unsigned char[gridSize];
+	unsigned char* cons = new unsigned char[gridSize];
+	memset(heights, 0, gridSize);
+	memset(areas, DT_TILECACHE_WALKABLE_AREA, gridSize);
+
+	// Directions: x-, z+, x+, z-. Low bits connect to the layer, high bits are portals to the neighbour tiles.
+	static const int offsetX[4] = { -1, 0, 1, 0 };
+	static const int offsetZ[4] = { 0, 1, 0, -1 };
+	for (int z = 0; z < tileSize; ++z)
+	{
+		for (int x = 0; x < tileSize; ++x)
+		{
+			unsigned char con = 0;
+			unsigned char portal = 0;
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				const int nx = x + offsetX[dir];
+				const int nz = z + offsetZ[dir];
+				if (nx >= 0 && nz >= 0 && nx < tileSize && nz < tileSize)
+					con |= (unsigned char)(1 << dir);
+				else
+					portal |= (unsigned char)(1 << dir);
+			}
+			cons[x + z * tileSize] = (unsigned char)((portal << 4) | con);
+		}
+	}
+
+	const dtStatus status = dtBuildTileCacheLayer(comp, &header, heights, areas, cons, outData, outDataSize);
+
+	delete[] heights;
+	delete[] areas;
+	delete[] cons;
+	return dtStatusSucceed(status);
+}
+
+// Initializes a tile cache with tilesX x tilesY flat layers, and the matching empty navmesh.
+inline bool initTestTileCache(dtTileCache* tileCache, dtNavMesh* navmesh,
+							  dtTileCacheAlloc* talloc, dtTileCacheCompressor* tcomp, dtTileCacheMeshProcess* tmproc,
+							  int tilesX, int tilesY, int tileSize = 32, int maxObstacles = 128)
+{
+	const float cs = 0.3f;
+	const float ch = 0.2f;
+
+	dtTileCacheParams tcparams;
+	memset(&tcparams, 0, sizeof(tcparams));
+	tcparams.cs = cs;
+	tcparams.ch = ch;
+	tcparams.width = tileSize;
+	tcparams.height = tileSize;
+	tcparams.walkableHeight = 2.0f;
+	tcparams.walkableRadius = 0.6f;
+	tcparams.walkableClimb = 0.9f;
+	tcparams.maxSimplificationError = 1.3f;
+	tcparams.maxTiles = tilesX * tilesY;
+	tcparams.maxObstacles = maxObstacles;
+	if (dtStatusFailed(tileCache->init(&tcparams, talloc, tcomp, tmproc)))
+		return false;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = tileSize * cs;
+	params.tileHeight = tileSize * cs;
+	params.maxTiles = tilesX * tilesY;
+	params.maxPolys = 256;
+	if (dtStatusFailed(navmesh->init(&params)))
+		return false;
+
+	for (int y = 0; y < tilesY; ++y)
+	{
+		for (int x = 0; x < tilesX; ++x)
+		{
+			unsigned char* data = 0;
+			int dataSize = 0;
+			if (!buildTestTileCacheLayer(tcomp, x, y, tileSize, cs, ch, &data, &dataSize))
+				return false;
+			if (dtStatusFailed(tileCache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0)))
+			{
+				dtFree(data);
+				return false;
+			}
+			if (dtStatusFailed(tileCache->buildNavMeshTilesAt(x, y, navmesh)))
+				return false;
+		}
+	}
+	return true;
+}
+
+#endif // TESTTILECACHE_H
@@ -0,0 +1,962 @@
+#include <algorithm>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+
+#include "TestTileCache.h"
+
+static int updateUntilDone(dtTileCache* tileCache, dtNavMesh* navmesh)
+{
+	int updates = 0;
+	bool upToDate = false;
+	while (!upToDate && updates < 1000)
+	{
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		updates++;
+	}
+	return updates;
+}
+
+static bool hasPolyAt(const dtNavMesh* navmesh, const float* pos)
+{
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	query->init(navmesh, 64);
+	const float halfExtents[3] = { 0.1f, 1.0f, 0.1f };
+	dtQueryFilter filter;
+	dtPolyRef ref = 0;
+	float nearest[3];
+	bool overPoly = false;
+	query->findNearestPoly(pos, halfExtents, &filter, &ref, nearest, &overPoly);
+	dtFreeNavMeshQuery(query);
+	return ref != 0 && overPoly;
+}
+
+// Returns the area of the polygon at the position, or -1 if there is none.
+static int getPolyAreaAt(const dtNavMesh* navmesh, const float* pos)
+{
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	query->init(navmesh, 64);
+	const float halfExtents[3] = { 0.1f, 1.0f, 0.1f };
+	dtQueryFilter filter;
+	dtPolyRef ref = 0;
+	float nearest[3];
+	bool overPoly = false;
+	query->findNearestPoly(pos, halfExtents, &filter, &ref, nearest, &overPoly);
+	dtFreeNavMeshQuery(query);
+	unsigned char area = 0;
+	if (!ref || !overPoly || dtStatusFailed(navmesh->getPolyArea(ref, &area)))
+		return -1;
+	return area;
+}
+
+TEST_CASE("dtTileCache::setTaskRunner")
+{
+	const int tilesX = 4;
+	const int tilesY = 4;
+
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* serialCache = dtAllocTileCache();
+	dtNavMesh* serialMesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(serialCache, serialMesh, &talloc, &tcomp, &tmproc, tilesX, tilesY));
+
+	dtTileCacheAlloc workerAllocs[4];
+	dtTileCacheAlloc* allocs[4] = { &workerAllocs[0], &workerAllocs[1], &workerAllocs[2], &workerAllocs[3] };
+	TestThreadTileCacheTaskRunner runner;
+	dtTileCache* parallelCache = dtAllocTileCache();
+	dtNavMesh* parallelMesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(parallelCache, parallelMesh, &talloc, &tcomp, &tmproc, tilesX, tilesY));
+	REQUIRE(dtStatusSucceed(parallelCache->setTaskRunner(&runner, allocs, 4)));
+	REQUIRE(parallelCache->getWorkerCount() == 4);
+
+	SECTION("Parallel update gives the same navmesh as the serial update")
+	{
+		// One obstacle on each inner tile corner, so that every obstacle touches four tiles.
+		const float tileWorldSize = 32 * 0.3f;
+		dtObstacleRef serialRefs[9];
+		dtObstacleRef parallelRefs[9];
+		float centers[9][3];
+		float probes[9][3];
+		for (int i = 0; i < 9; ++i)
+		{
+			centers[i][0] = ((i % 3) + 1) * tileWorldSize;
+			centers[i][1] = 0.0f;
+			centers[i][2] = ((i / 3) + 1) * tileWorldSize;
+			// Sample inside the obstacle, away from the shared tile corner.
+			dtVset(probes[i], centers[i][0] + 0.5f, 0.0f, centers[i][2] + 0.5f);
+			REQUIRE(dtStatusSucceed(serialCache->addObstacle(centers[i], 1.5f, 2.0f, &serialRefs[i])));
+			REQUIRE(dtStatusSucceed(parallelCache->addObstacle(centers[i], 1.5f, 2.0f, &parallelRefs[i])));
+		}
+
+		const int serialUpdates = updateUntilDone(serialCache, serialMesh);
+		const int parallelUpdates = updateUntilDone(parallelCache, parallelMesh);
+		CHECK(parallelUpdates < serialUpdates);
+
+		for (int i = 0; i < 9; ++i)
+		{
+			CHECK(parallelCache->getObstacleByRef(parallelRefs[i])->state == DT_OBSTACLE_PROCESSED);
+			CHECK(!hasPolyAt(parallelMesh, probes[i]));
+		}
+
+		for (int y = 0; y < tilesY; ++y)
+		{
+			for (int x = 0; x < tilesX; ++x)
+			{
+				const dtMeshTile* a = serialMesh->getTileAt(x, y, 0);
+				const dtMeshTile* b = parallelMesh->getTileAt(x, y, 0);
+				REQUIRE(a);
+				REQUIRE(b);
+				REQUIRE(a->dataSize == b->dataSize);
+				CHECK(memcmp(a->data, b->data, a->dataSize) == 0);
+			}
+		}
+
+		// Removing the obstacles restores the walkable area.
+		for (int i = 0; i < 9; ++i)
+			REQUIRE(dtStatusSucceed(parallelCache->removeObstacle(parallelRefs[i])));
+		updateUntilDone(parallelCache, parallelMesh);
+		for (int i = 0; i < 9; ++i)
+		{
+			CHECK(!parallelCache->getObstacleByRef(parallelRefs[i]));
+			CHECK(hasPolyAt(parallelMesh, probes[i]));
+		}
+	}
+
+	SECTION("Tiles can be built off the navmesh and swapped in later")
+	{
+		const float center[3] = { 4.8f, 0.0f, 4.8f };
+		dtObstacleRef ob;
+		REQUIRE(dtStatusSucceed(serialCache->addObstacle(center, 1.5f, 2.0f, &ob)));
+		// Registers the obstacle with the tiles it touches, then builds the first one.
+		bool upToDate = false;
+		REQUIRE(dtStatusSucceed(serialCache->update(0.0f, serialMesh, &upToDate)));
+		CHECK(upToDate);
+		CHECK(!hasPolyAt(serialMesh, center));
+
+		const dtCompressedTile* tile = serialCache->getTileAt(0, 0, 0);
+		REQUIRE(tile);
+		const dtCompressedTileRef ref = serialCache->getTileRef(tile);
+
+		dtTileCacheAlloc buildAlloc;
+		unsigned char* navData = 0;
+		int navDataSize = 0;
+		REQUIRE(dtStatusSucceed(serialCache->buildNavMeshTileData(ref, &buildAlloc, &navData, &navDataSize)));
+		REQUIRE(navData);
+		CHECK(navDataSize > 0);
+
+		// Building the data does not touch the navmesh.
+		const dtMeshTile* before = serialMesh->getTileAt(0, 0, 0);
+		REQUIRE(before);
+		const dtTileRef beforeRef = serialMesh->getTileRef(before);
+
+		REQUIRE(dtStatusSucceed(serialCache->swapNavMeshTile(ref, navData, navDataSize, serialMesh)));
+		const dtMeshTile* after = serialMesh->getTileAt(0, 0, 0);
+		REQUIRE(after);
+		CHECK(after->data == navData);
+		CHECK(serialMesh->getTileRef(after) != beforeRef);
+
+		// Stale references are rejected.
+		CHECK(dtStatusFailed(serialCache->buildNavMeshTileData(ref + (1u << 16), &buildAlloc, &navData, &navDataSize)));
+		CHECK(navData == 0);
+	}
+
+	SECTION("Invalid worker setups are rejected")
+	{
+		CHECK(dtStatusFailed(parallelCache->setTaskRunner(&runner, allocs, 0)));
+		CHECK(dtStatusFailed(parallelCache->setTaskRunner(&runner, 0, 2)));
+		dtTileCacheAlloc* missing[2] = { &workerAllocs[0], 0 };
+		CHECK(dtStatusFailed(parallelCache->setTaskRunner(&runner, missing, 2)));
+		CHECK(parallelCache->getWorkerCount() == 4);
+
+		REQUIRE(dtStatusSucceed(parallelCache->setTaskRunner(0, 0, 0)));
+		CHECK(parallelCache->getWorkerCount() == 1);
+	}
+
+	dtFreeTileCache(parallelCache);
+	dtFreeNavMesh(parallelMesh);
+	dtFreeTileCache(serialCache);
+	dtFreeNavMesh(serialMesh);
+}
+
+TEST_CASE("dtTileCache::setUpdateParams")
+{
+	const int tilesX = 4;
+	const int tilesY = 4;
+	const int obstacleCount = 2000;
+
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, tilesX, tilesY, 32, obstacleCount));
+
+	const dtTileCacheUpdateParams* defaults = tileCache->getUpdateParams();
+	CHECK(defaults->maxRequestsPerUpdate > 0);
+	CHECK(defaults->maxTilesPerUpdate == 1);
+
+	SECTION("Invalid params are rejected")
+	{
+		dtTileCacheUpdateParams params = *defaults;
+		params.maxRequestsPerUpdate = 0;
+		CHECK(dtStatusFailed(tileCache->setUpdateParams(&params)));
+		params = *defaults;
+		params.maxTilesPerUpdate = 0;
+		CHECK(dtStatusFailed(tileCache->setUpdateParams(&params)));
+		CHECK(tileCache->getUpdateParams()->maxTilesPerUpdate == 1);
+	}
+
+	SECTION("Bursts of obstacle requests are queued and each touched tile is rebuilt once")
+	{
+		dtTileCacheUpdateParams params;
+		params.maxRequestsPerUpdate = 500;
+		params.maxTilesPerUpdate = 4;
+		REQUIRE(dtStatusSucceed(tileCache->setUpdateParams(&params)));
+
+		// Small debris spread over the whole tile cache.
+		const float worldSize = tilesX * 32 * 0.3f;
+		dtObstacleRef refs[obstacleCount];
+		for (int i = 0; i < obstacleCount; ++i)
+		{
+			const float pos[3] = { (i * 37 % 101) / 101.0f * worldSize, 0.0f, (i * 53 % 97) / 97.0f * worldSize };
+			REQUIRE(dtStatusSucceed(tileCache->addObstacle(pos, 0.2f, 1.0f, &refs[i])));
+		}
+		CHECK(tileCache->getRequestCount() == obstacleCount);
+
+		bool upToDate = false;
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		CHECK(!upToDate);
+		CHECK(tileCache->getRequestCount() == obstacleCount - 500);
+		CHECK(tileCache->getUpdateCount() <= tilesX * tilesY - 4);
+
+		int updates = 1;
+		while (!upToDate && updates < 100)
+		{
+			REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+			CHECK(tileCache->getUpdateCount() <= tilesX * tilesY);
+			updates++;
+		}
+		REQUIRE(upToDate);
+		// Four updates to take the requests in, then each tile is rebuilt at most once more.
+		CHECK(updates <= 4 + tilesX * tilesY / 4);
+
+		for (int i = 0; i < obstacleCount; ++i)
+			REQUIRE(tileCache->getObstacleByRef(refs[i])->state == DT_OBSTACLE_PROCESSED);
+
+		for (int i = 0; i < obstacleCount; ++i)
+			REQUIRE(dtStatusSucceed(tileCache->removeObstacle(refs[i])));
+		while (tileCache->getRequestCount() || tileCache->getUpdateCount())
+			REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh)));
+		for (int i = 0; i < obstacleCount; ++i)
+			REQUIRE(!tileCache->getObstacleByRef(refs[i]));
+	}
+
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtTileCache obstacle ids")
+{
+	// More obstacles than the 16 bit obstacle index of the original ID layout.
+	const int obstacleCount = 70000;
+
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, 4, 4, 32, obstacleCount));
+
+	dtTileCacheUpdateParams params;
+	params.maxRequestsPerUpdate = obstacleCount;
+	params.maxTilesPerUpdate = 16;
+	REQUIRE(dtStatusSucceed(tileCache->setUpdateParams(&params)));
+
+	const float worldSize = 4 * 32 * 0.3f;
+	std::vector<dtObstacleRef> refs(obstacleCount);
+	for (int i = 0; i < obstacleCount; ++i)
+	{
+		const float pos[3] = { (i * 37 % 1009) / 1009.0f * worldSize, 0.0f, (i * 53 % 997) / 997.0f * worldSize };
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(pos, 0.05f, 1.0f, &refs[i])));
+	}
+	CHECK(tileCache->decodeObstacleIdObstacle(refs[obstacleCount - 1]) == obstacleCount - 1);
+
+	bool upToDate = false;
+	REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+	CHECK(upToDate);
+	for (int i = 0; i < obstacleCount; ++i)
+	{
+		const dtTileCacheObstacle* ob = tileCache->getObstacleByRef(refs[i]);
+		REQUIRE(ob);
+		REQUIRE(ob->state == DT_OBSTACLE_PROCESSED);
+		REQUIRE(tileCache->getObstacleRef(ob) == refs[i]);
+	}
+
+	// Freed obstacles get a new salt.
+	REQUIRE(dtStatusSucceed(tileCache->removeObstacle(refs[obstacleCount - 1])));
+	REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+	CHECK(upToDate);
+	CHECK(!tileCache->getObstacleByRef(refs[obstacleCount - 1]));
+	const float pos[3] = { 1.0f, 0.0f, 1.0f };
+	dtObstacleRef reused = 0;
+	REQUIRE(dtStatusSucceed(tileCache->addObstacle(pos, 0.05f, 1.0f, &reused)));
+	CHECK(tileCache->decodeObstacleIdObstacle(reused) == obstacleCount - 1);
+	CHECK(reused != refs[obstacleCount - 1]);
+
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtTileCache obstacle index")
+{
+	const int tilesX = 4;
+	const int tilesY = 4;
+
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, tilesX, tilesY));
+
+	SECTION("Obstacles outside of the tiles are processed and removed right away")
+	{
+		const float pos[3] = { -100.0f, 0.0f, -100.0f };
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(pos, 1.0f, 2.0f, &ref)));
+		bool upToDate = false;
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		CHECK(upToDate);
+		CHECK(tileCache->getObstacleByRef(ref)->state == DT_OBSTACLE_PROCESSED);
+
+		REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		CHECK(upToDate);
+		CHECK(!tileCache->getObstacleByRef(ref));
+	}
+
+	SECTION("Obstacles only apply to the tiles they were added to")
+	{
+		const float center[3] = { 4.8f, 0.0f, 4.8f };
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(center, 1.5f, 2.0f, &ref)));
+		bool upToDate = false;
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		REQUIRE(upToDate);
+		CHECK(!hasPolyAt(navmesh, center));
+
+		// Replace the layer, the new tile reuses the slot of the old one.
+		dtCompressedTile* tile = tileCache->getTileAt(0, 0, 0);
+		REQUIRE(tile);
+		const dtCompressedTileRef oldRef = tileCache->getTileRef(tile);
+		REQUIRE(dtStatusSucceed(tileCache->removeTile(oldRef, 0, 0)));
+		unsigned char* data = 0;
+		int dataSize = 0;
+		REQUIRE(buildTestTileCacheLayer(&tcomp, 0, 0, 32, 0.3f, 0.2f, &data, &dataSize));
+		dtCompressedTileRef newRef = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, &newRef)));
+		CHECK(tileCache->decodeTileIdTile(newRef) == tileCache->decodeTileIdTile(oldRef));
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(newRef, navmesh)));
+		CHECK(hasPolyAt(navmesh, center));
+
+		// The obstacle can still be removed.
+		REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+		while (tileCache->getRequestCount() || tileCache->getUpdateCount())
+			tileCache->update(0.0f, navmesh);
+		CHECK(!tileCache->getObstacleByRef(ref));
+	}
+
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtTileCache::beginBatch")
+{
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, 4, 4));
+
+	dtTileCacheUpdateParams params;
+	params.maxRequestsPerUpdate = 8;
+	params.maxTilesPerUpdate = 2;
+	REQUIRE(dtStatusSucceed(tileCache->setUpdateParams(&params)));
+
+	// 50 crates inside the first tile.
+	const int crateCount = 50;
+	float crates[crateCount][3];
+	for (int i = 0; i < crateCount; ++i)
+		dtVset(crates[i], 2.0f + (i % 10) * 0.6f, 0.0f, 2.0f + (i / 10) * 0.6f);
+	const float halfExtents[3] = { 0.2f, 0.5f, 0.2f };
+
+	SECTION("Unbatched changes rebuild the tile several times")
+	{
+		for (int i = 0; i < crateCount; ++i)
+			REQUIRE(dtStatusSucceed(tileCache->addBoxObstacle(crates[i], halfExtents, 0.0f, 0)));
+		tmproc.processCount = 0;
+		updateUntilDone(tileCache, navmesh);
+		CHECK(tmproc.processCount > 1);
+	}
+
+	SECTION("Batched changes are held until the batch ends, then rebuild the tile once")
+	{
+		tileCache->beginBatch();
+		for (int i = 0; i < crateCount; ++i)
+		{
+			// Nested batches only end with the outermost one.
+			tileCache->beginBatch();
+			REQUIRE(dtStatusSucceed(tileCache->addBoxObstacle(crates[i], halfExtents, 0.0f, 0)));
+			REQUIRE(dtStatusSucceed(tileCache->endBatch()));
+		}
+
+		tmproc.processCount = 0;
+		bool upToDate = true;
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		CHECK(!upToDate);
+		CHECK(tileCache->getRequestCount() == crateCount);
+		CHECK(tmproc.processCount == 0);
+
+		REQUIRE(dtStatusSucceed(tileCache->endBatch()));
+		CHECK(dtStatusFailed(tileCache->endBatch()));
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		CHECK(upToDate);
+		CHECK(tmproc.processCount == 1);
+		CHECK(!hasPolyAt(navmesh, crates[crateCount - 1]));
+	}
+
+	SECTION("Moving an obstacle keeps its reference and rebuilds each tile once")
+	{
+		const float from[3] = { 8.0f, 0.0f, 4.8f };
+		const float to[3] = { 11.2f, 0.0f, 4.8f };
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(from, 1.0f, 2.0f, &ref)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(!hasPolyAt(navmesh, from));
+
+		// The obstacle leaves tile (0,0) and stays in tile (1,0).
+		tmproc.processCount = 0;
+		REQUIRE(dtStatusSucceed(tileCache->moveObstacle(ref, to)));
+		bool upToDate = false;
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh, &upToDate)));
+		CHECK(upToDate);
+		CHECK(tmproc.processCount == 2);
+		CHECK(tileCache->getObstacleByRef(ref)->state == DT_OBSTACLE_PROCESSED);
+		CHECK(hasPolyAt(navmesh, from));
+		CHECK(!hasPolyAt(navmesh, to));
+
+		// Several moves in a batch only rebuild for the last position.
+		tmproc.processCount = 0;
+		tileCache->beginBatch();
+		REQUIRE(dtStatusSucceed(tileCache->moveObstacle(ref, from)));
+		REQUIRE(dtStatusSucceed(tileCache->moveObstacle(ref, to)));
+		REQUIRE(dtStatusSucceed(tileCache->endBatch()));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(tmproc.processCount == 2);
+		CHECK(!hasPolyAt(navmesh, to));
+
+		REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(dtStatusFailed(tileCache->moveObstacle(ref, from)));
+	}
+
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtTileCache::setLayerCacheSize")
+{
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, 4, 4));
+
+	const int layerSize = 32 * 32 * 3;
+	const float doorPos[3] = { 4.8f, 0.0f, 4.8f };
+
+	SECTION("The cache is disabled by default")
+	{
+		CHECK(tileCache->getLayerCacheSize() == 0);
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(doorPos, 1.0f, 2.0f, &ref)));
+		updateUntilDone(tileCache, navmesh);
+		REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+		tcomp.decompressCount = 0;
+		updateUntilDone(tileCache, navmesh);
+		CHECK(tcomp.decompressCount == 1);
+		CHECK(tileCache->getLayerCacheUsedSize() == 0);
+	}
+
+	SECTION("Rebuilding a cached tile skips the decompression")
+	{
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(layerSize * 4)));
+
+		// A door opening and closing.
+		tcomp.decompressCount = 0;
+		for (int i = 0; i < 5; ++i)
+		{
+			dtObstacleRef ref = 0;
+			REQUIRE(dtStatusSucceed(tileCache->addObstacle(doorPos, 1.0f, 2.0f, &ref)));
+			updateUntilDone(tileCache, navmesh);
+			CHECK(!hasPolyAt(navmesh, doorPos));
+			REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+			updateUntilDone(tileCache, navmesh);
+			CHECK(hasPolyAt(navmesh, doorPos));
+		}
+		CHECK(tcomp.decompressCount == 1);
+		// The layer and the contour polygons of its last build.
+		CHECK(tileCache->getLayerCacheUsedSize() > layerSize);
+
+		// The cached layer is dropped with its tile.
+		unsigned char* data = 0;
+		int dataSize = 0;
+		REQUIRE(dtStatusSucceed(tileCache->removeTile(tileCache->getTileRef(tileCache->getTileAt(0, 0, 0)), &data, &dataSize)));
+		CHECK(tileCache->getLayerCacheUsedSize() == 0);
+	}
+
+	SECTION("The least recently built layers are dropped to stay within the budget")
+	{
+		const dtCompressedTileRef tile0 = tileCache->getTileRef(tileCache->getTileAt(0, 0, 0));
+		const dtCompressedTileRef tile1 = tileCache->getTileRef(tileCache->getTileAt(1, 0, 0));
+		const dtCompressedTileRef tile2 = tileCache->getTileRef(tileCache->getTileAt(2, 0, 0));
+
+		// The tiles are the same, so are their cache entries.
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(layerSize * 16)));
+		tcomp.decompressCount = 0;
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile0, navmesh)));
+		const int entrySize = tileCache->getLayerCacheUsedSize();
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(entrySize * 2)));
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile1, navmesh)));
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile0, navmesh)));
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile2, navmesh)));
+		CHECK(tcomp.decompressCount == 3);
+		CHECK(tileCache->getLayerCacheUsedSize() == entrySize * 2);
+
+		// Tile 1 was the least recently built.
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile0, navmesh)));
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile2, navmesh)));
+		CHECK(tcomp.decompressCount == 3);
+		REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTile(tile1, navmesh)));
+		CHECK(tcomp.decompressCount == 4);
+
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(entrySize)));
+		CHECK(tileCache->getLayerCacheUsedSize() == entrySize);
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(0)));
+		CHECK(tileCache->getLayerCacheUsedSize() == 0);
+		CHECK(dtStatusFailed(tileCache->setLayerCacheSize(-1)));
+	}
+
+	SECTION("Parallel updates use the cache")
+	{
+		dtTileCacheAlloc workerAllocs[4];
+		dtTileCacheAlloc* allocs[4] = { &workerAllocs[0], &workerAllocs[1], &workerAllocs[2], &workerAllocs[3] };
+		TestThreadTileCacheTaskRunner runner;
+		REQUIRE(dtStatusSucceed(tileCache->setTaskRunner(&runner, allocs, 4)));
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(layerSize * 16)));
+
+		// The door touches the four tiles around the corner.
+		const float cornerPos[3] = { 9.6f, 0.0f, 9.6f };
+		tcomp.decompressCount = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			dtObstacleRef ref = 0;
+			REQUIRE(dtStatusSucceed(tileCache->addObstacle(cornerPos, 1.0f, 2.0f, &ref)));
+			updateUntilDone(tileCache, navmesh);
+			REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+			updateUntilDone(tileCache, navmesh);
+		}
+		CHECK(tcomp.decompressCount == 4);
+		CHECK(tileCache->getLayerCacheUsedSize() > layerSize * 4);
+	}
+
+	SECTION("Cached tiles build the same navmesh as uncached tiles")
+	{
+		dtTileCache* uncachedCache = dtAllocTileCache();
+		dtNavMesh* uncachedMesh = dtAllocNavMesh();
+		REQUIRE(initTestTileCache(uncachedCache, uncachedMesh, &talloc, &tcomp, &tmproc, 4, 4));
+		REQUIRE(dtStatusSucceed(tileCache->setLayerCacheSize(layerSize * 16)));
+
+		// Obstacles coming and going in the first tile, the contours away from the latest one keep their polygons.
+		const float positions[4][3] = {
+			{ 2.0f, 0.0f, 2.0f }, { 7.0f, 0.0f, 3.0f }, { 3.0f, 0.0f, 7.5f }, { 6.5f, 0.0f, 6.5f }
+		};
+		dtObstacleRef refs[2][4];
+		for (int i = 0; i < 4; ++i)
+		{
+			REQUIRE(dtStatusSucceed(tileCache->addObstacle(positions[i], 0.8f, 2.0f, &refs[0][i])));
+			REQUIRE(dtStatusSucceed(uncachedCache->addObstacle(positions[i], 0.8f, 2.0f, &refs[1][i])));
+			updateUntilDone(tileCache, navmesh);
+			updateUntilDone(uncachedCache, uncachedMesh);
+			if (i % 2 == 1)
+			{
+				REQUIRE(dtStatusSucceed(tileCache->removeObstacle(refs[0][i - 1])));
+				REQUIRE(dtStatusSucceed(uncachedCache->removeObstacle(refs[1][i - 1])));
+				updateUntilDone(tileCache, navmesh);
+				updateUntilDone(uncachedCache, uncachedMesh);
+			}
+
+			const dtMeshTile* a = navmesh->getTileAt(0, 0, 0);
+			const dtMeshTile* b = uncachedMesh->getTileAt(0, 0, 0);
+			REQUIRE(a);
+			REQUIRE(b);
+			REQUIRE(a->dataSize == b->dataSize);
+			CHECK(memcmp(a->data, b->data, a->dataSize) == 0);
+		}
+
+		dtFreeTileCache(uncachedCache);
+		dtFreeNavMesh(uncachedMesh);
+	}
+
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
+
+TEST_CASE("dtTileCache::addConvexObstacle")
+{
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, 2, 2));
+
+	// A diamond around (9.6, 9.6), across the four tiles.
+	const float diamond[4 * 3] = {
+		9.6f, 0.0f, 7.8f,
+		11.4f, 0.0f, 9.6f,
+		9.6f, 0.0f, 11.4f,
+		7.8f, 0.0f, 9.6f,
+	};
+	const float center[3] = { 9.9f, 0.0f, 9.9f };
+	const float corner[3] = { 8.4f, 0.0f, 8.4f };
+	const unsigned char waterArea = 5;
+
+	SECTION("A square marks the same cells as a box")
+	{
+		const dtCompressedTile* tile = tileCache->getTileAt(0, 0, 0);
+		REQUIRE(tile);
+		dtTileCacheLayer* boxLayer = 0;
+		dtTileCacheLayer* convexLayer = 0;
+		REQUIRE(dtStatusSucceed(dtDecompressTileCacheLayer(&talloc, &tcomp, tile->data, tile->dataSize, &boxLayer)));
+		REQUIRE(dtStatusSucceed(dtDecompressTileCacheLayer(&talloc, &tcomp, tile->data, tile->dataSize, &convexLayer)));
+
+		const float bmin[3] = { 1.0f, 0.0f, 1.0f };
+		const float bmax[3] = { 2.0f, 0.5f, 2.6f };
+		const float square[4 * 3] = {
+			bmin[0], 0.0f, bmin[2],
+			bmin[0], 0.0f, bmax[2],
+			bmax[0], 0.0f, bmax[2],
+			bmax[0], 0.0f, bmin[2],
+		};
+		REQUIRE(dtStatusSucceed(dtMarkBoxArea(*boxLayer, tile->header->bmin, 0.3f, 0.2f, bmin, bmax, waterArea)));
+		REQUIRE(dtStatusSucceed(dtMarkConvexPolyArea(*convexLayer, tile->header->bmin, 0.3f, 0.2f,
+													 square, 4, bmin[1], bmax[1], waterArea)));
+
+		const int gridSize = boxLayer->header->width * boxLayer->header->height;
+		int marked = 0;
+		for (int i = 0; i < gridSize; ++i)
+			marked += boxLayer->areas[i] == waterArea ? 1 : 0;
+		CHECK(marked == 4 * 6);
+		CHECK(memcmp(boxLayer->areas, convexLayer->areas, gridSize) == 0);
+
+		dtFreeTileCacheLayer(&talloc, boxLayer);
+		dtFreeTileCacheLayer(&talloc, convexLayer);
+	}
+
+	SECTION("Convex obstacles cut the navmesh in every tile they touch")
+	{
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addConvexObstacle(diamond, 4, -1.0f, 1.0f, &ref)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(tileCache->getObstacleByRef(ref)->state == DT_OBSTACLE_PROCESSED);
+		CHECK(tileCache->getObstacleByRef(ref)->ntouched == 4);
+		CHECK(!hasPolyAt(navmesh, center));
+		CHECK(hasPolyAt(navmesh, corner));
+
+		float bmin[3], bmax[3];
+		tileCache->getObstacleBounds(tileCache->getObstacleByRef(ref), bmin, bmax);
+		CHECK(bmin[0] == Catch::Approx(7.8f));
+		CHECK(bmax[2] == Catch::Approx(11.4f));
+		CHECK(bmax[1] == Catch::Approx(1.0f));
+
+		// Moving places the bottom center of the bounds at the position.
+		const float pos[3] = { 7.0f, -1.0f, 7.0f };
+		REQUIRE(dtStatusSucceed(tileCache->moveObstacle(ref, pos)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(hasPolyAt(navmesh, center));
+		CHECK(!hasPolyAt(navmesh, pos));
+		tileCache->getObstacleBounds(tileCache->getObstacleByRef(ref), bmin, bmax);
+		CHECK(bmin[0] == Catch::Approx(5.2f));
+		CHECK(bmin[1] == Catch::Approx(-1.0f));
+		CHECK(bmax[1] == Catch::Approx(1.0f));
+	}
+
+	SECTION("Obstacles can mark areas instead of holes")
+	{
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addConvexObstacle(diamond, 4, -1.0f, 1.0f, &ref, waterArea)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(getPolyAreaAt(navmesh, center) == waterArea);
+		CHECK(getPolyAreaAt(navmesh, corner) == 0);
+
+		// Unwalkable obstacles win over the areas, whatever the order they were added in.
+		const float pos[3] = { 9.6f, 0.0f, 9.6f };
+		dtObstacleRef hole = 0;
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(pos, 0.5f, 1.0f, &hole)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(getPolyAreaAt(navmesh, center) == -1);
+		const float edge[3] = { 9.9f, 0.0f, 8.4f };
+		CHECK(getPolyAreaAt(navmesh, edge) == waterArea);
+
+		REQUIRE(dtStatusSucceed(tileCache->removeObstacle(ref)));
+		REQUIRE(dtStatusSucceed(tileCache->removeObstacle(hole)));
+		updateUntilDone(tileCache, navmesh);
+		CHECK(getPolyAreaAt(navmesh, center) == 0);
+		CHECK(getPolyAreaAt(navmesh, edge) == 0);
+	}
+
+	SECTION("Areas do not fill the holes of the layers")
+	{
+		const dtCompressedTile* tile = tileCache->getTileAt(0, 0, 0);
+		REQUIRE(tile);
+		dtTileCacheLayer* layer = 0;
+		REQUIRE(dtStatusSucceed(dtDecompressTileCacheLayer(&talloc, &tcomp, tile->data, tile->dataSize, &layer)));
+
+		const float pos[3] = { 9.6f, 0.0f, 9.6f };
+		REQUIRE(dtStatusSucceed(dtMarkCylinderArea(*layer, tile->header->bmin, 0.3f, 0.2f, pos, 1.0f, 1.0f,
+												   DT_TILECACHE_NULL_AREA)));
+		const int gridSize = layer->header->width * layer->header->height;
+		int holes = 0;
+		for (int i = 0; i < gridSize; ++i)
+			holes += layer->areas[i] == DT_TILECACHE_NULL_AREA ? 1 : 0;
+		REQUIRE(holes > 0);
+
+		REQUIRE(dtStatusSucceed(dtMarkConvexPolyArea(*layer, tile->header->bmin, 0.3f, 0.2f,
+													 diamond, 4, -1.0f, 1.0f, waterArea)));
+		int holesAfter = 0;
+		int marked = 0;
+		for (int i = 0; i < gridSize; ++i)
+		{
+			holesAfter += layer->areas[i] == DT_TILECACHE_NULL_AREA ? 1 : 0;
+			marked += layer->areas[i] == waterArea ? 1 : 0;
+		}
+		CHECK(holesAfter == holes);
+		CHECK(marked > 0);
+
+		dtFreeTileCacheLayer(&talloc, layer);
+	}
+
+	SECTION("Invalid polygons are rejected")
+	{
+		CHECK(dtStatusFailed(tileCache->addConvexObstacle(diamond, 2, -1.0f, 1.0f, 0)));
+		CHECK(dtStatusFailed(tileCache->addConvexObstacle(diamond, DT_MAX_CONVEX_OBSTACLE_VERTS + 1, -1.0f, 1.0f, 0)));
+		CHECK(dtStatusFailed(tileCache->addConvexObstacle(diamond, 4, 1.0f, -1.0f, 0)));
+		CHECK(dtStatusFailed(tileCache->addConvexObstacle(0, 4, -1.0f, 1.0f, 0)));
+	}
+
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
+
+// Copies the tiles of a navmesh into an empty navmesh, keeping their references.
+static bool copyNavMeshTiles(const dtNavMesh* src, dtNavMesh* dst)
+{
+	for (int i = 0; i < src->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = src->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize)
+			continue;
+		unsigned char* data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+		memcpy(data, tile->data, tile->dataSize);
+		if (dtStatusFailed(dst->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, src->getTileRef(tile), 0)))
+		{
+			dtFree(data);
+			return false;
+		}
+	}
+	return true;
+}
+
+TEST_CASE("dtTileCache::storeObstacleState")
+{
+	dtTileCacheAlloc talloc;
+	TestTileCacheCompressor tcomp;
+	TestTileCacheMeshProcess tmproc;
+
+	dtTileCache* tileCache = dtAllocTileCache();
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(tileCache, navmesh, &talloc, &tcomp, &tmproc, 2, 2));
+
+	// A few obstacles, some of them waiting for their tiles to be rebuilt.
+	const float crate[3] = { 2.0f, 0.0f, 2.0f };
+	const float crateHalfExtents[3] = { 0.5f, 1.0f, 0.5f };
+	const float barrel[3] = { 12.0f, 0.0f, 3.0f };
+	const float pond[4 * 3] = {
+		8.0f, 0.0f, 8.0f,
+		8.0f, 0.0f, 11.0f,
+		11.0f, 0.0f, 11.0f,
+		11.0f, 0.0f, 8.0f,
+	};
+	dtObstacleRef crateRef = 0, barrelRef = 0, pondRef = 0, removedRef = 0;
+	REQUIRE(dtStatusSucceed(tileCache->addBoxObstacle(crate, crateHalfExtents, 0.5f, &crateRef)));
+	REQUIRE(dtStatusSucceed(tileCache->addObstacle(barrel, 0.4f, 1.0f, &removedRef)));
+	updateUntilDone(tileCache, navmesh);
+	REQUIRE(dtStatusSucceed(tileCache->removeObstacle(removedRef)));
+	REQUIRE(dtStatusSucceed(tileCache->addObstacle(barrel, 0.4f, 1.0f, &barrelRef)));
+	updateUntilDone(tileCache, navmesh);
+	CHECK(barrelRef != removedRef);
+
+	dtTileCacheUpdateParams params;
+	params.maxRequestsPerUpdate = 1;
+	params.maxTilesPerUpdate = 1;
+	REQUIRE(dtStatusSucceed(tileCache->setUpdateParams(&params)));
+	REQUIRE(dtStatusSucceed(tileCache->addConvexObstacle(pond, 4, -1.0f, 1.0f, &pondRef, 5)));
+	const float cratePos[3] = { 5.0f, 0.0f, 14.0f };
+	REQUIRE(dtStatusSucceed(tileCache->moveObstacle(crateRef, cratePos)));
+	REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navmesh)));
+	REQUIRE(tileCache->getRequestCount() == 1);
+	REQUIRE(tileCache->getUpdateCount() == 3);
+
+	std::vector<unsigned char> state(tileCache->getObstacleStateSize());
+	REQUIRE(dtStatusSucceed(tileCache->storeObstacleState(&state[0], (int)state.size())));
+	CHECK(dtStatusFailed(tileCache->storeObstacleState(&state[0], (int)state.size() - 1)));
+
+	// Restore into a new tile cache holding the same compressed tiles, and a copy of the navmesh.
+	dtTileCache* restoredCache = dtAllocTileCache();
+	dtNavMesh* scratchNavmesh = dtAllocNavMesh();
+	REQUIRE(initTestTileCache(restoredCache, scratchNavmesh, &talloc, &tcomp, &tmproc, 2, 2));
+	dtFreeNavMesh(scratchNavmesh);
+	dtNavMesh* restoredNavmesh = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(restoredNavmesh->init(navmesh->getParams())));
+	REQUIRE(copyNavMeshTiles(navmesh, restoredNavmesh));
+	REQUIRE(dtStatusSucceed(restoredCache->setUpdateParams(&params)));
+
+	SECTION("The obstacles, requests and rebuilds are restored")
+	{
+		tmproc.processCount = 0;
+		REQUIRE(dtStatusSucceed(restoredCache->restoreObstacleState(&state[0], (int)state.size())));
+		CHECK(tmproc.processCount == 0);
+		CHECK(restoredCache->getRequestCount() == 1);
+		CHECK(restoredCache->getUpdateCount() == 3);
+
+		const dtObstacleRef refs[3] = { crateRef, barrelRef, pondRef };
+		for (int i = 0; i < 3; ++i)
+		{
+			const dtTileCacheObstacle* a = tileCache->getObstacleByRef(refs[i]);
+			const dtTileCacheObstacle* b = restoredCache->getObstacleByRef(refs[i]);
+			REQUIRE(a);
+			REQUIRE(b);
+			CHECK(a->type == b->type);
+			CHECK(a->state == b->state);
+			CHECK(a->areaId == b->areaId);
+			CHECK(a->ntouched == b->ntouched);
+			CHECK(a->npending == b->npending);
+		}
+		CHECK(!restoredCache->getObstacleByRef(removedRef));
+
+		// Both tile caches end up with the same navmesh.
+		updateUntilDone(tileCache, navmesh);
+		updateUntilDone(restoredCache, restoredNavmesh);
+		for (int y = 0; y < 2; ++y)
+		{
+			for (int x = 0; x < 2; ++x)
+			{
+				const dtMeshTile* a = navmesh->getTileAt(x, y, 0);
+				const dtMeshTile* b = restoredNavmesh->getTileAt(x, y, 0);
+				REQUIRE(a);
+				REQUIRE(b);
+				REQUIRE(a->dataSize == b->dataSize);
+				CHECK(memcmp(a->data, b->data, a->dataSize) == 0);
+			}
+		}
+		CHECK(restoredCache->getObstacleByRef(crateRef)->state == DT_OBSTACLE_PROCESSED);
+		CHECK(getPolyAreaAt(restoredNavmesh, cratePos) == -1);
+
+		// Freed obstacles keep their salts.
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(restoredCache->addObstacle(barrel, 0.4f, 1.0f, &ref)));
+		CHECK(ref != removedRef);
+		CHECK(ref != barrelRef);
+	}
+
+	SECTION("Invalid restores are rejected")
+	{
+		CHECK(dtStatusFailed(restoredCache->restoreObstacleState(&state[0], (int)state.size() - 1)));
+		std::vector<unsigned char> badMagic(state);
+		badMagic[0] ^= 0xff;
+		CHECK(dtStatusFailed(restoredCache->restoreObstacleState(&badMagic[0], (int)badMagic.size())));
+
+		// The tile cache must not have an open batch.
+		restoredCache->beginBatch();
+		CHECK(dtStatusFailed(restoredCache->restoreObstacleState(&state[0], (int)state.size())));
+		REQUIRE(dtStatusSucceed(restoredCache->endBatch()));
+
+		// Obstacles with an unknown type or vertex count are rejected, and nothing is restored.
+		// The convex obstacle is found by its vertices, they are the first member of the obstacle.
+		const std::vector<unsigned char>::iterator pondVerts = std::search(state.begin(), state.end(),
+			(const unsigned char*)pond, (const unsigned char*)pond + sizeof(pond));
+		REQUIRE(pondVerts != state.end());
+		const size_t pondOffset = pondVerts - state.begin();
+		const size_t typeOffset = pondOffset + offsetof(dtTileCacheObstacle, type);
+		const size_t nvertsOffset = pondOffset + offsetof(dtTileCacheObstacle, convex) + offsetof(dtObstacleConvex, nverts);
+		const int badVertCounts[2] = { 2, DT_MAX_CONVEX_OBSTACLE_VERTS + 1 };
+		for (int i = 0; i < 2; ++i)
+		{
+			std::vector<unsigned char> badVerts(state);
+			memcpy(&badVerts[nvertsOffset], &badVertCounts[i], sizeof(int));
+			CHECK(dtStatusFailed(restoredCache->restoreObstacleState(&badVerts[0], (int)badVerts.size())));
+		}
+		std::vector<unsigned char> badType(state);
+		badType[typeOffset] = DT_OBSTACLE_CONVEX + 1;
+		CHECK(dtStatusFailed(restoredCache->restoreObstacleState(&badType[0], (int)badType.size())));
+		for (int i = 0; i < restoredCache->getObstacleCount(); ++i)
+			CHECK(restoredCache->getObstacle(i)->state == DT_OBSTACLE_EMPTY);
+		CHECK(restoredCache->getRequestCount() == 0);
+
+		// The tile cache must not hold obstacles.
+		REQUIRE(dtStatusSucceed(restoredCache->addObstacle(barrel, 0.4f, 1.0f, 0)));
+		CHECK(dtStatusFailed(restoredCache->restoreObstacleState(&state[0], (int)state.size())));
+	}
+
+	SECTION("The obstacle references must have the same layout")
+	{
+		dtTileCache* largeCache = dtAllocTileCache();
+		dtNavMesh* largeNavmesh = dtAllocNavMesh();
+		REQUIRE(initTestTileCache(largeCache, largeNavmesh, &talloc, &tcomp, &tmproc, 2, 2, 32, 0x10000 + 1));
+		CHECK(dtStatusFailed(largeCache->restoreObstacleState(&state[0], (int)state.size())));
+		dtFreeTileCache(largeCache);
+		dtFreeNavMesh(largeNavmesh);
+	}
+
+	SECTION("The state cannot be stored while a batch is open")
+	{
+		tileCache->beginBatch();
+		CHECK(dtStatusFailed(tileCache->storeObstacleState(&state[0], (int)state.size())));
+		REQUIRE(dtStatusSucceed(tileCache->endBatch()));
+		CHECK(dtStatusSucceed(tileCache->storeObstacleState(&state[0], (int)state.size())));
+	}
+
+	dtFreeTileCache(restoredCache);
+	dtFreeNavMesh(restoredNavmesh);
+	dtFreeTileCache(tileCache);
+	dtFreeNavMesh(navmesh);
+}
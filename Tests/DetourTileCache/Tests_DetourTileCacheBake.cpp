@@ -0,0 +1,373 @@
+#include <atomic>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "Recast.h"
+#include "DetourNavMesh.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBake.h"
+#include "DetourTileCacheBuilder.h"
+
+#include "TestTileCache.h"
+
+static const int BAKE_TILE_SIZE = 16;
+
+// Builds flat layers, with a second layer on every third tile, and tracks the layers held in memory.
+struct TestTileCacheLayerSource : public dtTileCacheLayerSource
+{
+	TestTileCacheCompressor comp;
+	std::atomic<int> liveLayers;
+	std::atomic<int> maxLiveLayers;
+	int failTile;
+
+	TestTileCacheLayerSource() : liveLayers(0), maxLiveLayers(0), failTile(-1) {}
+
+	virtual dtStatus buildTileLayers(const int tx, const int ty, const int /*worker*/,
+									 dtTileCacheLayerData* layers, const int maxLayers, int* layerCount)
+	{
+		const int nlayers = dtMin((tx + ty) % 3 == 0 ? 2 : 1, maxLayers);
+		for (int i = 0; i < nlayers; ++i)
+		{
+			if (!buildTestTileCacheLayer(&comp, tx, ty, BAKE_TILE_SIZE, 0.3f, 0.2f, &layers[i].data, &layers[i].dataSize))
+				return DT_FAILURE;
+			((dtTileCacheLayerHeader*)layers[i].data)->tlayer = i;
+			*layerCount = i + 1;
+
+			const int live = ++liveLayers;
+			int prevMax = maxLiveLayers;
+			while (live > prevMax && !maxLiveLayers.compare_exchange_weak(prevMax, live)) {}
+		}
+		if (tx + ty * 100 == failTile)
+			return DT_FAILURE;
+		return DT_SUCCESS;
+	}
+};
+
+// Records the location of the received layers.
+struct TestTileCacheLayerSink : public dtTileCacheLayerSink
+{
+	TestTileCacheLayerSource* source;
+	std::vector<int> layers;
+	int maxLayers;
+
+	TestTileCacheLayerSink(TestTileCacheLayerSource* s) : source(s), maxLayers(-1) {}
+
+	virtual dtStatus addLayer(unsigned char* data, const int /*dataSize*/)
+	{
+		const dtTileCacheLayerHeader* header = (const dtTileCacheLayerHeader*)data;
+		layers.push_back(header->tx + header->ty * 100 + header->tlayer * 10000);
+		dtFree(data);
+		source->liveLayers--;
+		if ((int)layers.size() == maxLayers)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		return DT_SUCCESS;
+	}
+};
+
+TEST_CASE("dtBakeTileCacheLayers")
+{
+	dtTileCacheBakeParams params;
+	params.tilesX = 5;
+	params.tilesY = 4;
+	params.maxLayersPerTile = 4;
+	params.maxTilesInFlight = 3;
+
+	TestThreadTileCacheTaskRunner runner;
+
+	SECTION("Parallel bakes stream the layers in tile order with bounded memory")
+	{
+		TestTileCacheLayerSource serialSource;
+		TestTileCacheLayerSink serialSink(&serialSource);
+		REQUIRE(dtStatusSucceed(dtBakeTileCacheLayers(&params, &serialSource, &serialSink, 0, 0)));
+
+		TestTileCacheLayerSource parallelSource;
+		TestTileCacheLayerSink parallelSink(&parallelSource);
+		REQUIRE(dtStatusSucceed(dtBakeTileCacheLayers(&params, &parallelSource, &parallelSink, &runner, 4)));
+
+		std::vector<int> expected;
+		for (int ty = 0; ty < params.tilesY; ++ty)
+		{
+			for (int tx = 0; tx < params.tilesX; ++tx)
+			{
+				expected.push_back(tx + ty * 100);
+				if ((tx + ty) % 3 == 0)
+					expected.push_back(tx + ty * 100 + 10000);
+			}
+		}
+		CHECK(serialSink.layers == expected);
+		CHECK(parallelSink.layers == expected);
+
+		CHECK(serialSource.maxLiveLayers <= params.maxTilesInFlight * 2);
+		CHECK(parallelSource.maxLiveLayers <= params.maxTilesInFlight * 2);
+		CHECK(parallelSource.liveLayers == 0);
+	}
+
+	SECTION("Baked layers can be added to a tile cache")
+	{
+		// The sink adds the layers to a tile cache, which takes the ownership of the data.
+		struct TileCacheSink : public dtTileCacheLayerSink
+		{
+			dtTileCache* tileCache;
+			virtual dtStatus addLayer(unsigned char* data, const int dataSize)
+			{
+				dtStatus status = tileCache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
+				if (dtStatusFailed(status))
+					dtFree(data);
+				return status;
+			}
+		};
+
+		dtTileCacheAlloc talloc;
+		TestTileCacheMeshProcess tmproc;
+		TestTileCacheLayerSource source;
+		dtTileCacheParams tcparams;
+		memset(&tcparams, 0, sizeof(tcparams));
+		tcparams.cs = 0.3f;
+		tcparams.ch = 0.2f;
+		tcparams.width = BAKE_TILE_SIZE;
+		tcparams.height = BAKE_TILE_SIZE;
+		tcparams.walkableHeight = 2.0f;
+		tcparams.walkableRadius = 0.6f;
+		tcparams.walkableClimb = 0.9f;
+		tcparams.maxSimplificationError = 1.3f;
+		tcparams.maxTiles = 64;
+		tcparams.maxObstacles = 16;
+		dtTileCache* tileCache = dtAllocTileCache();
+		REQUIRE(dtStatusSucceed(tileCache->init(&tcparams, &talloc, &source.comp, &tmproc)));
+
+		TileCacheSink sink;
+		sink.tileCache = tileCache;
+		REQUIRE(dtStatusSucceed(dtBakeTileCacheLayers(&params, &source, &sink, &runner, 2)));
+
+		dtCompressedTileRef tiles[8];
+		CHECK(tileCache->getTilesAt(0, 0, tiles, 8) == 2);
+		CHECK(tileCache->getTilesAt(1, 0, tiles, 8) == 1);
+		CHECK(tileCache->getTilesAt(4, 3, tiles, 8) == 1);
+
+		dtFreeTileCache(tileCache);
+	}
+
+	SECTION("Failures stop the bake")
+	{
+		// The tile (2,1) fails, the layers of the tiles before it are passed on and the others are freed.
+		TestTileCacheLayerSource source;
+		source.failTile = 2 + 1 * 100;
+		TestTileCacheLayerSink sink(&source);
+		CHECK(dtStatusFailed(dtBakeTileCacheLayers(&params, &source, &sink, &runner, 3)));
+		CHECK(sink.layers.size() == 9);
+		CHECK(sink.layers.back() == 1 + 1 * 100);
+
+		// The sink fails.
+		TestTileCacheLayerSource source2;
+		TestTileCacheLayerSink sink2(&source2);
+		sink2.maxLayers = 4;
+		CHECK(dtStatusFailed(dtBakeTileCacheLayers(&params, &source2, &sink2, &runner, 3)));
+		CHECK(sink2.layers.size() == 4);
+	}
+
+	SECTION("Invalid params are rejected")
+	{
+		TestTileCacheLayerSource source;
+		TestTileCacheLayerSink sink(&source);
+		params.maxTilesInFlight = 0;
+		CHECK(dtStatusFailed(dtBakeTileCacheLayers(&params, &source, &sink, 0, 0)));
+		params.maxTilesInFlight = 3;
+		CHECK(dtStatusFailed(dtBakeTileCacheLayers(&params, &source, &sink, &runner, 0)));
+		CHECK(sink.layers.empty());
+	}
+}
+
+// Rasterizes a ground plane with a bridge over its middle with Recast, the tiles under the bridge get two layers.
+struct RecastTileCacheLayerSource : public dtTileCacheLayerSource
+{
+	TestTileCacheCompressor comp;
+	std::vector<float> verts;
+	std::vector<int> tris;
+	float bmin[3];
+	float bmax[3];
+	float cs;
+	float ch;
+	int tileSize;
+	int walkableHeight;
+	int walkableClimb;
+	int walkableRadius;
+	int borderSize;
+
+	RecastTileCacheLayerSource(const int tilesX, const int tilesY) :
+		cs(0.3f), ch(0.2f), tileSize(BAKE_TILE_SIZE)
+	{
+		walkableHeight = (int)ceilf(2.0f / ch);
+		walkableClimb = (int)floorf(0.9f / ch);
+		walkableRadius = (int)ceilf(0.6f / cs);
+		borderSize = walkableRadius + 3;
+
+		const float sizeX = tilesX * tileSize * cs;
+		const float sizeZ = tilesY * tileSize * cs;
+		addQuad(0.0f, 0.0f, 0.0f, sizeX, sizeZ);
+		addQuad(0.0f, 3.0f, sizeZ * 0.4f, sizeX, sizeZ * 0.6f);
+		rcCalcBounds(&verts[0], (int)verts.size() / 3, bmin, bmax);
+		bmin[0] = 0.0f;
+		bmin[2] = 0.0f;
+	}
+
+	void addQuad(const float x0, const float y, const float z0, const float x1, const float z1)
+	{
+		const int base = (int)verts.size() / 3;
+		const float quad[12] = { x0, y, z0,  x0, y, z1,  x1, y, z1,  x1, y, z0 };
+		verts.insert(verts.end(), quad, quad + 12);
+		const int quadTris[6] = { base, base + 1, base + 2,  base, base + 2, base + 3 };
+		tris.insert(tris.end(), quadTris, quadTris + 6);
+	}
+
+	virtual dtStatus buildTileLayers(const int tx, const int ty, const int /*worker*/,
+									 dtTileCacheLayerData* layers, const int maxLayers, int* layerCount)
+	{
+		const float tcs = tileSize * cs;
+		const int size = tileSize + borderSize * 2;
+		float tbmin[3], tbmax[3];
+		tbmin[0] = bmin[0] + tx * tcs - borderSize * cs;
+		tbmin[1] = bmin[1];
+		tbmin[2] = bmin[2] + ty * tcs - borderSize * cs;
+		tbmax[0] = bmin[0] + (tx + 1) * tcs + borderSize * cs;
+		tbmax[1] = bmax[1];
+		tbmax[2] = bmin[2] + (ty + 1) * tcs + borderSize * cs;
+
+		const int nverts = (int)verts.size() / 3;
+		const int ntris = (int)tris.size() / 3;
+		std::vector<unsigned char> areas(ntris, 0);
+		rcContext ctx(false);
+		rcHeightfield* hf = rcAllocHeightfield();
+		rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+		rcHeightfieldLayerSet* lset = rcAllocHeightfieldLayerSet();
+		dtStatus status = DT_FAILURE;
+		if (hf && chf && lset &&
+			rcCreateHeightfield(&ctx, *hf, size, size, tbmin, tbmax, cs, ch))
+		{
+			rcMarkWalkableTriangles(&ctx, 45.0f, &verts[0], nverts, &tris[0], ntris, &areas[0]);
+			if (rcRasterizeTriangles(&ctx, &verts[0], nverts, &tris[0], &areas[0], ntris, *hf, walkableClimb) &&
+				rcBuildCompactHeightfield(&ctx, walkableHeight, walkableClimb, *hf, *chf) &&
+				rcErodeWalkableArea(&ctx, walkableRadius, *chf) &&
+				rcBuildHeightfieldLayers(&ctx, *chf, borderSize, walkableHeight, *lset))
+			{
+				status = DT_SUCCESS;
+				for (int i = 0; i < dtMin(lset->nlayers, maxLayers) && dtStatusSucceed(status); ++i)
+				{
+					const rcHeightfieldLayer* layer = &lset->layers[i];
+					dtTileCacheLayerHeader header;
+					memset(&header, 0, sizeof(header));
+					header.magic = DT_TILECACHE_MAGIC;
+					header.version = DT_TILECACHE_VERSION;
+					header.tx = tx;
+					header.ty = ty;
+					header.tlayer = i;
+					dtVcopy(header.bmin, layer->bmin);
+					dtVcopy(header.bmax, layer->bmax);
+					header.width = (unsigned char)layer->width;
+					header.height = (unsigned char)layer->height;
+					header.minx = (unsigned char)layer->minx;
+					header.maxx = (unsigned char)layer->maxx;
+					header.miny = (unsigned char)layer->miny;
+					header.maxy = (unsigned char)layer->maxy;
+					header.hmin = (unsigned short)layer->hmin;
+					header.hmax = (unsigned short)layer->hmax;
+					status = dtBuildTileCacheLayer(&comp, &header, layer->heights, layer->areas, layer->cons,
+												   &layers[i].data, &layers[i].dataSize);
+					if (dtStatusSucceed(status))
+						*layerCount = i + 1;
+				}
+			}
+		}
+		rcFreeHeightfieldLayerSet(lset);
+		rcFreeCompactHeightfield(chf);
+		rcFreeHeightField(hf);
+		return status;
+	}
+};
+
+TEST_CASE("dtBakeTileCacheLayers with Recast layers")
+{
+	dtTileCacheBakeParams params;
+	params.tilesX = 4;
+	params.tilesY = 5;
+	params.maxLayersPerTile = 4;
+	params.maxTilesInFlight = 3;
+
+	RecastTileCacheLayerSource source(params.tilesX, params.tilesY);
+	TestThreadTileCacheTaskRunner runner;
+
+	// Keeps the baked layers.
+	struct LayerSink : public dtTileCacheLayerSink
+	{
+		std::vector<std::vector<unsigned char> > layers;
+		virtual dtStatus addLayer(unsigned char* data, const int dataSize)
+		{
+			layers.push_back(std::vector<unsigned char>(data, data + dataSize));
+			dtFree(data);
+			return DT_SUCCESS;
+		}
+	};
+
+	LayerSink serialSink;
+	REQUIRE(dtStatusSucceed(dtBakeTileCacheLayers(&params, &source, &serialSink, 0, 0)));
+	LayerSink parallelSink;
+	REQUIRE(dtStatusSucceed(dtBakeTileCacheLayers(&params, &source, &parallelSink, &runner, 3)));
+	CHECK(parallelSink.layers == serialSink.layers);
+
+	// Every tile has the ground layer, the tiles under the bridge have the bridge layer too.
+	CHECK((int)serialSink.layers.size() > params.tilesX * params.tilesY);
+
+	dtTileCacheAlloc talloc;
+	TestTileCacheMeshProcess tmproc;
+	dtTileCacheParams tcparams;
+	memset(&tcparams, 0, sizeof(tcparams));
+	tcparams.cs = source.cs;
+	tcparams.ch = source.ch;
+	dtVcopy(tcparams.orig, source.bmin);
+	tcparams.width = BAKE_TILE_SIZE;
+	tcparams.height = BAKE_TILE_SIZE;
+	tcparams.walkableHeight = 2.0f;
+	tcparams.walkableRadius = 0.6f;
+	tcparams.walkableClimb = 0.9f;
+	tcparams.maxSimplificationError = 1.3f;
+	tcparams.maxTiles = params.tilesX * params.tilesY * params.maxLayersPerTile;
+	tcparams.maxObstacles = 16;
+	dtTileCache* tileCache = dtAllocTileCache();
+	REQUIRE(tileCache);
+	REQUIRE(dtStatusSucceed(tileCache->init(&tcparams, &talloc, &source.comp, &tmproc)));
+
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	dtVcopy(navParams.orig, source.bmin);
+	navParams.tileWidth = BAKE_TILE_SIZE * source.cs;
+	navParams.tileHeight = BAKE_TILE_SIZE * source.cs;
+	navParams.maxTiles = tcparams.maxTiles;
+	navParams.maxPolys = 256;
+	dtNavMesh* navmesh = dtAllocNavMesh();
+	REQUIRE(navmesh);
+	REQUIRE(dtStatusSucceed(navmesh->init(&navParams)));
+
+	for (size_t i = 0; i < serialSink.layers.size(); ++i)
+	{
+		const int dataSize = (int)serialSink.layers[i].size();
+		unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+		REQUIRE(data);
+		memcpy(data, &serialSink.layers[i][0], dataSize);
+		REQUIRE(dtStatusSucceed(tileCache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0)));
+	}
+	for (int ty = 0; ty < params.tilesY; ++ty)
+		for (int tx = 0; tx < params.tilesX; ++tx)
+			REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTilesAt(tx, ty, navmesh)));
+
+	// The ground and the bridge are both walkable in the middle of the mesh.
+	const dtMeshTile* tiles[4];
+	const int ntiles = ((const dtNavMesh*)navmesh)->getTilesAt(1, params.tilesY / 2, tiles, 4);
+	CHECK(ntiles == 2);
+	for (int i = 0; i < ntiles; ++i)
+		CHECK(tiles[i]->header->polyCount > 0);
+
+	dtFreeNavMesh(navmesh);
+	dtFreeTileCache(tileCache);
+}
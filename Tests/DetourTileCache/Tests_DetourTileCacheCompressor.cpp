@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "DetourNavMesh.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+#include "DetourTileCacheCompressor.h"
+
+#include "TestTileCache.h"
+
+// Builds the grids of a 64x64 layer with a slope, a ridge and a few holes, laid out as passed to the compressor.
+static std::vector<unsigned char> buildSlopedLayerGrids()
+{
+	const int size = 64;
+	const int gridSize = size * size;
+	std::vector<unsigned char> grids(gridSize * 3);
+	unsigned char* heights = &grids[0];
+	unsigned char* areas = &grids[gridSize];
+	unsigned char* cons = &grids[gridSize * 2];
+	for (int z = 0; z < size; ++z)
+	{
+		for (int x = 0; x < size; ++x)
+		{
+			const int i = x + z * size;
+			heights[i] = (unsigned char)(x / 2 + (x > 40 ? (x - 40) * 3 : 0));
+			const bool hole = (x / 8 + z / 8) % 5 == 0 && x % 8 < 3 && z % 8 < 3;
+			areas[i] = hole ? DT_TILECACHE_NULL_AREA : DT_TILECACHE_WALKABLE_AREA;
+			cons[i] = hole ? 0 : (unsigned char)(x == 0 || z == 0 || x == size - 1 || z == size - 1 ? 0x3f : 0x0f);
+		}
+	}
+	return grids;
+}
+
+static void checkRoundTrip(dtTileCacheCompressor* comp, const std::vector<unsigned char>& data, int* compressedSize)
+{
+	const int bufferSize = (int)data.size();
+	std::vector<unsigned char> compressed(comp->maxCompressedSize(bufferSize));
+	REQUIRE(dtStatusSucceed(comp->compress(bufferSize ? &data[0] : 0, bufferSize,
+										   &compressed[0], (int)compressed.size(), compressedSize)));
+	REQUIRE(*compressedSize <= (int)compressed.size());
+
+	std::vector<unsigned char> decompressed(bufferSize + 1);
+	int size = -1;
+	REQUIRE(dtStatusSucceed(comp->decompress(&compressed[0], *compressedSize,
+											 &decompressed[0], (int)decompressed.size(), &size)));
+	REQUIRE(size == bufferSize);
+	CHECK(memcmp(data.data(), decompressed.data(), bufferSize) == 0);
+}
+
+TEST_CASE("dtTileCacheLayerCompressor")
+{
+	dtTileCacheLayerCompressor comp;
+
+	SECTION("Layers round trip and shrink")
+	{
+		const std::vector<unsigned char> grids = buildSlopedLayerGrids();
+		int compressedSize = 0;
+		checkRoundTrip(&comp, grids, &compressedSize);
+		CHECK(compressedSize * 10 < (int)grids.size());
+	}
+
+	SECTION("Incompressible data stays within the bound")
+	{
+		std::vector<unsigned char> noise(5000);
+		unsigned int seed = 1;
+		for (size_t i = 0; i < noise.size(); ++i)
+		{
+			seed = seed * 1103515245u + 12345u;
+			noise[i] = (unsigned char)(seed >> 16);
+		}
+		int compressedSize = 0;
+		checkRoundTrip(&comp, noise, &compressedSize);
+	}
+
+	SECTION("Small and empty buffers round trip")
+	{
+		int compressedSize = 0;
+		checkRoundTrip(&comp, std::vector<unsigned char>(), &compressedSize);
+		checkRoundTrip(&comp, std::vector<unsigned char>(1, 7), &compressedSize);
+		checkRoundTrip(&comp, std::vector<unsigned char>(1000, 7), &compressedSize);
+		CHECK(compressedSize < 16);
+	}
+
+	SECTION("Non-square grids round trip and older streams still decode")
+	{
+		std::vector<unsigned char> grids = buildSlopedLayerGrids();
+		grids.resize(grids.size() - 3);
+		int compressedSize = 0;
+		checkRoundTrip(&comp, grids, &compressedSize);
+
+		// Heights stored as differences along the rows: heights 1, 2, areas 63, 63, connections 0, 15.
+		const unsigned char deltaHeights[] = { 0x01, 0x05, 1, 1, 63, 63, 0, 15 };
+		const unsigned char expected[] = { 1, 2, 63, 63, 0, 15 };
+		unsigned char out[6];
+		int size = 0;
+		REQUIRE(dtStatusSucceed(comp.decompress(deltaHeights, sizeof(deltaHeights), out, sizeof(out), &size)));
+		CHECK(size == 6);
+		CHECK(memcmp(out, expected, sizeof(expected)) == 0);
+	}
+
+	SECTION("Corrupt data is rejected")
+	{
+		const std::vector<unsigned char> grids = buildSlopedLayerGrids();
+		std::vector<unsigned char> compressed(comp.maxCompressedSize((int)grids.size()));
+		int compressedSize = 0;
+		REQUIRE(dtStatusSucceed(comp.compress(&grids[0], (int)grids.size(), &compressed[0], (int)compressed.size(), &compressedSize)));
+
+		std::vector<unsigned char> out(grids.size());
+		int size = 0;
+		// Output buffer too small.
+		CHECK(dtStatusFailed(comp.decompress(&compressed[0], compressedSize, &out[0], (int)out.size() - 1, &size)));
+		// Truncated stream.
+		CHECK(dtStatusFailed(comp.decompress(&compressed[0], compressedSize - 1, &out[0], (int)out.size(), &size)));
+		// Match reaching before the start of the output.
+		const unsigned char badOffset[] = { 0, 0x80, 0x10, 0x00 };
+		CHECK(dtStatusFailed(comp.decompress(badOffset, sizeof(badOffset), &out[0], (int)out.size(), &size)));
+		// Unknown format flags.
+		const unsigned char badFlags[] = { 0x80, 0x00, 0x00 };
+		CHECK(dtStatusFailed(comp.decompress(badFlags, sizeof(badFlags), &out[0], (int)out.size(), &size)));
+		// Grids which do not match the row width.
+		const unsigned char badWidth[] = { 0x02, 0x02, 0x00, 0x05, 1, 2, 3, 4, 5, 6 };
+		CHECK(dtStatusFailed(comp.decompress(badWidth, sizeof(badWidth), &out[0], (int)out.size(), &size)));
+		// Compression buffer too small.
+		CHECK(dtStatusFailed(comp.compress(&grids[0], (int)grids.size(), &compressed[0], 16, &compressedSize)));
+	}
+
+	SECTION("Tile caches using the compressor build the same navmesh")
+	{
+		dtTileCacheAlloc talloc;
+		TestTileCacheCompressor copyComp;
+		TestTileCacheMeshProcess tmproc;
+
+		dtTileCache* copyCache = dtAllocTileCache();
+		dtNavMesh* copyMesh = dtAllocNavMesh();
+		REQUIRE(initTestTileCache(copyCache, copyMesh, &talloc, &copyComp, &tmproc, 2, 2));
+		dtTileCache* layerCache = dtAllocTileCache();
+		dtNavMesh* layerMesh = dtAllocNavMesh();
+		REQUIRE(initTestTileCache(layerCache, layerMesh, &talloc, &comp, &tmproc, 2, 2));
+
+		const dtCompressedTile* copyTile = copyCache->getTileAt(1, 1, 0);
+		const dtCompressedTile* layerTile = layerCache->getTileAt(1, 1, 0);
+		REQUIRE(copyTile);
+		REQUIRE(layerTile);
+		CHECK(layerTile->compressedSize * 10 < copyTile->compressedSize);
+
+		for (int y = 0; y < 2; ++y)
+		{
+			for (int x = 0; x < 2; ++x)
+			{
+				const dtMeshTile* a = copyMesh->getTileAt(x, y, 0);
+				const dtMeshTile* b = layerMesh->getTileAt(x, y, 0);
+				REQUIRE(a);
+				REQUIRE(b);
+				REQUIRE(a->dataSize == b->dataSize);
+				CHECK(memcmp(a->data, b->data, a->dataSize) == 0);
+			}
+		}
+
+		dtFreeTileCache(layerCache);
+		dtFreeNavMesh(layerMesh);
+		dtFreeTileCache(copyCache);
+		dtFreeNavMesh(copyMesh);
+	}
+}